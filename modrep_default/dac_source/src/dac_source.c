@@ -23,6 +23,7 @@
 #include <skeleton.h>
 #include <complex.h>
 #include <math.h>
+#include <time.h>
 
 #include "rtdal.h"
 
@@ -37,6 +38,7 @@ r_dac_t dac;
 static float rate,gain,freq;
 static int nsamples,wait_packets;
 static int blocking;
+static long long sample_idx;
 
 int process_params();
 
@@ -151,6 +153,8 @@ int stream_started=0;
  */
 int work(void **inp, void **out) {
 	int n;
+	struct timespec ts;
+	pkt_meta_t *meta;
 
 	if (!stream_started) {
 		rtdal_dac_start_rx_stream(dac);
@@ -171,12 +175,20 @@ int work(void **inp, void **out) {
 		modinfo_msg("not receiving ts=%d\n",oesr_tstamp(ctx));
 		return 0;
 	}
+	clock_gettime(CLOCK_MONOTONIC,&ts);
 	n = rtdal_dac_recv(dac,out[0],nsamples,blocking);
 	modinfo_msg("ts=%d, recv %d samples\n",oesr_tstamp(ctx),n);
 	if (n != nsamples) {
 		moderror_msg("Recv %d/%d samples\n",n,nsamples);
 		return -1;
 	}
+	meta = get_output_meta(0);
+	if (meta) {
+		meta->tstamp_ns = (long long) ts.tv_sec*1000000000+ts.tv_nsec;
+		meta->sample_idx = sample_idx;
+		meta->flags |= PKT_META_TSTAMP | PKT_META_SAMPLE_IDX;
+	}
+	sample_idx += n;
 
 	return nsamples;
 }
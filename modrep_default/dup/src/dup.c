@@ -51,7 +51,9 @@ int work(void **inp, void **out) {
 		return 0;
 	}
 	for (i=0;i<nof_output_itf;i++) {
-		memcpy(out[i],inp[0],rcv_samples);
+		if (forward_input(0,i)) {
+			return -1;
+		}
 	}
 	return rcv_samples;
 }
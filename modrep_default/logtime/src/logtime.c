@@ -59,6 +59,9 @@ int initialize() {
 			return -1;
 		}
 	}
+	if (set_output_passthrough(0,0)) {
+		return -1;
+	}
 	return 0;
 }
 
@@ -80,7 +83,9 @@ int work(void **inp, void **out) {
 			data[1]=(unsigned int) t.tv_usec;
 			rtdal_log_add(logtime,data,2*sizeof(unsigned int));
 		}
-		memcpy(out[0],inp[0],get_input_samples(0));
+		if (out[0] != inp[0]) {
+			memcpy(out[0],inp[0],get_input_samples(0));
+		}
 		//modinfo_msg("received %d bytes\n",get_input_samples(0));
 		return get_input_samples(0);
 	}
@@ -41,6 +41,11 @@ int initialize() {
 
 	power_id = param_id("power");
 	scale_id = param_id("scale");
+
+	/* output is the input scaled in place */
+	if (set_output_passthrough(0,0)) {
+		return -1;
+	}
 	return 0;
 }
 
@@ -83,6 +83,11 @@ int initialize() {
 
 	bypass=0;
 	param_get_int_name("bypass",&bypass);
+	if (bypass) {
+		if (set_output_passthrough(0,0)) {
+			return -1;
+		}
+	}
 
 	correlation_threshold=10000;
 	param_get_int_name("correlation_threshold",&correlation_threshold);
@@ -124,7 +129,9 @@ int work(void **inp, void **out) {
 	}
 
 	if (bypass) {
-		memcpy(output,input,input_len*sizeof(input_t));
+		if (output != input) {
+			memcpy(output,input,input_len*sizeof(input_t));
+		}
 		output_len=input_len;
 		goto fix_cfo;
 	}
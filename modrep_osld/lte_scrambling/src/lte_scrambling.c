@@ -159,6 +159,10 @@ int initialize() {
 	} else { /* soft-bit scrambling */
 		input_sample_sz=sizeof(float);
 		output_sample_sz=sizeof(float);
+		/* soft bits are descrambled in place */
+		if (set_output_passthrough(0,0)) {
+			return -1;
+		}
 	}
 
 	/* Obtain a handler for fast access to the parameter */
@@ -132,6 +132,14 @@ int oesr_itf_ptr_request(itf_t itf, void **ptr);
 int oesr_itf_ptr_release(itf_t itf, void *ptr, int len);
 int oesr_itf_ptr_put(itf_t itf, void *ptr, int len, int tstamp);
 int oesr_itf_ptr_get(itf_t itf, void **ptr, int *len, int tstamp);
+int oesr_itf_ptr_forward(itf_t out, itf_t in, void *ptr, int len, int tstamp);
+int oesr_itf_ptr_exclusive(itf_t itf, void *ptr);
+int oesr_itf_is_shared(itf_t itf);
+pkt_meta_t *oesr_itf_ptr_meta(itf_t itf, void *ptr);
+int oesr_itf_ptr_request_n(itf_t itf, void **ptr, int max);
+int oesr_itf_ptr_put_n(itf_t itf, void **ptr, int *len, int n, int tstamp);
+int oesr_itf_ptr_get_n(itf_t itf, void **ptr, int *len, int max, int tstamp);
+int oesr_itf_ptr_release_n(itf_t itf, void **ptr, int *len, int n);
 /**@} */
 
 /**@defgroup var Public variables and parameters functions
@@ -300,6 +308,21 @@ int oesr_log_printf(log_t log, const char *fmt, ...);
  * After the samples have been processed, a final call to oesr_itf_ptr_release() allows the packet
  * to be reused again by the transmitter.
  *
+ * A packet received with oesr_itf_ptr_get() can be sent through another interface with
+ * oesr_itf_ptr_forward(). If the platform uses shared interfaces (queue_type="refq" in the
+ * rtdal_opts section of the platform configuration), the buffer is reference-counted: it is not
+ * copied and it is reused once every receiver has released it. Otherwise it is copied to a new packet.
+ *
+ * A receiver that fell behind can drain all its pending packets in a single call with
+ * oesr_itf_ptr_get_n() and release them with oesr_itf_ptr_release_n(). Similarly, a transmitter
+ * can obtain several buffers with oesr_itf_ptr_request_n() and send them with oesr_itf_ptr_put_n().
+ *
+ * Every packet carries a pkt_meta_t header with its timestamp, the index of its first sample, the
+ * subframe and some flags (i.e. end of burst). oesr_itf_ptr_meta() returns the header of a packet
+ * obtained with oesr_itf_ptr_request() or oesr_itf_ptr_get(). The header is cleared when the
+ * packet is requested and travels with it, so it is not copied with the payload. A packet
+ * forwarded without copying shares its header with the input packet.
+ *
  * These functions give the user direct access to the internal RTDAL memory. The buffers are
  * automatically allocated for the size passed as a parameter to the oesr_itf_create() function.
  * The user MUST ensure that this size is not exceed.
@@ -73,6 +73,9 @@ void waveform_delete(waveform_t* waveform);
 int waveform_update(waveform_t *waveform);
 int waveform_parse(waveform_t* waveform, int is_mainwaveform);
 int waveform_mode_set(waveform_t* waveform, char *name);
+int waveform_migrate(waveform_t* waveform, char *name, int processor_idx);
+int waveform_calibrate(waveform_t *waveform, int nof_slots, float percentile, int reload);
+int waveform_calibration_save(waveform_t *waveform);
 /**@} */
 
 /**@defgroup status Waveform status management function
@@ -41,5 +41,21 @@ struct _s_log {
 };
 typedef struct _s_log* log_t;
 
+/* valid fields of pkt_meta_t */
+#define PKT_META_TSTAMP		0x1	/* tstamp_ns is valid */
+#define PKT_META_SAMPLE_IDX	0x2	/* sample_idx is valid */
+#define PKT_META_SUBFRAME	0x4	/* subframe is valid */
+#define PKT_META_EOB		0x8	/* last packet of a burst */
+
+/** Metadata carried with every packet. The size must not exceed RTDAL_PKT_META_SZ */
+typedef struct {
+	long long tstamp_ns;	/* time the first sample was produced or acquired */
+	long long sample_idx;	/* index of the first sample in the stream */
+	int tslot;				/* time slot the packet was generated at */
+	int subframe;
+	int flags;				/* PKT_META_* */
+	int reserved;
+} pkt_meta_t;
+
 
 #endif /* oesr_TYPES_H_ */
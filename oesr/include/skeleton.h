@@ -44,6 +44,80 @@ int get_input_samples(int idx);
  */
 int set_output_samples(int idx, int len);
 
+/** Sends the samples received from the input port in_idx through the output port out_idx.
+ * If the interfaces are shared (queue_type="refq") the same buffer is sent without copying
+ * it, and the buffer of the output port passed to work() is not sent.
+ * \returns 0 on success or -1 on error.
+ */
+int forward_input(int in_idx, int out_idx);
+
+/** Declares that the output port out_idx is the input port in_idx modified in place. Call it
+ * from initialize(). With shared interfaces (queue_type="refq") the output buffer passed to work()
+ * is then the input buffer and it is forwarded downstream (see forward_input()) instead of
+ * requesting a new one. If another module also reads the input buffer, or with the other queue
+ * types, which cannot forward a buffer without copying it, work() receives a separate output
+ * buffer as usual and has to write all of it from the input.
+ * \returns 0 on success or -1 on error.
+ */
+int set_output_passthrough(int out_idx, int in_idx);
+
+/** Returns the metadata (timestamp, sample index, subframe, flags) of the packet received from
+ * the input port idx in this time slot.
+ * \returns a pointer to the metadata or NULL if no packet was received.
+ */
+pkt_meta_t *get_input_meta(int idx);
+
+/** Returns the metadata of the packet sent through the output port idx. Before calling work()
+ * it is a copy of the metadata of the first input port with a packet, or only has the tslot
+ * field set if no packet was received. work() may modify it. Outputs sent with forward_input()
+ * carry the metadata of the input.
+ * \returns a pointer to the metadata or NULL if the port is not connected.
+ */
+pkt_meta_t *get_output_meta(int idx);
+
+/** Enables the batch mode. Call it from initialize(). Then, in each call to work() the module
+ * receives up to max_packets pending packets from every input port, and may send up to
+ * max_packets packets through every output port. This amortizes the cost per call when the
+ * producer is ahead. input[i] and output[i] are the first packet of each port, and the other
+ * packets are accessed with the get_input_packet() and get_output_packet() functions.
+ * forward_input() forwards all the received packets. Passthrough outputs are not supported.
+ * \returns 0 on success or -1 on error.
+ */
+int set_batch_mode(int max_packets);
+
+/** Returns the number of packets received from the input port idx in this call, or -1 on error.
+ */
+int get_input_packets(int idx);
+
+/** Returns the address of the packet k received from the input port idx and saves in nsamples,
+ * if not NULL, its number of samples. Returns NULL if there is no such packet.
+ */
+void *get_input_packet(int idx, int k, int *nsamples);
+
+/** Returns the metadata of the packet k received from the input port idx, or NULL.
+ */
+pkt_meta_t *get_input_packet_meta(int idx, int k);
+
+/** Returns the number of packets that can be sent through the output port idx in this call, or
+ * -1 on error.
+ */
+int get_output_packets(int idx);
+
+/** Returns the address of the packet k of the output port idx, or NULL if there is no such packet.
+ */
+void *get_output_packet(int idx, int k);
+
+/** Sets the number of samples of the packet k of the output port idx. The packet 0 is
+ * set_output_samples() or the value returned by work(). Packets are sent in order until the
+ * first one with no samples.
+ * \returns 0 on success or -1 on error.
+ */
+int set_output_packet_samples(int idx, int k, int len);
+
+/** Returns the metadata of the packet k of the output port idx, or NULL.
+ */
+pkt_meta_t *get_output_packet_meta(int idx, int k);
+
 
 
 int work(void **input, void **output);
@@ -29,7 +29,7 @@ enum variable_serialize_data {
 };
 
 enum waveform_serialize_action {
-	WAVEFORM_LOAD, WAVEFORM_STATUS, WAVEFORM_MODE
+	WAVEFORM_LOAD, WAVEFORM_STATUS, WAVEFORM_MODE, WAVEFORM_MAPPING
 };
 
 int waveform_serialize(waveform_t *dest, packet_t *pkt, int loading_node_id,
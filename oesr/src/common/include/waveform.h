@@ -25,6 +25,17 @@
 #include "str.h"
 #include "objects_max.h"
 
+/** Maximum number of copies of a replicated group of modules */
+#define ITF_MAX_REPLICAS 8
+
+/** Maximum number of output interfaces reported in execinfo_t */
+#define EXECINFO_MAX_ITF 8
+
+/** Number of bins of the execution time histogram in execinfo_t. Bins 0-7 count exact
+ * microseconds, the rest are quarter-octave wide. The last bin collects
+ * everything above ~115 ms */
+#define EXECINFO_HIST_SZ 64
+
 typedef struct {
 	int module_ts;
 	int node_ts;
@@ -40,6 +51,11 @@ typedef struct {
 	time_t t_exec[3];
 	int last_update_ts;
 	int start_ts;
+	int nof_itf;
+	rtdal_itf_stats_t itf[EXECINFO_MAX_ITF]; /**< Telemetry of the output interfaces, if enabled */
+	unsigned int exec_hist[EXECINFO_HIST_SZ]; /**< Histogram of execution times (us) */
+	int processor_idx; /**< Processor where the module is running */
+	rtdal_perf_counters_t perf; /**< Hardware counters of the module, if enabled */
 } execinfo_t;
 
 typedef struct {
@@ -52,6 +68,10 @@ typedef struct {
 	int delay;
 	int log_enable;
 	r_itf_t hw_itf;
+	int replicas; /**< Copies of the remote module when this port enters or leaves a replicated group */
+	int remote_replica; /**< Copy of the remote port this port is connected to */
+	int replica_next; /**< Copy the next packet is sent to or received from */
+	r_itf_t replica_itf[ITF_MAX_REPLICAS];
 } interface_t;
 
 typedef enum {
@@ -106,6 +126,11 @@ typedef struct {
 	int stage;
 	int index;
 	int log_enable;
+	int replicas; /**< Number of copies of the replicated group the module belongs to, or 0 */
+	int replica_idx; /**< Copy number. Copies of the same module have consecutive ids */
+	int replica_group;
+	int period; /**< The module runs once every period time slots, 0 or 1 runs it every slot */
+	int phase; /**< Time slot, modulo period, in which the module runs */
 } module_t;
 
 
@@ -162,4 +187,6 @@ int waveform_alloc(waveform_t *waveform, int nof_modules);
 int waveform_free(waveform_t *waveform);
 int variable_alloc(variable_t *variable, int nof_modes);
 int variable_free(variable_t *variable);
+void execinfo_hist_add(execinfo_t *obj, int exec_us);
+int execinfo_hist_percentile(unsigned int *hist, float percentile);
 #endif
@@ -102,6 +102,23 @@ int waveform_serialize(waveform_t *src, packet_t *pkt, int loading_node_id,
 			}
 		}
 	break;
+	case WAVEFORM_MAPPING:
+		nof_modules = 0;
+		for (i=0;i<src->nof_modules;i++) {
+			man_node_t *node = src->modules[i].node;
+			if (loading_node_id == node->id) {
+				nof_modules++;
+			}
+		}
+		add_i(&nof_modules);
+		for (i=0;i<src->nof_modules;i++) {
+			man_node_t *node = src->modules[i].node;
+			if (loading_node_id == node->id) {
+				add_i(&src->modules[i].id);
+				add_i(&src->modules[i].processor_idx);
+			}
+		}
+	break;
 	}
 	return 0;
 }
@@ -183,6 +200,8 @@ int module_serialize(module_t *src, packet_t *pkt, enum variable_serialize_data
 	add_i(&src->nof_modes);
 	add_i(&src->mode.cur_mode);
 	add_i(&src->log_enable);
+	add_i(&src->period);
+	add_i(&src->phase);
 	if (packet_add_data(pkt,src->name,STR_LEN))
 		return -1;
 	if (packet_add_data(pkt,src->binary,STR_LEN))
@@ -224,6 +243,8 @@ int module_unserializeTo(packet_t *pkt, module_t *dest, enum variable_serialize_
 	get_i(&dest->nof_modes);
 	get_i(&dest->mode.cur_mode);
 	get_i(&dest->log_enable);
+	get_i(&dest->period);
+	get_i(&dest->phase);
 	dest->mode.next_tslot = 0;
 	if (packet_get_data(pkt,dest->name,STR_LEN)) return -1;
 	if (packet_get_data(pkt,dest->binary,STR_LEN)) return -1;
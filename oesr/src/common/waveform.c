@@ -176,3 +176,53 @@ int variable_free(variable_t *variable) {
 }
 
 
+
+static int execinfo_hist_bin(int exec_us) {
+	int msb, idx;
+	if (exec_us < 8) {
+		return exec_us<0?0:exec_us;
+	}
+	msb = 31-__builtin_clz((unsigned int) exec_us);
+	idx = (msb-1)*4 + ((exec_us>>(msb-2))&3);
+	return idx<EXECINFO_HIST_SZ?idx:EXECINFO_HIST_SZ-1;
+}
+
+/* lower edge (us) of bin idx */
+static int execinfo_hist_edge(int idx) {
+	if (idx < 8) {
+		return idx;
+	}
+	return (4+idx%4)<<(idx/4-1);
+}
+
+/** Adds an execution time sample to the histogram of the execinfo object
+ */
+void execinfo_hist_add(execinfo_t *obj, int exec_us) {
+	obj->exec_hist[execinfo_hist_bin(exec_us)]++;
+}
+
+/** Computes the given percentile (0-100) of a histogram filled with execinfo_hist_add().
+ * The upper edge of the bin is returned, so the result is a conservative estimate.
+ * \returns the percentile in microseconds or -1 if the histogram is empty
+ */
+int execinfo_hist_percentile(unsigned int *hist, float percentile) {
+	int i;
+	unsigned long long total=0, acc=0, th;
+	for (i=0;i<EXECINFO_HIST_SZ;i++) {
+		total += hist[i];
+	}
+	if (!total) {
+		return -1;
+	}
+	th = (unsigned long long) (percentile*total/100);
+	if (th >= total) {
+		th = total-1;
+	}
+	for (i=0;i<EXECINFO_HIST_SZ-1;i++) {
+		acc += hist[i];
+		if (acc > th) {
+			break;
+		}
+	}
+	return i<EXECINFO_HIST_SZ-1?execinfo_hist_edge(i+1):2*execinfo_hist_edge(i);
+}
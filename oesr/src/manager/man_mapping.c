@@ -166,6 +166,11 @@ void generate_model_platform(man_platform_t *platform) {
 	}
 }
 
+/* cost of the module in its current mode, the one waveform_calibrate() measures */
+static float module_cost(module_t *module) {
+	return module->c_mopts[module->mode.cur_mode];
+}
+
 void generate_model_c_vector(waveform_t *waveform, int multiplicity) {
 	int i,j,k;
 	int M = waveform->nof_modules;
@@ -173,7 +178,11 @@ void generate_model_c_vector(waveform_t *waveform, int multiplicity) {
 	memset(tmp_c,0,sizeof(float)*M);
 
 	for (i=0;i<M;i++) {
-		tmp_c[join_function[i]] += waveform->modules[i].c_mopts[0]*multiplicity;
+		/* each copy of a replicated group processes one of every replicas packets and
+		 * multi-rate modules run once every period slots */
+		tmp_c[join_function[i]] += module_cost(&waveform->modules[i])*multiplicity/
+				(waveform->modules[i].replicas>1?waveform->modules[i].replicas:1)/
+				(waveform->modules[i].period>1?waveform->modules[i].period:1);
 		wave.force[i] = -1;
 	}
 	j=0;
@@ -202,6 +211,14 @@ void generate_model_c_vector(waveform_t *waveform, int multiplicity) {
 	mapdebug("\n",0);
 	wave.nof_tasks = j;
 
+	/* copies of a replicated group run on different processors */
+	for (k=0;k<j;k++) {
+		i = joined_function[k];
+		if (waveform->modules[i].replicas > 1) {
+			wave.force[k] = waveform->modules[i].replica_idx%plat.nof_processors;
+		}
+	}
+
 	mapdebug("c_res=",0);
 	for (i=0;i<j;i++) {
 		mapdebug("%g,",wave.c[i]);
@@ -286,6 +303,12 @@ void generate_model_stages(waveform_t *waveform) {
 					if (waveform->modules[i].outputs[j].delay == -1) {
 						waveform->modules[i].outputs[j].delay = abs(waveform->modules[i].stage-waveform->modules[k].stage);
 					}
+					/* a copy leaving its replicated group has replicas time slots per packet */
+					if (waveform->modules[i].replicas > 1
+							&& waveform->modules[k].replica_group != waveform->modules[i].replica_group
+							&& waveform->modules[i].outputs[j].delay < waveform->modules[i].replicas) {
+						waveform->modules[i].outputs[j].delay = waveform->modules[i].replicas;
+					}
 					mapdebug("delay %s:%d->%s(%d):%d is %d slots\n",waveform->modules[i].name,
 							j, waveform->modules[k].name,waveform->modules[k].id,
 							waveform->modules[i].outputs[j].remote_port_idx,
@@ -342,10 +365,10 @@ int call_algorithm(mapping_t *m, waveform_t *waveform, man_platform_t *platform)
 			m->p_res[i]=0;
 
 			for (int j = 0; j < waveform->modules[i].nof_outputs; j++) {
-				waveform->modules[i].outputs[j].delay = -1;
+				waveform->modules[i].outputs[j].delay = RTDAL_ITF_FUTEX;
 			}
 			for (int j = 0; j < waveform->modules[i].nof_inputs; j++) {
-				waveform->modules[i].inputs[j].delay = -1;
+				waveform->modules[i].inputs[j].delay = RTDAL_ITF_FUTEX;
 			}
 		}
 		for (int i=0;i<waveform->nof_modules;i++) {
@@ -353,7 +376,7 @@ int call_algorithm(mapping_t *m, waveform_t *waveform, man_platform_t *platform)
 				if (waveform->modules[i].inputs[j].remote_module_id>waveform->modules[i].id) {
 					for (int k=0;k<waveform->nof_modules;k++) {
 						if (waveform->modules[k].id == waveform->modules[i].inputs[j].remote_module_id) {
-							waveform->modules[k].outputs[waveform->modules[i].inputs[j].remote_port_idx].delay = -2;
+							waveform->modules[k].outputs[waveform->modules[i].inputs[j].remote_port_idx].delay = RTDAL_ITF_POLLING;
 						}
 					}
 				}
@@ -412,7 +435,7 @@ int mapping_map(mapping_t *m, waveform_t *waveform) {
 		waveform->modules[i].exec_position = i;/*waveform->nof_modules-i-1;*/
 		node = p->node;
 		m->modules_x_node[node->id]++;
-		total_mopts+=waveform->modules[i].c_mopts[0];
+		total_mopts+=module_cost(&waveform->modules[i]);
 	}
 	printf("Done. %g GOPTS\n",total_mopts/1000);
 	ret = 0;
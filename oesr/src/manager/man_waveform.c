@@ -16,6 +16,9 @@
  * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <rtdal.h>
 #include "str.h"
 #include "defs.h"
@@ -136,6 +139,152 @@ int waveform_update(waveform_t *waveform) {
 }
 
 
+/** Writes the calibrated computing costs of the waveform to the sidecar file
+ * <model_file>.cal, which is read by waveform_parse() on the next start.
+ * \returns 0 on success or -1 on error.
+ */
+int waveform_calibration_save(waveform_t *waveform) {
+	char path[LSTR_LEN];
+	FILE *f;
+	int i,j;
+
+	snprintf(path,LSTR_LEN,"%s.cal",waveform->model_file);
+	f = fopen(path,"w");
+	if (!f) {
+		aerror_msg("opening calibration file %s\n",path);
+		return -1;
+	}
+	fprintf(f,"# Calibrated computing costs for %s. Generated by waveform_calibrate()\n",
+			waveform->model_file);
+	fprintf(f,"calibration = (\n");
+	for (i=0;i<waveform->nof_modules;i++) {
+		fprintf(f,"\t{name=\"%s\"; mopts=[",waveform->modules[i].name);
+		for (j=0;j<waveform->nof_modes;j++) {
+			fprintf(f,"%s%.4f",j?", ":"",waveform->modules[i].c_mopts[j]);
+		}
+		fprintf(f,"];}%s\n",i<waveform->nof_modules-1?",":"");
+	}
+	fprintf(f,");\n");
+	fclose(f);
+	return 0;
+}
+
+static int waveform_restart(waveform_t *waveform) {
+	waveform_status_t new_status;
+
+	new_status.next_timeslot = rtdal_time_slot();
+	new_status.cur_status = STOP;
+	if (waveform_status_set(waveform,&new_status)) {
+		return -1;
+	}
+	if (waveform_load(waveform)) {
+		return -1;
+	}
+	new_status.cur_status = INIT;
+	if (waveform_status_set(waveform,&new_status)) {
+		return -1;
+	}
+	new_status.cur_status = RUN;
+	if (waveform_status_set(waveform,&new_status)) {
+		return -1;
+	}
+	return 0;
+}
+
+/** Replaces the static computing cost of each module (the mopts in the model file) with
+ * the measured one. The waveform must be running. It is monitored during nof_slots time
+ * slots and the given percentile of the execution time of each module in that window is
+ * fed back into the cost model for the module's current mode. Modules that did not
+ * execute keep their cost. The calibrated costs are saved with waveform_calibration_save().
+ * If reload is non-zero, the mapping is recomputed and the waveform is stopped, loaded
+ * again with the new mapping and set to run.
+ * \returns 0 on success or -1 on error.
+ */
+int waveform_calibrate(waveform_t *waveform, int nof_slots, float percentile, int reload) {
+	man_platform_t *platform = man_platform_get_context();
+	unsigned int *hist;
+	time_t t;
+	int i,j,p,mode,multiplicity,end_ts;
+	float c;
+
+	aassert(waveform);
+	if (!waveform_status_is_running(&waveform->status)) {
+		aerror("Waveform must be running to calibrate\n");
+		return -1;
+	}
+	if (nof_slots <= 0 || percentile <= 0 || percentile > 100) {
+		aerror("Invalid calibration parameters\n");
+		return -1;
+	}
+	hist = calloc(waveform->nof_modules,sizeof(unsigned int)*EXECINFO_HIST_SZ);
+	if (!hist) {
+		aerror("allocating memory\n");
+		return -1;
+	}
+	/* the histograms are cumulative, keep a snapshot to measure only this window */
+	if (waveform_update(waveform)) {
+		goto error;
+	}
+	for (i=0;i<waveform->nof_modules;i++) {
+		memcpy(&hist[i*EXECINFO_HIST_SZ],waveform->modules[i].execinfo.exec_hist,
+				sizeof(unsigned int)*EXECINFO_HIST_SZ);
+	}
+	end_ts = rtdal_time_slot()+nof_slots;
+	while(rtdal_time_slot() < end_ts) {
+		t.tv_sec = 0;
+		t.tv_usec = platform->ts_length_us>1000?platform->ts_length_us:1000;
+		rtdal_sleep(&t);
+	}
+	if (waveform_update(waveform)) {
+		goto error;
+	}
+
+	if (waveform->granularity_us) {
+		multiplicity = platform->ts_length_us/waveform->granularity_us;
+	} else {
+		multiplicity = 1;
+	}
+	if (!multiplicity) {
+		multiplicity = 1;
+	}
+
+	printf("Calibration (p%.1f over %d slots):\n",percentile,nof_slots);
+	for (i=0;i<waveform->nof_modules;i++) {
+		for (j=0;j<EXECINFO_HIST_SZ;j++) {
+			hist[i*EXECINFO_HIST_SZ+j] = waveform->modules[i].execinfo.exec_hist[j]-
+					hist[i*EXECINFO_HIST_SZ+j];
+		}
+		p = execinfo_hist_percentile(&hist[i*EXECINFO_HIST_SZ],percentile);
+		mode = waveform->modules[i].mode.cur_mode;
+		if (p < 0) {
+			printf("  %-20s\t%8.2f (no samples)\n",waveform->modules[i].name,
+					waveform->modules[i].c_mopts[mode]);
+			continue;
+		}
+		c = (float) p/multiplicity;
+		printf("  %-20s\t%8.2f -> %8.2f\n",waveform->modules[i].name,
+				waveform->modules[i].c_mopts[mode],c);
+		waveform->modules[i].c_mopts[mode] = c;
+	}
+	free(hist);
+	hist = NULL;
+
+	if (waveform_calibration_save(waveform)) {
+		return -1;
+	}
+	if (reload) {
+		if (waveform_restart(waveform)) {
+			aerror("reloading calibrated waveform\n");
+			return -1;
+		}
+	}
+	return 0;
+error:
+	free(hist);
+	return -1;
+}
+
+
 /**  Returns 1 if the waveform is allowed to transmit from the current status to the
  * new_status passed as second parameter, zero otherwise
  */
@@ -242,6 +391,37 @@ int waveform_mode_set(waveform_t* waveform, char *name) {
 }
 
 
+/**
+ * Moves the module name, and the modules connected to it with zero delay, to the processor
+ * processor_idx of its node without stopping the waveform. The processor of every module is
+ * then updated from the node.
+ */
+int waveform_migrate(waveform_t* waveform, char *name, int processor_idx) {
+	module_t *module;
+	int i;
+	mdebug("waveform_id=%d name=%s processor_idx=%d\n",waveform->id,name,processor_idx);
+	if (!waveform_status_is_loaded(&waveform->status)) {
+		aerror("Waveform is not loaded\n");
+		return -1;
+	}
+	module = waveform_find_module_name(waveform, name);
+	if (!module) {
+		aerror_msg("module %s not found\n",name);
+		return -1;
+	}
+	module->processor_idx = processor_idx;
+	if (waveform_send(waveform, CMD_SET, WAVEFORM_MAPPING)) {
+		return -1;
+	}
+	if (waveform_update(waveform)) {
+		return -1;
+	}
+	for (i=0;i<waveform->nof_modules;i++) {
+		waveform->modules[i].processor_idx = waveform->modules[i].execinfo.processor_idx;
+	}
+	return 0;
+}
+
 /**
  *  returns true if the Status is LOADED, INIT, RUN or PAUSE
  */
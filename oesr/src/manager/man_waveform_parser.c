@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <libconfig.h>
 #include <string.h>
+#include <unistd.h>
 
 #if (((LIBCONFIG_VER_MAJOR < 1) || (LIBCONFIG_VER_MINOR < 4) \
 	   || (LIBCONFIG_VER_REVISION < 8)))
@@ -37,6 +38,7 @@
 #define ITF_PREALLOC 100
 
 static int waveform_id=1;
+static int replica_groups=0;
 strdef(tmp_string);
 
 static int find_mode(waveform_t *w, const char *name) {
@@ -317,67 +319,101 @@ static int read_interface_mod_itf(config_setting_t *cfg, waveform_t *w,
 	return 1;
 }
 
-static int read_interface(config_setting_t *cfg, waveform_t *w) {
+/** Reads an interface connecting a module port to the physical interface with the id given
+ * by the "physic" field. Only one of src or dest must be given.
+ */
+static int read_physic_interface(config_setting_t *cfg, waveform_t *w, int physic_id) {
 	config_setting_t *src=NULL, *dest=NULL;
-	module_t *src_module=NULL, *dest_module=NULL;
-	interface_t *src_itf=NULL, *dest_itf=NULL;
-	int src_port, dest_port;
-	double tmp;
+	module_t *module=NULL;
+	interface_t *itf=NULL;
+	int port;
 
-	src = config_setting_get_member(cfg, "src");
-	if (!src) {
-		aerror("missing src\n");
+	if (physic_id <= 0) {
+		aerror_msg("invalid physic interface id %d\n",physic_id);
 		return 0;
 	}
+	src = config_setting_get_member(cfg, "src");
 	dest = config_setting_get_member(cfg, "dest");
-	if (!dest) {
-		aerror("missing dest\n");
+	if ((src && dest) || (!src && !dest)) {
+		aerror("physic interfaces must have either src or dest\n");
 		return 0;
 	}
-	if (!read_interface_mod_itf(src,w,&src_module,&src_port,1)) {
-		aerror("reading src\n");
+	if (!read_interface_mod_itf(src?src:dest,w,&module,&port,src?1:0)) {
+		aerror("reading physic interface\n");
 		return 0;
 	}
-
-	if (w->auto_ctrl_module) {
-		src_port++;
+	if (!module) {
+		aerror("physic interfaces can not be connected to waveform ports\n");
+		return 0;
 	}
-
-	if (src_port > ITF_PREALLOC) {
-		aerror_msg("src port too high. Maximum is %d\n",ITF_PREALLOC);
+	if (src && w->auto_ctrl_module) {
+		port++;
+	}
+	if (port >= ITF_PREALLOC) {
+		aerror_msg("port too high. Maximum is %d\n",ITF_PREALLOC);
 		return 0;
 	}
-
-	if (src_module) {
-		src_itf = &src_module->outputs[src_port];
+	if (src) {
+		itf = &module->outputs[port];
+	} else {
+		itf = &module->inputs[port];
 	}
-
-	if (!read_interface_mod_itf(dest,w,&dest_module,&dest_port,0)) {
-		aerror("reading src\n");
+	if (itf->remote_module_id || itf->physic_itf_id) {
+		aerror_msg("port %d in module %s already connected\n",port,module->name);
 		return 0;
 	}
-
-	if (dest_module && dest_module == w->auto_ctrl_module) {
-		dest_port+=dest_module->nof_outputs;
+	if (src) {
+		module->nof_outputs++;
+	} else {
+		module->nof_inputs++;
+	}
+	itf->physic_itf_id = physic_id;
+	itf->remote_module_id = 0;
+	itf->remote_port_idx = 0;
+	itf->total_mbpts = 0;
+	if (!config_setting_lookup_int(cfg, "delay", &itf->delay)) {
+		itf->delay = -1;
+	}
+	if (!config_setting_lookup_bool(cfg, "log", &itf->log_enable)) {
+		itf->log_enable = 0;
 	}
+	pardebug("%d:%d<->physic %d\n",module->id,port,physic_id);
+	return 1;
+}
 
-	if (dest_port > ITF_PREALLOC) {
-		aerror_msg("src port too high. Maximum is %d\n",ITF_PREALLOC);
-		return 0;
+enum replica_fan {
+	FAN_NONE, FAN_SRC, FAN_DEST
+};
+
+/** Connects the output src_port of src_module to the input dest_port of dest_module. A NULL
+ * module is a port of the model (_input or _output) which is connected when the model is
+ * included. When one side is a replicated group, the other side (src with FAN_SRC, dest with
+ * FAN_DEST) is connected once for each copy r. Its port points to the first copy and sends
+ * (or receives) the packets to (from) the copies in turn.
+ */
+static int connect_interface(config_setting_t *cfg, module_t *src_module, int src_port,
+		module_t *dest_module, int dest_port, enum replica_fan fan, int r, int replicas) {
+	interface_t *src_itf=NULL, *dest_itf=NULL;
+	int src_once = fan == FAN_SRC && r > 0;
+	int dest_once = fan == FAN_DEST && r > 0;
+	double tmp;
+
+	if (src_module) {
+		src_itf = &src_module->outputs[src_port];
 	}
 	if (dest_module) {
 		dest_itf = &dest_module->inputs[dest_port];
 	}
 
-	if (dest_module && dest_itf && dest_itf->remote_module_id >= 0) {
+	if (dest_module && dest_itf && dest_itf->remote_module_id >= 0 && !dest_once) {
 		dest_module->nof_inputs++;
 	}
 
-	if (src_module && src_itf && src_itf->remote_module_id >= 0) {
+	if (src_module && src_itf && src_itf->remote_module_id >= 0 && !src_once) {
 		src_module->nof_outputs++;
 	}
 
-	if (src_itf) {
+	if (src_itf && !src_once) {
 		if (dest_module) {
 			src_itf->remote_module_id = dest_module->id;
 		} else {
@@ -390,13 +426,13 @@ static int read_interface(config_setting_t *cfg, waveform_t *w) {
 		printf("dest_id=%d, dest_port=%d\n",src_itf->remote_module_id,src_itf->remote_port_idx);
 	}
 */
-	if (dest_module && dest_itf && dest_itf->remote_module_id>0) {
+	if (dest_module && dest_itf && dest_itf->remote_module_id>0 && !dest_once) {
 		aerror_msg("input port %d in module %s already connected\n",
 				dest_port,dest_module->name);
 		return 0;
 	}
 
-	if (dest_itf) {
+	if (dest_itf && !dest_once) {
 		if (src_module) {
 			dest_itf->remote_module_id = src_module->id;
 		} else {
@@ -405,6 +441,22 @@ static int read_interface(config_setting_t *cfg, waveform_t *w) {
 		dest_itf->remote_port_idx = src_port;
 	}
 
+	if (fan == FAN_SRC) {
+		if (src_itf) {
+			src_itf->replicas = replicas;
+		}
+		if (dest_itf) {
+			dest_itf->remote_replica = r;
+		}
+	} else if (fan == FAN_DEST) {
+		if (dest_itf) {
+			dest_itf->replicas = replicas;
+		}
+		if (src_itf) {
+			src_itf->remote_replica = r;
+		}
+	}
+
 	if (src_itf) {
 		if (config_setting_lookup_float(cfg, "mbpts", &tmp)) {
 			src_itf->total_mbpts = (float) tmp;
@@ -442,6 +494,90 @@ static int read_interface(config_setting_t *cfg, waveform_t *w) {
 	return 1;
 }
 
+static int read_interface(config_setting_t *cfg, waveform_t *w) {
+	config_setting_t *src=NULL, *dest=NULL;
+	module_t *src_module=NULL, *dest_module=NULL;
+	int src_port, dest_port;
+	int src_copies, dest_copies, r;
+
+	if (config_setting_lookup_int(cfg, "physic", &src_port)) {
+		return read_physic_interface(cfg, w, src_port);
+	}
+
+	src = config_setting_get_member(cfg, "src");
+	if (!src) {
+		aerror("missing src\n");
+		return 0;
+	}
+	dest = config_setting_get_member(cfg, "dest");
+	if (!dest) {
+		aerror("missing dest\n");
+		return 0;
+	}
+	if (!read_interface_mod_itf(src,w,&src_module,&src_port,1)) {
+		aerror("reading src\n");
+		return 0;
+	}
+
+	if (w->auto_ctrl_module) {
+		src_port++;
+	}
+
+	if (src_port > ITF_PREALLOC) {
+		aerror_msg("src port too high. Maximum is %d\n",ITF_PREALLOC);
+		return 0;
+	}
+
+	if (!read_interface_mod_itf(dest,w,&dest_module,&dest_port,0)) {
+		aerror("reading src\n");
+		return 0;
+	}
+
+	if (dest_module && dest_module == w->auto_ctrl_module) {
+		dest_port+=dest_module->nof_outputs;
+	}
+
+	if (dest_port > ITF_PREALLOC) {
+		aerror_msg("src port too high. Maximum is %d\n",ITF_PREALLOC);
+		return 0;
+	}
+
+	src_copies = (src_module && src_module->replicas > 1)?src_module->replicas:1;
+	dest_copies = (dest_module && dest_module->replicas > 1)?dest_module->replicas:1;
+
+	if (src_copies > 1 && dest_copies > 1) {
+		/* inside a replicated group, each copy is connected to the same copy */
+		if (src_module->replica_group != dest_module->replica_group) {
+			aerror_msg("can not connect %s to %s, they are in different replicated groups\n",
+					src_module->name,dest_module->name);
+			return 0;
+		}
+		for (r=0;r<src_copies;r++) {
+			if (!connect_interface(cfg,src_module+r,src_port,dest_module+r,dest_port,
+					FAN_NONE,0,0)) {
+				return 0;
+			}
+		}
+	} else if (dest_copies > 1) {
+		for (r=0;r<dest_copies;r++) {
+			if (!connect_interface(cfg,src_module,src_port,dest_module+r,dest_port,
+					FAN_SRC,r,dest_copies)) {
+				return 0;
+			}
+		}
+	} else if (src_copies > 1) {
+		for (r=0;r<src_copies;r++) {
+			if (!connect_interface(cfg,src_module+r,src_port,dest_module,dest_port,
+					FAN_DEST,r,src_copies)) {
+				return 0;
+			}
+		}
+	} else {
+		return connect_interface(cfg,src_module,src_port,dest_module,dest_port,FAN_NONE,0,0);
+	}
+	return 1;
+}
+
 static int read_mopts_mode(config_setting_t *cfg, module_t *mod, waveform_t *w) {
 	const char *tmp;
 	int i;
@@ -548,6 +684,24 @@ static int read_module(config_setting_t *cfg, module_t *mod, waveform_t *w, int
 	if (t) {
 		mod->log_enable |=0x2;
 	}
+	/* multi-rate modules run once every period time slots */
+	mod->period = 1;
+	mod->phase = 0;
+	config_setting_lookup_int(cfg, "period", &mod->period);
+	if (mod->period < 1) {
+		aerror_msg("invalid period %d in module %s\n",mod->period,mod->name);
+		return 0;
+	}
+	if (config_setting_lookup_int(cfg, "phase", &mod->phase) && mod->period == 1) {
+		awarn("Ignoring phase %d of module %s, which runs every time slot\n",mod->phase,
+				mod->name);
+		mod->phase = 0;
+	}
+	if (mod->phase < 0 || mod->phase >= mod->period) {
+		aerror_msg("invalid phase %d in module %s with period %d\n",mod->phase,mod->name,
+				mod->period);
+		return 0;
+	}
 	n_vars = read_variables(cfg, mod, mod->name, w);
 	if (n_vars < 0) {
 		aerror_msg("reading variables for module %s\n", mod->name);
@@ -596,7 +750,7 @@ void check_interfaces(module_t *module) {
 	int i;
 	for (i=0;i<module->nof_inputs;i++) {
 		module->inputs[i].id = i;
-		if (!module->inputs[i].remote_module_id) {
+		if (!module->inputs[i].remote_module_id && !module->inputs[i].physic_itf_id) {
 			aerror_msg("warning: module %s has %d input ports but port %d "
 					"has not been connected\n",module->name,module->nof_inputs,
 					i);
@@ -604,7 +758,7 @@ void check_interfaces(module_t *module) {
 	}
 	for (i=0;i<module->nof_outputs;i++) {
 		module->outputs[i].id = module->nof_inputs+i;
-		if (!module->outputs[i].remote_module_id) {
+		if (!module->outputs[i].remote_module_id && !module->outputs[i].physic_itf_id) {
 			aerror_msg("warning: module %s has %d output ports but port %d "
 					"has not been connected\n",module->name,module->nof_outputs,
 					i);
@@ -737,6 +891,101 @@ int join_stages(waveform_t *w, config_setting_t *cfg) {
 }
 
 
+/** Returns the number of copies of the module name given in the replicate section of the
+ * model file, 1 if it is not replicated or -1 on error. The position of its group in the
+ * section is saved in group.
+ */
+static int read_replicas(config_setting_t *replicate, const char *name, int *group) {
+	config_setting_t *grp, *mods;
+	const char *tmp;
+	int i,j,copies;
+
+	if (!replicate || !name) {
+		return 1;
+	}
+	for (i=0;i<config_setting_length(replicate);i++) {
+		grp = config_setting_get_elem(replicate, (unsigned int) i);
+		mods = config_setting_get_member(grp, "modules");
+		if (!mods || !config_setting_lookup_int(grp, "copies", &copies)) {
+			aerror_msg("replicate group %d must have modules and copies fields\n",i);
+			return -1;
+		}
+		for (j=0;j<config_setting_length(mods);j++) {
+			tmp = config_setting_get_string_elem(mods, (unsigned int) j);
+			if (tmp && !strcmp(tmp,name)) {
+				if (copies < 1 || copies > ITF_MAX_REPLICAS) {
+					aerror_msg("replicate group %d has %d copies, maximum is %d\n",i,copies,
+							ITF_MAX_REPLICAS);
+					return -1;
+				}
+				*group = i;
+				return copies;
+			}
+		}
+	}
+	return 1;
+}
+
+/** Overrides the computing costs parsed from the model file with the ones in the
+ * calibration sidecar file <model_file>.cal, generated by waveform_calibrate().
+ * Missing file is not an error. Modules not found in the file keep their cost.
+ * \returns 0 on success or -1 on error
+ */
+static int read_calibration(waveform_t *w) {
+	char path[LSTR_LEN];
+	config_t config;
+	config_setting_t *cal, *modcfg, *mopts, *elem;
+	module_t *mod;
+	const char *name;
+	int i,j,n,ret=-1;
+
+	snprintf(path,LSTR_LEN,"%s.cal",w->model_file);
+	if (access(path,R_OK)) {
+		return 0;
+	}
+	config_init(&config);
+	if (!config_read_file(&config, path)) {
+		aerror_msg("%s line %d - %s: \n", path, config_error_line(&config),
+				config_error_text(&config));
+		goto destroy;
+	}
+	cal = config_lookup(&config, "calibration");
+	if (!cal) {
+		aerror_msg("Section calibration not found in %s\n",path);
+		goto destroy;
+	}
+	n = config_setting_length(cal);
+	for (i=0;i<n;i++) {
+		modcfg = config_setting_get_elem(cal, (unsigned int) i);
+		if (!config_setting_lookup_string(modcfg, "name", &name)) {
+			aerror_msg("Missing module name in %s\n",path);
+			goto destroy;
+		}
+		mod = waveform_find_module_name(w, (char*) name);
+		if (!mod) {
+			continue;
+		}
+		mopts = config_setting_get_member(modcfg, "mopts");
+		if (!mopts || config_setting_length(mopts) != w->nof_modes) {
+			aerror_msg("Invalid mopts for module %s in %s\n",name,path);
+			goto destroy;
+		}
+		for (j=0;j<w->nof_modes;j++) {
+			elem = config_setting_get_elem(mopts, (unsigned int) j);
+			if (config_setting_type(elem) == CONFIG_TYPE_INT) {
+				mod->c_mopts[j] = (float) config_setting_get_int(elem);
+			} else {
+				mod->c_mopts[j] = (float) config_setting_get_float(elem);
+			}
+			pardebug("[cal] %s mopts[%d]=%.2f\n",name,j,mod->c_mopts[j]);
+		}
+	}
+	ret = 0;
+destroy:
+	config_destroy(&config);
+	return ret;
+}
+
 /** Fills the contents of the object w with the configuration of file w->model_file.
  * waveform_parse() allocates memory for modules, interfaces and variables as required by the model file.
  * It also generates the waveform resource model (c,b) and saves it in w->c and w->b.
@@ -748,9 +997,10 @@ int waveform_parse(waveform_t* w, int is_mainwaveform) {
 	aassert(w);
 	int ret;
 	config_setting_t *modules, *modcfg, *interfaces, *itfcfg, *modes, *modecfg,*maincfg;
+	config_setting_t *replicate;
 	int nof_modules, nof_root_modules,nof_itfs,nof_modes;
 	int i,j;
-	int instances;
+	int instances, copies, group, groups_base;
 	module_t *mod;
 	const char *tmp;
 	config_t config;
@@ -803,6 +1053,13 @@ int waveform_parse(waveform_t* w, int is_mainwaveform) {
 	nof_root_modules = config_setting_length(modules);
 	nof_modules = 0;
 
+	/* groups of modules instantiated several times, each copy receives one packet in turn */
+	replicate = config_lookup(&config, "replicate");
+	groups_base = replica_groups;
+	if (replicate) {
+		replica_groups += config_setting_length(replicate);
+	}
+
 	/* find multiple instances modules */
 	for (i=0;i<nof_root_modules;i++) {
 		modcfg = config_setting_get_elem(modules, (unsigned int) i);
@@ -810,7 +1067,11 @@ int waveform_parse(waveform_t* w, int is_mainwaveform) {
 			if (config_setting_lookup_int(modcfg, "instances", &instances)) {
 				nof_modules += instances;
 			} else {
-				nof_modules ++;
+				copies = read_replicas(replicate, config_setting_name(modcfg), &group);
+				if (copies < 0) {
+					goto destroy;
+				}
+				nof_modules += copies;
 			}
 		}
 	}
@@ -829,6 +1090,31 @@ int waveform_parse(waveform_t* w, int is_mainwaveform) {
 		if (!config_setting_lookup_int(modcfg, "instances", &instances)) {
 			instances = 1;
 		}
+		copies = read_replicas(replicate, config_setting_name(modcfg), &group);
+		if (copies < 0) {
+			goto destroy;
+		}
+		if (copies > 1) {
+			if (instances > 1 || config_setting_lookup_string(modcfg, "include", &tmp)) {
+				aerror_msg("module %s can not be replicated\n",config_setting_name(modcfg));
+				goto destroy;
+			}
+			/* copies of the same module are consecutive, the first keeps the name */
+			for (j=0;j<copies;j++) {
+				mod = &w->modules[w->nof_parsed_modules];
+				if (!read_module(modcfg,mod, w, -1)) {
+					aerror_msg("parsing module %d\n",i);
+					goto destroy;
+				}
+				if (j) {
+					snprintf(&mod->name[strlen(mod->name)],STR_LEN-strlen(mod->name),"_%d",j);
+				}
+				mod->replicas = copies;
+				mod->replica_idx = j;
+				mod->replica_group = groups_base+group+1;
+			}
+			continue;
+		}
 		for (j=0;j<instances;j++) {
 			pardebug("parsing module %d position %d\n",i,w->nof_parsed_modules);
 			if (nof_modules) {
@@ -889,6 +1175,10 @@ int waveform_parse(waveform_t* w, int is_mainwaveform) {
 				goto destroy;
 			}
 		}
+		if (read_calibration(w)) {
+			aerror("Reading calibration file\n");
+			goto destroy;
+		}
 		w->id = waveform_id++;
 	}
 
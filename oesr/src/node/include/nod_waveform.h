@@ -51,6 +51,8 @@ typedef struct {
 	int finishing;
 	int tslot_multiplicity;
 	int precach_pipeline;
+	long queue_mem;				/** bytes allocated by the internal interfaces */
+	long queue_mem_fixed;		/** bytes they would take with fixed-size slots */
 	strdef(name);
 } nod_waveform_t;
 
@@ -64,6 +66,8 @@ int nod_waveform_status_stop(nod_waveform_t *waveform);
 void* nod_waveform_reset_pipeline(void *_waveform);
 nod_module_t* nod_waveform_find_module_id(nod_waveform_t *w, int module_id);
 nod_module_t* nod_waveform_find_module_name(nod_waveform_t *w, char *name);
+int nod_waveform_migrate(nod_waveform_t *w, nod_module_t *module, int processor_idx);
+int nod_waveform_balance(nod_waveform_t *w, int processor_idx);
 
 int nod_module_alloc(nod_module_t *module);
 int nod_module_load(nod_module_t *module);
@@ -78,6 +82,8 @@ variable_t* nod_module_variable_get(nod_module_t *module, string name);
 variable_t* nod_module_variable_create(nod_module_t *module, string name, int size);
 
 int nod_module_execinfo_add_sample(execinfo_t *execinfo, int ctx_tstamp);
+int nod_module_execinfo_itf(nod_module_t *module);
+int nod_module_execinfo_perf(nod_module_t *module);
 
 int nod_variable_init(variable_t *variable, int size);
 int nod_variable_close(variable_t *variable);
@@ -113,6 +113,9 @@ int nod_anode_parse_cfg(char *config_file) {
 	if (!config_setting_lookup_bool(cfg,"join_logs_sync",&logs_cfg.join_logs_sync)) {
 		logs_cfg.join_logs_sync=0;
 	}
+	if (!config_setting_lookup_int(cfg,"migrate_overruns",&anode.migrate_overruns)) {
+		anode.migrate_overruns=0;
+	}
 
 	ret=0;
 destroy:
@@ -120,6 +123,48 @@ destroy:
 	return ret;
 }
 
+/**
+ * Low-priority task that moves modules out of the overloaded processor passed as argument.
+ */
+static void* nod_anode_balance_task(void *arg) {
+	int processor_idx = (int) (long) arg;
+	int i;
+
+	for (i=0;i<anode.max_waveforms;i++) {
+		if (anode.loaded_waveforms[i].status.cur_status == RUN) {
+			if (nod_waveform_balance(&anode.loaded_waveforms[i], processor_idx)) {
+				break;
+			}
+		}
+	}
+	anode.balance_tslot = rtdal_time_slot();
+	anode.balancing = 0;
+	return NULL;
+}
+
+/**
+ * Kernel periodic function. When a pipeline has finished late anode.migrate_overruns
+ * consecutive time slots, launches nod_anode_balance_task() to move modules out of it.
+ */
+static void nod_anode_balance_check(void) {
+	rtdal_machine_t machine;
+	int i;
+
+	if (anode.balancing || rtdal_time_slot()-anode.balance_tslot < anode.migrate_overruns) {
+		return;
+	}
+	rtdal_machine(&machine);
+	for (i=0;i<machine.nof_cores;i++) {
+		if (rtdal_pipeline_overruns(i) >= anode.migrate_overruns) {
+			anode.balancing = 1;
+			if (rtdal_task_new(NULL, nod_anode_balance_task, (void*) (long) i)) {
+				anode.balancing = 0;
+			}
+			return;
+		}
+	}
+}
+
 /**
  * 1) Pre-allocates max_waveforms objects of type Waveform
  * (with max_modules_x_waveform and max_variables_x_module modules and variables object instances)
@@ -188,6 +233,13 @@ int nod_anode_initialize(rtdal_machine_t *machine, int max_waveforms) {
 	}
 
 	nod_anode_initialize_waveforms(max_waveforms);
+
+	if (anode.migrate_overruns > 0 && machine->scheduling == SCHEDULING_PIPELINE) {
+		if (rtdal_periodic_add(nod_anode_balance_check, 1)) {
+			aerror("adding balance check\n");
+			return -1;
+		}
+	}
 	return 0;
 }
 
@@ -36,6 +36,9 @@ typedef struct {
 	r_itf_t ctr_itf;
 	r_itf_t probe_itf;
 	r_itf_t slaves_itf[MAX(node_itfphysic)];
+	int migrate_overruns;	/** consecutive late time slots before moving modules, 0 disables it */
+	int balancing;
+	int balance_tslot;
 } nod_anode_t;
 
 struct log_cfg {
@@ -149,6 +149,8 @@ int nod_module_load(nod_module_t *module) {
 	strcpy(attr.binary_path,module->parent.binary);
 	attr.exec_position = module->parent.exec_position;
 	attr.pipeline_id = module->parent.processor_idx;
+	attr.period = module->parent.period;
+	attr.phase = module->parent.phase;
 	attr.finish_callback = nod_module_finish_callback;
 
 	nod_waveform_t *waveform = module->parent.waveform;
@@ -189,6 +191,7 @@ int nod_module_load(nod_module_t *module) {
 		rtdal_perror("rtdal_process_new");
 		return -1;
 	}
+	rtdal_log_trace_name(module->process, module->parent.name);
 	return 0;
 }
 
@@ -312,6 +315,40 @@ variable_t* nod_module_variable_create(nod_module_t *module, string name, int si
 }
 
 
+/**
+ * Copies the telemetry of the internal output interfaces of the module to its execinfo. Ports
+ * without telemetry (not created, physical or disabled) are reported with zero counters.
+ */
+int nod_module_execinfo_itf(nod_module_t *module) {
+	execinfo_t *obj = &module->parent.execinfo;
+	int i;
+
+	obj->nof_itf = module->parent.nof_outputs;
+	if (obj->nof_itf > EXECINFO_MAX_ITF) {
+		obj->nof_itf = EXECINFO_MAX_ITF;
+	}
+	for (i=0;i<obj->nof_itf;i++) {
+		if (!module->parent.outputs[i].hw_itf
+				|| rtdal_itf_get_stats(module->parent.outputs[i].hw_itf, &obj->itf[i])) {
+			memset(&obj->itf[i],0,sizeof(rtdal_itf_stats_t));
+		}
+	}
+	return 0;
+}
+
+/**
+ * Copies the hardware counters of the process of the module to its execinfo. They are zero if
+ * the perf_counters option of the platform is disabled.
+ */
+int nod_module_execinfo_perf(nod_module_t *module) {
+	execinfo_t *obj = &module->parent.execinfo;
+
+	if (!module->process || rtdal_process_get_perf(module->process, &obj->perf)) {
+		memset(&obj->perf,0,sizeof(rtdal_perf_counters_t));
+	}
+	return 0;
+}
+
 int nod_module_execinfo_add_sample(execinfo_t *obj, int ctx_tstamp) {
 	int tstamp = rtdal_time_slot();
 	int cpu = obj->t_exec[0].tv_usec;
@@ -338,6 +375,7 @@ int nod_module_execinfo_add_sample(execinfo_t *obj, int ctx_tstamp) {
 	obj->module_ts = ctx_tstamp;
 	obj->max_rel_us = relinquish > obj->max_rel_us ? relinquish : obj->max_rel_us;
 	obj->max_start_us = start > obj->max_start_us ? start : obj->max_start_us;
+	execinfo_hist_add(obj, cpu);
 
 	if (tstamp - obj->start_ts + 1 > 0) {
 		obj->mean_exec_us = (float) obj->mean_exec_us +
@@ -16,6 +16,7 @@
  * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdlib.h>
 #include "rtdal.h"
 #include "defs.h"
 #include "packet.h"
@@ -51,6 +52,66 @@ int nod_waveform_free(nod_waveform_t *w) {
 	return 0;
 }
 
+/*  With the dag scheduling, a module runs after the modules that write to its internal inputs
+ * with zero delay, since it reads their packets in the same time slot. The edf_order option of
+ * the pipeline scheduling derives the deadlines of the modules from them.
+ */
+static int nod_waveform_dependencies(nod_waveform_t *w) {
+	int i, j;
+	interface_t *in;
+	nod_module_t *remote;
+
+	for (i=0;i<w->nof_modules;i++) {
+		for (j=0;j<w->modules[i].parent.nof_inputs;j++) {
+			in = &w->modules[i].parent.inputs[j];
+			if (in->physic_itf_id) {
+				continue;
+			}
+			remote = nod_waveform_find_module_id(w, in->remote_module_id);
+			if (!remote || in->remote_port_idx >= remote->parent.nof_outputs
+					|| remote->parent.outputs[in->remote_port_idx].delay != 0) {
+				continue;
+			}
+			if (rtdal_process_depends(w->modules[i].process, remote->process)) {
+				aerror_msg("Ignoring dependency of %s on %s (cycle or too many inputs)\n",
+						w->modules[i].parent.name, remote->parent.name);
+			}
+		}
+	}
+	return 0;
+}
+
+/*  With the batch clock, the pipeline of a module does not run a time slot before the pipelines
+ * of the modules writing to its internal inputs have written its packets. Inputs leaving a
+ * replicated group are written by all its copies, which have consecutive ids.
+ */
+static int nod_waveform_links(nod_waveform_t *w) {
+	int i, j, r;
+	interface_t *in;
+	nod_module_t *remote;
+
+	for (i=0;i<w->nof_modules;i++) {
+		for (j=0;j<w->modules[i].parent.nof_inputs;j++) {
+			in = &w->modules[i].parent.inputs[j];
+			if (in->physic_itf_id) {
+				continue;
+			}
+			for (r=0;r<(in->replicas>1?in->replicas:1);r++) {
+				remote = nod_waveform_find_module_id(w, in->remote_module_id+r);
+				if (!remote || in->remote_port_idx >= remote->parent.nof_outputs) {
+					continue;
+				}
+				if (rtdal_process_link(w->modules[i].process, remote->process,
+						remote->parent.outputs[in->remote_port_idx].delay)) {
+					aerror_msg("Ignoring link of %s with %s (zero delay in both directions)\n",
+							w->modules[i].parent.name, remote->parent.name);
+				}
+			}
+		}
+	}
+	return 0;
+}
+
 /*  nod_waveform_load() calls nod_module_load() for each module in the waveform
  */
 int nod_waveform_load(nod_waveform_t *w) {
@@ -68,6 +129,14 @@ int nod_waveform_load(nod_waveform_t *w) {
 		}
 		printf(".");fflush(0);
 	}
+	rtdal_machine_t machine;
+	rtdal_machine(&machine);
+	if (machine.scheduling == SCHEDULING_DAG || machine.edf_order) {
+		nod_waveform_dependencies(w);
+	}
+	if (machine.clock_mode == BATCH_TIMER) {
+		nod_waveform_links(w);
+	}
 	if (nod_waveform_run(w,1)) {
 		ndebug("error running waveform %s. Removing\n",w->name);
 		return -1;
@@ -285,6 +354,8 @@ int nod_waveform_status_init(nod_waveform_t *waveform) {
 	void *ret_val;
 
 	waveform->status.cur_status = INIT;
+	waveform->queue_mem = 0;
+	waveform->queue_mem_fixed = 0;
 
 	if (rtdal_task_new(&task,nod_waveform_status_init_thread,waveform)) {
 		aerror("creating task\n");
@@ -318,6 +389,9 @@ int nod_waveform_status_init(nod_waveform_t *waveform) {
 			}
 			return -1;
 		}
+		ainfo("Waveform %s queues memory: %.2f MB (%.2f MB with fixed-size slots)\n",
+				waveform->name, (float) waveform->queue_mem/1024/1024,
+				(float) waveform->queue_mem_fixed/1024/1024);
 	}
 
 	return 0;
@@ -426,6 +500,159 @@ int nod_waveform_status_new(nod_waveform_t *waveform, waveform_status_t *new_sta
 }
 
 
+/*  Adds to group the modules connected to module with zero delay interfaces, directly or through
+ * other modules, since they exchange packets in the same time slot and must run in the same
+ * pipeline. Returns the number of modules in group or -1 if there are more than max.
+ */
+static int nod_waveform_zero_delay_group(nod_waveform_t *w, nod_module_t *module,
+		nod_module_t **group, int max) {
+	int i, j, n, k;
+	interface_t *itf;
+	nod_module_t *m, *remote;
+
+	group[0] = module;
+	n = 1;
+	for (k=0;k<n;k++) {
+		m = group[k];
+		for (i=0;i<m->parent.nof_inputs+m->parent.nof_outputs;i++) {
+			if (i<m->parent.nof_inputs) {
+				itf = &m->parent.inputs[i];
+				remote = itf->physic_itf_id?NULL:nod_waveform_find_module_id(w, itf->remote_module_id);
+				if (!remote || itf->remote_port_idx >= remote->parent.nof_outputs
+						|| remote->parent.outputs[itf->remote_port_idx].delay != 0) {
+					continue;
+				}
+			} else {
+				itf = &m->parent.outputs[i-m->parent.nof_inputs];
+				remote = itf->physic_itf_id?NULL:nod_waveform_find_module_id(w, itf->remote_module_id);
+				if (!remote || itf->delay != 0) {
+					continue;
+				}
+			}
+			for (j=0;j<n;j++) {
+				if (group[j] == remote) {
+					break;
+				}
+			}
+			if (j == n) {
+				if (n == max) {
+					return -1;
+				}
+				group[n++] = remote;
+			}
+		}
+	}
+	return n;
+}
+
+/**  Moves the module, together with the modules it exchanges packets with zero delay, to the
+ * processor processor_idx while the waveform is running.
+ * \returns 0 on success, -1 on error
+ */
+int nod_waveform_migrate(nod_waveform_t *w, nod_module_t *module, int processor_idx) {
+	nod_module_t *group[RTDAL_MAX_MIGRATE];
+	r_proc_t procs[RTDAL_MAX_MIGRATE];
+	int i, n;
+
+	ndebug("waveform_id=%d, module_id=%d, processor_idx=%d\n",w->id,module->parent.id,
+			processor_idx);
+	if (module->parent.processor_idx == processor_idx) {
+		return 0;
+	}
+	n = nod_waveform_zero_delay_group(w, module, group, RTDAL_MAX_MIGRATE);
+	if (n < 0) {
+		aerror_msg("Too many modules connected with zero delay to %s\n",module->parent.name);
+		return -1;
+	}
+	for (i=0;i<n;i++) {
+		if (group[i]->parent.processor_idx != module->parent.processor_idx) {
+			aerror_msg("Module %s has zero delay to %s, which runs in another processor\n",
+					module->parent.name, group[i]->parent.name);
+			return -1;
+		}
+		procs[i] = group[i]->process;
+	}
+	if (rtdal_process_migrate(procs, n, processor_idx)) {
+		rtdal_perror("rtdal_process_migrate");
+		return -1;
+	}
+	for (i=0;i<n;i++) {
+		group[i]->parent.processor_idx = processor_idx;
+	}
+	return 0;
+}
+
+/**  Moves modules out of the overloaded processor processor_idx to the least loaded one. Among
+ * the groups of modules that must run together, moves the one that best balances the mean
+ * execution time of both processors, if any reduces the load of processor_idx.
+ * \returns 1 if a group has been moved, 0 if none improves the balance or -1 on error
+ */
+int nod_waveform_balance(nod_waveform_t *w, int processor_idx) {
+	nod_module_t *group[RTDAL_MAX_MIGRATE], *best;
+	float load[RTDAL_MAX_CORES], c, best_max;
+	char *visited;
+	rtdal_machine_t machine;
+	int i, j, n, dest;
+
+	rtdal_machine(&machine);
+	if (processor_idx < 0 || processor_idx >= machine.nof_cores || machine.nof_cores < 2) {
+		return 0;
+	}
+	memset(load, 0, sizeof(float)*RTDAL_MAX_CORES);
+	for (i=0;i<w->nof_modules;i++) {
+		if (w->modules[i].parent.processor_idx < machine.nof_cores) {
+			load[w->modules[i].parent.processor_idx] += w->modules[i].parent.execinfo.mean_exec_us;
+		}
+	}
+	dest = processor_idx?0:1;
+	for (i=0;i<machine.nof_cores;i++) {
+		if (i != processor_idx && load[i] < load[dest]) {
+			dest = i;
+		}
+	}
+
+	visited = calloc(1, w->nof_modules);
+	if (!visited) {
+		return -1;
+	}
+	best = NULL;
+	best_max = load[processor_idx];
+	for (i=0;i<w->nof_modules;i++) {
+		if (visited[i] || w->modules[i].parent.processor_idx != processor_idx) {
+			continue;
+		}
+		n = nod_waveform_zero_delay_group(w, &w->modules[i], group, RTDAL_MAX_MIGRATE);
+		if (n < 0) {
+			visited[i] = 1;
+			continue;
+		}
+		c = 0;
+		for (j=0;j<n;j++) {
+			visited[group[j]-w->modules] = 1;
+			c += group[j]->parent.execinfo.mean_exec_us;
+		}
+		if (load[processor_idx]-c > load[dest]+c) {
+			c = load[processor_idx]-c;
+		} else {
+			c = load[dest]+c;
+		}
+		if (c < best_max) {
+			best_max = c;
+			best = &w->modules[i];
+		}
+	}
+	free(visited);
+	if (!best) {
+		return 0;
+	}
+	ndebug("moving %s from processor %d to %d (load %.0f/%.0f us)\n",best->parent.name,
+			processor_idx, dest, load[processor_idx], load[dest]);
+	if (nod_waveform_migrate(w, best, dest)) {
+		return -1;
+	}
+	return 1;
+}
+
 /**  Returns a pointer to the first module with id the second parameter
  * \returns a non-null pointer if found or null otherwise
  */
@@ -479,6 +706,9 @@ int nod_waveform_serialize(nod_waveform_t *src, packet_t *pkt, int all_module,
 			if (module_serialize(&src->modules[i].parent,pkt,copy_data))
 				return -1;
 		} else {
+			nod_module_execinfo_itf(&src->modules[i]);
+			nod_module_execinfo_perf(&src->modules[i]);
+			src->modules[i].parent.execinfo.processor_idx = src->modules[i].parent.processor_idx;
 			if (execinfo_serialize(&src->modules[i].parent.execinfo,pkt))
 				return -1;
 		}
@@ -497,7 +727,8 @@ int nod_waveform_unserializeTo(packet_t *pkt, nod_waveform_t *dest) {
 	ndebug("waveform_id=%d, nof_modules=%d, status=%d,\n",
 			dest->id, dest->nof_modules,dest->status.cur_status);
 	int i, j;
-	int nof_modules, tmp;
+	int nof_modules, tmp, processor_idx;
+	int *prev_idx;
 	enum variable_serialize_data copy_data;
 	enum waveform_serialize_action action;
 	int granularity_us;
@@ -581,6 +812,40 @@ int nod_waveform_unserializeTo(packet_t *pkt, nod_waveform_t *dest) {
 			dest->modules[j].parent.mode.next_tslot = mode.next_tslot;
 		}
 		break;
+	case WAVEFORM_MAPPING:
+		get_i(&nof_modules);
+		ndebug("id=%d, nof_modules=%d\n",dest->id,nof_modules);
+		prev_idx = calloc(dest->nof_modules?dest->nof_modules:1, sizeof(int));
+		if (!prev_idx) {
+			return -1;
+		}
+		for (j=0;j<dest->nof_modules;j++) {
+			prev_idx[j] = dest->modules[j].parent.processor_idx;
+		}
+		for (i=0;i<nof_modules;i++) {
+			get_i(&tmp);
+			get_i(&processor_idx);
+			for (j=0;j<dest->nof_modules;j++) {
+				if (dest->modules[j].parent.id == tmp) {
+					break;
+				}
+			}
+			if (j == dest->nof_modules) {
+				aerror_msg("module id %d not found\n",tmp);
+				free(prev_idx);
+				return -1;
+			}
+			/* the module already followed another one of its zero-delay group */
+			if (dest->modules[j].parent.processor_idx != prev_idx[j]) {
+				continue;
+			}
+			if (nod_waveform_migrate(dest, &dest->modules[j], processor_idx)) {
+				free(prev_idx);
+				return -1;
+			}
+		}
+		free(prev_idx);
+		break;
 	}
 	return 0;
 }
@@ -32,6 +32,178 @@
 extern r_log_t queues_log;
 extern struct log_cfg logs_cfg;
 
+/* the packet metadata is stored in the RTDAL_PKT_META_SZ bytes reserved by the rtdal */
+typedef char pkt_meta_fits[sizeof(pkt_meta_t) <= RTDAL_PKT_META_SZ ? 1 : -1];
+
+/* A port entering a replicated group sends each packet to the next copy in turn. A port leaving
+ * it starts looking for the oldest packet from the copy after the last one it received from. */
+static inline void itf_replica_next(interface_t *x) {
+	if (x->replicas > 1) {
+		x->replica_next = x->replica_next+1<x->replicas?x->replica_next+1:0;
+		x->hw_itf = x->replica_itf[x->replica_next];
+	}
+}
+
+/* returns 1 if the packet with metadata a was generated before the one with metadata b */
+static inline int itf_meta_older(pkt_meta_t *a, pkt_meta_t *b) {
+	if (a->tslot != b->tslot) {
+		return a->tslot < b->tslot;
+	}
+	if (a->flags & b->flags & PKT_META_TSTAMP) {
+		return a->tstamp_ns < b->tstamp_ns;
+	}
+	return 0;
+}
+
+/* A port leaving a replicated group receives first the packet generated first. The copies run
+ * on different processors and may finish out of order, so it compares the metadata of the
+ * packets at the head of every copy. Ties go to the copies in turn. Selects the queue of the
+ * oldest packet in x->hw_itf, which is the next copy if all are empty. The copies are peeked, so
+ * statistics and trace only see the pop from the selected one. Blocking queues are not polled
+ * and are read in turn. Returns 0 or -1 on error. */
+static int itf_replica_select(interface_t *x, int tstamp) {
+	pkt_meta_t *meta, *best_meta = NULL;
+	void *p;
+	int i, r, l, n, best = -1;
+
+	if (x->replicas <= 1 || rtdal_itf_get_delay(x->hw_itf) < 0) {
+		return 0;
+	}
+	for (i=0;i<x->replicas;i++) {
+		r = (x->replica_next+i)%x->replicas;
+		n = rtdal_itf_peek(x->replica_itf[r], &p, &l, tstamp);
+		if (n == -1) {
+			return -1;
+		} else if (n != 1) {
+			continue;
+		}
+		meta = (pkt_meta_t*) rtdal_itf_meta(x->replica_itf[r], p);
+		if (best == -1 || (meta && best_meta && itf_meta_older(meta, best_meta))) {
+			best = r;
+			best_meta = meta;
+		}
+	}
+	if (best != -1) {
+		x->replica_next = best;
+		x->hw_itf = x->replica_itf[best];
+	}
+	return 0;
+}
+
+/* Pops the oldest packet of a replicated group, returns like rtdal_itf_pop() */
+static int itf_replica_pop(interface_t *x, void **ptr, int *len, int tstamp) {
+	if (itf_replica_select(x, tstamp)) {
+		return -1;
+	}
+	return rtdal_itf_pop(x->hw_itf, ptr, len, tstamp);
+}
+
+/* Creates the queue of the internal output port nod_itf. Ports sending to a replicated group
+ * create one queue for each copy r. */
+static r_itf_t itf_queue_new(oesr_context_t *ctx, interface_t *nod_itf, int port_idx, int size,
+		int r) {
+	nod_module_t *module = ctx->module;
+	r_itf_t rtdal_itf;
+	r_log_t log;
+	char tmp[128];
+	int nof_msg;
+	long bring_sz, min_sz;
+
+	if (logs_cfg.queues_en
+			&& (module->parent.log_enable ||
+					nod_itf->log_enable || logs_cfg.queues_all)) {
+		if (queues_log) {
+			log = queues_log;
+		} else {
+			if (r) {
+				snprintf(tmp,128,"%s.%d_%d.log",module->parent.name,port_idx,r);
+			} else {
+				snprintf(tmp,128,"%s.%d.log",module->parent.name,port_idx);
+			}
+			log = rtdal_log_new(tmp,TEXT,1024*1024);
+			if (!log) {
+				aerror_msg("Could not create queue log %s\n",tmp);
+			}
+		}
+	} else {
+		log = NULL;
+	}
+	if (nod_itf->delay >= 0) {
+		if (size<4096) {
+			nof_msg = OESR_ITF_DEFAULT_MSG*(nod_itf->delay+1)+128;
+		}
+		else {
+			nof_msg = OESR_ITF_DEFAULT_MSG*(nod_itf->delay+1);
+		}
+	} else {
+		nof_msg = 64;
+	}
+
+	rtdal_machine_t machine;
+	rtdal_machine(&machine);
+	nod_waveform_t *waveform = module->parent.waveform;
+	waveform->queue_mem_fixed += (long) nof_msg*size;
+	if (machine.queue_type == QUEUE_TYPE_BRING) {
+		/* packets usually are much shorter than size, but the ring keeps room for the packets
+		 * in flight plus one more even if all of them have the maximum size */
+		bring_sz = (long) (machine.queue_bring_ratio*nof_msg*size);
+		min_sz = (long) ((nod_itf->delay>0?nod_itf->delay:0)+2)*size;
+		if (bring_sz < min_sz) {
+			bring_sz = min_sz;
+		}
+		rtdal_itf = (r_itf_t) rtdal_itfbring_new((int) bring_sz, size, nod_itf->delay,log);
+		if (!rtdal_itf) {
+			OESR_HWERROR("rtdal_itfbring_new");
+			return NULL;
+		}
+		waveform->queue_mem += rtdal_itfbring_get_size(rtdal_itf);
+	} else if (machine.queue_type == QUEUE_TYPE_REFQ) {
+		rtdal_itf = (r_itf_t) rtdal_itfrefq_new(nof_msg,
+				size, nod_itf->delay,log);
+		if (!rtdal_itf) {
+			OESR_HWERROR("rtdal_itfrefq_new");
+			return NULL;
+		}
+		/* the pool has two buffers per packet */
+		waveform->queue_mem += (long) 2*nof_msg*size;
+	} else if (machine.queue_type == QUEUE_TYPE_LFQ) {
+		rtdal_itf = (r_itf_t) rtdal_itflfq_new(nof_msg,
+				size, nod_itf->delay,log);
+		if (!rtdal_itf) {
+			OESR_HWERROR("rtdal_itflfq_new");
+			return NULL;
+		}
+		waveform->queue_mem += (long) nof_msg*size;
+	} else {
+		rtdal_itf = (r_itf_t) rtdal_itfspscq_new(nof_msg,
+				size, nod_itf->delay,log);
+		if (!rtdal_itf) {
+			OESR_HWERROR("rtdal_itfspscq_new");
+			return NULL;
+		}
+		waveform->queue_mem += (long) nof_msg*size;
+	}
+	if (machine.itf_stats) {
+		rtdal_itf_set_stats(rtdal_itf, 1);
+	}
+	if (r) {
+		snprintf(tmp,128,"%s.%d_%d",module->parent.name,port_idx,r);
+	} else {
+		snprintf(tmp,128,"%s.%d",module->parent.name,port_idx);
+	}
+	rtdal_log_trace_name(rtdal_itf, tmp);
+	/* the queue is read by the module (copy r of the group) at the other side */
+	if (machine.numa_policy != NUMA_POLICY_NONE) {
+		nod_module_t *remote = nod_waveform_find_module_id(waveform,
+				nod_itf->remote_module_id+r);
+		if (remote && rtdal_itf_place(rtdal_itf, remote->parent.processor_idx)) {
+			awarn("Could not place queue %s.%d in the node of module %s\n",
+					module->parent.name,port_idx,remote->parent.name);
+		}
+	}
+	return rtdal_itf;
+}
+
 /**
  *
  * The oesr_itf_create() function initializes the interface with the rtdal. A pair of
@@ -56,8 +228,8 @@ itf_t oesr_itf_create(void *context, int port_idx, oesr_itf_mode_t mode, int siz
 	sdebug("context=0x%x, module_id=%d, port_idx=%d, mode=%d, size=%d inputs=%d outputs=%d\n",context,module->parent.id,
 			port_idx, mode, size,module->parent.nof_inputs,module->parent.nof_outputs);
 	r_itf_t rtdal_itf;
-	interface_t *nod_itf = NULL;
-	int nof_msg;
+	interface_t *nod_itf = NULL, *remote_itf;
+	int r, nof_queues;
 
 	OESR_ASSERT_PARAM_P(module);
 	OESR_ASSERT_PARAM_P(port_idx>=0);
@@ -76,75 +248,75 @@ itf_t oesr_itf_create(void *context, int port_idx, oesr_itf_mode_t mode, int siz
 		nod_itf = &module->parent.inputs[port_idx];
 	}
 
+	nof_queues = nod_itf->replicas>1?nod_itf->replicas:1;
+
 	if (nod_itf->physic_itf_id != 0) {
 		/* is external */
 		rtdal_itf = (r_itf_t) rtdal_itfphysic_get_id(nod_itf->physic_itf_id);
 		if (!rtdal_itf) {
 			OESR_HWERROR("rtdal_itf_physic_get_id");
+			return NULL;
 		}
+		nod_itf->replica_itf[0] = rtdal_itf;
 	} else {
 		/* is internal */
 		if (mode == ITF_WRITE) {
-			r_log_t log;
-			char tmp[128];
-			if (logs_cfg.queues_en
-					&& (module->parent.log_enable ||
-							nod_itf->log_enable || logs_cfg.queues_all)) {
-				if (queues_log) {
-					log = queues_log;
-				} else {
-					snprintf(tmp,128,"%s.%d.log",module->parent.name,port_idx);
-					log = rtdal_log_new(tmp,TEXT,1024*1024);
-					if (!log) {
-						aerror_msg("Could not create queue log %s\n",tmp);
-					}
-				}
-			} else {
-				log = NULL;
-			}
-			if (nod_itf->delay >= 0) {
-				if (size<4096) {
-					nof_msg = OESR_ITF_DEFAULT_MSG*(nod_itf->delay+1)+128;
-				}
-				else {
-					nof_msg = OESR_ITF_DEFAULT_MSG*(nod_itf->delay+1);
+			/* with a replicated group at the other side, one queue for each copy */
+			for (r=0;r<nof_queues;r++) {
+				nod_itf->replica_itf[r] = itf_queue_new(ctx, nod_itf, port_idx, size, r);
+				if (!nod_itf->replica_itf[r]) {
+					return NULL;
 				}
-			} else {
-				nof_msg = 64;
-			}
-
-			rtdal_itf = (r_itf_t) rtdal_itfspscq_new(nof_msg,
-					size, nod_itf->delay,log);
-			if (!rtdal_itf) {
-				OESR_HWERROR("rtdal_itfspscq_new");
-				return NULL;
 			}
+			rtdal_itf = nod_itf->replica_itf[0];
 		} else {
 			sdebug("remote_id=%d, remote_idx=%d\n",nod_itf->remote_module_id,
 					nod_itf->remote_port_idx);
 			nod_waveform_t *waveform = module->parent.waveform;
-			nod_module_t *remote = nod_waveform_find_module_id(waveform,
-					nod_itf->remote_module_id);
-			if (!remote) {
-				OESR_SETERROR(OESR_ERROR_MODNOTFOUND);
-				return NULL;
-			}
-			sdebug("remote found\n",0);
-			if (nod_itf->remote_port_idx > remote->parent.nof_outputs) {
-				OESR_SETERROR(OESR_ERROR_NOTFOUND);
-				return NULL;
-			}
-			sdebug("valid\n",0);
-			rtdal_itf = remote->parent.outputs[nod_itf->remote_port_idx].hw_itf;
-			if (!rtdal_itf) {
-				OESR_SETERROR(OESR_ERROR_NOTREADY);
-				return NULL;
+			/* leaving a replicated group, read from all the copies, which have consecutive ids */
+			for (r=0;r<nof_queues;r++) {
+				nod_module_t *remote = nod_waveform_find_module_id(waveform,
+						nod_itf->remote_module_id+r);
+				if (!remote) {
+					OESR_SETERROR(OESR_ERROR_MODNOTFOUND);
+					return NULL;
+				}
+				sdebug("remote found\n",0);
+				if (nod_itf->remote_port_idx > remote->parent.nof_outputs) {
+					OESR_SETERROR(OESR_ERROR_NOTFOUND);
+					return NULL;
+				}
+				sdebug("valid\n",0);
+				remote_itf = &remote->parent.outputs[nod_itf->remote_port_idx];
+				/* entering a replicated group, each copy reads its own queue */
+				if (remote_itf->replicas > 1) {
+					rtdal_itf = remote_itf->hw_itf?remote_itf->replica_itf[nod_itf->remote_replica]:NULL;
+				} else {
+					rtdal_itf = remote_itf->hw_itf;
+				}
+				if (!rtdal_itf) {
+					OESR_SETERROR(OESR_ERROR_NOTREADY);
+					return NULL;
+				}
+				nod_itf->replica_itf[r] = rtdal_itf;
 			}
+			rtdal_itf = nod_itf->replica_itf[0];
 		}
 	}
 	nod_itf->hw_itf = rtdal_itf;
+	nod_itf->replica_next = 0;
 	sdebug("module_id=%d hitf=0x%x\n",module->parent.id,rtdal_itf);
 
+	/* with the best-effort worker pool, the module runs when its interfaces are ready */
+	if (nod_itf->physic_itf_id == 0) {
+		for (r=0;r<nof_queues;r++) {
+			if (rtdal_process_add_itf(module->process, nod_itf->replica_itf[r], mode == ITF_READ)) {
+				OESR_HWERROR("rtdal_process_add_itf");
+				return NULL;
+			}
+		}
+	}
+
 	return (itf_t) nod_itf;
 }
 
@@ -205,7 +377,15 @@ int oesr_itf_delay_set(void *context, int port_idx, int mode, int delay) {
 int oesr_itf_close(itf_t itf) {
 	assert(itf);
 	interface_t *x = (interface_t*) itf;
-	return rtdal_itf_remove(x->hw_itf);
+	int r, ret = 0;
+	x->hw_itf = NULL;
+	for (r=0;r<(x->replicas>1?x->replicas:1);r++) {
+		if (rtdal_itf_remove(x->replica_itf[r])) {
+			ret = -1;
+		}
+		x->replica_itf[r] = NULL;
+	}
+	return ret;
 }
 
 /**
@@ -225,8 +405,13 @@ int oesr_itf_close(itf_t itf) {
 int oesr_itf_write(itf_t itf, void* buffer, int size, int tstamp) {
 	assert(itf);
 	interface_t *x = (interface_t*) itf;
+	int n;
 	assert(x->hw_itf);
-	return rtdal_itf_send(x->hw_itf,buffer,size,tstamp);
+	/* empty packets are not queued */
+	if ((n = rtdal_itf_send(x->hw_itf,buffer,size,tstamp)) == 1 && size > 0) {
+		itf_replica_next(x);
+	}
+	return n;
 }
 
 /**
@@ -244,7 +429,14 @@ int oesr_itf_write(itf_t itf, void* buffer, int size, int tstamp) {
 int oesr_itf_read(itf_t itf, void* buffer, int size, int tstamp) {
 	assert(itf);
 	interface_t *x = (interface_t*) itf;
-	return rtdal_itf_recv(x->hw_itf,buffer,size,tstamp);
+	int n;
+	if (itf_replica_select(x, tstamp)) {
+		return -1;
+	}
+	if ((n = rtdal_itf_recv(x->hw_itf,buffer,size,tstamp)) > 0) {
+		itf_replica_next(x);
+	}
+	return n;
 }
 
 /**
@@ -292,7 +484,11 @@ int oesr_itf_ptr_request(itf_t itf, void **ptr) {
 int oesr_itf_ptr_release(itf_t itf, void *ptr, int len) {
 	assert(itf);
 	interface_t *x = (interface_t*) itf;
-	return rtdal_itf_release(x->hw_itf,ptr,len);
+	int n;
+	if ((n = rtdal_itf_release(x->hw_itf,ptr,len)) == 1) {
+		itf_replica_next(x);
+	}
+	return n;
 }
 
 
@@ -308,10 +504,179 @@ int oesr_itf_ptr_release(itf_t itf, void *ptr, int len) {
 int oesr_itf_ptr_put(itf_t itf, void *ptr, int len, int tstamp) {
 	assert(itf);
 	interface_t *x = (interface_t*) itf;
-	return rtdal_itf_push(x->hw_itf, ptr, len, tstamp);
+	int n;
+	/* empty packets are not queued */
+	if ((n = rtdal_itf_push(x->hw_itf, ptr, len, tstamp)) == 1 && len > 0) {
+		itf_replica_next(x);
+	}
+	return n;
 }
 
 
+/**
+ * Sends through the interface out a packet received from the interface in with
+ * oesr_itf_ptr_get(). If both interfaces are shared (queue_type="refq") the same buffer is sent,
+ * otherwise its contents are copied to a new packet. In both cases, the packet still has to be
+ * released from the interface in.
+ *
+ * \param out Output interface handler returned by the oesr_itf_create() function.
+ * \param in Input interface where ptr was received from
+ * \param len Number of useful bytes in the packet
+ *
+ * \return 1 on success, 0 if the packet could not be sent or -1 on error.
+ */
+int oesr_itf_ptr_forward(itf_t out, itf_t in, void *ptr, int len, int tstamp) {
+	assert(out);
+	assert(in);
+	interface_t *x = (interface_t*) out;
+	interface_t *y = (interface_t*) in;
+	void *optr, *ometa, *imeta;
+	int n;
+
+	if (rtdal_itf_is_shared(x->hw_itf) == 1 && rtdal_itf_is_shared(y->hw_itf) == 1) {
+		n = rtdal_itf_push_ref(x->hw_itf, y->hw_itf, ptr, len, tstamp);
+	} else {
+		if ((n = rtdal_itf_request(x->hw_itf, &optr)) != 1) {
+			return n;
+		}
+		memcpy(optr, ptr, (size_t) len);
+		ometa = rtdal_itf_meta(x->hw_itf, optr);
+		imeta = rtdal_itf_meta(y->hw_itf, ptr);
+		if (ometa && imeta) {
+			memcpy(ometa, imeta, sizeof(pkt_meta_t));
+		} else if (ometa) {
+			memset(ometa, 0, sizeof(pkt_meta_t));
+		}
+		n = rtdal_itf_push(x->hw_itf, optr, len, tstamp);
+	}
+	if (n == 1 && len > 0) {
+		itf_replica_next(x);
+	}
+	return n;
+}
+
+/**
+ * Returns 1 if the interface shares its buffers with the interfaces it forwards to or from
+ * (queue_type="refq"), so that oesr_itf_ptr_forward() does not copy the packet, 0 if it does not
+ * or -1 on error.
+ */
+int oesr_itf_is_shared(itf_t itf) {
+	assert(itf);
+	interface_t *x = (interface_t*) itf;
+	return rtdal_itf_is_shared(x->hw_itf);
+}
+
+/**
+ * Returns 1 if the packet ptr, received with oesr_itf_ptr_get(), is not read by other modules
+ * and can be modified in place, or 0 otherwise.
+ */
+int oesr_itf_ptr_exclusive(itf_t itf, void *ptr) {
+	assert(itf);
+	interface_t *x = (interface_t*) itf;
+	if (rtdal_itf_is_shared(x->hw_itf) == 1) {
+		return rtdal_pool_refcnt(ptr) == 1;
+	}
+	return 1;
+}
+
+/**
+ * Returns the metadata header of the packet ptr, obtained with oesr_itf_ptr_request() or
+ * oesr_itf_ptr_get(). The header of a requested packet is cleared and is sent with it by
+ * oesr_itf_ptr_put().
+ *
+ * \param itf Handler returned by the oesr_itf_create() function.
+ * \param ptr Address of the packet
+ *
+ * \return Pointer to the header or null on error.
+ */
+pkt_meta_t *oesr_itf_ptr_meta(itf_t itf, void *ptr) {
+	assert(itf);
+	interface_t *x = (interface_t*) itf;
+	return (pkt_meta_t*) rtdal_itf_meta(x->hw_itf, ptr);
+}
+
+/**
+ * Obtains up to max buffers to be sent with oesr_itf_ptr_put_n().
+ *
+ * \param itf Handler returned by the oesr_itf_create() function.
+ * \param ptr Array of at least max pointers where the buffer addresses are saved
+ * \param max Maximum number of buffers
+ *
+ * \return The number of buffers, which may be lower than max, 0 if there is no space in the
+ * interface or -1 on error
+ */
+int oesr_itf_ptr_request_n(itf_t itf, void **ptr, int max) {
+	assert(itf);
+	interface_t *x = (interface_t*) itf;
+	/* each packet to a replicated group goes to a different queue */
+	if (x->replicas > 1 && max > 1) {
+		max = 1;
+	}
+	return rtdal_itf_request_n(x->hw_itf, ptr, max);
+}
+
+/**
+ * Sends in order the first n buffers obtained with oesr_itf_ptr_request_n(). A buffer with
+ * len 0 ends the batch, the remaining buffers are not sent.
+ *
+ * \param itf Handler returned by the oesr_itf_create() function.
+ * \param len Number of useful bytes written to each buffer
+ *
+ * \return The number of packets sent or -1 on error.
+ */
+int oesr_itf_ptr_put_n(itf_t itf, void **ptr, int *len, int n, int tstamp) {
+	assert(itf);
+	interface_t *x = (interface_t*) itf;
+	int i, ret;
+
+	for (i=0;i<n && len[i]>0;i++) {
+		if ((ret = rtdal_itf_push(x->hw_itf, ptr[i], len[i], tstamp)) != 1) {
+			return ret==-1?-1:i;
+		}
+		itf_replica_next(x);
+	}
+	return i;
+}
+
+/**
+ * Receives up to max pending packets from an interface. It waits for the first packet like
+ * oesr_itf_ptr_get().
+ *
+ * \param itf Handler returned by the oesr_itf_create() function.
+ * \param ptr Array of at least max pointers where the packet addresses are saved
+ * \param len Array of at least max integers where the packet lengths are saved
+ *
+ * \return The number of packets received, 0 if there are no packets pending or -1 on error.
+ */
+int oesr_itf_ptr_get_n(itf_t itf, void **ptr, int *len, int max, int tstamp) {
+	assert(itf);
+	interface_t *x = (interface_t*) itf;
+	/* each packet from a replicated group comes from a different queue */
+	if (x->replicas > 1) {
+		return itf_replica_pop(x, ptr, len, tstamp);
+	}
+	return rtdal_itf_pop_n(x->hw_itf, ptr, len, max, tstamp);
+}
+
+/**
+ * Releases in order the n packets received with oesr_itf_ptr_get_n().
+ *
+ * \return 1 on success, 0 if a packet could not be released, or -1 on error.
+ */
+int oesr_itf_ptr_release_n(itf_t itf, void **ptr, int *len, int n) {
+	assert(itf);
+	interface_t *x = (interface_t*) itf;
+	int i, ret;
+
+	for (i=0;i<n;i++) {
+		if ((ret = rtdal_itf_release(x->hw_itf, ptr[i], len[i])) != 1) {
+			return ret;
+		}
+		itf_replica_next(x);
+	}
+	return 1;
+}
+
 /**
  * Receives a buffer from an interface.
  *
@@ -325,5 +690,5 @@ int oesr_itf_ptr_put(itf_t itf, void *ptr, int len, int tstamp) {
 int oesr_itf_ptr_get(itf_t itf, void **ptr, int *len, int tstamp) {
 	assert(itf);
 	interface_t *x = (interface_t*) itf;
-	return rtdal_itf_pop(x->hw_itf, ptr, len, tstamp);
+	return itf_replica_pop(x, ptr, len, tstamp);
 }
@@ -43,6 +43,8 @@ extern const int nof_output_itf;
 extern const int input_max_samples;
 extern const int output_max_samples;
 
+#define MAX_OUTPUTS 	30
+
 static int *input_len;
 static int *output_len;
 static int array_dims[2];
@@ -51,6 +53,8 @@ static char *input_buffer;
 static char *output_buffer;
 static void **input_ptr;
 static void **output_ptr;
+static pkt_meta_t *input_meta;
+static pkt_meta_t *output_meta;
 
 typedef struct {
 	char *name;
@@ -71,6 +75,74 @@ int set_output_samples(int idx, int len) {
 	output_len[idx] = len;
 	return 0;
 }
+int forward_input(int in_idx, int out_idx) {
+	if (in_idx<0 || in_idx>=nof_input_itf || out_idx<0 || out_idx>=nof_output_itf)
+			return -1;
+	memcpy(output_ptr[out_idx],input_ptr[in_idx],input_len[in_idx]*input_sample_sz);
+	output_len[out_idx] = input_len[in_idx]*input_sample_sz/output_sample_sz;
+	return 0;
+}
+
+pkt_meta_t *get_input_meta(int idx) {
+	if (idx<0 || idx>=nof_input_itf)
+		return NULL;
+	return &input_meta[idx];
+}
+
+pkt_meta_t *get_output_meta(int idx) {
+	if (idx<0 || idx>=nof_output_itf)
+		return NULL;
+	return &output_meta[idx];
+}
+
+/* one packet per port and call to work() */
+int set_batch_mode(int max_packets) {
+	return max_packets>=1?0:-1;
+}
+
+int get_input_packets(int idx) {
+	if (idx<0 || idx>=nof_input_itf)
+		return -1;
+	return 1;
+}
+
+void *get_input_packet(int idx, int k, int *nsamples) {
+	if (idx<0 || idx>=nof_input_itf || k)
+		return NULL;
+	if (nsamples) *nsamples = input_len[idx];
+	return input_ptr[idx];
+}
+
+pkt_meta_t *get_input_packet_meta(int idx, int k) {
+	return k?NULL:get_input_meta(idx);
+}
+
+int get_output_packets(int idx) {
+	if (idx<0 || idx>=nof_output_itf)
+		return -1;
+	return 1;
+}
+
+void *get_output_packet(int idx, int k) {
+	if (idx<0 || idx>=nof_output_itf || k)
+		return NULL;
+	return output_ptr[idx];
+}
+
+int set_output_packet_samples(int idx, int k, int len) {
+	return k?-1:set_output_samples(idx,len);
+}
+
+pkt_meta_t *get_output_packet_meta(int idx, int k) {
+	return k?NULL:get_output_meta(idx);
+}
+
+int set_output_passthrough(int out_idx, int in_idx) {
+	if (in_idx<0 || in_idx>=nof_input_itf || out_idx<0 || out_idx>=MAX_OUTPUTS)
+			return -1;
+	/* the output buffer is never the input buffer, work() fills it */
+	return 0;
+}
 
 
 void help() {
@@ -260,11 +332,13 @@ void allocate_memory() {
 		input_len = mxCalloc(sizeof(int),nof_input_itf);
 		input_buffer = mxCalloc(input_sample_sz,nof_input_itf*input_max_samples);
 		input_ptr = mxCalloc(sizeof(void*), nof_input_itf);
+		input_meta = mxCalloc(sizeof(pkt_meta_t), nof_input_itf);
 	}
 	if (nof_output_itf*output_sample_sz) {
 		output_len = mxCalloc(sizeof(int),nof_output_itf);
 		output_buffer = mxCalloc(output_sample_sz,nof_output_itf*output_max_samples);
 		output_ptr = mxCalloc(sizeof(void*), nof_output_itf);
+		output_meta = mxCalloc(sizeof(pkt_meta_t), nof_output_itf);
 	}
 }
 
@@ -12,6 +12,7 @@
 
 #define MAX_INPUTS 		30
 #define MAX_OUTPUTS 	30
+#define MAX_BATCH		16
 #define MAX_VARIABLES 	50
 #define MAX_PARAMETERS 	50
 
@@ -43,6 +44,15 @@ counter_t counter;
 
 void *input_ptr[MAX_INPUTS], *output_ptr[MAX_OUTPUTS];
 int rcv_len[MAX_INPUTS], snd_len[MAX_OUTPUTS];
+int forwarded[MAX_OUTPUTS];
+int passthrough[MAX_OUTPUTS];
+pkt_meta_t *input_meta[MAX_INPUTS], *output_meta[MAX_OUTPUTS];
+
+/* batch mode: up to batch_max packets per port and call to work() */
+int batch_max;
+void *input_vec[MAX_INPUTS][MAX_BATCH], *output_vec[MAX_OUTPUTS][MAX_BATCH];
+int rcv_vec[MAX_INPUTS][MAX_BATCH], snd_vec[MAX_OUTPUTS][MAX_BATCH];
+int nof_rcv[MAX_INPUTS], nof_snd[MAX_OUTPUTS];
 
 void *ctx;
 
@@ -52,6 +62,13 @@ void init_memory() {
 
 	memset(outputs,0,sizeof(itf_t)*MAX_OUTPUTS);
 	memset(snd_len,0,sizeof(int)*MAX_OUTPUTS);
+	memset(forwarded,0,sizeof(int)*MAX_OUTPUTS);
+	memset(passthrough,0,sizeof(int)*MAX_OUTPUTS);
+	memset(input_meta,0,sizeof(pkt_meta_t*)*MAX_INPUTS);
+	memset(output_meta,0,sizeof(pkt_meta_t*)*MAX_OUTPUTS);
+	memset(nof_rcv,0,sizeof(int)*MAX_INPUTS);
+	memset(nof_snd,0,sizeof(int)*MAX_OUTPUTS);
+	batch_max = 1;
 
 	memset(vars,0,sizeof(var_t)*MAX_VARIABLES);
 
@@ -306,10 +323,114 @@ int process_ctrl_packet(void) {
 	return 0;
 }
 
+/* the input buffer is only forwarded without copying it if both interfaces are shared,
+ * otherwise the output is requested as usual and work() writes it from the input */
+static int passthrough_shared(int out_idx, int in_idx) {
+	return oesr_itf_is_shared(outputs[out_idx]) == 1 && oesr_itf_is_shared(inputs[in_idx]) == 1;
+}
+
+/* forwards the input buffer modified in place by work() */
+static int passthrough_output(int out_idx, int in_idx, int tstamp) {
+	int n;
+	forwarded[out_idx] = 1;
+	if (!snd_len[out_idx]) {
+		return 0;
+	}
+	n = oesr_itf_ptr_forward(outputs[out_idx],inputs[in_idx],input_ptr[in_idx],
+			snd_len[out_idx],tstamp);
+	if (n == 0) {
+		moddebug("no space left in output interface %d\n",out_idx);
+	} else if (n == -1) {
+		oesr_perror("oesr_itf_ptr_forward\n");
+		return -1;
+	} else {
+		itflog(out_idx,"snd",snd_len[out_idx]/output_sample_sz,snd_len[out_idx]);
+	}
+	return 0;
+}
+
+/* the k-th output packet inherits the metadata of the k-th packet of the first input that has it */
+static void init_output_meta(pkt_meta_t *meta, int k, int tstamp) {
+	int i;
+	for (i=0;i<nof_input_itf;i++) {
+		if (nof_rcv[i] > k) {
+			memcpy(meta,k?oesr_itf_ptr_meta(inputs[i],input_vec[i][k]):input_meta[i],
+					sizeof(pkt_meta_t));
+			return;
+		}
+	}
+	meta->tslot = tstamp;
+}
+
+static int get_input_batch(int i, int tstamp) {
+	int k, n;
+	n = oesr_itf_ptr_get_n(inputs[i], input_vec[i], rcv_vec[i], batch_max, tstamp);
+	if (n == -1) {
+		oesr_perror("oesr_itf_ptr_get_n");
+		return -1;
+	}
+	nof_rcv[i] = n;
+	if (n > 0) {
+		input_ptr[i] = input_vec[i][0];
+		rcv_len[i] = rcv_vec[i][0]/input_sample_sz;
+		input_meta[i] = oesr_itf_ptr_meta(inputs[i],input_ptr[i]);
+		for (k=0;k<n;k++) {
+			itflog(i,"rcv",rcv_vec[i][k]/input_sample_sz,rcv_vec[i][k]);
+		}
+	} else {
+		input_ptr[i] = NULL;
+		rcv_len[i] = 0;
+	}
+	return 0;
+}
+
+static int request_output_batch(int i, int tstamp) {
+	int k, n;
+	pkt_meta_t *meta;
+	n = oesr_itf_ptr_request_n(outputs[i], output_vec[i], batch_max);
+	if (n == 0) {
+		moddebug("no packets available in output interface %d\n",i);
+		return -1;
+	} else if (n == -1) {
+		oesr_perror("oesr_itf_ptr_request_n");
+		return -1;
+	}
+	nof_snd[i] = n;
+	output_ptr[i] = output_vec[i][0];
+	memset(snd_vec[i],0,sizeof(int)*n);
+	for (k=0;k<n;k++) {
+		meta = oesr_itf_ptr_meta(outputs[i],output_vec[i][k]);
+		if (meta) {
+			init_output_meta(meta,k,tstamp);
+		}
+		if (!k) {
+			output_meta[i] = meta;
+		}
+	}
+	return 0;
+}
+
+static int put_output_batch(int i, int tstamp) {
+	int k, n;
+	snd_vec[i][0] = snd_len[i];
+	n = oesr_itf_ptr_put_n(outputs[i], output_vec[i], snd_vec[i], nof_snd[i], tstamp);
+	if (n == -1) {
+		oesr_perror("oesr_itf_ptr_put_n\n");
+		return -1;
+	}
+	for (k=0;k<n;k++) {
+		itflog(i,"snd",snd_vec[i][k]/output_sample_sz,snd_vec[i][k]);
+	}
+	if (n < nof_snd[i] && snd_vec[i][n]) {
+		moddebug("no space left in output interface %d\n",i);
+	}
+	return 0;
+}
+
 int Run(void *_ctx) {
 	ctx = _ctx;
 	int tstamp = oesr_tstamp(ctx);
-	int i;
+	int i, j;
 	int n;
 
 
@@ -331,9 +452,15 @@ int Run(void *_ctx) {
 	}
 
 	for (i=0;i<nof_input_itf;i++) {
+		input_meta[i] = NULL;
+		nof_rcv[i] = 0;
 		if (!inputs[i]) {
 			input_ptr[i] = NULL;
 			rcv_len[i] = 0;
+		} else if (batch_max > 1) {
+			if (get_input_batch(i,tstamp)) {
+				return -1;
+			}
 		} else {
 			do {
 				moddebug("reading from %d\n",i);
@@ -345,14 +472,27 @@ int Run(void *_ctx) {
 				} else if (n == 1) {
 					moddebug("received %d bytes\n",rcv_len[i]);
 					rcv_len[i] /= input_sample_sz;
+					input_meta[i] = oesr_itf_ptr_meta(inputs[i],input_ptr[i]);
+					nof_rcv[i] = 1;
 					itflog(i,"rcv",rcv_len[i],rcv_len[i]*input_sample_sz);
 				}
 			} while (n==2);
 		}
 	}
 	for (i=0;i<nof_output_itf;i++) {
+		j = passthrough[i]-1;
+		output_meta[i] = NULL;
 		if (!outputs[i]) {
 			output_ptr[i] = NULL;
+		} else if (j >= 0 && input_ptr[j] && passthrough_shared(i,j)
+				&& oesr_itf_ptr_exclusive(inputs[j],input_ptr[j])) {
+			moddebug("output %d is input %d\n",i,j);
+			output_ptr[i] = input_ptr[j];
+			output_meta[i] = input_meta[j];
+		} else if (batch_max > 1) {
+			if (request_output_batch(i,tstamp)) {
+				return -1;
+			}
 		} else {
 			moddebug("requesting output %d\n",i);
 			n = oesr_itf_ptr_request(outputs[i], &output_ptr[i]);
@@ -364,10 +504,15 @@ int Run(void *_ctx) {
 				printf("request\n");
 				return -1;
 			}
+			output_meta[i] = oesr_itf_ptr_meta(outputs[i],output_ptr[i]);
+			if (output_meta[i]) {
+				init_output_meta(output_meta[i],0,tstamp);
+			}
 		}
 	}
 
 	memset(snd_len,0,sizeof(int)*nof_output_itf);
+	memset(forwarded,0,sizeof(int)*nof_output_itf);
 
 	moddebug("Calling WORK()\n",0);
 	n = work(input_ptr,output_ptr);
@@ -376,15 +521,28 @@ int Run(void *_ctx) {
 	}
 
 	for (i=0;i<nof_output_itf;i++) {
-		if (!snd_len[i] && output_ptr[i]) {
+		if (!snd_len[i] && output_ptr[i] && !forwarded[i]) {
 			snd_len[i] = n*output_sample_sz;
 		}
 	}
 
+	for (i=0;i<nof_output_itf;i++) {
+		j = passthrough[i]-1;
+		if (j >= 0 && output_ptr[i] && output_ptr[i] == input_ptr[j]) {
+			if (passthrough_output(i,j,tstamp)) {
+				return -1;
+			}
+		}
+	}
+
 	for (i=0;i<nof_input_itf;i++) {
 		if (input_ptr[i]) {
 			moddebug("releasing input %d size %d\n",i,rcv_len[i]*input_sample_sz);
-			n = oesr_itf_ptr_release(inputs[i],input_ptr[i],rcv_len[i]*input_sample_sz);
+			if (batch_max > 1) {
+				n = oesr_itf_ptr_release_n(inputs[i],input_vec[i],rcv_vec[i],nof_rcv[i]);
+			} else {
+				n = oesr_itf_ptr_release(inputs[i],input_ptr[i],rcv_len[i]*input_sample_sz);
+			}
 			if (n == 0) {
 				moddebug("packet from interface %d not released\n",i);
 			} else if (n == -1) {
@@ -395,7 +553,11 @@ int Run(void *_ctx) {
 		}
 	}
 	for (i=0;i<nof_output_itf;i++) {
-		if (output_ptr[i]) {
+		if (output_ptr[i] && !forwarded[i] && batch_max > 1) {
+			if (put_output_batch(i,tstamp)) {
+				return -1;
+			}
+		} else if (output_ptr[i] && !forwarded[i]) {
 			moddebug("sending output %d size %d\n",i,snd_len[i]);
 			n = oesr_itf_ptr_put(outputs[i],output_ptr[i], snd_len[i],tstamp);
 			if (n == 0) {
@@ -429,6 +591,142 @@ int set_output_samples(int idx, int len) {
 	return 0;
 }
 
+pkt_meta_t *get_input_meta(int idx) {
+	if (idx<0 || idx>=nof_input_itf)
+			return NULL;
+	return input_meta[idx];
+}
+
+pkt_meta_t *get_output_meta(int idx) {
+	if (idx<0 || idx>=nof_output_itf)
+			return NULL;
+	return output_meta[idx];
+}
+
+int forward_input(int in_idx, int out_idx) {
+	int k, n;
+	if (in_idx<0 || in_idx>=nof_input_itf || out_idx<0 || out_idx>=nof_output_itf)
+			return -1;
+	if (!input_ptr[in_idx] || !outputs[out_idx]) {
+		return 0;
+	}
+	if (batch_max == 1) {
+		rcv_vec[in_idx][0] = rcv_len[in_idx]*input_sample_sz;
+		input_vec[in_idx][0] = input_ptr[in_idx];
+	}
+	for (k=0;k<nof_rcv[in_idx];k++) {
+		if (!rcv_vec[in_idx][k]) {
+			continue;
+		}
+		n = oesr_itf_ptr_forward(outputs[out_idx],inputs[in_idx],input_vec[in_idx][k],
+				rcv_vec[in_idx][k],oesr_tstamp(ctx));
+		if (n == 0) {
+			moddebug("no space left in output interface %d\n",out_idx);
+			break;
+		} else if (n == -1) {
+			oesr_perror("oesr_itf_ptr_forward\n");
+			return -1;
+		} else {
+			itflog(out_idx,"fwd",rcv_vec[in_idx][k]/input_sample_sz,rcv_vec[in_idx][k]);
+		}
+	}
+	forwarded[out_idx] = 1;
+	return 0;
+}
+
+int set_batch_mode(int max_packets) {
+	int i;
+	if (max_packets<1 || max_packets>MAX_BATCH) {
+		moderror_msg("Batch size must be between 1 and %d\n",MAX_BATCH);
+		return -1;
+	}
+	for (i=0;i<nof_output_itf && max_packets>1;i++) {
+		if (passthrough[i]) {
+			moderror_msg("Output %d is passed through, batch mode not supported\n",i);
+			return -1;
+		}
+	}
+	batch_max = max_packets;
+	return 0;
+}
+
+int get_input_packets(int idx) {
+	if (idx<0 || idx>=nof_input_itf)
+			return -1;
+	return nof_rcv[idx];
+}
+
+void *get_input_packet(int idx, int k, int *nsamples) {
+	if (idx<0 || idx>=nof_input_itf || k<0 || k>=nof_rcv[idx])
+			return NULL;
+	if (batch_max == 1) {
+		if (nsamples) *nsamples = rcv_len[idx];
+		return input_ptr[idx];
+	}
+	if (nsamples) *nsamples = rcv_vec[idx][k]/input_sample_sz;
+	return input_vec[idx][k];
+}
+
+pkt_meta_t *get_input_packet_meta(int idx, int k) {
+	void *ptr = get_input_packet(idx,k,NULL);
+	if (!ptr) {
+		return NULL;
+	}
+	return oesr_itf_ptr_meta(inputs[idx],ptr);
+}
+
+int get_output_packets(int idx) {
+	if (idx<0 || idx>=nof_output_itf)
+			return -1;
+	if (batch_max == 1) {
+		return output_ptr[idx]?1:0;
+	}
+	return output_ptr[idx]?nof_snd[idx]:0;
+}
+
+void *get_output_packet(int idx, int k) {
+	if (k<0 || k>=get_output_packets(idx))
+			return NULL;
+	return batch_max==1?output_ptr[idx]:output_vec[idx][k];
+}
+
+int set_output_packet_samples(int idx, int k, int len) {
+	if (k<0 || k>=get_output_packets(idx))
+			return -1;
+	if (!k) {
+		return set_output_samples(idx,len);
+	}
+	snd_vec[idx][k] = len*output_sample_sz;
+	return 0;
+}
+
+pkt_meta_t *get_output_packet_meta(int idx, int k) {
+	if (k<0 || k>=get_output_packets(idx))
+			return NULL;
+	if (!k) {
+		return output_meta[idx];
+	}
+	return oesr_itf_ptr_meta(outputs[idx],output_vec[idx][k]);
+}
+
+int set_output_passthrough(int out_idx, int in_idx) {
+	int i;
+	if (in_idx<0 || in_idx>=nof_input_itf || out_idx<0 || out_idx>=nof_output_itf)
+			return -1;
+	if (batch_max > 1) {
+		moderror("Passthrough outputs are not supported in batch mode\n");
+		return -1;
+	}
+	for (i=0;i<nof_output_itf;i++) {
+		if (i != out_idx && passthrough[i] == in_idx+1) {
+			moderror_msg("Input %d is already passed through output %d\n",in_idx,i);
+			return -1;
+		}
+	}
+	passthrough[out_idx] = in_idx+1;
+	return 0;
+}
+
 int param_get(pmid_t id, void *ptr, int max_size, param_type_t *type) {
 	if (type) {
 		*type = (param_type_t) oesr_var_param_type(ctx,(var_t) id);
@@ -42,10 +42,13 @@ extern const int input_max_samples;
 extern const int output_max_samples;
 
 
+#define MAX_OUTPUTS 	30
+
 static int *input_lengths;
 static int *output_lengths;
 
 static void **input_ptr, **output_ptr;
+static pkt_meta_t *input_meta, *output_meta;
 
 static char *input_data, *output_data;
 
@@ -75,6 +78,89 @@ inline int set_output_samples(int idx, int len) {
 	return 0;
 }
 
+int forward_input(int in_idx, int out_idx) {
+	if (in_idx<0 || in_idx>=nof_input_itf || out_idx<0 || out_idx>=nof_output_itf)
+			return -1;
+	memcpy(output_ptr[out_idx],input_ptr[in_idx],input_lengths[in_idx]*input_sample_sz);
+	output_lengths[out_idx] = input_lengths[in_idx]*input_sample_sz/output_sample_sz;
+	return 0;
+}
+
+pkt_meta_t *get_input_meta(int idx) {
+	if (idx<0 || idx>=nof_input_itf)
+		return NULL;
+	return &input_meta[idx];
+}
+
+pkt_meta_t *get_output_meta(int idx) {
+	if (idx<0 || idx>=nof_output_itf)
+		return NULL;
+	return &output_meta[idx];
+}
+
+/* one packet per port and call to work() */
+int set_batch_mode(int max_packets) {
+	return max_packets>=1?0:-1;
+}
+
+int get_input_packets(int idx) {
+	if (idx<0 || idx>=nof_input_itf)
+		return -1;
+	return 1;
+}
+
+void *get_input_packet(int idx, int k, int *nsamples) {
+	if (idx<0 || idx>=nof_input_itf || k)
+		return NULL;
+	if (nsamples) *nsamples = input_lengths[idx];
+	return input_ptr[idx];
+}
+
+pkt_meta_t *get_input_packet_meta(int idx, int k) {
+	return k?NULL:get_input_meta(idx);
+}
+
+int get_output_packets(int idx) {
+	if (idx<0 || idx>=nof_output_itf)
+		return -1;
+	return 1;
+}
+
+void *get_output_packet(int idx, int k) {
+	if (idx<0 || idx>=nof_output_itf || k)
+		return NULL;
+	return output_ptr[idx];
+}
+
+int set_output_packet_samples(int idx, int k, int len) {
+	return k?-1:set_output_samples(idx,len);
+}
+
+pkt_meta_t *get_output_packet_meta(int idx, int k) {
+	return k?NULL:get_output_meta(idx);
+}
+
+/* each call to work() is a time slot */
+static void init_meta(int tslot) {
+	int i;
+	for (i=0;i<nof_input_itf;i++) {
+		memset(&input_meta[i],0,sizeof(pkt_meta_t));
+		input_meta[i].tslot = tslot;
+	}
+	for (i=0;i<nof_output_itf;i++) {
+		memset(&output_meta[i],0,sizeof(pkt_meta_t));
+		output_meta[i].tslot = tslot;
+	}
+}
+
+int set_output_passthrough(int out_idx, int in_idx) {
+	if (in_idx<0 || in_idx>=nof_input_itf || out_idx<0 || out_idx>=MAX_OUTPUTS)
+			return -1;
+	/* the output buffer is never the input buffer, work() fills it */
+	return 0;
+}
+
+
 void allocate_memory() {
 	posix_memalign((void**)&input_data,64,input_max_samples*nof_input_itf*input_sample_sz);
 	posix_memalign((void**)&output_data,64,output_max_samples*nof_output_itf*output_sample_sz);
@@ -88,6 +174,10 @@ void allocate_memory() {
 	assert(input_ptr);
 	output_ptr = calloc(sizeof(void*),nof_output_itf);
 	assert(output_ptr);
+	input_meta = calloc(sizeof(pkt_meta_t),nof_input_itf);
+	assert(input_meta);
+	output_meta = calloc(sizeof(pkt_meta_t),nof_output_itf);
+	assert(output_meta);
 }
 
 void free_memory() {
@@ -95,6 +185,8 @@ void free_memory() {
 	free(output_data);
 	free(input_lengths);
 	free(output_lengths);
+	free(input_meta);
+	free(output_meta);
 	if (parameters) {
 		for (int i=0;i<nof_params;i++) {
 			if (parameters[i].name) free(parameters[i].name);
@@ -211,6 +303,7 @@ int main(int argc, char **argv)
 			input_lengths[0] = file_read_sz/run_times;
 			input_ptr[0] = &input_data[input_sample_sz*i*file_read_sz/run_times];
 		}
+		init_meta(i);
 		ret = work(input_ptr, output_ptr);
 	}
 	clock_gettime(CLOCK_MONOTONIC,&tdata[2]);
@@ -20,6 +20,80 @@ int print_modes(waveform_t *waveform) {
 	return 0;
 }
 
+/* prints the telemetry of the output interfaces, if any was collected */
+void print_itfinfo(waveform_t *waveform) {
+	int i, j, header=0;
+	rtdal_itf_stats_t *s;
+	for (i=0;i<waveform->nof_modules;i++) {
+		for (j=0;j<waveform->modules[i].execinfo.nof_itf;j++) {
+			s = &waveform->modules[i].execinfo.itf[j];
+			if (!s->pushed && !s->dropped) {
+				continue;
+			}
+			if (!header) {
+				printf("\n Output\t\t\t     Pushed  Dropped  Empty  HWM  Lat slots (mean/max)"
+						"  Lat us (mean/max)\n");
+				header=1;
+			}
+			printf(" %-20s:%d%11lld%9lld%7lld%5d%12.2f/%-9d%9.1f/%.1f\n",
+					waveform->modules[i].name,j,s->pushed,s->dropped,s->empty,s->max_occupancy,
+					s->mean_latency_slots,s->max_latency_slots,s->mean_latency_ns/1000,
+					(float) s->max_latency_ns/1000);
+		}
+	}
+}
+
+static void print_perfline(char *name, int proc, rtdal_perf_counters_t *p) {
+	long long ki = p->count[RTDAL_PERF_INSTRUCTIONS]/1000;
+	long long cycles = p->count[RTDAL_PERF_CYCLES];
+	if (!ki) {
+		ki = 1;
+	}
+	printf(" %-20s%5d%10lld%14.1f%7.2f%9.2f%9.2f%9.2f\n",name,proc,p->runs,
+			(double) cycles/(p->runs?p->runs:1)/1000,
+			(double) p->count[RTDAL_PERF_INSTRUCTIONS]/(cycles?cycles:1),
+			(double) p->count[RTDAL_PERF_L1D_MISSES]/ki,
+			(double) p->count[RTDAL_PERF_LLC_MISSES]/ki,
+			(double) p->count[RTDAL_PERF_BRANCH_MISSES]/ki);
+}
+
+/* prints the hardware counters of the modules grouped by processor, if any was collected */
+void print_perfinfo(waveform_t *waveform) {
+	rtdal_perf_counters_t total;
+	execinfo_t *e;
+	int i, j, p, max_proc=0, n, header=0;
+
+	for (i=0;i<waveform->nof_modules;i++) {
+		if (waveform->modules[i].processor_idx > max_proc) {
+			max_proc = waveform->modules[i].processor_idx;
+		}
+	}
+	for (p=0;p<=max_proc;p++) {
+		memset(&total,0,sizeof(rtdal_perf_counters_t));
+		n = 0;
+		for (i=0;i<waveform->nof_modules;i++) {
+			e = &waveform->modules[i].execinfo;
+			if (waveform->modules[i].processor_idx != p || !e->perf.runs) {
+				continue;
+			}
+			if (!header) {
+				printf("\n Module\t\t     Proc      Runs  Kcycles/run    IPC"
+						"  L1D/ki   LLC/ki   Br/ki\n");
+				header=1;
+			}
+			print_perfline(waveform->modules[i].name,p,&e->perf);
+			total.runs += e->perf.runs;
+			for (j=0;j<RTDAL_PERF_NOF_EVENTS;j++) {
+				total.count[j] += e->perf.count[j];
+			}
+			n++;
+		}
+		if (n > 1) {
+			print_perfline("  total",p,&total);
+		}
+	}
+}
+
 int print_execinfo(waveform_t *waveform, int tslot_us) {
 	int i;
 	const char *t;
@@ -45,15 +119,21 @@ int print_execinfo(waveform_t *waveform, int tslot_us) {
 	}
 	printf(" Total\t\t\t%11d (%.2f%%)\t Max: %d (%.2f%%)\n",total_cpu, (float) 100*total_cpu/tslot_us,
 			total_max_cpu, (float) 100*total_max_cpu/tslot_us);
+	print_itfinfo(waveform);
+	print_perfinfo(waveform);
 	return 0;
 }
 
 rtdal_machine_t machine;
 
+#define CALIBRATE_SLOTS		1000
+#define CALIBRATE_PERCENTILE	99.0
+
 void *_run_main(void *arg) {
 	int c;
 	int tslen;
 	int mode;
+	int proc;
 
 	rtdal_machine(&machine);
 	tslen = machine.ts_len_ns/1000;
@@ -83,6 +163,8 @@ void *_run_main(void *arg) {
 			"\t<s>\tStop waveform\n"
 			"\t<m>\tSet waveform mode\n"
 			"\t<e>\tView execution time\n"
+			"\t<c>\tCalibrate costs and remap\n"
+			"\t<g>\tMove a module to another processor\n"
 			"\n<Ctr+C>\tExit\n");
 	waveform_status_t new_status;
 	do {
@@ -150,6 +232,27 @@ void *_run_main(void *arg) {
 				break;
 			}
 			break;
+		case 'g':
+			getchar();
+			printf("\nEnter module index and processor: ");
+			if (scanf("%d %d",&mode,&proc) != 2 || mode < 0 || mode >= waveform.nof_modules) {
+				aerror("reading input\n");
+				break;
+			}
+			if (waveform_migrate(&waveform,waveform.modules[mode].name,proc)) {
+				aerror("moving module\n");
+				break;
+			}
+			printf("OK!\n");
+			break;
+		case 'c':
+			printf("\nCalibrating during %d slots...\n",CALIBRATE_SLOTS);
+			if (waveform_calibrate(&waveform,CALIBRATE_SLOTS,CALIBRATE_PERCENTILE,1)) {
+				aerror("calibrating waveform\n");
+				break;
+			}
+			printf("OK!\n");
+			break;
 		case '\n':
 			break;
 		default:
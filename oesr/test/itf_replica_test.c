@@ -0,0 +1,184 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Checks the ports entering and leaving a replicated group of modules. An output port fanned out
+ * to two copies must send each non-empty packet to the next copy, and a zero-length packet, which
+ * is not queued, must not move to the next copy. An input port fanned in from two copies must
+ * receive first the packet with the oldest time slot, whatever copy finished first and however
+ * many packets each copy generated.
+ *
+ * Returns 0 if all the checks pass.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "rtdal.h"
+#include "rtdal_context.h"
+#include "oesr.h"
+#include "waveform.h"
+#include "nod_anode.h"
+
+#define MSG_SZ		64
+#define MAX_MSG		8
+
+r_log_t rtdal_log;
+
+/* provided by the kernel, the node and the dataflow workers, unused with the interfaces alone */
+rtdal_context_t rtdal;
+void dataflow_remove_itf(r_itf_t itf) {}
+void dataflow_wake(rtdal_process_t *proc) {}
+struct log_cfg logs_cfg;
+r_log_t oesr_log, queues_log;
+nod_module_t *nod_waveform_find_module_id(nod_waveform_t *w, int module_id) {return NULL;}
+void rtdal_machine(rtdal_machine_t *machine) {}
+int rtdal_process_add_itf(r_proc_t proc, r_itf_t itf, int is_input) {return 0;}
+r_itf_t rtdal_itfphysic_get_id(int id) {return NULL;}
+
+static rtdal_error_t error_ctx;
+static rtdal_time_t time_ctx;
+
+static r_itf_t queues[2];
+static interface_t fan_out, fan_in;
+
+#define check(cond, msg) if (!(cond)) { printf("%s:%d: %s\n",__FILE__,__LINE__,msg); return -1; }
+
+static void replicated(interface_t *x) {
+	memset(x,0,sizeof(interface_t));
+	x->replicas = 2;
+	x->replica_itf[0] = queues[0];
+	x->replica_itf[1] = queues[1];
+	x->hw_itf = queues[0];
+}
+
+/* sends a packet of len bytes with the time slot tslot in its metadata */
+static int put(interface_t *x, int len, int tslot) {
+	itf_t itf = (itf_t) x;
+	void *ptr;
+	pkt_meta_t *meta;
+	check(oesr_itf_ptr_request(itf,&ptr) == 1, "request failed");
+	meta = oesr_itf_ptr_meta(itf,ptr);
+	check(meta, "no metadata");
+	meta->tslot = tslot;
+	memset(ptr,tslot,MSG_SZ);
+	check(oesr_itf_ptr_put(itf,ptr,len,0) == 1, "put failed");
+	return 0;
+}
+
+/* returns the time slot of the packet pending in queue q, or -1 if it is empty */
+static int head(int q) {
+	void *ptr;
+	int len;
+	if (rtdal_itf_pop(queues[q],&ptr,&len,0) != 1) {
+		return -1;
+	}
+	return ((pkt_meta_t*) rtdal_itf_meta(queues[q],ptr))->tslot;
+}
+
+static int drop(int q) {
+	void *ptr;
+	int len;
+	check(rtdal_itf_pop(queues[q],&ptr,&len,0) == 1, "pop failed");
+	check(rtdal_itf_release(queues[q],ptr,len) == 1, "release failed");
+	return 0;
+}
+
+/* receives a packet through the port leaving the group and returns its time slot */
+static int get(interface_t *x) {
+	itf_t itf = (itf_t) x;
+	void *ptr;
+	int len, tslot;
+	check(oesr_itf_ptr_get(itf,&ptr,&len,0) == 1, "get failed");
+	tslot = oesr_itf_ptr_meta(itf,ptr)->tslot;
+	check(oesr_itf_ptr_release(itf,ptr,len) == 1, "release failed");
+	return tslot;
+}
+
+static int test_fan_out() {
+	replicated(&fan_out);
+	if (put(&fan_out,0,1) || put(&fan_out,MSG_SZ,2) || put(&fan_out,0,3)
+			|| put(&fan_out,MSG_SZ,4) || put(&fan_out,MSG_SZ,5)) {
+		return -1;
+	}
+	check(head(0) == 2, "first packet not sent to copy 0");
+	if (drop(0)) {
+		return -1;
+	}
+	check(head(0) == 5, "third packet not sent to copy 0");
+	check(head(1) == 4, "zero-length packet moved the second one to copy 0");
+	if (drop(0) || drop(1)) {
+		return -1;
+	}
+	check(head(0) == -1 && head(1) == -1, "zero-length packets were queued");
+	return 0;
+}
+
+/* sends a packet with the time slot tslot through the queue of copy q */
+static int put_copy(int q, int tslot) {
+	void *ptr;
+	check(rtdal_itf_request(queues[q],&ptr) == 1, "request failed");
+	((pkt_meta_t*) rtdal_itf_meta(queues[q],ptr))->tslot = tslot;
+	check(rtdal_itf_push(queues[q],ptr,MSG_SZ,0) == 1, "push failed");
+	return 0;
+}
+
+static int test_fan_in() {
+	rtdal_itf_stats_t s0, s1;
+	void *ptr;
+	int len;
+
+	replicated(&fan_in);
+	rtdal_itf_set_stats(queues[0],1);
+	rtdal_itf_set_stats(queues[1],1);
+	/* copy 0 generates two packets for the input of slot 9 and copy 1 finishes slot 11 first */
+	if (put_copy(1,11) || put_copy(0,9) || put_copy(0,10) || put_copy(1,12)) {
+		return -1;
+	}
+	check(get(&fan_in) == 9, "slot 9 not received first");
+	check(get(&fan_in) == 10, "slot 10 not received second");
+	check(get(&fan_in) == 11, "slot 11 not received third");
+	check(get(&fan_in) == 12, "slot 12 not received last");
+	check(oesr_itf_ptr_get((itf_t) &fan_in,&ptr,&len,0) == 0, "empty group returned a packet");
+	/* only the copy that is read counts an empty pop, not the ones compared with it */
+	rtdal_itf_get_stats(queues[0],&s0);
+	rtdal_itf_get_stats(queues[1],&s1);
+	check(s0.empty+s1.empty == 1, "unread copies counted as empty");
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	int ret;
+
+	rtdal_error_set_context(&error_ctx);
+	rtdal_time_set_context(&time_ctx);
+
+	queues[0] = rtdal_itfspscq_new(MAX_MSG,MSG_SZ,0,NULL);
+	queues[1] = rtdal_itfspscq_new(MAX_MSG,MSG_SZ,0,NULL);
+	if (!queues[0] || !queues[1]) {
+		printf("Error creating the queues\n");
+		return -1;
+	}
+	ret = test_fan_out() || test_fan_in();
+	if (!ret) {
+		printf("replicated interfaces ok\n");
+	}
+	rtdal_itf_remove(queues[0]);
+	rtdal_itf_remove(queues[1]);
+	return ret?-1:0;
+}
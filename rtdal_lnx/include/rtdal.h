@@ -73,11 +73,16 @@ struct rtdal_process_attr {
 	int exec_position; /**< Indicates the execution position in the processing core. */
 	int process_group_id;
 	void* (*finish_callback)(void*); /**< Callback function used to notify changes in rtdal_processerror_t */
+	int period; /**< The process runs once every period time slots. 0 or 1 runs it every slot */
+	int phase; /**< Time slot, modulo period, in which the process runs. Must be lower than period */
 };
 
 /** Maximum process_group_id number */
 #define MAX_PROCESS_GROUP_ID	100
 
+/** Maximum number of processes moved together by rtdal_process_migrate() */
+#define RTDAL_MAX_MIGRATE		16
+
 r_proc_t rtdal_process_new(struct rtdal_process_attr *attr, void *arg);
 int rtdal_process_remove(r_proc_t proc);
 int rtdal_process_run(r_proc_t proc);
@@ -86,6 +91,17 @@ int rtdal_process_seterror(r_proc_t proc, rtdal_processerrors_t code);
 rtdal_processerrors_t rtdal_process_geterror(r_proc_t proc);
 int rtdal_process_isrunning(r_proc_t proc);
 int rtdal_process_group_notified(r_proc_t proc);
+int rtdal_process_depends(r_proc_t proc, r_proc_t pred);
+int rtdal_process_link(r_proc_t proc, r_proc_t src, int delay);
+int rtdal_process_add_itf(r_proc_t proc, r_itf_t itf, int is_input);
+int rtdal_process_migrate(r_proc_t *procs, int nof_procs, int pipeline_id);
+int rtdal_pipeline_overruns(int pipeline_id);
+long long rtdal_pipeline_missed_slots(int pipeline_id);
+long long rtdal_pipeline_missed_ticks(int pipeline_id);
+int rtdal_pipeline_get_stats(int pipeline_id, rtdal_pipeline_stats_t *stats);
+int rtdal_pipeline_get_jitter(int pipeline_id, rtdal_jitter_stats_t *stats);
+int rtdal_pipeline_get_perf(int pipeline_id, rtdal_perf_counters_t *perf);
+int rtdal_process_get_perf(r_proc_t proc, rtdal_perf_counters_t *perf);
 
 /**@} */
 
@@ -132,6 +148,9 @@ int rtdal_file_read(int fd, void* buf, int size);
  */
 #define RTDAL_LOG_OPTS_EXCL	0x1
 int rtdal_log_init(char *base_path, int max_logs, int max_str_len,  int _default_log_sz, void *redirect_stream);
+int rtdal_log_init_trace(int ring_kb, int flush_ms);
+void rtdal_log_trace_timeline(int enable);
+void rtdal_log_trace_name(void *obj, char *name);
 void rtdal_log_flushall();
 void rtdal_log_flush(r_log_t log);
 r_log_t rtdal_log_new(char *name, r_log_mode_t mode, int size);
@@ -144,6 +163,22 @@ void rtdal_log_add_tslot(r_log_t log);
 /**@} */
 
 
+/**@defgroup pool Reference-counted buffer pools
+ * A buffer obtained with rtdal_pool_get() has one reference. It returns to the pool when the
+ * last reference is dropped with rtdal_pool_unref(). References may be added and dropped from
+ * any task.
+ * @{
+ */
+r_pool_t rtdal_pool_new(int nof_buffers, int buffer_sz);
+int rtdal_pool_remove(r_pool_t pool);
+int rtdal_pool_reset(r_pool_t pool);
+void *rtdal_pool_get(r_pool_t pool);
+int rtdal_pool_ref(void *ptr);
+int rtdal_pool_unref(void *ptr);
+int rtdal_pool_refcnt(void *ptr);
+void *rtdal_pool_meta(void *ptr);
+/**@} */
+
 /**@defgroup itf Interfaces functions
  * @{ */
 
@@ -153,7 +188,18 @@ int rtdal_itfphysic_create(r_itf_t obj, string address);
 int rtdal_itfphysic_connect(r_itf_t obj);
 int rtdal_itfphysic_disconnect(r_itf_t obj);
 
+/* negative delays of the internal interfaces */
+#define RTDAL_ITF_BLOCKING		-1	/* blocks on a semaphore posted on every packet */
+#define RTDAL_ITF_POLLING		-2	/* returns empty after waiting up to 1 ms for a packet */
+#define RTDAL_ITF_FUTEX			-3	/* spins and then blocks on a futex */
+
+#define RTDAL_PKT_META_SZ		32	/* bytes of metadata carried with every packet */
+
 r_itf_t rtdal_itfspscq_new(int max_msg, int msg_sz, int delay, r_log_t log);
+r_itf_t rtdal_itflfq_new(int max_msg, int msg_sz, int delay, r_log_t log);
+r_itf_t rtdal_itfbring_new(int buf_sz, int msg_sz, int delay, r_log_t log);
+int rtdal_itfbring_get_size(r_itf_t obj);
+r_itf_t rtdal_itfrefq_new(int max_msg, int msg_sz, int delay, r_log_t log);
 
 int rtdal_itf_reset(r_itf_t obj);
 int rtdal_itf_remove(r_itf_t obj);
@@ -162,12 +208,22 @@ int rtdal_itf_set_blocking(r_itf_t obj, int block);
 int rtdal_itf_get_blocking(r_itf_t obj);
 int rtdal_itf_push(r_itf_t obj, void *ptr, int len, int tstamp);
 int rtdal_itf_pop(r_itf_t obj, void **ptr, int *len, int tstamp);
+int rtdal_itf_peek(r_itf_t obj, void **ptr, int *len, int tstamp);
 int rtdal_itf_request(r_itf_t obj, void **ptr);
 int rtdal_itf_release(r_itf_t obj, void *ptr, int len);
+int rtdal_itf_request_n(r_itf_t obj, void **ptr, int max);
+int rtdal_itf_pop_n(r_itf_t obj, void **ptr, int *len, int max, int tstamp);
 int rtdal_itf_send(r_itf_t obj, void* buffer, int len, int tstamp);
 int rtdal_itf_recv(r_itf_t obj, void* buffer, int len, int tstamp);
 int rtdal_itf_set_delay(r_itf_t obj, int delay);
 int rtdal_itf_get_delay(r_itf_t obj);
+int rtdal_itf_ready(r_itf_t obj, int is_input);
+int rtdal_itf_is_shared(r_itf_t obj);
+int rtdal_itf_push_ref(r_itf_t obj, r_itf_t src, void *ptr, int len, int tstamp);
+void *rtdal_itf_meta(r_itf_t obj, void *ptr);
+int rtdal_itf_set_stats(r_itf_t obj, int enable);
+int rtdal_itf_get_stats(r_itf_t obj, rtdal_itf_stats_t *stats);
+int rtdal_itf_place(r_itf_t obj, int pipeline_id);
 /**@} */
 
 /**@defgroup dac AD/DA interface
@@ -218,6 +274,7 @@ int rtdal_dac_recv(r_dac_t obj, void *data, int nsamples, int blocking);
 #define RTDAL_ERROR_LARGE 		5
 #define RTDAL_ERROR_NOTFOUND 	6
 #define RTDAL_ERROR_DL			7
+#define RTDAL_ERROR_NOTREADY	8
 
 
 char* rtdal_error_string();
@@ -286,6 +343,75 @@ void rtdal_error_print(const char *user_message);
  * it will be killed and the finish_callback function will be called. The core execution thread will
  * then continue with the next process in the pipeline.
  *
+ * <b> DAG SCHEDULING </b>
+ *
+ * With the dag scheduling the pipeline_id only selects the core that starts a process. Within a
+ * time slot, a process runs after the processes declared with rtdal_process_depends() and may be
+ * stolen by any idle core, so independent branches of a waveform run in parallel. The time slot
+ * finishes when all the processes have run. The rt_cfg miss_correct and exec_correct options are
+ * not applied, since all the pipelines take part in every time slot.
+ *
+ * <b> MIGRATION </b>
+ *
+ * With the pipeline scheduling, rtdal_process_migrate() moves running processes to another
+ * pipeline at a time slot boundary: they run in the old pipeline until the time slot t of the
+ * handover and in the new one from the next time slot it starts. They never run twice in a time
+ * slot. However, if the old pipeline finishes slot t late, after the new one has started slot
+ * t+1, the processes do not run in slot t+1 and join the new pipeline in slot t+2.
+ * rtdal_pipeline_overruns() returns how many consecutive time slots a
+ * pipeline has finished late, which can be used to decide when to move processes away from it.
+ *
+ * <b> SLACK AND DEADLINE ORDER </b>
+ *
+ * With the slack_stats option, each pipeline measures the time left before the next tick when it
+ * finishes a time slot. rtdal_pipeline_get_stats() returns its minimum, mean and histogram. With the
+ * edf_order option, each pipeline runs its processes in deadline order instead of exec_position
+ * order. A process must finish before the processes that depend on it (rtdal_process_depends())
+ * can start, so the ones feeding other pipelines in the same time slot run first.
+ *
+ * <b> TIMER JITTER </b>
+ *
+ * With timer_spin_us, the single and multi timers sleep on CLOCK_MONOTONIC until timer_spin_us
+ * before each tick and busy-wait the rest, trading a busy core for a shorter wake-up delay. With
+ * the jitter_stats option, each pipeline measures how late it starts every time slot with respect
+ * to its tick. rtdal_pipeline_get_jitter() returns the maximum, mean and histogram.
+ *
+ * <b> PERFORMANCE COUNTERS </b>
+ *
+ * With the perf_counters option, each pipeline opens a group of hardware counters (cycles,
+ * instructions, L1 data and last level cache misses and branch misses) with perf_event_open() and
+ * reads it before and after running each process. rtdal_process_get_perf() returns the counts of
+ * a process and rtdal_pipeline_get_perf() the sum over the processes run by a pipeline. Reading
+ * the group costs two system calls per process and time slot. The processes run by the
+ * best-effort worker pool are not counted.
+ *
+ * <b> TIMER OVERRUNS </b>
+ *
+ * A tick is missed when the timer wakes up one or more periods after it, because the previous
+ * time slot ran for too long. rtdal_pipeline_missed_ticks() returns how many ticks the timer of a
+ * pipeline has missed. With timer_overrun="compress" (default) the missed ticks are run back to
+ * back to catch up, and the time slot counter counts ticks. With timer_overrun="skip" they are
+ * dropped and the time slot counter jumps to the time slot of the real time, so the timestamps and
+ * delays of the packets keep their meaning in real time. rtdal_pipeline_missed_slots() returns how
+ * many time slots a pipeline has not run.
+ *
+ * <b> BATCH CLOCK </b>
+ *
+ * With timer_mode="batch" there is no timer and each pipeline runs its time slots as fast as it
+ * can, so a waveform can be run offline to measure how many subframes per second the machine
+ * processes. In a pipeline thread, rtdal_time_slot() returns the time slot of that pipeline. A
+ * pipeline runs at most batch_window time slots ahead of the others, and not before the packets
+ * it reads from the processes declared with rtdal_process_link() have been written. The
+ * processes must not be migrated.
+ *
+ * <b> BEST-EFFORT WORKER POOL </b>
+ *
+ * With the best-effort scheduling and the besteffort_workers option, a fixed pool of threads runs
+ * the processes instead of one thread per process. A process is run when all the blocking
+ * interfaces declared with rtdal_process_add_itf() are ready (see rtdal_itf_ready()): its inputs
+ * have a packet and its outputs have space. Pushing or releasing a packet wakes up the process at
+ * the other side. Polling inputs are not waited for.
+ *
  */
 
 /** \addtogroup task
@@ -322,6 +448,10 @@ void rtdal_error_print(const char *user_message);
  *
  * Interfaces can have an associated <b> delay </b>, which is a non-negative integer number. If delay
  * is non-null, a packet generated at time slot <i>n</i> is not received until timeslot <i>n+delay</i>.
+ * Negative delays are used when the tasks are not synchronized to the time slot: with
+ * RTDAL_ITF_BLOCKING and RTDAL_ITF_FUTEX the receiver blocks until a packet is available, and with
+ * RTDAL_ITF_POLLING it waits for a packet for a bounded time. RTDAL_ITF_FUTEX spins for a short
+ * time before sleeping and the sender only makes a system call if the receiver is sleeping.
  *
  * Two or more tasks can communicate with an internal interface if all use the same r_itf_t handler with the
  * send/recv or push/pop functions. Only one task can create the interface and need to share the
@@ -331,10 +461,21 @@ void rtdal_error_print(const char *user_message);
  * Two or more tasks using rtdal_itfphysic_get() to obtain a handler to a physical interface with the same
  * name can send and receive data.
  *
- * TODO: Physical interfaces are not yet implemented.
+ * Physical interfaces can be shared memory rings between processes ("shm://name") or network
+ * sockets ("tcp://host:port", "udp://host:port").
  *
  * There are two kinds of internal interfaces:
  * 	- SPSCQ is a single producer single consumer wait-free queue.
+ * 	- LFQ is also a single producer single consumer queue, but the read and write indices are
+ * 	published with acquire/release atomics and kept in separate cache lines. It is safe on
+ * 	weakly-ordered hardware and avoids false sharing when producer and consumer run on different
+ * 	cores.
+ * 	- BRING is a single producer single consumer byte ring. Packets are stored contiguously and
+ * 	only take the length they were pushed with, so the buffer can be much smaller than
+ * 	max_msg*msg_sz when most packets are shorter than the maximum.
+ * 	- REFQ carries references to buffers of a rtdal pool. A buffer popped from a REFQ can be pushed
+ * 	to any number of other REFQ with rtdal_itf_push_ref() without copying it. It returns to the
+ * 	pool after the last consumer releases it.
  * 	- MPMCQ is a multi producer multi consumer lock-free queue which may be used if more than one
  * 	task has to read or write from the interface. TODO: This is currently under development
  *
@@ -412,6 +553,28 @@ void rtdal_error_print(const char *user_message);
  *
  * The zero-copy mode is operated using the rtdal_itf_push(), rtdal_itf_pop(), rtdal_itf_request() and
  * rtdal_itf_release() functions.
+ *
+ * A consumer that falls behind may drain several packets at once with rtdal_itf_pop_n(), and a
+ * producer may obtain several buffers with rtdal_itf_request_n(). Packets are then released or
+ * pushed one by one in the same order.
+ *
+ * Every packet carries RTDAL_PKT_META_SZ bytes of metadata next to its contents. In zero-copy mode,
+ * rtdal_itf_meta() returns the address of the metadata of a packet obtained with rtdal_itf_request()
+ * or rtdal_itf_pop(). It is cleared by rtdal_itf_request() and travels with the packet without
+ * copying the payload. RTDAL does not interpret it. Physical network interfaces send it in the
+ * byte order of the host.
+ *
+ * The internal interfaces can measure their own behaviour. After rtdal_itf_set_stats(), they count
+ * the pushed packets, the requests that failed because the interface was full, the popped packets
+ * and the pops that found no packet, and they track the occupancy high-water mark and the latency
+ * from push() to release(), in time slots and in nanoseconds. rtdal_itf_get_stats() can be called
+ * from any thread. The counters are cleared by rtdal_itf_reset().
+ *
+ * On NUMA machines, the buffers of an internal interface are placed in the node of the thread
+ * that creates it, usually the producer. rtdal_itf_place() moves them to the node of the core of
+ * another pipeline, normally the one of the consumer, when the numa_policy option of the platform
+ * is preferred or bind. With these policies, each pipeline thread also allocates its memory,
+ * including the buffers the modules allocate at initialization, in the node of its core.
  */
 
 
@@ -23,13 +23,32 @@
 #include "str.h"
 
 enum clock_mode {
-	SINGLE_TIMER, MULTI_TIMER, NO_TIMER
+	SINGLE_TIMER, MULTI_TIMER, NO_TIMER, BATCH_TIMER
+};
+
+/* what the timer does with the ticks missed while a time slot runs longer than a period */
+enum timer_overrun {
+	OVERRUN_COMPRESS, OVERRUN_SKIP
 };
 
 #define RT_FAULT_OPTS_HARD 1
 #define RT_FAULT_OPTS_SOFT 2
 
 #define RTDAL_MAX_CORES		16
+#define RTDAL_MAX_PHYSIC	5
+
+/* physical interface defined in the physic_itfs section of the platform configuration */
+struct rtdal_physic_cfg {
+	int id;
+	strdef(name);
+	lstrdef(address);
+	int mode_is_input;
+	int max_msg;
+	int msg_sz;
+	int blocking;
+	int delay;
+	int batch;
+};
 
 struct rtdal_logs_cfg {
 	int enabled;
@@ -37,6 +56,10 @@ struct rtdal_logs_cfg {
 	int timing_en;
 	int log_to_stout;
 	int log_length_mb;
+	int trace;
+	int trace_kb;
+	int trace_flush_ms;
+	int timeline;
 	lstrdef(base_path);
 };
 
@@ -49,8 +72,10 @@ struct rtfault_cfg {
 	int xenomai_warn_msw;
 };
 
-enum scheduling_mode {SCHEDULING_PIPELINE, SCHEDULING_BESTEFFORT};
+enum scheduling_mode {SCHEDULING_PIPELINE, SCHEDULING_BESTEFFORT, SCHEDULING_DAG};
 enum queue_mode {QUEUE_NONBLOCKING, QUEUE_BLOCKING};
+enum queue_type {QUEUE_TYPE_SPSCQ, QUEUE_TYPE_LFQ, QUEUE_TYPE_BRING, QUEUE_TYPE_REFQ};
+enum numa_policy {NUMA_POLICY_NONE, NUMA_POLICY_PREFERRED, NUMA_POLICY_BIND};
 
 /**
  * Public structure configured at initialize() from the information read from platform.conf. Stores some properties of the local machine architecture.
@@ -70,6 +95,13 @@ typedef struct {
 	int pipeline_prio;
 	int sync_period;
 	int sync_continuous;
+	int sync_mode;
+	int sync_spin_us;
+	int timer_spin_us;
+	enum timer_overrun timer_overrun;
+	int batch_window;
+	int batch_slots;
+	int batch_report_s;
 	int slave_master;
 	int max_waveforms;
 	int max_modules_x_waveform;
@@ -82,6 +114,17 @@ typedef struct {
 	void (*slave_sync_kernel) (void*, struct timespec *time);
 	enum scheduling_mode scheduling;
 	enum queue_mode queues;
+	enum queue_type queue_type;
+	float queue_bring_ratio;
+	int itf_stats;
+	enum numa_policy numa_policy;
+	int slack_stats;
+	int jitter_stats;
+	int perf_counters;
+	int edf_order;
+	int besteffort_workers;
+	struct rtdal_physic_cfg physic_itfs[RTDAL_MAX_PHYSIC];
+	int nof_physic_itfs;
 }rtdal_machine_t;
 
 #endif
@@ -37,6 +37,80 @@ struct h_itf_ {
 };
 typedef struct h_itf_* r_itf_t;
 
+/**
+ * Telemetry of an internal interface, returned by rtdal_itf_get_stats(). Latencies are measured
+ * from the push() of a packet to its release() by the consumer.
+ */
+typedef struct {
+	long long pushed;
+	long long dropped;		/**< Requests that failed because the interface was full */
+	long long popped;
+	long long empty;		/**< Pops that returned no packet */
+	int max_occupancy;		/**< High-water mark, in packets */
+	int max_latency_slots;
+	float mean_latency_slots;
+	float mean_latency_ns;
+	long long max_latency_ns;
+}rtdal_itf_stats_t;
+
+/** Number of bins of the slack histogram in rtdal_pipeline_stats_t */
+#define RTDAL_SLACK_HIST_SZ	21
+
+/**
+ * Slack of a pipeline, returned by rtdal_pipeline_get_stats(). The slack of a time slot is the
+ * time left before the next tick when its last process finishes. slack_hist[0] counts the slots
+ * finished after the next tick and slack_hist[i] the ones with a slack between (i-1)*5% and
+ * i*5% of the time slot. The last bin also counts the larger ones.
+ */
+typedef struct {
+	long long slots;
+	long long late;			/**< Slots finished after the next tick */
+	long long min_slack_ns;
+	float mean_slack_ns;
+	unsigned int slack_hist[RTDAL_SLACK_HIST_SZ];
+}rtdal_pipeline_stats_t;
+
+/** Number of bins of the wake-up error histogram in rtdal_jitter_stats_t */
+#define RTDAL_JITTER_HIST_SZ	24
+
+/**
+ * Wake-up error of a pipeline, returned by rtdal_pipeline_get_jitter(): how late it started each
+ * time slot with respect to the tick. hist[0] counts the errors below 1 us and hist[i] the ones
+ * between 2^(i-1) and 2^i us. The last bin also counts the larger ones.
+ */
+typedef struct {
+	long long slots;
+	long long max_ns;
+	long long sum_ns;
+	unsigned int hist[RTDAL_JITTER_HIST_SZ];
+}rtdal_jitter_stats_t;
+
+/** Hardware events counted with the perf_counters option */
+enum rtdal_perf_event {
+	RTDAL_PERF_CYCLES = 0,
+	RTDAL_PERF_INSTRUCTIONS,
+	RTDAL_PERF_L1D_MISSES,		/**< Level 1 data cache read misses */
+	RTDAL_PERF_LLC_MISSES,		/**< Last level cache misses */
+	RTDAL_PERF_BRANCH_MISSES,
+	RTDAL_PERF_NOF_EVENTS
+};
+
+/**
+ * Hardware performance counters of a process or a pipeline, returned by rtdal_process_get_perf()
+ * and rtdal_pipeline_get_perf(). Only user space is counted, while the processes run. The events
+ * the CPU does not count are 0. When the kernel multiplexes the counters the values are
+ * scaled.
+ */
+typedef struct {
+	long long runs;
+	long long count[RTDAL_PERF_NOF_EVENTS];
+}rtdal_perf_counters_t;
+
+struct h_pool_ {
+	int id;
+};
+typedef struct h_pool_* r_pool_t;
+
 
 struct h_dac_ {
 	int id;
@@ -0,0 +1,34 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CPU_RELAX_H_
+#define CPU_RELAX_H_
+
+/**
+ * Hint to the processor that the caller is spinning on a shared variable. Used by all the
+ * spin-then-futex waits.
+ */
+static inline void cpu_relax() {
+#if defined(__i386__) || defined(__x86_64__)
+	__asm__ __volatile__("pause");
+#else
+	__asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+#endif /* CPU_RELAX_H_ */
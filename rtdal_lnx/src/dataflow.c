@@ -0,0 +1,356 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "rtdal.h"
+#include "rtdal_error.h"
+#include "rtdal_context.h"
+#include "rtdal_itf.h"
+#include "rtdal_itfphysic.h"
+#include "rtdal_process.h"
+#include "rtdal_task.h"
+#include "modulethread.h"
+#include "dataflow.h"
+#include "defs.h"
+
+/**
+ * Worker pool for SCHEDULING_BESTEFFORT.
+ *
+ * Instead of one thread per process, a fixed number of workers (usually one per core) run the
+ * processes from a FIFO ready list. A process is put in the list when one of its interfaces
+ * changes (the queues call dataflow_notify() after a push or a release) or when it is started,
+ * and a worker only runs it if all its blocking inputs have a packet and all its blocking
+ * outputs have space. After running, it goes back to the list while it is still ready, so a
+ * source keeps running until its outputs are full.
+ *
+ * The state of a process is changed with atomic operations. Notifications never take the mutex
+ * unless the process is idle: a notification while it is running marks it dirty and the worker
+ * requeues it afterwards, so no notification is lost between the readiness check and going idle.
+ * Every transition to or from DF_QUEUED is done with the mutex held.
+ *
+ * Interfaces not declared with rtdal_process_add_itf() (like the external ones) are not tracked,
+ * and a process that still blocks inside them holds its worker.
+ */
+
+#define DATAFLOW_REMOVE_WAIT_MS		1000
+
+enum dataflow_state {
+	DF_REMOVED=0, DF_IDLE, DF_QUEUED, DF_RUNNING, DF_DIRTY
+};
+
+extern rtdal_context_t rtdal;
+
+static struct {
+	int nof_workers;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	rtdal_process_t *head;
+	rtdal_process_t *tail;
+} df;
+
+/* process being run by this worker */
+static __thread rtdal_process_t *df_current;
+
+static inline void df_enqueue(rtdal_process_t *proc) {
+	proc->df_next = NULL;
+	if (df.tail) {
+		df.tail->df_next = proc;
+	} else {
+		df.head = proc;
+	}
+	df.tail = proc;
+	pthread_cond_signal(&df.cond);
+}
+
+static inline rtdal_process_t *df_dequeue() {
+	rtdal_process_t *proc = df.head;
+	df.head = proc->df_next;
+	if (!df.head) {
+		df.tail = NULL;
+	}
+	return proc;
+}
+
+static void df_unlink(rtdal_process_t *proc) {
+	rtdal_process_t *prev = NULL, *x;
+	for (x=df.head;x && x != proc;x=x->df_next) {
+		prev = x;
+	}
+	if (!x) {
+		return;
+	}
+	if (prev) {
+		prev->df_next = proc->df_next;
+	} else {
+		df.head = proc->df_next;
+	}
+	if (df.tail == proc) {
+		df.tail = prev;
+	}
+}
+
+/* polling inputs (back edges) never block, so they do not need to be ready */
+static int df_ready(rtdal_process_t *proc) {
+	int i, ready = 1, delay;
+
+	pthread_mutex_lock(&proc->itf_mutex);
+	for (i=0;i<proc->nof_itfs && ready;i++) {
+		delay = ((rtdal_itf_t*) proc->itfs[i])->delay;
+		if (delay >= 0 || (proc->itf_is_input[i] && delay == RTDAL_ITF_POLLING)) {
+			continue;
+		}
+		ready = rtdal_itf_ready(proc->itfs[i], proc->itf_is_input[i]) == 1;
+	}
+	pthread_mutex_unlock(&proc->itf_mutex);
+	return ready;
+}
+
+/* returns non-zero if the process should run again */
+static int df_run(rtdal_process_t *proc) {
+	if (!proc->runnable || !proc->run_point || !df_ready(proc)) {
+		return 0;
+	}
+	df_current = proc;
+	proc->is_running = 1;
+	if (proc->run_point(proc->arg)) {
+		rtdal_itfphysic_flush();
+		aerror_msg("Error running module %s\n",proc->attributes.binary_path);
+		proc->is_running = 0;
+		dataflow_remove(proc);
+		df_current = NULL;
+		return 0;
+	}
+	rtdal_itfphysic_flush();
+	proc->is_running = 0;
+	df_current = NULL;
+	modulethread_check_status(proc);
+	return proc->runnable && proc->run_point && df_ready(proc);
+}
+
+static void *dataflow_worker(void *arg) {
+	rtdal_process_t *proc;
+	int again, state;
+
+	pthread_mutex_lock(&df.mutex);
+	while(1) {
+		while (!df.head) {
+			pthread_cond_wait(&df.cond, &df.mutex);
+		}
+		proc = df_dequeue();
+		__atomic_store_n(&proc->df_state, DF_RUNNING, __ATOMIC_SEQ_CST);
+		pthread_mutex_unlock(&df.mutex);
+
+		/* pairs with the fence in dataflow_wake() */
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		again = df_run(proc);
+
+		pthread_mutex_lock(&df.mutex);
+		state = __atomic_load_n(&proc->df_state, __ATOMIC_SEQ_CST);
+		if (state == DF_REMOVED) {
+			continue;
+		}
+		if (!again) {
+			state = DF_RUNNING;
+			if (__atomic_compare_exchange_n(&proc->df_state, &state, DF_IDLE, 0,
+					__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+				continue;
+			}
+		}
+		/* still ready or notified while running */
+		__atomic_store_n(&proc->df_state, DF_QUEUED, __ATOMIC_SEQ_CST);
+		df_enqueue(proc);
+	}
+	return NULL;
+}
+
+/**
+ * Starts nof_workers worker threads, or one per online processor if nof_workers is negative.
+ */
+int dataflow_initialize(int nof_workers) {
+	int i;
+
+	if (nof_workers < 0) {
+		nof_workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if (nof_workers < 1) {
+		nof_workers = 1;
+	}
+	pthread_mutex_init(&df.mutex, NULL);
+	pthread_cond_init(&df.cond, NULL);
+	df.head = NULL;
+	df.tail = NULL;
+	for (i=0;i<nof_workers;i++) {
+		if (rtdal_task_new_prio(NULL, dataflow_worker, NULL, rtdal.machine.kernel_prio-1, -1)) {
+			aerror("Creating worker thread\n");
+			return -1;
+		}
+	}
+	df.nof_workers = nof_workers;
+	hdebug("started %d workers\n",nof_workers);
+	return 0;
+}
+
+int dataflow_enabled() {
+	return df.nof_workers > 0;
+}
+
+int dataflow_add(rtdal_process_t *proc) {
+	pthread_mutex_init(&proc->itf_mutex, NULL);
+	proc->nof_itfs = 0;
+	proc->df_next = NULL;
+	__atomic_store_n(&proc->df_state, DF_IDLE, __ATOMIC_SEQ_CST);
+	return 0;
+}
+
+/**
+ * Removes the process from the pool, waiting until it is not running. Can be called by the
+ * process itself.
+ */
+int dataflow_remove(rtdal_process_t *proc) {
+	int i, state, ret = 0, waited = 0;
+	rtdal_itf_t *itf;
+
+	proc->run_point = NULL;
+	pthread_mutex_lock(&df.mutex);
+	state = __atomic_load_n(&proc->df_state, __ATOMIC_SEQ_CST);
+	while (proc != df_current && (state == DF_RUNNING || state == DF_DIRTY)) {
+		if (waited++ >= DATAFLOW_REMOVE_WAIT_MS) {
+			aerror_msg("Timeout removing process pid=%d from the worker pool\n",proc->pid);
+			ret = -1;
+			break;
+		}
+		pthread_mutex_unlock(&df.mutex);
+		usleep(1000);
+		pthread_mutex_lock(&df.mutex);
+		state = __atomic_load_n(&proc->df_state, __ATOMIC_SEQ_CST);
+	}
+	if (state == DF_QUEUED) {
+		df_unlink(proc);
+	}
+	__atomic_store_n(&proc->df_state, DF_REMOVED, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&df.mutex);
+
+	pthread_mutex_lock(&proc->itf_mutex);
+	for (i=0;i<proc->nof_itfs;i++) {
+		itf = (rtdal_itf_t*) proc->itfs[i];
+		if (itf->consumer == proc) {
+			itf->consumer = NULL;
+		}
+		if (itf->producer == proc) {
+			itf->producer = NULL;
+		}
+	}
+	proc->nof_itfs = 0;
+	pthread_mutex_unlock(&proc->itf_mutex);
+	return ret;
+}
+
+/**
+ * Queues the process if it is idle, or marks it to run again if it is running.
+ */
+void dataflow_wake(rtdal_process_t *proc) {
+	int state;
+
+	/* the change that made the process ready must be visible before reading its state */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	state = __atomic_load_n(&proc->df_state, __ATOMIC_SEQ_CST);
+	while (state == DF_RUNNING) {
+		if (__atomic_compare_exchange_n(&proc->df_state, &state, DF_DIRTY, 0,
+				__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+			return;
+		}
+	}
+	if (state != DF_IDLE) {
+		return;
+	}
+	pthread_mutex_lock(&df.mutex);
+	if (__atomic_load_n(&proc->df_state, __ATOMIC_SEQ_CST) == DF_IDLE) {
+		__atomic_store_n(&proc->df_state, DF_QUEUED, __ATOMIC_SEQ_CST);
+		df_enqueue(proc);
+	}
+	pthread_mutex_unlock(&df.mutex);
+}
+
+static void df_itf_detach(rtdal_process_t *proc, r_itf_t itf) {
+	int i;
+
+	pthread_mutex_lock(&proc->itf_mutex);
+	for (i=0;i<proc->nof_itfs;i++) {
+		if (proc->itfs[i] == itf) {
+			proc->nof_itfs--;
+			proc->itfs[i] = proc->itfs[proc->nof_itfs];
+			proc->itf_is_input[i] = proc->itf_is_input[proc->nof_itfs];
+			break;
+		}
+	}
+	pthread_mutex_unlock(&proc->itf_mutex);
+}
+
+/**
+ * Declares that proc reads (is_input=1) or writes the interface, which will wake it up.
+ */
+int dataflow_add_itf(rtdal_process_t *proc, r_itf_t itf, int is_input) {
+	rtdal_itf_t *x = (rtdal_itf_t*) itf;
+
+	if (itf->type == ITF_EXTERNAL) {
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		return -1;
+	}
+	pthread_mutex_lock(&proc->itf_mutex);
+	if (proc->nof_itfs == RTDAL_PROCESS_MAX_ITF) {
+		pthread_mutex_unlock(&proc->itf_mutex);
+		RTDAL_SETERROR(RTDAL_ERROR_NOSPACE);
+		return -1;
+	}
+	proc->itfs[proc->nof_itfs] = itf;
+	proc->itf_is_input[proc->nof_itfs] = (char) is_input;
+	proc->nof_itfs++;
+	if (is_input) {
+		x->consumer = proc;
+	} else {
+		x->producer = proc;
+	}
+	pthread_mutex_unlock(&proc->itf_mutex);
+
+	/* the interface may already have packets or space */
+	dataflow_wake(proc);
+	return 0;
+}
+
+/**
+ * Called when the interface is removed, stops notifying its processes.
+ */
+void dataflow_remove_itf(r_itf_t itf) {
+	rtdal_itf_t *x = (rtdal_itf_t*) itf;
+	rtdal_process_t *proc;
+
+	if (!itf || !dataflow_enabled() || itf->type == ITF_EXTERNAL) {
+		return;
+	}
+	if ((proc = x->consumer)) {
+		x->consumer = NULL;
+		df_itf_detach(proc, itf);
+	}
+	if ((proc = x->producer)) {
+		x->producer = NULL;
+		df_itf_detach(proc, itf);
+	}
+}
@@ -0,0 +1,42 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DATAFLOW_H_
+#define DATAFLOW_H_
+
+#include "rtdal_process.h"
+
+int dataflow_initialize(int nof_workers);
+int dataflow_enabled();
+int dataflow_add(rtdal_process_t *proc);
+int dataflow_remove(rtdal_process_t *proc);
+int dataflow_add_itf(rtdal_process_t *proc, r_itf_t itf, int is_input);
+void dataflow_remove_itf(r_itf_t itf);
+void dataflow_wake(rtdal_process_t *proc);
+
+/**
+ * Called by the queues after a push (with their consumer) or a release (with their producer).
+ * The process is only set while the worker pool is running.
+ */
+static inline void dataflow_notify(void *proc) {
+	if (proc) {
+		dataflow_wake((rtdal_process_t*) proc);
+	}
+}
+
+#endif
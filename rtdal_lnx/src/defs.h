@@ -66,3 +66,7 @@ extern r_log_t rtdal_log;
 
 #define CAST(dst,src,type) type dst = (type) src
 
+/* used to keep data written by different threads in separate cache lines */
+#define CACHE_LINE_SZ	64
+#define CACHE_ALIGNED	__attribute__((aligned(CACHE_LINE_SZ)))
+
@@ -27,4 +27,12 @@
 #define futex_wait(a) syscall(SYS_futex, a, FUTEX_WAIT, 0, NULL, NULL, NULL)
 #define futex_wake(a) syscall(SYS_futex, a, FUTEX_WAKE, INT_MAX, NULL, NULL, NULL)
 
+/* sleeps while *a==v. Not private, can be used in memory shared between processes */
+#define futex_wait_val(a,v) syscall(SYS_futex, a, FUTEX_WAIT, v, NULL, NULL, NULL)
+
+/* same for memory only used by the threads of this process */
+#define futex_wait_private(a,v) syscall(SYS_futex, a, FUTEX_WAIT_PRIVATE, v, NULL, NULL, NULL)
+#define futex_wait_private_timeout(a,v,t) syscall(SYS_futex, a, FUTEX_WAIT_PRIVATE, v, t, NULL, NULL)
+#define futex_wake_private(a) syscall(SYS_futex, a, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, NULL)
+
 #endif /* FUTEX_H_ */
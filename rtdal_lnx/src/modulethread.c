@@ -7,6 +7,7 @@
 #include "rtdal_context.h"
 #include "rtdal_task.h"
 #include "rtdal_process.h"
+#include "rtdal_itfphysic.h"
 #include "pipeline.h"
 #include "defs.h"
 #include "modulethread.h"
@@ -18,7 +19,7 @@ extern int pgroup_notified_failure[MAX_PROCESS_GROUP_ID];
 
 
 
-inline static void run_check_status(rtdal_process_t *proc) {
+void modulethread_check_status(rtdal_process_t *proc) {
 
 	if (proc->runnable && proc->finish_code != FINISH_OK &&
 			!pgroup_notified_failure[proc->attributes.process_group_id]) {
@@ -45,6 +46,7 @@ void *modulethread_run(void *arg) {
 		proc->is_running = 1;
 		if (proc->run_point) {
 			if (proc->run_point(proc->arg)) {
+				rtdal_itfphysic_flush();
 				aerror_msg("Error running module %s\n",proc->attributes.binary_path);
 				modulethread_remove(proc);
 				proc->is_running = 0;
@@ -53,8 +55,9 @@ void *modulethread_run(void *arg) {
 		} else {
 			return NULL;
 		}
+		rtdal_itfphysic_flush();
 		proc->is_running = 0;
-		run_check_status(proc);
+		modulethread_check_status(proc);
 	}
 	return NULL;
 }
@@ -1,3 +1,4 @@
 
 int modulethread_new(rtdal_process_t *proc);
 int modulethread_remove(rtdal_process_t *proc);
+void modulethread_check_status(rtdal_process_t *proc);
@@ -26,6 +26,10 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "pipeline.h"
 #include "rtdal.h"
@@ -33,6 +37,12 @@
 #include "rtdal_time.h"
 #include "rtdal_kernel.h"
 #include "pipeline_sync.h"
+#include "pipeline_dag.h"
+#include "pipeline_batch.h"
+#include "rtdal_context.h"
+#include "rtdal_numa.h"
+#include "rtdal_trace.h"
+#include "rtdal_itfphysic.h"
 #include "defs.h"
 
 #include "barrier.h"
@@ -44,6 +54,11 @@ struct timespec nsec_deb2[NSEC_DEB_LEN];
 static int timer_first_cycle = 0;
 static int num_pipelines;
 static int is_first_in_cycle_count;
+static int migrations_pending;
+static pthread_mutex_t migrate_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+#define MIGRATE_WAIT_MS	1000
+#define EDF_UPDATE_SLOTS	100
 
 extern int timeslot_p[MAX_PIPELINES];
 
@@ -51,10 +66,13 @@ int pgroup_notified_failure[MAX_PROCESS_GROUP_ID];
 
 extern barrier_t start_barrier;
 
-void pipeline_initialize(int _num_pipelines) {
+extern rtdal_context_t rtdal;
+
+int pipeline_initialize(int _num_pipelines) {
 	hdebug("num_pipelines=%d\n",_num_pipelines);
 	num_pipelines = _num_pipelines;
-	pipeline_sync_initialize(num_pipelines);
+	return pipeline_sync_initialize(num_pipelines, rtdal.machine.sync_mode,
+			rtdal.machine.sync_spin_us);
 }
 
 inline void pipeline_sync_thread_idx(int idx) {
@@ -74,12 +92,20 @@ inline static void pipeline_run_thread_run_module(pipeline_t *pipe,
 		pipe->running_process = proc;
 		pipe->running_process_idx = idx;
 		proc->is_running = 1;
+		if (pipe->perf.nof_fd) {
+			perf_begin(&pipe->perf);
+		}
 		if (proc->run_point(proc->arg)) {
 			aerror_msg("Error running module %d:%d\n",
 					pipe->id,pipe->running_process_idx);
-			pipeline_remove(pipe,proc);
+			/* with SCHEDULING_DAG it may run in another pipeline */
+			pipeline_remove(proc->pipeline,proc);
 			proc->is_running = 0;
 		}
+		if (pipe->perf.nof_fd) {
+			perf_end(&pipe->perf, &proc->perf, &pipe->perf_total);
+		}
+		rtdal_itfphysic_flush();
 		proc->is_running = 0;
 	}
 }
@@ -116,6 +142,236 @@ inline static void pipeline_run_thread_print_time(pipeline_t *obj) {
 #endif
 
 }
+/**
+ * Runs a process after checking its status. idx is its position in the pipeline, or in the
+ * graph with SCHEDULING_DAG.
+ */
+void pipeline_run_process(pipeline_t *obj, rtdal_process_t *proc, int idx) {
+	struct timespec t0, t1;
+	trace_exec_t ev;
+	int exec_ns;
+
+	pipeline_run_thread_check_status(obj,proc);
+	/* multi-rate processes skip the slots out of their phase */
+	if (proc->attributes.period > 1
+			&& obj->tslot % proc->attributes.period != proc->attributes.phase) {
+		return;
+	}
+	if (!proc->runnable || (!rtdal.machine.edf_order && !rtdal_trace_timeline_on())) {
+		pipeline_run_thread_run_module(obj,proc,idx);
+		return;
+	}
+	if (rtdal.machine.edf_order) {
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+	}
+	ev.begin_ns = rtdal_trace_timeline_on()?rtdal_trace_time():0;
+	pipeline_run_thread_run_module(obj,proc,idx);
+	if (rtdal.machine.edf_order) {
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		exec_ns = (int) ((t1.tv_sec-t0.tv_sec)*1000000000+t1.tv_nsec-t0.tv_nsec);
+		proc->edf_exec_ns += (exec_ns-proc->edf_exec_ns)/8;
+	}
+	if (ev.begin_ns) {
+		ev.proc = (uint64_t) (uintptr_t) proc;
+		ev.pipeline = obj->id;
+		ev.tslot = obj->tslot;
+		rtdal_trace_event(TRACE_EXEC, &ev, sizeof(ev));
+	}
+}
+
+/**
+ * Computes the deadline of the processes of the pipeline, relative to the beginning of the time
+ * slot. A process must finish before the processes depending on it (see rtdal_process_depends())
+ * can start, that is their deadline minus their execution time, so the ones feeding other
+ * pipelines get earlier deadlines. The dependencies inside the pipeline are iterated until they
+ * settle. The deadlines of the other pipelines are the last ones they computed.
+ */
+static void pipeline_edf_deadlines(pipeline_t *obj) {
+	rtdal_process_t *p, *q;
+	int i, j, d, changed, passes=0;
+
+	for (p=obj->first_process;p;p=p->next) {
+		p->edf_deadline_ns = (int) rtdal.machine.ts_len_ns;
+	}
+	do {
+		changed = 0;
+		for (i=0;i<MAX(rtdal_process);i++) {
+			p = &rtdal.processes[i];
+			if (!p->pid || !p->pipeline) {
+				continue;
+			}
+			d = p->edf_deadline_ns - (p->edf_exec_ns>0?p->edf_exec_ns:1);
+			for (j=0;j<p->nof_preds;j++) {
+				q = p->preds[j];
+				if (q->pipeline == obj && d < q->edf_deadline_ns) {
+					q->edf_deadline_ns = d;
+					changed = 1;
+				}
+			}
+		}
+	} while (changed && passes++ <= obj->nof_processes);
+}
+
+/**
+ * Sorts the processes of the pipeline by deadline. The list is in exec_position order and the
+ * sort is stable, so processes with the same deadline keep it.
+ */
+static void pipeline_edf_sort(pipeline_t *obj) {
+	rtdal_process_t *p;
+	int j, n=0;
+
+	pipeline_edf_deadlines(obj);
+	for (p=obj->first_process;p && n<MAX(rtdal_process);p=p->next) {
+		for (j=n;j>0 && obj->edf_order[j-1]->edf_deadline_ns > p->edf_deadline_ns;j--) {
+			obj->edf_order[j] = obj->edf_order[j-1];
+		}
+		obj->edf_order[j] = p;
+		n++;
+	}
+	obj->nof_edf = n;
+	hdebug("pipeid=%d sorted %d processes\n",obj->id,n);
+}
+
+/**
+ * Runs the processes of the pipeline in deadline order instead of exec_position order. The
+ * order is updated every EDF_UPDATE_SLOTS time slots, as the execution times change, and when a
+ * process is added or removed.
+ */
+static void pipeline_edf_run_time_slot(pipeline_t *obj) {
+	int i;
+	if (__atomic_exchange_n(&obj->edf_dirty, 0, __ATOMIC_ACQ_REL)
+			|| !(obj->tslot % EDF_UPDATE_SLOTS)) {
+		pipeline_edf_sort(obj);
+	}
+	for (i=0;i<obj->nof_edf;i++) {
+		/* removed after the last sort */
+		if (obj->edf_order[i]->pipeline != obj) {
+			continue;
+		}
+		pipeline_run_process(obj,obj->edf_order[i],i);
+	}
+}
+
+/**
+ * Returns the current time in ns since the reference time set by the first tick, which is the
+ * start of time slot 1. Time slot n starts n-1 time slots after it. It is read on
+ * CLOCK_MONOTONIC, like the hybrid timer sleeps, so NTP adjustments do not affect it.
+ */
+static inline long long pipeline_time_ns() {
+	struct timespec x;
+
+	clock_gettime(CLOCK_MONOTONIC, &x);
+	return (long long) x.tv_sec*1000000000 + x.tv_nsec - rtdal.time.init_mono_ns;
+}
+
+/**
+ * Adds the slack of the time slot just finished to the pipeline statistics, that is the time
+ * left until the tick of the next time slot.
+ */
+static void pipeline_slack_update(pipeline_t *obj) {
+	rtdal_pipeline_stats_t *s = &obj->stats;
+	long long slack_ns;
+	int bin;
+
+	slack_ns = (long long) obj->tslot*rtdal.machine.ts_len_ns - pipeline_time_ns();
+	if (slack_ns < 0) {
+		bin = 0;
+		s->late++;
+	} else {
+		bin = 1+(int) (slack_ns*(RTDAL_SLACK_HIST_SZ-1)/rtdal.machine.ts_len_ns);
+		if (bin >= RTDAL_SLACK_HIST_SZ) {
+			bin = RTDAL_SLACK_HIST_SZ-1;
+		}
+	}
+	s->slack_hist[bin]++;
+	if (!s->slots || slack_ns < s->min_slack_ns) {
+		s->min_slack_ns = slack_ns;
+	}
+	s->slots++;
+	s->mean_slack_ns += ((float) slack_ns-s->mean_slack_ns)/s->slots;
+}
+
+/**
+ * Adds how late the pipeline started the current time slot with respect to its tick to the
+ * jitter histogram. Only this thread writes it, rtdal_pipeline_get_jitter() reads it while
+ * running, so the counters are stored atomically.
+ */
+static void pipeline_jitter_update(pipeline_t *obj) {
+	rtdal_jitter_stats_t *s = &obj->jitter;
+	long long late_ns, us;
+	int bin;
+
+	late_ns = pipeline_time_ns() - (long long) (obj->tslot-1)*rtdal.machine.ts_len_ns;
+	if (late_ns < 0) {
+		/* the monotonic reference is mapped from the realtime tick with some error */
+		late_ns = 0;
+	}
+	bin = 0;
+	for (us=late_ns/1000;us && bin<RTDAL_JITTER_HIST_SZ-1;us>>=1) {
+		bin++;
+	}
+	__atomic_store_n(&s->hist[bin], s->hist[bin]+1, __ATOMIC_RELAXED);
+	if (late_ns > s->max_ns) {
+		__atomic_store_n(&s->max_ns, late_ns, __ATOMIC_RELAXED);
+	}
+	__atomic_store_n(&s->sum_ns, s->sum_ns+late_ns, __ATOMIC_RELAXED);
+	__atomic_store_n(&s->slots, s->slots+1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Called by the source pipeline after running its processes. Removes the processes to migrate
+ * from the list and hands them over to the destination pipeline.
+ */
+inline static void pipeline_migrate_handover(pipeline_t *obj) {
+	pipeline_migration_t *m = &obj->migration;
+	int i, state = MIGRATE_REQUESTED;
+	if (__atomic_load_n(&m->state, __ATOMIC_ACQUIRE) != MIGRATE_REQUESTED) {
+		return;
+	}
+	/* the requester may cancel it concurrently */
+	if (!__atomic_compare_exchange_n(&m->state, &state, MIGRATE_MOVING, 0,
+			__ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+		return;
+	}
+	for (i=0;i<m->nof_procs;i++) {
+		pipeline_remove(obj, m->procs[i]);
+	}
+	m->tslot = obj->tslot;
+	__atomic_store_n(&m->state, MIGRATE_HANDOVER, __ATOMIC_RELEASE);
+}
+
+/**
+ * Called by each pipeline before running its processes. Inserts the processes handed over by
+ * other pipelines in a previous time slot.
+ */
+inline static void pipeline_migrate_pickup(pipeline_t *obj) {
+	pipeline_migration_t *m;
+	rtdal_process_t *proc;
+	int i, j, state;
+	if (!__atomic_load_n(&migrations_pending, __ATOMIC_ACQUIRE)) {
+		return;
+	}
+	for (i=0;i<num_pipelines;i++) {
+		m = &rtdal.pipelines[i].migration;
+		state = MIGRATE_HANDOVER;
+		if (m->dest != obj || m->tslot >= obj->tslot
+				|| __atomic_load_n(&m->state, __ATOMIC_ACQUIRE) != MIGRATE_HANDOVER) {
+			continue;
+		}
+		/* the requester may roll it back concurrently */
+		if (__atomic_compare_exchange_n(&m->state, &state, MIGRATE_MOVING, 0,
+				__ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			for (j=0;j<m->nof_procs;j++) {
+				proc = m->procs[j];
+				proc->attributes.pipeline_id = obj->id;
+				pipeline_add(obj, proc);
+			}
+			__atomic_sub_fetch(&migrations_pending, 1, __ATOMIC_RELEASE);
+			__atomic_store_n(&m->state, MIGRATE_IDLE, __ATOMIC_RELEASE);
+		}
+	}
+}
+
 /**
  * Atomic modulo num_pipelines counter.
  */
@@ -125,7 +381,7 @@ inline static int is_first_in_cycle() {
 }
 
 inline static void pipeline_run_time_slot(pipeline_t *obj, struct timespec *time) {
-	int idx;
+	int idx, prev_tslot;
 	rtdal_process_t *run_proc;
 	hdebug("pipeid=%d, tslot=%d, nof_process=%d thread=%d\n",obj->id,obj->ts_counter,
 			obj->nof_processes, obj->thread);
@@ -133,12 +389,32 @@ inline static void pipeline_run_time_slot(pipeline_t *obj, struct timespec *time
 
 	pipeline_run_thread_print_time(obj);
 
+	prev_tslot = obj->tslot;
+	obj->tslot = rtdal_time_slot();
+	if (prev_tslot && obj->tslot > prev_tslot+1) {
+		__atomic_store_n(&obj->missed_slots, obj->missed_slots+obj->tslot-prev_tslot-1,
+				__ATOMIC_RELAXED);
+	}
+	if (rtdal.machine.jitter_stats) {
+		pipeline_jitter_update(obj);
+	}
+	if (rtdal_trace_timeline_on()) {
+		trace_slot_t ev = {obj->id, obj->tslot};
+		rtdal_trace_event(TRACE_SLOT, &ev, sizeof(ev));
+	}
+	pipeline_migrate_pickup(obj);
+
 	run_proc = obj->first_process;
 	idx = 0;
 
 	timelog(obj->log_in);
 
-	if (obj->enable) {
+	if (rtdal.machine.scheduling == SCHEDULING_DAG) {
+		/* the graph is shared by all the pipelines, so they all take part in every slot */
+		pipeline_dag_run_time_slot(obj);
+	} else if (obj->enable && rtdal.machine.edf_order) {
+		pipeline_edf_run_time_slot(obj);
+	} else if (obj->enable) {
 		while(run_proc) {
 			hdebug("%d/%d: run=%d code=%d next=0x%x\n",idx,obj->nof_processes,run_proc->runnable,
 					run_proc->finish_code,run_proc->next);
@@ -148,8 +424,7 @@ inline static void pipeline_run_time_slot(pipeline_t *obj, struct timespec *time
 				kill(getpid(),SIGTERM);
 				pthread_exit(NULL);
 			}
-			pipeline_run_thread_check_status(obj,run_proc);
-			pipeline_run_thread_run_module(obj,run_proc, idx);
+			pipeline_run_process(obj,run_proc,idx);
 			run_proc = run_proc->next;
 			idx++;
 		}
@@ -157,16 +432,54 @@ inline static void pipeline_run_time_slot(pipeline_t *obj, struct timespec *time
 
 	timelog(obj->log_out);
 
+	if (rtdal.machine.slack_stats) {
+		pipeline_slack_update(obj);
+	}
+
+	pipeline_migrate_handover(obj);
+
 	obj->ts_counter=rtdal_time_slot();
+	if (obj->ts_counter != obj->tslot) {
+		obj->overruns++;
+	} else {
+		obj->overruns = 0;
+	}
 
 	obj->finished = 1;
 }
 
 
 
+/* Called from the thread of the pipeline before running its first time slot. The modules
+ * allocate their buffers from this thread, so they are placed in the node of its core. */
+static void pipeline_numa_bind(pipeline_t *obj) {
+	if (obj->numa_node >= 0 && !obj->numa_bound) {
+		if (numa_bind_thread(obj->numa_node, rtdal.machine.numa_policy)) {
+			awarn("Could not bind the memory of pipeline %d to node %d\n",obj->id,
+					obj->numa_node);
+		}
+		obj->numa_bound = 1;
+	}
+}
+
+/* Called from the thread of the pipeline before running its first time slot. The counters
+ * only count the thread that opens them. */
+static void pipeline_perf_open(pipeline_t *obj) {
+	if (rtdal.machine.perf_counters && !obj->perf_opened) {
+		if (perf_open(&obj->perf)) {
+			awarn("Hardware counters not available in pipeline %d: %s\n",obj->id,
+					strerror(errno));
+		}
+		obj->perf_opened = 1;
+	}
+}
+
 void pipeline_run_from_timer(void *arg, struct timespec *time) {
 	pipeline_t *obj = (pipeline_t*) arg;
 
+	pipeline_numa_bind(obj);
+	pipeline_perf_open(obj);
+
 	hdebug("now is %d:%d\n",time->tv_sec,time->tv_nsec);
 
 	if (!timer_first_cycle && time) {
@@ -174,7 +487,10 @@ void pipeline_run_from_timer(void *arg, struct timespec *time) {
 		timer_first_cycle = 1;
 	}
 
-	if (!is_first_in_cycle()) {
+	if (rtdal.machine.timer_overrun == OVERRUN_SKIP) {
+		/* the pipelines skipping different ticks would break the first in cycle count */
+		kernel_tslot_run_tick(time);
+	} else if (!is_first_in_cycle()) {
 		kernel_tslot_run();
 	}
 
@@ -201,9 +517,23 @@ void *pipeline_run_thread(void *self) {
 
 	hdebug("pipeid=%d waiting\n",obj->id);
 
+	pipeline_numa_bind(obj);
+	pipeline_perf_open(obj);
+
+	if (rtdal.machine.clock_mode == BATCH_TIMER) {
+		/* rtdal_time_slot() returns the time slot of this pipeline */
+		rtdal_time_set_thread_slot(&obj->batch_tslot);
+	}
+
 	obj->stop = 0;
 	while(!obj->stop) {
-		pipeline_sync_thread_waits(obj->id);
+		if (rtdal.machine.clock_mode == BATCH_TIMER) {
+			if (pipeline_batch_wait(obj)) {
+				break;
+			}
+		} else {
+			pipeline_sync_thread_waits(obj->id);
+		}
 
 #ifdef __XENO__
 		pthread_set_mode_np(0, PTHREAD_LOCK_SCHED);
@@ -212,11 +542,19 @@ void *pipeline_run_thread(void *self) {
 #ifdef __XENO__
 		pthread_set_mode_np(PTHREAD_LOCK_SCHED, 0);
 #endif
+		if (rtdal.machine.clock_mode == BATCH_TIMER) {
+			pipeline_batch_finished(obj);
+		}
 
 		if (obj->wait_on_finish) {
 			barrier_wait(&start_barrier);
 		}
 	}
+	/* the counters only count this thread, a new thread opens its own */
+	if (obj->perf.nof_fd) {
+		perf_close(&obj->perf);
+	}
+	obj->perf_opened = 0;
 	hdebug("pipeid=%d exiting\n",obj->id);
 	return NULL;
 }
@@ -256,6 +594,10 @@ int pipeline_rt_fault(pipeline_t *obj) {
 #else
 	obj->finished = 1;
 	obj->rtfaults++;
+	if (rtdal_trace_timeline_on()) {
+		trace_fault_t ev = {(uint64_t) (uintptr_t) obj->running_process, obj->id, obj->tslot};
+		rtdal_trace_event(TRACE_FAULT, &ev, sizeof(ev));
+	}
 /*	if (obj->running_process->runnable) {
 		obj->running_process->finish_code = RTFAULT;
 	}
@@ -295,6 +637,11 @@ int pipeline_add(pipeline_t *obj, rtdal_process_t *process) {
 
 	exec_pos = process->attributes.exec_position;
 
+	if (rtdal.machine.scheduling == SCHEDULING_DAG) {
+		pipeline_dag_lock();
+		pipeline_dag_changed();
+	}
+
 	/* head because empty list */
 	if (!obj->first_process) {
 		hdebug("pipeid=%d add pid=%d to head\n", obj->id, process->pid);
@@ -325,7 +672,12 @@ end:
 	obj->nof_processes++;
 	/* assign pipeline to object */
 	process->pipeline = obj;
+	process->edf_deadline_ns = (int) rtdal.machine.ts_len_ns;
+	__atomic_store_n(&obj->edf_dirty, 1, __ATOMIC_RELEASE);
 
+	if (rtdal.machine.scheduling == SCHEDULING_DAG) {
+		pipeline_dag_unlock();
+	}
 	return i;
 }
 
@@ -336,13 +688,17 @@ end:
  * @return Zero on success, -1 on error
  */
 int pipeline_remove(pipeline_t *obj, rtdal_process_t *proc) {
-	hdebug("pipeid=%d, nof_process=%d, pid=%d, pid_pos=%d\n",obj->id,obj->nof_processes,
-			proc->pid,proc->attributes.exec_position);
 	RTDAL_ASSERT_PARAM(obj);
 	RTDAL_ASSERT_PARAM(proc);
+	hdebug("pipeid=%d, nof_process=%d, pid=%d, pid_pos=%d\n",obj->id,obj->nof_processes,
+			proc->pid,proc->attributes.exec_position);
 
 	rtdal_process_t *cur, *prev;
 
+	if (rtdal.machine.scheduling == SCHEDULING_DAG) {
+		pipeline_dag_lock();
+		pipeline_dag_changed();
+	}
 	prev = NULL;
 	cur = obj->first_process;
 	while(cur != proc && cur) {
@@ -352,6 +708,9 @@ int pipeline_remove(pipeline_t *obj, rtdal_process_t *proc) {
 		cur = cur->next;
 	}
 	if (!cur) {
+		if (rtdal.machine.scheduling == SCHEDULING_DAG) {
+			pipeline_dag_unlock();
+		}
 		RTDAL_SETERROR(RTDAL_ERROR_NOTFOUND);
 		return -1;
 	}
@@ -365,7 +724,104 @@ int pipeline_remove(pipeline_t *obj, rtdal_process_t *proc) {
 
 	obj->nof_processes--;
 	proc->next = NULL;
+	proc->pipeline = NULL;
+	__atomic_store_n(&obj->edf_dirty, 1, __ATOMIC_RELEASE);
 
+	if (rtdal.machine.scheduling == SCHEDULING_DAG) {
+		pipeline_dag_unlock();
+	}
 	return 0;
 }
 
+/**
+ * Moves the processes procs from the pipeline obj to the pipeline dest at a time slot boundary,
+ * without stopping them. They keep their exec_position, so they are inserted in dest in the same
+ * order as if they had been created there. Processes exchanging packets with zero delay must be
+ * moved together in the same call.
+ * Blocks until the destination pipeline runs them. If the source pipeline does not reach the end
+ * of a time slot in MIGRATE_WAIT_MS, or the destination does not start one in MIGRATE_WAIT_MS
+ * more, the processes stay in (or go back to) obj and it returns -1.
+ * @return Zero on success, -1 on error
+ */
+int pipeline_migrate(pipeline_t *obj, pipeline_t *dest, rtdal_process_t **procs, int nof_procs) {
+	hdebug("pipeid=%d, dest=%d, nof_procs=%d\n",obj->id,dest->id,nof_procs);
+	RTDAL_ASSERT_PARAM(obj);
+	RTDAL_ASSERT_PARAM(dest);
+	RTDAL_ASSERT_PARAM(procs);
+	pipeline_migration_t *m = &obj->migration;
+	int i, state, ret = -1;
+
+	if (obj == dest || nof_procs <= 0 || nof_procs > RTDAL_MAX_MIGRATE) {
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		return -1;
+	}
+	for (i=0;i<nof_procs;i++) {
+		if (!procs[i] || procs[i]->pipeline != obj) {
+			RTDAL_SETERROR(RTDAL_ERROR_NOTFOUND);
+			return -1;
+		}
+	}
+
+	pthread_mutex_lock(&migrate_mutex);
+	memcpy(m->procs, procs, sizeof(rtdal_process_t*)*nof_procs);
+	m->nof_procs = nof_procs;
+	m->dest = dest;
+	__atomic_add_fetch(&migrations_pending, 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&m->state, MIGRATE_REQUESTED, __ATOMIC_RELEASE);
+
+	for (i=0;i<MIGRATE_WAIT_MS;i++) {
+		if (__atomic_load_n(&m->state, __ATOMIC_ACQUIRE) == MIGRATE_IDLE) {
+			ret = 0;
+			goto out;
+		}
+		usleep(1000);
+	}
+	state = MIGRATE_REQUESTED;
+	if (__atomic_compare_exchange_n(&m->state, &state, MIGRATE_IDLE, 0,
+			__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		__atomic_sub_fetch(&migrations_pending, 1, __ATOMIC_RELEASE);
+		RTDAL_SETERROR(RTDAL_ERROR_NOTREADY);
+		goto out;
+	}
+	/* already removed from obj, dest will take them in its next time slot */
+	for (i=0;i<MIGRATE_WAIT_MS;i++) {
+		if (__atomic_load_n(&m->state, __ATOMIC_ACQUIRE) == MIGRATE_IDLE) {
+			ret = 0;
+			goto out;
+		}
+		usleep(1000);
+	}
+	/* dest did not start a time slot, give them back to obj */
+	state = MIGRATE_HANDOVER;
+	if (__atomic_compare_exchange_n(&m->state, &state, MIGRATE_MOVING, 0,
+			__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		for (i=0;i<m->nof_procs;i++) {
+			pipeline_add(obj, m->procs[i]);
+		}
+		__atomic_sub_fetch(&migrations_pending, 1, __ATOMIC_RELEASE);
+		__atomic_store_n(&m->state, MIGRATE_IDLE, __ATOMIC_RELEASE);
+		RTDAL_SETERROR(RTDAL_ERROR_NOTREADY);
+		goto out;
+	}
+	/* dest is inserting them, which does not block */
+	while(__atomic_load_n(&m->state, __ATOMIC_ACQUIRE) != MIGRATE_IDLE) {
+		usleep(1000);
+	}
+	ret = 0;
+out:
+	pthread_mutex_unlock(&migrate_mutex);
+	return ret;
+}
+
+/**
+ * Waits for the migration in progress, if any, and keeps new ones from starting until
+ * pipeline_migrate_unlock(). While a migration is in progress the processes being moved do not
+ * belong to any pipeline, so they cannot be removed.
+ */
+void pipeline_migrate_lock() {
+	pthread_mutex_lock(&migrate_mutex);
+}
+
+void pipeline_migrate_unlock() {
+	pthread_mutex_unlock(&migrate_mutex);
+}
@@ -23,11 +23,30 @@
 #include "objects_max.h"
 #include "rtdal_process.h"
 #include "rtdal_timer.h"
+#include "rtdal_perf.h"
 /*
 #define PRINT_TIME
 
 #define PRINT_RT_FAULT
 */
+enum pipeline_migrate_state {
+	MIGRATE_IDLE=0, MIGRATE_REQUESTED, MIGRATE_MOVING, MIGRATE_HANDOVER
+};
+
+/**
+ * Processes leaving a pipeline. The source pipeline removes them after running its time slot
+ * and the destination pipeline inserts them before running a later one, so they never run
+ * twice in a time slot. If the source hands them over after the destination has started the
+ * next time slot, they skip that slot.
+ */
+typedef struct {
+	rtdal_process_t *procs[RTDAL_MAX_MIGRATE];
+	int nof_procs;
+	void *dest;
+	int tslot;
+	int state;
+}pipeline_migration_t;
+
 /**
  * A ProcThread is a POSIX-thread that runs in a single processor core with
  * real-time priority and FIFO-scheduling (non-preemptable).
@@ -76,16 +95,49 @@ typedef struct {
 	int waiting;
 	int xenomai_warn_msw;
 	int wait_on_finish;
+
+	/* time slot being executed and number of consecutive slots finished late */
+	int tslot;
+	int overruns;
+	/* time slots not run, skipped by the timer or started while still running the previous one */
+	long long missed_slots;
+	pipeline_migration_t migration;
+
+	rtdal_pipeline_stats_t stats;
+	/* written by the thread of the pipeline only, read by rtdal_pipeline_get_jitter() */
+	rtdal_jitter_stats_t jitter;
+
+	/* with edf_order, the processes sorted by deadline. Rebuilt when edf_dirty is set */
+	rtdal_process_t *edf_order[MAX(rtdal_process)];
+	int nof_edf;
+	int edf_dirty;
+
+	/* NUMA node of the core of the pipeline, or -1 if numa_policy is none or it is unknown */
+	int numa_node;
+	int numa_bound;
+
+	/* with the batch clock, the time slot this pipeline is running */
+	int batch_tslot;
+
+	/* with perf_counters, the counters of the thread of the pipeline and their sum over the
+	 * processes it has run, read by rtdal_pipeline_get_perf() */
+	perf_group_t perf;
+	int perf_opened;
+	rtdal_perf_counters_t perf_total;
 }pipeline_t;
 
 void pipeline_run_from_timer(void *arg, struct timespec *time);
 void pipeline_sync_threads();
 void pipeline_sync_thread_idx(int idx);
-void pipeline_initialize(int _num_pipelines);
+int pipeline_initialize(int _num_pipelines);
 void *pipeline_run_thread(void *obj);
 int pipeline_recover_thread(pipeline_t *obj);
 int pipeline_rt_fault(pipeline_t *obj);
+void pipeline_run_process(pipeline_t *obj, rtdal_process_t *proc, int idx);
 int pipeline_add(pipeline_t *obj, rtdal_process_t *process);
 int pipeline_remove(pipeline_t *obj, rtdal_process_t *proc);
+int pipeline_migrate(pipeline_t *obj, pipeline_t *dest, rtdal_process_t **procs, int nof_procs);
+void pipeline_migrate_lock();
+void pipeline_migrate_unlock();
 
 #endif
@@ -0,0 +1,252 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pipeline.h"
+#include "pipeline_batch.h"
+#include "rtdal.h"
+#include "rtdal_error.h"
+#include "rtdal_context.h"
+#include "rtdal_kernel.h"
+#include "futex.h"
+#include "cpu_relax.h"
+#include "objects_max.h"
+#include "defs.h"
+
+/**
+ * Batch clock (timer_mode="batch"), to run a waveform offline as fast as possible.
+ *
+ * There is no timer. Each pipeline thread runs its own time slots one after another and
+ * rtdal_time_slot() returns, in each pipeline thread, the time slot that pipeline is running, so
+ * the queues see the same time stamps as with a timer. A pipeline starts its time slot n when
+ * every other pipeline j has finished the time slot n-lag[j]:
+ * 	- lag is batch_window for pipelines not connected, so no pipeline runs more than batch_window
+ * 	time slots ahead of the others (and fills the queues of the slower ones).
+ * 	- when a process reads with delay d the packets of a process in pipeline j (see
+ * 	rtdal_process_link()), lag[j] is at most d, so the packets are there when it runs.
+ *
+ * With delays of one time slot between the pipelines, consecutive subframes are processed at the
+ * same time by the pipelines on different cores, like a software pipeline, and a pipeline only
+ * waits when the one before it is slower on average, not at every time slot.
+ *
+ * The pipeline that finishes a time slot last advances the global time slot (see
+ * kernel_tslot_run()), which is the one seen by the other threads. While no pipeline has
+ * processes the time slots last time_slot_ns, so waveforms load as usual.
+ */
+
+#define BATCH_RING		128		/* power of two, more than twice BATCH_MAX_WINDOW */
+#define BATCH_SPIN		4096	/* polls before sleeping */
+
+typedef char batch_ring_fits[BATCH_RING > 2*BATCH_MAX_WINDOW ? 1 : -1];
+
+extern rtdal_context_t rtdal;
+
+static struct {
+	/* incremented every time a pipeline finishes a time slot */
+	int progress CACHE_ALIGNED;
+	int sleepers CACHE_ALIGNED;
+
+	/* time slots finished by each pipeline */
+	struct {
+		int slots CACHE_ALIGNED;
+	} done[MAX(pipeline)];
+
+	/* pipelines that finished time slot n, at position n%BATCH_RING */
+	int finished[BATCH_RING] CACHE_ALIGNED;
+
+	int nof_pipelines CACHE_ALIGNED;
+	int window;
+	int running;
+	int lag[MAX(pipeline)][MAX(pipeline)];
+
+	/* first time slot finished with processes, to measure the throughput */
+	int first_slot;
+	struct timespec first_time;
+	int limit_sent;
+} batch;
+
+int pipeline_batch_initialize(int nof_pipelines, int window) {
+	int i, j;
+
+	if (nof_pipelines < 1 || nof_pipelines > MAX(pipeline)
+			|| window < 1 || window > BATCH_MAX_WINDOW) {
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		return -1;
+	}
+	memset(&batch,0,sizeof(batch));
+	batch.nof_pipelines = nof_pipelines;
+	batch.window = window;
+	for (i=0;i<nof_pipelines;i++) {
+		for (j=0;j<nof_pipelines;j++) {
+			batch.lag[i][j] = window;
+		}
+	}
+	return 0;
+}
+
+/**
+ * The pipeline pipeline_id reads with delay time slots the packets written by the pipeline
+ * src_pipeline_id. Interfaces not synchronized to the time slot (negative delay) are ignored.
+ * \returns 0 on success or -1 if both pipelines would wait for each other
+ */
+int pipeline_batch_link(int pipeline_id, int src_pipeline_id, int delay) {
+	RTDAL_ASSERT_PARAM(pipeline_id >= 0 && pipeline_id < batch.nof_pipelines);
+	RTDAL_ASSERT_PARAM(src_pipeline_id >= 0 && src_pipeline_id < batch.nof_pipelines);
+
+	if (pipeline_id == src_pipeline_id || delay < 0) {
+		return 0;
+	}
+	if (delay == 0 && !batch.lag[src_pipeline_id][pipeline_id]) {
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		return -1;
+	}
+	if (delay < batch.lag[pipeline_id][src_pipeline_id]) {
+		__atomic_store_n(&batch.lag[pipeline_id][src_pipeline_id], delay, __ATOMIC_RELEASE);
+	}
+	return 0;
+}
+
+static void batch_wake() {
+	__atomic_add_fetch(&batch.progress, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&batch.sleepers, __ATOMIC_SEQ_CST)) {
+		futex_wake_private(&batch.progress);
+	}
+}
+
+/** Releases the pipeline threads, which wait in pipeline_batch_wait() until then */
+void pipeline_batch_start() {
+	__atomic_store_n(&batch.running, 1, __ATOMIC_RELEASE);
+	batch_wake();
+}
+
+void pipeline_batch_stop() {
+	__atomic_store_n(&batch.running, 0, __ATOMIC_RELEASE);
+	batch_wake();
+}
+
+static int batch_can_run(int id, int tslot) {
+	int j;
+	for (j=0;j<batch.nof_pipelines;j++) {
+		if (j != id && __atomic_load_n(&batch.done[j].slots, __ATOMIC_ACQUIRE)
+				< tslot - __atomic_load_n(&batch.lag[id][j], __ATOMIC_ACQUIRE)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ * Waits until the pipeline can run its next time slot, which is then stored in obj->batch_tslot.
+ * Spins a while and then sleeps until another pipeline finishes a time slot.
+ * \returns 0 when the time slot can be run or -1 if the pipeline has to stop
+ */
+int pipeline_batch_wait(pipeline_t *obj) {
+	int tslot = batch.done[obj->id].slots+1;
+	int seen, spins = 0;
+
+	while(1) {
+		seen = __atomic_load_n(&batch.progress, __ATOMIC_ACQUIRE);
+		if (obj->stop) {
+			return -1;
+		}
+		if (__atomic_load_n(&batch.running, __ATOMIC_ACQUIRE) && batch_can_run(obj->id, tslot)) {
+			obj->batch_tslot = tslot;
+			return 0;
+		}
+		if (spins < BATCH_SPIN) {
+			spins++;
+			cpu_relax();
+			continue;
+		}
+		__atomic_add_fetch(&batch.sleepers, 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&batch.progress, __ATOMIC_SEQ_CST) == seen) {
+			futex_wait_private(&batch.progress, seen);
+		}
+		__atomic_sub_fetch(&batch.sleepers, 1, __ATOMIC_SEQ_CST);
+	}
+}
+
+static int batch_nof_processes() {
+	int i, n = 0;
+	for (i=0;i<batch.nof_pipelines;i++) {
+		n += rtdal.pipelines[i].nof_processes;
+	}
+	return n;
+}
+
+/* called by the pipeline that finishes the time slot tslot last */
+static void batch_slot_finished(int tslot) {
+	struct timespec t;
+
+	kernel_tslot_run();
+
+	if (!batch_nof_processes()) {
+		t.tv_sec = rtdal.machine.ts_len_ns/1000000000;
+		t.tv_nsec = rtdal.machine.ts_len_ns%1000000000;
+		clock_nanosleep(CLOCK_MONOTONIC, 0, &t, NULL);
+		return;
+	}
+	if (!batch.first_slot) {
+		clock_gettime(CLOCK_MONOTONIC, &batch.first_time);
+		__atomic_store_n(&batch.first_slot, tslot, __ATOMIC_RELEASE);
+	} else if (rtdal.machine.batch_slots && !batch.limit_sent
+			&& tslot-batch.first_slot >= rtdal.machine.batch_slots) {
+		/* the sigwait thread exits as with ctrl+c */
+		batch.limit_sent = 1;
+		kill(getpid(), SIGINT);
+	}
+}
+
+/**
+ * Called by the pipeline after running the time slot obj->batch_tslot
+ */
+void pipeline_batch_finished(pipeline_t *obj) {
+	int tslot = obj->batch_tslot;
+
+	__atomic_store_n(&batch.done[obj->id].slots, tslot, __ATOMIC_RELEASE);
+	if (__atomic_add_fetch(&batch.finished[tslot&(BATCH_RING-1)], 1, __ATOMIC_ACQ_REL)
+			== batch.nof_pipelines) {
+		__atomic_store_n(&batch.finished[tslot&(BATCH_RING-1)], 0, __ATOMIC_RELAXED);
+		batch_slot_finished(tslot);
+	}
+	batch_wake();
+}
+
+/**
+ * Saves the number of time slots (subframes) finished by all the pipelines since the first one
+ * with processes and the seconds they took.
+ * \returns 0 on success or -1 if no time slot with processes has finished yet
+ */
+int pipeline_batch_stats(long long *slots, double *seconds) {
+	struct timespec t;
+	int first = __atomic_load_n(&batch.first_slot, __ATOMIC_ACQUIRE);
+
+	if (!first) {
+		return -1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	*slots = rtdal_time_slot()-first;
+	*seconds = (double) (t.tv_sec-batch.first_time.tv_sec)
+			+ (double) (t.tv_nsec-batch.first_time.tv_nsec)/1e9;
+	return 0;
+}
@@ -0,0 +1,34 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PIPELINE_BATCH_H_
+#define PIPELINE_BATCH_H_
+
+#include "pipeline.h"
+
+#define BATCH_MAX_WINDOW	32
+
+int pipeline_batch_initialize(int nof_pipelines, int window);
+int pipeline_batch_link(int pipeline_id, int src_pipeline_id, int delay);
+void pipeline_batch_start();
+void pipeline_batch_stop();
+int pipeline_batch_wait(pipeline_t *obj);
+void pipeline_batch_finished(pipeline_t *obj);
+int pipeline_batch_stats(long long *slots, double *seconds);
+
+#endif
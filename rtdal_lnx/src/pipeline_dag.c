@@ -0,0 +1,379 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "pipeline.h"
+#include "pipeline_dag.h"
+#include "rtdal.h"
+#include "rtdal_error.h"
+#include "rtdal_context.h"
+#include "cpu_relax.h"
+#include "objects_max.h"
+#include "defs.h"
+
+/**
+ * Scheduler for SCHEDULING_DAG.
+ *
+ * The processes keep their pipeline (home core) and execution position, but inside a time slot
+ * each one runs as soon as the processes it depends on (see rtdal_process_depends()) have run,
+ * on any core. Every pipeline thread owns a work-stealing deque (Chase-Lev): at the beginning
+ * of the slot it pushes the processes of its pipeline without dependencies, it runs the
+ * processes from the bottom of its deque, pushes those that become ready after them, and when
+ * its deque is empty it steals from the top of the other deques.
+ *
+ * The time slot is finished when all the processes have run and all the pipeline threads have
+ * started it. The thread that finishes it rebuilds the graph if processes or dependencies have
+ * changed and then increments the generation counter, which releases the other threads. The
+ * pipelines still wait for the next time slot in pipeline_sync.c.
+ */
+
+#define DAG_DEQUE_SZ		256		/* power of two, at least MAX(rtdal_process) */
+#define DAG_SPIN_YIELD		4096	/* empty polls before yielding the processor */
+#define DAG_UPDATE_WAIT_MS	1000
+
+typedef struct {
+	long top CACHE_ALIGNED;		/* stolen from here */
+	long bottom CACHE_ALIGNED;	/* owner pushes and pops here */
+	int buf[DAG_DEQUE_SZ];
+} CACHE_ALIGNED dag_deque_t;
+
+typedef struct {
+	rtdal_process_t *proc;
+	int nof_preds;
+	int pending;
+	int first_succ;
+	int nof_succ;
+} dag_node_t;
+
+typedef char dag_deque_fits[DAG_DEQUE_SZ >= MAX(rtdal_process) ? 1 : -1];
+
+extern rtdal_context_t rtdal;
+
+static struct {
+	int gen CACHE_ALIGNED;
+	int remaining CACHE_ALIGNED;
+
+	int nof_pipelines CACHE_ALIGNED;
+	int dirty;
+	int updates;
+	pthread_mutex_t mutex;
+
+	/* graph, only modified between time slots */
+	int nof_nodes;
+	dag_node_t nodes[MAX(rtdal_process)];
+	int succ[MAX(rtdal_process)*RTDAL_PROCESS_MAX_PREDS];
+	int roots[MAX(rtdal_process)];
+	int first_root[MAX(pipeline)+1];
+
+	dag_deque_t deques[MAX(pipeline)];
+} dag;
+
+/* called by the owner only */
+static inline void deque_push(dag_deque_t *q, int x) {
+	long b = __atomic_load_n(&q->bottom, __ATOMIC_RELAXED);
+	q->buf[b&(DAG_DEQUE_SZ-1)] = x;
+	__atomic_store_n(&q->bottom, b+1, __ATOMIC_RELEASE);
+}
+
+/* called by the owner only */
+static inline int deque_pop(dag_deque_t *q) {
+	long b, t;
+	int x;
+
+	b = __atomic_load_n(&q->bottom, __ATOMIC_RELAXED)-1;
+	__atomic_store_n(&q->bottom, b, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	t = __atomic_load_n(&q->top, __ATOMIC_RELAXED);
+	if (t > b) {
+		__atomic_store_n(&q->bottom, b+1, __ATOMIC_RELAXED);
+		return -1;
+	}
+	x = q->buf[b&(DAG_DEQUE_SZ-1)];
+	if (t == b) {
+		/* last element, race against the thieves */
+		if (!__atomic_compare_exchange_n(&q->top, &t, t+1, 0, __ATOMIC_SEQ_CST,
+				__ATOMIC_RELAXED)) {
+			x = -1;
+		}
+		__atomic_store_n(&q->bottom, b+1, __ATOMIC_RELAXED);
+	}
+	return x;
+}
+
+static inline int deque_steal(dag_deque_t *q) {
+	long t, b;
+	int x;
+
+	t = __atomic_load_n(&q->top, __ATOMIC_ACQUIRE);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	b = __atomic_load_n(&q->bottom, __ATOMIC_ACQUIRE);
+	if (t >= b) {
+		return -1;
+	}
+	x = q->buf[t&(DAG_DEQUE_SZ-1)];
+	if (!__atomic_compare_exchange_n(&q->top, &t, t+1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+		return -1;
+	}
+	return x;
+}
+
+/**
+ * Builds the graph from the processes in the pipelines. Nodes are numbered in pipeline and
+ * execution position order, so the roots of each pipeline keep their execution order.
+ */
+static void dag_rebuild() {
+	int i, j, k, n, r;
+	rtdal_process_t *p, *q;
+
+	for (i=0;i<MAX(rtdal_process);i++) {
+		rtdal.processes[i].dag_idx = -1;
+	}
+	n = 0;
+	for (i=0;i<dag.nof_pipelines;i++) {
+		for (p=rtdal.pipelines[i].first_process;p && n<MAX(rtdal_process);p=p->next) {
+			p->dag_idx = n;
+			memset(&dag.nodes[n],0,sizeof(dag_node_t));
+			dag.nodes[n].proc = p;
+			n++;
+		}
+	}
+	dag.nof_nodes = n;
+
+	/* count edges of processes in the graph */
+	for (k=0;k<n;k++) {
+		p = dag.nodes[k].proc;
+		for (j=0;j<p->nof_preds;j++) {
+			q = p->preds[j];
+			if (q->dag_idx >= 0) {
+				dag.nodes[k].nof_preds++;
+				dag.nodes[q->dag_idx].nof_succ++;
+			}
+		}
+	}
+	for (k=0,j=0;k<n;k++) {
+		dag.nodes[k].first_succ = j;
+		j += dag.nodes[k].nof_succ;
+		dag.nodes[k].nof_succ = 0;
+	}
+	for (k=0;k<n;k++) {
+		p = dag.nodes[k].proc;
+		for (j=0;j<p->nof_preds;j++) {
+			q = p->preds[j];
+			if (q->dag_idx >= 0) {
+				dag_node_t *pn = &dag.nodes[q->dag_idx];
+				dag.succ[pn->first_succ+pn->nof_succ++] = k;
+			}
+		}
+	}
+
+	/* roots of each pipeline */
+	for (i=0,r=0,k=0;i<dag.nof_pipelines;i++) {
+		dag.first_root[i] = r;
+		for (;k<n && dag.nodes[k].proc->pipeline == &rtdal.pipelines[i];k++) {
+			if (!dag.nodes[k].nof_preds) {
+				dag.roots[r++] = k;
+			}
+		}
+	}
+	dag.first_root[i] = r;
+
+	for (k=0;k<n;k++) {
+		dag.nodes[k].pending = dag.nodes[k].nof_preds;
+	}
+	hdebug("nodes=%d roots=%d\n",n,r);
+}
+
+/* accounts for count finished processes or started threads */
+static inline void dag_done(int count) {
+	if (__atomic_sub_fetch(&dag.remaining, count, __ATOMIC_ACQ_REL)) {
+		return;
+	}
+	/* last one of the time slot. The others are waiting for the generation to change */
+	if (__atomic_load_n(&dag.dirty, __ATOMIC_ACQUIRE) && !pthread_mutex_trylock(&dag.mutex)) {
+		if (dag.dirty) {
+			dag_rebuild();
+			dag.dirty = 0;
+			__atomic_add_fetch(&dag.updates, 1, __ATOMIC_RELEASE);
+		}
+		pthread_mutex_unlock(&dag.mutex);
+	}
+	__atomic_store_n(&dag.remaining, dag.nof_nodes+dag.nof_pipelines, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&dag.gen, 1, __ATOMIC_RELEASE);
+}
+
+static inline void dag_run(pipeline_t *obj, dag_deque_t *q, int k) {
+	dag_node_t *n = &dag.nodes[k];
+	int i, s;
+
+	/* all its predecessors have run, re-arm it for the next time slot */
+	__atomic_store_n(&n->pending, n->nof_preds, __ATOMIC_RELAXED);
+
+	pipeline_run_process(obj, n->proc, k);
+
+	for (i=0;i<n->nof_succ;i++) {
+		s = dag.succ[n->first_succ+i];
+		if (!__atomic_sub_fetch(&dag.nodes[s].pending, 1, __ATOMIC_ACQ_REL)) {
+			deque_push(q, s);
+		}
+	}
+	dag_done(1);
+}
+
+/**
+ * Runs one time slot of the graph from the pipeline thread obj. Returns when all the processes
+ * of the time slot have run, in this or in other threads.
+ */
+void pipeline_dag_run_time_slot(pipeline_t *obj) {
+	dag_deque_t *q = &dag.deques[obj->id];
+	int gen, i, k, spins=0;
+
+	gen = __atomic_load_n(&dag.gen, __ATOMIC_ACQUIRE);
+
+	/* push in reverse order, the bottom is popped first */
+	for (i=dag.first_root[obj->id+1]-1;i>=dag.first_root[obj->id];i--) {
+		deque_push(q, dag.roots[i]);
+	}
+	dag_done(1);
+
+	while (__atomic_load_n(&dag.gen, __ATOMIC_ACQUIRE) == gen) {
+		k = deque_pop(q);
+		for (i=1;k<0 && i<dag.nof_pipelines;i++) {
+			k = deque_steal(&dag.deques[(obj->id+i)%dag.nof_pipelines]);
+		}
+		if (k >= 0) {
+			dag_run(obj, q, k);
+			spins = 0;
+		} else if (++spins < DAG_SPIN_YIELD) {
+			cpu_relax();
+		} else {
+			sched_yield();
+			spins = 0;
+		}
+	}
+}
+
+int pipeline_dag_initialize(int nof_pipelines) {
+	hdebug("nof_pipelines=%d\n",nof_pipelines);
+	if (nof_pipelines > MAX(pipeline)) {
+		return -1;
+	}
+	memset(&dag,0,sizeof(dag));
+	dag.nof_pipelines = nof_pipelines;
+	dag.remaining = nof_pipelines;
+	dag.dirty = 1;
+	pthread_mutex_init(&dag.mutex, NULL);
+	return 0;
+}
+
+void pipeline_dag_lock() {
+	pthread_mutex_lock(&dag.mutex);
+}
+
+void pipeline_dag_unlock() {
+	pthread_mutex_unlock(&dag.mutex);
+}
+
+/** The graph will be rebuilt at the end of the current time slot. Call with the lock taken */
+void pipeline_dag_changed() {
+	__atomic_store_n(&dag.dirty, 1, __ATOMIC_RELEASE);
+}
+
+/* returns 1 if pred is proc or runs before it */
+static int dag_reaches(rtdal_process_t *proc, rtdal_process_t *pred) {
+	int i;
+	if (proc == pred) {
+		return 1;
+	}
+	for (i=0;i<pred->nof_preds;i++) {
+		if (dag_reaches(proc, pred->preds[i])) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Adds a dependency of proc on pred. Fails with RTDAL_ERROR_INVAL if it would create a cycle.
+ */
+int pipeline_dag_add_dep(rtdal_process_t *proc, rtdal_process_t *pred) {
+	int i, ret = -1;
+
+	pthread_mutex_lock(&dag.mutex);
+	for (i=0;i<proc->nof_preds;i++) {
+		if (proc->preds[i] == pred) {
+			ret = 0;
+			goto out;
+		}
+	}
+	if (proc->nof_preds == RTDAL_PROCESS_MAX_PREDS) {
+		RTDAL_SETERROR(RTDAL_ERROR_NOSPACE);
+		goto out;
+	}
+	if (dag_reaches(proc, pred)) {
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		goto out;
+	}
+	proc->preds[proc->nof_preds++] = pred;
+	pipeline_dag_changed();
+	ret = 0;
+out:
+	pthread_mutex_unlock(&dag.mutex);
+	return ret;
+}
+
+/** Removes the dependencies of other processes on proc */
+void pipeline_dag_remove_deps(rtdal_process_t *proc) {
+	int i, j;
+	rtdal_process_t *p;
+
+	pthread_mutex_lock(&dag.mutex);
+	for (i=0;i<MAX(rtdal_process);i++) {
+		p = &rtdal.processes[i];
+		for (j=0;j<p->nof_preds;j++) {
+			if (p->preds[j] == proc) {
+				p->preds[j] = p->preds[--p->nof_preds];
+				j--;
+			}
+		}
+	}
+	proc->nof_preds = 0;
+	pipeline_dag_changed();
+	pthread_mutex_unlock(&dag.mutex);
+}
+
+/**
+ * Waits until the pipelines have taken the last changes, so that a removed process is not
+ * running anymore. Gives up after DAG_UPDATE_WAIT_MS if the pipelines are not running.
+ * \returns 0 if the graph was updated or -1 on timeout
+ */
+int pipeline_dag_wait_update() {
+	int i;
+	int seq = __atomic_load_n(&dag.updates, __ATOMIC_ACQUIRE);
+	for (i=0;i<DAG_UPDATE_WAIT_MS;i++) {
+		if (__atomic_load_n(&dag.updates, __ATOMIC_ACQUIRE) != seq) {
+			return 0;
+		}
+		usleep(1000);
+	}
+	return -1;
+}
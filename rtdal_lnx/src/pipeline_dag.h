@@ -0,0 +1,34 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PIPELINE_DAG_H_
+#define PIPELINE_DAG_H_
+
+#include "pipeline.h"
+#include "rtdal_process.h"
+
+int pipeline_dag_initialize(int nof_pipelines);
+void pipeline_dag_run_time_slot(pipeline_t *obj);
+int pipeline_dag_add_dep(rtdal_process_t *proc, rtdal_process_t *pred);
+void pipeline_dag_remove_deps(rtdal_process_t *proc);
+void pipeline_dag_changed();
+void pipeline_dag_lock();
+void pipeline_dag_unlock();
+int pipeline_dag_wait_update();
+
+#endif
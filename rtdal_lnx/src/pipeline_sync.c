@@ -1,14 +1,17 @@
 #include <pthread.h>
 #include <semaphore.h>
 #include <string.h>
+#include <time.h>
 
 #include "rtdal.h"
 #include "futex.h"
+#include "cpu_relax.h"
 #include "objects_max.h"
 #include "pipeline_sync.h"
 #include "defs.h"
 
 static int num_pipelines;
+static int sync_mode = PIPELINESYNC_MUTEX_TYPE;
 
 static sem_t semaphores[MAX_PIPELINES];
 static int futex;
@@ -19,6 +22,17 @@ static pthread_cond_t sync_cond;
 int timeslot = 0;
 int timeslot_p[MAX_PIPELINES];
 
+/* EPOCH mode. The waker only writes the epoch and reads the number of sleepers, each waiter
+ * only writes its own last seen epoch */
+static struct {
+	int epoch CACHE_ALIGNED;
+	int sleepers CACHE_ALIGNED;
+	long long spin_ns;
+	struct {
+		int seen;
+	} CACHE_ALIGNED waiter[MAX_PIPELINES];
+} ep;
+
 static inline int pipeline_sync_initialize_condvar() {
 	pthread_mutex_init(&sync_mutex, NULL);
 	pthread_cond_init(&sync_cond, NULL);
@@ -85,71 +99,127 @@ static inline void pipeline_sync_thread_wake_barrier() {
 	pthread_barrier_wait(&barrier);
 }
 
-inline int pipeline_sync_initialize(int _num_pipelines) {
+static inline long long epoch_now_ns() {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC,&t);
+	return (long long) t.tv_sec*1000000000+t.tv_nsec;
+}
+
+static inline int pipeline_sync_initialize_epoch(int spin_us) {
+	memset(&ep, 0, sizeof(ep));
+	ep.spin_ns = (long long) spin_us*1000;
+	return 0;
+}
+
+/* Spins up to spin_ns waiting for the epoch to change and then sleeps on it. Epochs missed
+ * while running a late time slot are skipped, as in the CONDVAR mode */
+static inline void pipeline_sync_thread_waits_epoch(int idx) {
+	int seen = ep.waiter[idx].seen, e;
+	long long t0;
+	unsigned int n=0;
+
+	hdebug("epoch=%d, seen=%d, idx=%d\n",ep.epoch,seen,idx);
+	e = __atomic_load_n(&ep.epoch, __ATOMIC_ACQUIRE);
+	if (e == seen && ep.spin_ns) {
+		t0 = epoch_now_ns();
+		do {
+			cpu_relax();
+			e = __atomic_load_n(&ep.epoch, __ATOMIC_ACQUIRE);
+			/* read the clock once every 64 polls */
+		} while (e == seen && ((++n&63) || epoch_now_ns()-t0 < ep.spin_ns));
+	}
+	while (e == seen) {
+		/* the waker reads sleepers after incrementing the epoch, and futex_wait returns
+		 * if the epoch is no longer seen, so the wakeup can not be lost */
+		__atomic_add_fetch(&ep.sleepers, 1, __ATOMIC_SEQ_CST);
+		futex_wait_private(&ep.epoch, seen);
+		__atomic_sub_fetch(&ep.sleepers, 1, __ATOMIC_RELAXED);
+		e = __atomic_load_n(&ep.epoch, __ATOMIC_ACQUIRE);
+	}
+	ep.waiter[idx].seen = e;
+}
+
+static inline void pipeline_sync_thread_wake_epoch() {
+	__atomic_add_fetch(&ep.epoch, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&ep.sleepers, __ATOMIC_SEQ_CST)) {
+		futex_wake_private(&ep.epoch);
+	}
+	hdebug("epoch=%d\n",ep.epoch);
+}
+
+/**
+ * Initializes the synchronization of num_pipelines pipelines with the given mode (SEM, FUTEX,
+ * BARRIER, CONDVAR or EPOCH), or PIPELINESYNC_MUTEX_TYPE if mode is 0. With EPOCH, the pipelines
+ * spin spin_us microseconds before sleeping.
+ */
+int pipeline_sync_initialize(int _num_pipelines, int mode, int spin_us) {
 	if (_num_pipelines > MAX_PIPELINES) {
 		return -1;
 	}
 	num_pipelines = _num_pipelines;
-
-#if PIPELINESYNC_MUTEX_TYPE==SEM
-	return pipeline_sync_initialize_sem();
-#endif
-#if PIPELINESYNC_MUTEX_TYPE==FUTEX
-	return pipeline_sync_initialize_futex();
-#endif
-#if PIPELINESYNC_MUTEX_TYPE==BARRIER
-	return pipeline_sync_initialize_barrier();
-#endif
-#if PIPELINESYNC_MUTEX_TYPE==CONDVAR
-	return pipeline_sync_initialize_condvar();
-#endif
-
+	sync_mode = mode?mode:PIPELINESYNC_MUTEX_TYPE;
+
+	switch(sync_mode) {
+	case SEM:
+		return pipeline_sync_initialize_sem();
+	case FUTEX:
+		return pipeline_sync_initialize_futex();
+	case BARRIER:
+		return pipeline_sync_initialize_barrier();
+	case CONDVAR:
+		return pipeline_sync_initialize_condvar();
+	case EPOCH:
+		return pipeline_sync_initialize_epoch(spin_us);
+	default:
+		return -1;
+	}
 }
 
 inline void pipeline_sync_thread_waits(int idx) {
-
-#if PIPELINESYNC_MUTEX_TYPE==SEM
-	pipeline_sync_thread_waits_sem(idx);
-#endif
-#if PIPELINESYNC_MUTEX_TYPE==FUTEX
-	pipeline_sync_thread_waits_futex(idx);
-#endif
-#if PIPELINESYNC_MUTEX_TYPE==BARRIER
-	pipeline_sync_thread_waits_barrier(idx);
-#endif
-#if PIPELINESYNC_MUTEX_TYPE==CONDVAR
-	pipeline_sync_thread_waits_condvar(idx);
-#endif
+	switch(sync_mode) {
+	case SEM:
+		pipeline_sync_thread_waits_sem(idx);
+		break;
+	case FUTEX:
+		pipeline_sync_thread_waits_futex(idx);
+		break;
+	case BARRIER:
+		pipeline_sync_thread_waits_barrier(idx);
+		break;
+	case CONDVAR:
+		pipeline_sync_thread_waits_condvar(idx);
+		break;
+	case EPOCH:
+		pipeline_sync_thread_waits_epoch(idx);
+		break;
+	}
 }
 
 inline void pipeline_sync_threads_wake() {
-#if PIPELINESYNC_MUTEX_TYPE==SEM
-	pipeline_sync_thread_wake_sem();
-#endif
-#if PIPELINESYNC_MUTEX_TYPE==FUTEX
-	pipeline_sync_thread_wake_futex();
-#endif
-#if PIPELINESYNC_MUTEX_TYPE==BARRIER
-	pipeline_sync_thread_wake_barrier();
-#endif
-#if PIPELINESYNC_MUTEX_TYPE==CONDVAR
-	pipeline_sync_thread_wake_condvar();
-#endif
+	switch(sync_mode) {
+	case SEM:
+		pipeline_sync_thread_wake_sem();
+		break;
+	case FUTEX:
+		pipeline_sync_thread_wake_futex();
+		break;
+	case BARRIER:
+		pipeline_sync_thread_wake_barrier();
+		break;
+	case CONDVAR:
+		pipeline_sync_thread_wake_condvar();
+		break;
+	case EPOCH:
+		pipeline_sync_thread_wake_epoch();
+		break;
+	}
 }
 
+/* Only SEM wakes a single pipeline, the other modes wake all of them */
 inline void pipeline_sync_threads_wake_idx(int idx) {
-#if PIPELINESYNC_MUTEX_TYPE==SEM
-	pipeline_sync_thread_wake_sem_idx(idx);
-#endif
-#if PIPELINESYNC_MUTEX_TYPE==FUTEX
-#error Not implemented
-#endif
-#if PIPELINESYNC_MUTEX_TYPE==BARRIER
-	pipeline_sync_thread_wake_barrier();
-#endif
-#if PIPELINESYNC_MUTEX_TYPE==CONDVAR
-	pipeline_sync_thread_wake_condvar();
-#endif
+	if (sync_mode == SEM) {
+		pipeline_sync_thread_wake_sem_idx(idx);
+	} else {
+		pipeline_sync_threads_wake();
+	}
 }
-
-
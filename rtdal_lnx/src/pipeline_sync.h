@@ -30,11 +30,13 @@
 #define FUTEX 		2
 #define BARRIER		3
 #define CONDVAR		4
+#define EPOCH		5
 
+/* default mode, used when the platform config does not select one */
 #define PIPELINESYNC_MUTEX_TYPE 4
 
 
-int pipeline_sync_initialize(int num_pipelines);
+int pipeline_sync_initialize(int num_pipelines, int mode, int spin_us);
 void pipeline_sync_thread_waits(int idx);
 void pipeline_sync_threads_wake();
 void pipeline_sync_threads_wake_idx(int idx);
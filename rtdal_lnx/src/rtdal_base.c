@@ -31,6 +31,7 @@
 #include "rtdal_context.h"
 #include "rtdal_time.h"
 #include "modulethread.h"
+#include "dataflow.h"
 #include "rtdal_file.h"
 #include "rtdal_error.h"
 #include "rtdal_itfspscq.h"
@@ -39,6 +40,8 @@
 #include "str.h"
 
 static rtdal_context_t *context;
+
+static int start_node_interfaces();
 extern int pgroup_notified_failure[MAX_PROCESS_GROUP_ID];
 
 void rtdal_printf(const char *format, ...) {
@@ -91,11 +94,16 @@ int rtdal_initialize_node(rtdal_context_t *_context, string config_file,
 
 	rtdal_error_set_context(&context->error);
 	context->time.ts_len_us = context->machine.ts_len_ns/1000;
+	context->time.ts_len_ns = context->machine.ts_len_ns;
 	rtdal_time_set_context(&context->time);
 
 	rtdal_time_reset();
 
-	return -1;
+	if (start_node_interfaces()) {
+		return -1;
+	}
+
+	return 0;
 }
 
 
@@ -106,11 +114,53 @@ int rtdal_initialize_node(rtdal_context_t *_context, string config_file,
  * 4) If !multicast, PhysicItf.create("udp://node_ip:sync_port") mode out name "slavesync%d" for each n in node list
  * 5) If multicast, PhysicItf.create("udp://MULTICAST_GROUP1:sync_port") mode out name "slavesync0" (only one output interface is created)
  * 6) Create data interfaces with name "data_id" with id consecutive numbers
+ *
+ * Currently, only the data interfaces defined in the physic_itfs section of the platform
+ * configuration file are created.
  */
-static int __attribute__((__unused__)) start_node_interfaces(string config_file) {
+static int start_node_interfaces() {
 	assert(context);
-	aerror("Not yet implemented");
-	return -1;
+	int i;
+	struct rtdal_physic_cfg *cfg;
+	rtdal_itfphysic_t *itf;
+
+	for (i=0;i<context->machine.nof_physic_itfs;i++) {
+		cfg = &context->machine.physic_itfs[i];
+		itf = &context->physic_itfs[i];
+		itf->parent.id = cfg->id;
+		strcpy(itf->parent.name,cfg->name);
+		itf->parent.mode_is_input = cfg->mode_is_input;
+		itf->parent.is_blocking = cfg->blocking;
+		itf->parent.delay = cfg->delay;
+		itf->batch = cfg->batch;
+		itf->max_msg = cfg->max_msg;
+		itf->msg_sz = cfg->msg_sz;
+		if (rtdal_itfphysic_create((r_itf_t) itf, cfg->address)) {
+			aerror_msg("Creating physical interface %s\n",cfg->name);
+			return -1;
+		}
+		if (rtdal_itfphysic_connect((r_itf_t) itf)) {
+			rtdal_error_print("rtdal_itfphysic_connect");
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static void stop_node_interfaces() {
+	int i;
+	for (i=0;i<context->machine.nof_physic_itfs;i++) {
+		rtdal_itfphysic_disconnect((r_itf_t) &context->physic_itfs[i]);
+	}
+}
+
+/**
+ * Releases the resources allocated by rtdal_initialize_node()
+ */
+void rtdal_finish_node() {
+	if (context) {
+		stop_node_interfaces();
+	}
 }
 
 /**
@@ -160,6 +210,9 @@ int rtdal_periodic_add(void (*callback)(void), int period) {
 	context->periodic[i].counter = 0;
 	context->periodic[i].period = period;
 	context->periodic[i].callback = callback;
+	if (i >= context->nof_periodic) {
+		context->nof_periodic = i+1;
+	}
 	pthread_mutex_unlock(&context->mutex);
 	hdebug("i=%d, period=%d, callback=0x%x\n",i,period,callback);
 	return 0;
@@ -185,6 +238,7 @@ int rtdal_periodic_remove(void (*callback)(void)) {
 
 	if (i == MAX(rtdal_periodic)) {
 		RTDAL_SETERROR(RTDAL_ERROR_NOTFOUND);
+		pthread_mutex_unlock(&context->mutex);
 		return -1;
 	}
 	context->periodic[i].counter = 0;
@@ -323,6 +377,12 @@ r_proc_t rtdal_process_new(struct rtdal_process_attr *attr, void *arg) {
 		goto out;
 	}
 
+	if (attr->period < 0 || attr->phase < 0
+			|| (attr->period > 1 && attr->phase >= attr->period)) {
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		goto out;
+	}
+
 	pgroup_notified_failure[attr->process_group_id] = 0;
 	memset(&context->processes[i],0,sizeof(rtdal_process_t));
 	context->processes[i].pid=i+1;
@@ -336,13 +396,18 @@ r_proc_t rtdal_process_new(struct rtdal_process_attr *attr, void *arg) {
 
 	switch(context->machine.scheduling) {
 		case SCHEDULING_PIPELINE:
+		case SCHEDULING_DAG:
 			if (pipeline_add(&context->pipelines[attr->pipeline_id],
 					&context->processes[i]) == -1) {
 				goto out;
 			}
 		break;
 		case SCHEDULING_BESTEFFORT:
-			if (modulethread_new(&context->processes[i])) {
+			if (dataflow_enabled()) {
+				if (dataflow_add(&context->processes[i])) {
+					goto out;
+				}
+			} else if (modulethread_new(&context->processes[i])) {
 				goto out;
 			}
 			break;
@@ -51,6 +51,7 @@ typedef struct {
 } rtdal_context_t;
 
 int rtdal_initialize_node(rtdal_context_t *context, string config_file, void (*ts_begin_fnc)(void));
+void rtdal_finish_node();
 
 
 #endif
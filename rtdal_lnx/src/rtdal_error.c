@@ -82,6 +82,8 @@ inline static const char *print_error_string(int code) {
 		return "Dynamic Loading. ";
 	case RTDAL_ERROR_NOTFOUND:
 		return "Object not found. ";
+	case RTDAL_ERROR_NOTREADY:
+		return "Not connected. ";
 	default:
 		return "";
 	}
@@ -19,24 +19,67 @@
 #include <stddef.h>
 #include "rtdal_itf.h"
 #include "rtdal_itfspscq.h"
+#include "rtdal_itflfq.h"
+#include "rtdal_itfbring.h"
+#include "rtdal_itfrefq.h"
 #include "rtdal_itfphysic.h"
+#include "rtdal_itfstats.h"
+#include "dataflow.h"
 #include "rtdal.h"
+#include "rtdal_error.h"
+#include "rtdal_context.h"
+#include "rtdal_trace.h"
 #include "defs.h"
 #include "str.h"
 
+extern rtdal_context_t rtdal;
+
 #define call(a, ...) switch(obj->type) {\
 					case ITF_EXTERNAL: return rtdal_itfphysic_##a(__VA_ARGS__); \
 					case ITF_INT_SPSCQ: return rtdal_itfspscq_##a(__VA_ARGS__); \
+					case ITF_INT_LFQ: return rtdal_itflfq_##a(__VA_ARGS__); \
+					case ITF_INT_BRING: return rtdal_itfbring_##a(__VA_ARGS__); \
+					case ITF_INT_REFQ: return rtdal_itfrefq_##a(__VA_ARGS__); \
 					default: return -1; }
 
+/* same as call() but saves the result in n */
+#define call_n(n, a, ...) switch(obj->type) {\
+					case ITF_EXTERNAL: n = rtdal_itfphysic_##a(__VA_ARGS__); break; \
+					case ITF_INT_SPSCQ: n = rtdal_itfspscq_##a(__VA_ARGS__); break; \
+					case ITF_INT_LFQ: n = rtdal_itflfq_##a(__VA_ARGS__); break; \
+					case ITF_INT_BRING: n = rtdal_itfbring_##a(__VA_ARGS__); break; \
+					case ITF_INT_REFQ: n = rtdal_itfrefq_##a(__VA_ARGS__); break; \
+					default: n = -1; }
+
+static void trace_itf(r_itf_t obj, int op, int len) {
+	trace_itf_t ev;
+	ev.itf = (uint64_t) (uintptr_t) obj;
+	ev.op = op;
+	ev.len = len;
+	rtdal_trace_event(TRACE_ITF, &ev, sizeof(ev));
+}
+
 int rtdal_itf_remove(r_itf_t obj) {
+	dataflow_remove_itf(obj);
 	call(remove,obj);
 }
 
 int rtdal_itf_reset(r_itf_t obj) {
+	if (obj && obj->type != ITF_EXTERNAL) {
+		itf_stats_reset(&((rtdal_itf_t*) obj)->stats);
+	}
 	call(reset,obj);
 }
 
+/** Checks, without blocking, whether a packet can be popped from (is_input=1) or pushed to
+ * (is_input=0) the interface. External interfaces are always ready.
+ *
+ * \returns 1 if ready, 0 if not or -1 on error
+ */
+int rtdal_itf_ready(r_itf_t obj, int is_input) {
+	call(ready,obj,is_input);
+}
+
 /** Receives up to len bytes from the interface and stores the data in the
  * memory pointed by buffer.
  *
@@ -48,7 +91,15 @@ int rtdal_itf_reset(r_itf_t obj) {
  * 0 if there are no pending packets in the interface or -1 on error
  */
 int rtdal_itf_recv(r_itf_t obj, void* buffer, int len, int tstamp) {
-	call(recv,obj,buffer,len,tstamp);
+	int n;
+	if (!rtdal_trace_timeline_on()) {
+		call(recv,obj,buffer,len,tstamp);
+	}
+	call_n(n,recv,obj,buffer,len,tstamp);
+	if (n > 0) {
+		trace_itf(obj,TRACE_ITF_POP,n);
+	}
+	return n;
 }
 
 /** Sends len bytes from the memory pointed by buffer through the interface
@@ -61,7 +112,15 @@ int rtdal_itf_recv(r_itf_t obj, void* buffer, int len, int tstamp) {
  * \returns 1 if the packet was sent, 0 if there is no space in the interface or -1 on error
  */
 int rtdal_itf_send(r_itf_t obj, void* buffer, int len, int tstamp) {
-	call(send,obj,buffer,len,tstamp);
+	int n;
+	if (!rtdal_trace_timeline_on()) {
+		call(send,obj,buffer,len,tstamp);
+	}
+	call_n(n,send,obj,buffer,len,tstamp);
+	if (n > 0) {
+		trace_itf(obj,TRACE_ITF_PUSH,len);
+	}
+	return n;
 }
 
 int rtdal_itf_set_blocking(r_itf_t obj, int block) {
@@ -103,7 +162,15 @@ int rtdal_itf_release(r_itf_t obj, void *ptr, int len) {
  * \returns 1 on success, 0 if there is no space in the interface or -1 on error
  */
 int rtdal_itf_push(r_itf_t obj, void *ptr, int len, int tstamp) {
-	call(push,obj,ptr, len,tstamp);
+	int n;
+	if (!rtdal_trace_timeline_on()) {
+		call(push,obj,ptr, len,tstamp);
+	}
+	call_n(n,push,obj,ptr,len,tstamp);
+	if (n > 0) {
+		trace_itf(obj,TRACE_ITF_PUSH,len);
+	}
+	return n;
 }
 
 
@@ -119,13 +186,99 @@ int rtdal_itf_push(r_itf_t obj, void *ptr, int len, int tstamp) {
  * \returns 1 on success, 0 if there are no packets pending in the interface or -1 on error
  */
 int rtdal_itf_pop(r_itf_t obj, void **ptr, int *len, int tstamp) {
-	call(pop,obj,ptr,len,tstamp);
+	int n;
+	if (!rtdal_trace_timeline_on()) {
+		call(pop,obj,ptr,len,tstamp);
+	}
+	call_n(n,pop,obj,ptr,len,tstamp);
+	if (n > 0) {
+		trace_itf(obj,TRACE_ITF_POP,*len);
+	}
+	return n;
+}
+
+/**Returns the packet at the head of the interface like rtdal_itf_pop(), but an empty interface is
+ * not counted in the statistics and the pop is not traced. Used to look at several interfaces
+ * before popping from one of them.
+ *
+ * \returns 1 if there is a packet, 0 if there are no packets pending in the interface or -1 on error
+ */
+int rtdal_itf_peek(r_itf_t obj, void **ptr, int *len, int tstamp) {
+	call(peek,obj,ptr,len,tstamp);
+}
+
+/**Saves in ptr[0..n-1] the addresses of up to max consecutive buffers, which must be pushed in
+ * the same order with rtdal_itf_push(). Interfaces that do not support it return one buffer.
+ *
+ * \returns The number of buffers n, 0 if there are no free packets in the interface or -1 on error
+ */
+int rtdal_itf_request_n(r_itf_t obj, void **ptr, int max) {
+	RTDAL_ASSERT_PARAM(obj);
+	RTDAL_ASSERT_PARAM(ptr);
+	RTDAL_ASSERT_PARAM(max>0);
+	switch(obj->type) {
+	case ITF_INT_SPSCQ: return rtdal_itfspscq_request_n(obj,ptr,max);
+	case ITF_INT_LFQ: return rtdal_itflfq_request_n(obj,ptr,max);
+	default: return rtdal_itf_request(obj,ptr);
+	}
+}
+
+/**Pops up to max pending packets, saving their addresses and lengths in ptr[0..n-1] and
+ * len[0..n-1]. It waits for the first packet like rtdal_itf_pop() and returns the rest of packets
+ * that can be received now. They must be released in the same order with rtdal_itf_release().
+ * Interfaces that do not support it return one packet.
+ *
+ * \returns The number of packets n, 0 if there are no packets pending in the interface or -1 on error
+ */
+int rtdal_itf_pop_n(r_itf_t obj, void **ptr, int *len, int max, int tstamp) {
+	int i, n;
+	RTDAL_ASSERT_PARAM(obj);
+	RTDAL_ASSERT_PARAM(ptr);
+	RTDAL_ASSERT_PARAM(len);
+	RTDAL_ASSERT_PARAM(max>0);
+	switch(obj->type) {
+	case ITF_INT_SPSCQ: n = rtdal_itfspscq_pop_n(obj,ptr,len,max,tstamp); break;
+	case ITF_INT_LFQ: n = rtdal_itflfq_pop_n(obj,ptr,len,max,tstamp); break;
+	case ITF_INT_BRING: n = rtdal_itfbring_pop_n(obj,ptr,len,max,tstamp); break;
+	case ITF_INT_REFQ: n = rtdal_itfrefq_pop_n(obj,ptr,len,max,tstamp); break;
+	default: return rtdal_itf_pop(obj,ptr,len,tstamp);
+	}
+	if (rtdal_trace_timeline_on()) {
+		for (i=0;i<n;i++) {
+			trace_itf(obj,TRACE_ITF_POP,len[i]);
+		}
+	}
+	return n;
 }
 
 int rtdal_itf_set_callback(r_itf_t obj, void (*fnc)(void), int prio) {
 	call(set_callback,obj,fnc,prio);
 }
 
+/** Moves the buffers of an internal interface to the NUMA node of the core of the pipeline
+ * pipeline_id, normally the one running the process that reads it, following the numa_policy
+ * of the platform. Nothing is done if the policy is none or for physical interfaces.
+ *
+ * \returns 0 on success or -1 on error
+ */
+int rtdal_itf_place(r_itf_t obj, int pipeline_id) {
+	int node;
+
+	RTDAL_ASSERT_PARAM(obj);
+	RTDAL_ASSERT_PARAM(pipeline_id>=0 && pipeline_id<rtdal.machine.nof_cores);
+	node = rtdal.pipelines[pipeline_id].numa_node;
+	if (node < 0) {
+		return 0;
+	}
+	switch(obj->type) {
+	case ITF_INT_SPSCQ: return rtdal_itfspscq_place(obj,node,rtdal.machine.numa_policy);
+	case ITF_INT_LFQ: return rtdal_itflfq_place(obj,node,rtdal.machine.numa_policy);
+	case ITF_INT_BRING: return rtdal_itfbring_place(obj,node,rtdal.machine.numa_policy);
+	case ITF_INT_REFQ: return rtdal_itfrefq_place(obj,node,rtdal.machine.numa_policy);
+	default: return 0;
+	}
+}
+
 int rtdal_itf_set_delay(r_itf_t obj, int delay) {
 	call(set_delay,obj,delay);
 }
@@ -134,3 +287,100 @@ int rtdal_itf_get_delay(r_itf_t obj) {
 	call(get_delay,obj);
 }
 
+/** Returns 1 if a packet due at time slot pkt_tstamp is stale at time slot tstamp and has to be
+ * dropped by pop(). With timer_overrun="skip" the slots missed by an overrun are not executed,
+ * so the packets due in them would otherwise be delivered late as current. One slot of lag is
+ * tolerated.
+ */
+int rtdal_itf_is_stale(int pkt_tstamp, int tstamp) {
+	return pkt_tstamp < tstamp-1 && rtdal.machine.timer_overrun == OVERRUN_SKIP;
+}
+
+
+/** Returns the address of the RTDAL_PKT_META_SZ bytes of metadata of the packet ptr, obtained
+ * with rtdal_itf_request() or rtdal_itf_pop(). The metadata is cleared by rtdal_itf_request() and
+ * is received with the packet.
+ *
+ * \returns The address of the metadata or NULL on error
+ */
+void *rtdal_itf_meta(r_itf_t obj, void *ptr) {
+	RTDAL_ASSERT_PARAM_P(obj);
+	switch(obj->type) {
+	case ITF_EXTERNAL: return rtdal_itfphysic_meta(obj,ptr);
+	case ITF_INT_SPSCQ: return rtdal_itfspscq_meta(obj,ptr);
+	case ITF_INT_LFQ: return rtdal_itflfq_meta(obj,ptr);
+	case ITF_INT_BRING: return rtdal_itfbring_meta(obj,ptr);
+	case ITF_INT_REFQ: return rtdal_itfrefq_meta(obj,ptr);
+	default: return NULL;
+	}
+}
+
+/** Returns 1 if the packets of the interface are reference-counted buffers that can be pushed
+ * to other interfaces of the same kind using rtdal_itf_push_ref(), or 0 otherwise.
+ */
+int rtdal_itf_is_shared(r_itf_t obj) {
+	RTDAL_ASSERT_PARAM(obj);
+	return obj->type == ITF_INT_REFQ;
+}
+
+/** Pushes to obj the packet ptr, popped from src, without copying it. Both interfaces must be
+ * shared (see rtdal_itf_is_shared()). The packet still has to be released from src.
+ *
+ * \returns 1 on success, 0 if there is no space in the interface or -1 on error
+ */
+int rtdal_itf_push_ref(r_itf_t obj, r_itf_t src, void *ptr, int len, int tstamp) {
+	int n;
+	RTDAL_ASSERT_PARAM(obj);
+	if (obj->type != ITF_INT_REFQ) {
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		return -1;
+	}
+	n = rtdal_itfrefq_push_ref(obj,src,ptr,len,tstamp);
+	if (n > 0 && rtdal_trace_timeline_on()) {
+		trace_itf(obj,TRACE_ITF_PUSH,len);
+	}
+	return n;
+}
+
+/** Enables or disables the telemetry of an internal interface. While enabled, the interface
+ * counts the pushed, dropped and popped packets and the pops that found no packet, and measures
+ * its occupancy and the latency of the packets, both in time slots and in nanoseconds.
+ * Physical interfaces are not supported.
+ *
+ * \returns 0 on success or -1 on error
+ */
+int rtdal_itf_set_stats(r_itf_t obj, int enable) {
+	RTDAL_ASSERT_PARAM(obj);
+	switch(obj->type) {
+	case ITF_INT_SPSCQ:
+	case ITF_INT_LFQ:
+	case ITF_INT_BRING:
+		((rtdal_itf_t*) obj)->stats.enabled = enable;
+		return 0;
+	case ITF_INT_REFQ: return rtdal_itfrefq_set_stats(obj,enable);
+	default:
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		return -1;
+	}
+}
+
+/** Saves in stats the telemetry of the interface since its creation or its last reset.
+ * It may be called from any thread while the interface is being used.
+ *
+ * \returns 0 on success or -1 on error
+ */
+int rtdal_itf_get_stats(r_itf_t obj, rtdal_itf_stats_t *stats) {
+	RTDAL_ASSERT_PARAM(obj);
+	RTDAL_ASSERT_PARAM(stats);
+	switch(obj->type) {
+	case ITF_INT_SPSCQ:
+	case ITF_INT_LFQ:
+	case ITF_INT_BRING:
+		itf_stats_get(&((rtdal_itf_t*) obj)->stats, stats);
+		return 0;
+	case ITF_INT_REFQ: return rtdal_itfrefq_get_stats(obj,stats);
+	default:
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		return -1;
+	}
+}
@@ -21,11 +21,40 @@
 
 #include "str.h"
 #include "rtdal.h"
+#include "defs.h"
 #include "rtdal_itfspscq.h"
+#include "rtdal_itflfq.h"
+#include "rtdal_itfbring.h"
+#include "rtdal_itfrefq.h"
 
 #define ITF_INT_QUEUE		1
 #define ITF_INT_SPSCQ		2
 #define ITF_EXTERNAL		4
+#define ITF_INT_LFQ		8
+#define ITF_INT_BRING		16
+#define ITF_INT_REFQ		32
+
+/**
+ * Telemetry counters, updated with the functions in rtdal_itfstats.h. The producer and the
+ * consumer counters are kept in different cache lines.
+ */
+typedef struct {
+	int enabled;
+
+	/* written by the producer only */
+	long long pushed;
+	long long dropped;
+	char pad[CACHE_LINE_SZ];
+
+	/* written by the consumer only */
+	long long popped;
+	long long empty;
+	int max_occupancy;
+	int max_latency_slots;
+	long long sum_latency_slots;
+	long long sum_latency_ns;
+	long long max_latency_ns;
+}itf_stats_t;
 
 /**
  * Abstract class that manages the rtdal data or control, physical or logical interfaces.
@@ -45,7 +74,14 @@ typedef struct {
 
 	r_log_t log;
 
+	itf_stats_t stats;
+
+	/* processes writing and reading the interface, woken up by the best-effort worker pool */
+	void *producer;
+	void *consumer;
 }rtdal_itf_t;
 
+int rtdal_itf_is_stale(int pkt_tstamp, int tstamp);
+
 
 #endif
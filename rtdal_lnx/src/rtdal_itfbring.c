@@ -0,0 +1,529 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "ring_buff_osal.h"
+
+#include "rtdal.h"
+#include "rtdal_error.h"
+#include "rtdal_itf.h"
+#include "rtdal_itfbring.h"
+#include "rtdal_itfwait.h"
+#include "dataflow.h"
+#include "rtdal_itfstats.h"
+#include "rtdal_numa.h"
+#include "defs.h"
+#include "str.h"
+
+#define USE_SYSTEM_TSTAMP
+
+/**
+ * Single producer single consumer byte ring. Conversely to rtdal_itfspscq and rtdal_itflfq,
+ * packets are not stored in fixed-size slots. Each packet is stored contiguously in a single
+ * byte buffer, after a header with its length and timestamp, and it only takes the actual
+ * length it was pushed with.
+ *
+ * To keep the request/push/pop/release zero-copy contract, request() still needs msg_sz
+ * contiguous bytes, because the length of the packet is not known until push(). If they do not
+ * fit before the end of the buffer, push() writes a wrap marker and the packet is stored at the
+ * beginning of the buffer.
+ *
+ * The read and write positions are free-running byte counters, each in its own cache line and
+ * published with release stores. Headers and packet lengths are rounded to the cache line size,
+ * so that the packet data is always aligned.
+ */
+typedef struct {
+	int tstamp;
+	int len;
+	long long tx_ns;
+	char meta[RTDAL_PKT_META_SZ];
+} r_bpkt_t;
+
+#define BRING_HDR_SZ		CACHE_LINE_SZ
+#define BRING_WRAP			-1
+
+#define bring_align(x) ((((x)+CACHE_LINE_SZ-1)/CACHE_LINE_SZ)*CACHE_LINE_SZ)
+
+typedef struct {
+	rtdal_itf_t parent;
+
+	int buf_sz;
+	int max_msg_sz;
+	int max_pkt_sz;
+	ring_buff_binary_sem_t sem_r;
+	ring_buff_binary_sem_t sem_w;
+	char *data;
+
+	/* written by the producer only */
+	uint64_t write CACHE_ALIGNED;
+	uint64_t read_cache;
+
+	/* written by the consumer only */
+	uint64_t read CACHE_ALIGNED;
+	uint64_t write_cache;
+
+	/* consumer and producer waits with RTDAL_ITF_FUTEX and RTDAL_ITF_POLLING */
+	itf_wait_t wait_r CACHE_ALIGNED;
+	itf_wait_t wait_w CACHE_ALIGNED;
+} CACHE_ALIGNED rtdal_itfbring_t;
+
+#define cast(a,b) RTDAL_ASSERT_PARAM(a);\
+			rtdal_itfbring_t *b = (rtdal_itfbring_t*) a;
+
+#define bring_hdr(itf,pos) ((r_bpkt_t*) &(itf)->data[(pos)%(itf)->buf_sz])
+
+static int bring_id=1;
+
+/**
+ * Creates a byte ring of buf_sz bytes for packets of up to msg_sz bytes. The buffer is enlarged
+ * to hold at least two packets of msg_sz bytes.
+ */
+r_itf_t rtdal_itfbring_new(int buf_sz, int msg_sz, int delay, r_log_t log) {
+	rtdal_itfbring_t *itf;
+
+	if (posix_memalign((void**)&itf,CACHE_LINE_SZ,sizeof(rtdal_itfbring_t))) {
+		return NULL;
+	}
+	memset(itf,0,sizeof(rtdal_itfbring_t));
+
+	itf->parent.type = ITF_INT_BRING;
+	itf->max_msg_sz = msg_sz;
+	itf->max_pkt_sz = BRING_HDR_SZ+bring_align(msg_sz);
+	itf->buf_sz = bring_align(buf_sz);
+	if (itf->buf_sz < 2*itf->max_pkt_sz) {
+		itf->buf_sz = 2*itf->max_pkt_sz;
+	}
+	itf->parent.delay = delay;
+	itf->parent.log = log;
+	itf->parent.id=bring_id++;
+	if (posix_memalign((void**)&itf->data,CACHE_LINE_SZ,itf->buf_sz)) {
+		free(itf);
+		return NULL;
+	}
+	memset(itf->data,0,itf->buf_sz);
+	if (itf->parent.delay == RTDAL_ITF_BLOCKING) {
+		ring_buff_binary_sem_create(&itf->sem_r);
+		ring_buff_binary_sem_create(&itf->sem_w);
+	}
+	itf_wait_init(&itf->wait_r);
+	itf_wait_init(&itf->wait_w);
+
+	return (r_itf_t) itf;
+}
+
+/**
+ * Returns the number of bytes allocated for the buffer
+ */
+int rtdal_itfbring_get_size(r_itf_t obj) {
+	cast(obj,itf);
+	return itf->buf_sz;
+}
+
+int rtdal_itfbring_reset(r_itf_t obj) {
+	cast(obj,itf);
+
+	qdebug("resetting %d bytes\n",itf->buf_sz);
+	__atomic_store_n(&itf->read, 0, __ATOMIC_RELEASE);
+	__atomic_store_n(&itf->write, 0, __ATOMIC_RELEASE);
+	itf->read_cache = 0;
+	itf->write_cache = 0;
+	return 0;
+}
+
+int rtdal_itfbring_remove(r_itf_t obj) {
+	cast(obj,itf);
+	if (itf->data) {
+		free(itf->data);
+		itf->data = NULL;
+	}
+	if (itf->parent.delay == RTDAL_ITF_BLOCKING) {
+		ring_buff_binary_sem_destroy(itf->sem_r);
+		ring_buff_binary_sem_destroy(itf->sem_w);
+	}
+	itf->buf_sz = 0;
+	itf->max_msg_sz = 0;
+	itf->parent.id = 0;
+
+	free(itf);
+
+	return 0;
+}
+
+/**
+ * Moves the ring to the NUMA node node (see numa_place())
+ */
+int rtdal_itfbring_place(r_itf_t obj, int node, int policy) {
+	cast(obj,itf);
+	return numa_place(itf->data, (size_t) itf->buf_sz, node, policy);
+}
+
+/* bytes the next request has to reserve, including the skipped end of the buffer if it wraps */
+inline static int bring_need(rtdal_itfbring_t *itf) {
+	int tail = itf->buf_sz - (int) (itf->write%itf->buf_sz);
+	if (tail < itf->max_pkt_sz) {
+		return tail + itf->max_pkt_sz;
+	} else {
+		return itf->max_pkt_sz;
+	}
+}
+
+/* called by the consumer only */
+inline static int bring_is_empty_nb(rtdal_itfbring_t *itf) {
+	if (itf->read == itf->write_cache) {
+		itf->write_cache = __atomic_load_n(&itf->write, __ATOMIC_ACQUIRE);
+		if (itf->read == itf->write_cache) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* called by the producer only */
+inline static int bring_is_full_nb(rtdal_itfbring_t *itf) {
+	uint64_t need = (uint64_t) bring_need(itf);
+	if (itf->write - itf->read_cache + need > (uint64_t) itf->buf_sz) {
+		itf->read_cache = __atomic_load_n(&itf->read, __ATOMIC_ACQUIRE);
+		if (itf->write - itf->read_cache + need > (uint64_t) itf->buf_sz) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int bring_can_pop(void *arg) {
+	return !bring_is_empty_nb((rtdal_itfbring_t*) arg);
+}
+
+static int bring_can_push(void *arg) {
+	return !bring_is_full_nb((rtdal_itfbring_t*) arg);
+}
+
+int rtdal_itfbring_ready(r_itf_t obj, int is_input) {
+	cast(obj,itf);
+	return is_input?bring_can_pop(itf):bring_can_push(itf);
+}
+
+inline static int bring_is_empty(rtdal_itfbring_t *itf) {
+	if (itf->parent.delay >= 0) {
+		return bring_is_empty_nb(itf);
+	} else if (itf->parent.delay == RTDAL_ITF_POLLING) {
+		return !itf_wait(&itf->wait_r, bring_can_pop, itf, 1000);
+	} else if (itf->parent.delay == RTDAL_ITF_FUTEX) {
+		itf_wait(&itf->wait_r, bring_can_pop, itf, 0);
+		return 0;
+	} else {
+		while (bring_is_empty_nb(itf)) {
+			qdebug("wait write=%llu read=%llu\n",itf->write_cache,itf->read);
+			ring_buff_binary_sem_take(itf->sem_r);
+		}
+		return 0;
+	}
+}
+
+inline static int bring_is_full(rtdal_itfbring_t *itf) {
+	if (itf->parent.delay >= 0) {
+		return bring_is_full_nb(itf);
+	} else if (itf->parent.delay != RTDAL_ITF_BLOCKING) {
+		itf_wait(&itf->wait_w, bring_can_push, itf, 0);
+		return 0;
+	} else {
+		while (bring_is_full_nb(itf)) {
+			qdebug("wait write=%llu read=%llu\n",itf->write,itf->read_cache);
+			ring_buff_binary_sem_take(itf->sem_w);
+		}
+		return 0;
+	}
+}
+
+int rtdal_itfbring_request(r_itf_t obj, void **ptr) {
+	cast(obj,itf);
+	RTDAL_ASSERT_PARAM(ptr);
+	int tail;
+
+	*ptr = NULL;
+
+	if (bring_is_full(itf)) {
+		qdebug("[full] id=%d write=%llu read=%llu\n",itf->parent.id,itf->write,itf->read_cache);
+		RTDAL_SETERROR(RTDAL_ERROR_NOSPACE);
+		itf_stats_drop(&itf->parent);
+		return 0;
+	}
+
+	tail = itf->buf_sz - (int) (itf->write%itf->buf_sz);
+	if (tail < itf->max_pkt_sz) {
+		*ptr = &itf->data[BRING_HDR_SZ];
+	} else {
+		*ptr = &itf->data[itf->write%itf->buf_sz+BRING_HDR_SZ];
+	}
+	memset(((r_bpkt_t*) ((char*) *ptr-BRING_HDR_SZ))->meta,0,RTDAL_PKT_META_SZ);
+	qdebug("[ok] write=%llu/%d\n",itf->write,itf->buf_sz);
+
+	return 1;
+}
+
+int rtdal_itfbring_push(r_itf_t obj, void *ptr, int len, int tstamp) {
+	cast(obj,itf);
+	uint64_t write;
+	int tail;
+	r_bpkt_t *hdr;
+
+	if (!len) {
+		return 1;
+	}
+	if (len > itf->max_msg_sz) {
+		RTDAL_SETERROR(RTDAL_ERROR_LARGE);
+		return -1;
+	}
+
+#ifdef USE_SYSTEM_TSTAMP
+	tstamp=rtdal_time_slot();
+#endif
+
+	write = itf->write;
+	tail = itf->buf_sz - (int) (write%itf->buf_sz);
+	if (tail < itf->max_pkt_sz) {
+		/* request() returned the beginning of the buffer */
+		bring_hdr(itf,write)->len = BRING_WRAP;
+		write += tail;
+	}
+	hdr = bring_hdr(itf,write);
+	hdr->tstamp = tstamp+itf->parent.delay;
+	hdr->len = len;
+	hdr->tx_ns = itf_stats_tx(&itf->parent);
+	qdebug("write=%llu/%d, len=%d, tstamp=%d, delay=%d\n",write,itf->buf_sz,len,tstamp,
+			itf->parent.delay);
+
+	/* publishes the header and packet contents before the new write position */
+	__atomic_store_n(&itf->write, write+BRING_HDR_SZ+bring_align(len), __ATOMIC_RELEASE);
+
+	if (itf->parent.delay == RTDAL_ITF_BLOCKING) {
+		ring_buff_binary_sem_give(itf->sem_r);
+	} else if (itf->parent.delay < 0) {
+		itf_wait_signal(&itf->wait_r);
+	}
+	dataflow_notify(itf->parent.consumer);
+
+	return 1;
+}
+
+/**
+ * Like rtdal_itfbring_pop() but an empty queue is not counted in the statistics
+ */
+int rtdal_itfbring_peek(r_itf_t obj, void **ptr, int *len, int tstamp) {
+	cast(obj,itf);
+	RTDAL_ASSERT_PARAM(ptr);
+	RTDAL_ASSERT_PARAM(len);
+	r_bpkt_t *hdr;
+
+	*ptr = NULL;
+	*len = 0;
+
+	do {
+		if (bring_is_empty(itf)) {
+			qdebug("[empty] read=%llu write=%llu\n",itf->read,itf->write_cache);
+			return 0;
+		}
+
+		hdr = bring_hdr(itf,itf->read);
+		if (hdr->len == BRING_WRAP) {
+			/* the producer publishes the marker and the next packet at once, so it is not empty */
+			__atomic_store_n(&itf->read, itf->read+itf->buf_sz-itf->read%itf->buf_sz,
+					__ATOMIC_RELEASE);
+			hdr = bring_hdr(itf,itf->read);
+		}
+
+		if (itf->parent.delay < 0) {
+			break;
+		}
+#ifdef USE_SYSTEM_TSTAMP
+		tstamp=rtdal_time_slot();
+#endif
+		if (hdr->tstamp > tstamp) {
+			qdebug("[delay] read=%llu, tstamp=%d now=%d\n",itf->read,hdr->tstamp,tstamp);
+			return 0;
+		}
+		if (!rtdal_itf_is_stale(hdr->tstamp,tstamp)) {
+			break;
+		}
+		qdebug("[old] read=%llu, tstamp=%d now=%d\n",itf->read,hdr->tstamp,tstamp);
+		rtdal_itfbring_release(obj,NULL,0);
+	} while(1);
+
+	qdebug("[ok] read=%llu, tstamp=%d (now=%d)\n",itf->read,hdr->tstamp,tstamp);
+	*ptr = (char*) hdr+BRING_HDR_SZ;
+	*len = hdr->len;
+
+	return 1;
+}
+
+int rtdal_itfbring_pop(r_itf_t obj, void **ptr, int *len, int tstamp) {
+	cast(obj,itf);
+	int n;
+
+	if (!(n = rtdal_itfbring_peek(obj, ptr, len, tstamp))) {
+		itf_stats_empty(&itf->parent);
+	}
+	return n;
+}
+
+/**
+ * Pops up to max pending packets. Waits for the first one like rtdal_itfbring_pop(). They must
+ * be released in the same order.
+ */
+int rtdal_itfbring_pop_n(r_itf_t obj, void **ptr, int *len, int max, int tstamp) {
+	cast(obj,itf);
+	uint64_t pos;
+	r_bpkt_t *hdr;
+	int n;
+
+	if ((n = rtdal_itfbring_pop(obj, &ptr[0], &len[0], tstamp)) != 1) {
+		return n;
+	}
+#ifdef USE_SYSTEM_TSTAMP
+	tstamp=rtdal_time_slot();
+#endif
+	pos = itf->read+BRING_HDR_SZ+bring_align(len[0]);
+	for (n=1;n<max;n++) {
+		if (pos == itf->write_cache) {
+			itf->write_cache = __atomic_load_n(&itf->write, __ATOMIC_ACQUIRE);
+			if (pos == itf->write_cache) {
+				break;
+			}
+		}
+		hdr = bring_hdr(itf,pos);
+		if (hdr->len == BRING_WRAP) {
+			pos += itf->buf_sz-pos%itf->buf_sz;
+			hdr = bring_hdr(itf,pos);
+		}
+		if (itf->parent.delay >= 0 && hdr->tstamp > tstamp) {
+			break;
+		}
+		ptr[n] = (char*) hdr+BRING_HDR_SZ;
+		len[n] = hdr->len;
+		pos += BRING_HDR_SZ+bring_align(hdr->len);
+	}
+	return n;
+}
+
+int rtdal_itfbring_release(r_itf_t obj, void *ptr, int len) {
+	cast(obj,itf);
+	r_bpkt_t *hdr;
+
+	if (bring_hdr(itf,itf->read)->len == BRING_WRAP) {
+		/* packets returned by rtdal_itfbring_pop_n() may start after a wrap marker */
+		itf->read += itf->buf_sz-itf->read%itf->buf_sz;
+	}
+	hdr = bring_hdr(itf,itf->read);
+	len = hdr->len;
+	itf_stats_rx(&itf->parent, hdr->tstamp-itf->parent.delay, hdr->tx_ns);
+
+	/* the producer may reuse the space once it observes the new read position */
+	__atomic_store_n(&itf->read, itf->read+BRING_HDR_SZ+bring_align(len), __ATOMIC_RELEASE);
+	qdebug("read=%llu, write=%llu\n",itf->read,itf->write_cache);
+
+	if (itf->parent.delay == RTDAL_ITF_BLOCKING) {
+		ring_buff_binary_sem_give(itf->sem_w);
+	} else if (itf->parent.delay < 0) {
+		itf_wait_signal(&itf->wait_w);
+	}
+	dataflow_notify(itf->parent.producer);
+
+	return 1;
+}
+
+/* the header of a packet returned by request() or pop() is just before its contents */
+void *rtdal_itfbring_meta(r_itf_t obj, void *ptr) {
+	RTDAL_ASSERT_PARAM_P(obj);
+	RTDAL_ASSERT_PARAM_P(ptr);
+	return ((r_bpkt_t*) ((char*) ptr-BRING_HDR_SZ))->meta;
+}
+
+int rtdal_itfbring_set_delay(r_itf_t obj, int delay) {
+	aerror("Not yet implemented");
+	return -1;
+}
+
+int rtdal_itfbring_get_delay(r_itf_t obj) {
+	cast(obj,itf);
+	return itf->parent.delay;
+}
+
+int rtdal_itfbring_set_callback(r_itf_t obj, void (*fnc)(void), int prio) {
+	aerror("Not yet implemented");
+	return -1;
+}
+
+int rtdal_itfbring_set_blocking(r_itf_t obj, int block) {
+	aerror("Not yet implemented");
+	return -1;
+}
+
+int rtdal_itfbring_get_blocking(r_itf_t obj) {
+	aerror("Not yet implemented");
+	return -1;
+}
+
+int rtdal_itfbring_send(r_itf_t obj, void* buffer, int len, int tstamp) {
+	cast(obj,itf);
+	RTDAL_ASSERT_PARAM(buffer);
+	RTDAL_ASSERT_PARAM(len>=0);
+
+	int n;
+	void *ptr;
+
+	if (len > itf->max_msg_sz) {
+		RTDAL_SETERROR(RTDAL_ERROR_LARGE);
+		return -1;
+	}
+
+	if ((n = rtdal_itfbring_request(obj, &ptr)) != 1) {
+		return n;
+	}
+
+	memcpy(ptr, buffer, (size_t) len);
+
+	return rtdal_itfbring_push(obj,ptr,len,tstamp);
+}
+
+int rtdal_itfbring_recv(r_itf_t obj, void* buffer, int len, int tstamp) {
+	RTDAL_ASSERT_PARAM(buffer);
+	RTDAL_ASSERT_PARAM(len>=0);
+
+	int n, plen;
+	void *ptr=NULL;
+
+	if ((n = rtdal_itfbring_pop(obj, &ptr, &plen, tstamp)) < 1) {
+		return n;
+	}
+
+	if (plen > len) {
+		plen = len;
+	}
+
+	memcpy(buffer, ptr, (size_t) plen);
+
+	if ((n = rtdal_itfbring_release(obj,NULL,0)) != 1) {
+		printf("Caution packet could not be released (%d)\n",n);
+	}
+	return plen;
+}
@@ -0,0 +1,46 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef rtdal_ITFBRING_H
+#define rtdal_ITFBRING_H
+
+#include "str.h"
+#include "rtdal_itf.h"
+#include "rtdal.h"
+
+
+int rtdal_itfbring_reset(r_itf_t obj);
+int rtdal_itfbring_remove(r_itf_t obj);
+int rtdal_itfbring_request(r_itf_t obj, void **ptr);
+int rtdal_itfbring_push(r_itf_t obj, void *ptr, int len, int tstamp);
+int rtdal_itfbring_pop(r_itf_t obj, void **ptr, int *len, int tstamp);
+int rtdal_itfbring_peek(r_itf_t obj, void **ptr, int *len, int tstamp);
+int rtdal_itfbring_release(r_itf_t obj, void *ptr, int len);
+int rtdal_itfbring_pop_n(r_itf_t obj, void **ptr, int *len, int max, int tstamp);
+int rtdal_itfbring_send(r_itf_t obj, void* buffer, int len, int tstamp);
+int rtdal_itfbring_recv(r_itf_t obj, void* buffer, int len, int tstamp);
+int rtdal_itfbring_set_callback(r_itf_t obj, void (*fnc)(void), int prio);
+int rtdal_itfbring_set_blocking(r_itf_t obj, int block);
+int rtdal_itfbring_get_blocking(r_itf_t obj);
+int rtdal_itfbring_set_delay(r_itf_t obj, int delay);
+int rtdal_itfbring_get_delay(r_itf_t obj);
+void *rtdal_itfbring_meta(r_itf_t obj, void *ptr);
+int rtdal_itfbring_ready(r_itf_t obj, int is_input);
+int rtdal_itfbring_get_size(r_itf_t obj);
+int rtdal_itfbring_place(r_itf_t obj, int node, int policy);
+#endif
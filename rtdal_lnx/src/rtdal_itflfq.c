@@ -0,0 +1,515 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "ring_buff_osal.h"
+
+#include "rtdal.h"
+#include "rtdal_error.h"
+#include "rtdal_itf.h"
+#include "rtdal_itflfq.h"
+#include "rtdal_itfwait.h"
+#include "dataflow.h"
+#include "rtdal_itfstats.h"
+#include "rtdal_numa.h"
+#include "defs.h"
+#include "str.h"
+
+#define USE_SYSTEM_TSTAMP
+
+/**
+ * Lock-free SPSC queue. Conversely to rtdal_itfspscq, slots are not flagged as valid/invalid.
+ * Instead, the producer owns the write index and the consumer owns the read index, each in its
+ * own cache line, and they are published with release stores and observed with acquire loads.
+ * Each side keeps a cached copy of the remote index, which is only refreshed when the queue
+ * looks full (producer) or empty (consumer), so in steady state each side only touches its
+ * own cache line.
+ *
+ * One slot is always left empty to distinguish a full queue from an empty one.
+ */
+typedef struct {
+	int tstamp;
+	int len;
+	void *data;
+	long long tx_ns;
+	char meta[RTDAL_PKT_META_SZ];
+} CACHE_ALIGNED r_lfpkt_t;
+
+typedef struct {
+	rtdal_itf_t parent;
+
+	int max_msg;
+	int max_msg_sz;
+	ring_buff_binary_sem_t sem_r;
+	ring_buff_binary_sem_t sem_w;
+	r_lfpkt_t *packets;
+	char *data;
+	/* called with the data of each stale packet dropped by pop() */
+	void (*drop)(void *data);
+
+	/* written by the producer only */
+	int write CACHE_ALIGNED;
+	int read_cache;
+
+	/* written by the consumer only */
+	int read CACHE_ALIGNED;
+	int write_cache;
+
+	/* consumer and producer waits with RTDAL_ITF_FUTEX and RTDAL_ITF_POLLING */
+	itf_wait_t wait_r CACHE_ALIGNED;
+	itf_wait_t wait_w CACHE_ALIGNED;
+} CACHE_ALIGNED rtdal_itflfq_t;
+
+#define cast(a,b) RTDAL_ASSERT_PARAM(a);\
+			rtdal_itflfq_t *b = (rtdal_itflfq_t*) a;
+
+#define lfq_next(itf,idx) ((idx)+1 >= (itf)->max_msg ? 0 : (idx)+1)
+
+static int lfq_id=1;
+
+r_itf_t rtdal_itflfq_new(int max_msg, int msg_sz, int delay, r_log_t log) {
+	int i;
+	rtdal_itflfq_t *itf;
+
+	if (posix_memalign((void**)&itf,CACHE_LINE_SZ,sizeof(rtdal_itflfq_t))) {
+		return NULL;
+	}
+	memset(itf,0,sizeof(rtdal_itflfq_t));
+
+	itf->parent.type = ITF_INT_LFQ;
+	itf->max_msg = max_msg+1;
+	/* keep every packet in its own cache lines */
+	itf->max_msg_sz = ((msg_sz+CACHE_LINE_SZ-1)/CACHE_LINE_SZ)*CACHE_LINE_SZ;
+	itf->parent.delay = delay;
+	itf->parent.log = log;
+	itf->parent.id=lfq_id++;
+	itf->read = 0;
+	itf->write = 0;
+	itf->read_cache = 0;
+	itf->write_cache = 0;
+	if (posix_memalign((void**)&itf->data,CACHE_LINE_SZ,itf->max_msg*itf->max_msg_sz)) {
+		free(itf);
+		return NULL;
+	}
+	memset(itf->data,0,itf->max_msg*itf->max_msg_sz);
+	if (posix_memalign((void**)&itf->packets,CACHE_LINE_SZ,itf->max_msg*sizeof(r_lfpkt_t))) {
+		free(itf->data);
+		free(itf);
+		return NULL;
+	}
+	memset(itf->packets,0,itf->max_msg*sizeof(r_lfpkt_t));
+	for (i=0;i<itf->max_msg;i++) {
+		itf->packets[i].data = &itf->data[i*itf->max_msg_sz];
+	}
+	if (itf->parent.delay == RTDAL_ITF_BLOCKING) {
+		ring_buff_binary_sem_create(&itf->sem_r);
+		ring_buff_binary_sem_create(&itf->sem_w);
+	}
+	itf_wait_init(&itf->wait_r);
+	itf_wait_init(&itf->wait_w);
+
+	return (r_itf_t) itf;
+}
+
+int rtdal_itflfq_reset(r_itf_t obj) {
+	cast(obj,itf);
+
+	qdebug("resetting %d msg \n",itf->max_msg);
+	__atomic_store_n(&itf->read, 0, __ATOMIC_RELEASE);
+	__atomic_store_n(&itf->write, 0, __ATOMIC_RELEASE);
+	itf->read_cache = 0;
+	itf->write_cache = 0;
+	return 0;
+}
+
+int rtdal_itflfq_remove(r_itf_t obj) {
+	cast(obj,itf);
+	if (itf->data) {
+		free(itf->data);
+		itf->data = NULL;
+	}
+	if (itf->packets) {
+		free(itf->packets);
+		itf->packets = NULL;
+	}
+	if (itf->parent.delay == RTDAL_ITF_BLOCKING) {
+		ring_buff_binary_sem_destroy(itf->sem_r);
+		ring_buff_binary_sem_destroy(itf->sem_w);
+	}
+	itf->max_msg = 0;
+	itf->max_msg_sz = 0;
+	itf->parent.id = 0;
+
+	free(itf);
+
+	return 0;
+}
+
+/**
+ * Moves the packets to the NUMA node node (see numa_place())
+ */
+int rtdal_itflfq_place(r_itf_t obj, int node, int policy) {
+	cast(obj,itf);
+	if (numa_place(itf->data, (size_t) itf->max_msg*itf->max_msg_sz, node, policy)) {
+		return -1;
+	}
+	return numa_place(itf->packets, itf->max_msg*sizeof(r_lfpkt_t), node, policy);
+}
+
+/* called by the consumer only */
+inline static int lfq_is_empty_nb(rtdal_itflfq_t *itf) {
+	if (itf->read == itf->write_cache) {
+		itf->write_cache = __atomic_load_n(&itf->write, __ATOMIC_ACQUIRE);
+		if (itf->read == itf->write_cache) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* called by the producer only */
+inline static int lfq_is_full_nb(rtdal_itflfq_t *itf) {
+	int next = lfq_next(itf,itf->write);
+	if (next == itf->read_cache) {
+		itf->read_cache = __atomic_load_n(&itf->read, __ATOMIC_ACQUIRE);
+		if (next == itf->read_cache) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int lfq_can_pop(void *arg) {
+	return !lfq_is_empty_nb((rtdal_itflfq_t*) arg);
+}
+
+static int lfq_can_push(void *arg) {
+	return !lfq_is_full_nb((rtdal_itflfq_t*) arg);
+}
+
+int rtdal_itflfq_ready(r_itf_t obj, int is_input) {
+	cast(obj,itf);
+	return is_input?lfq_can_pop(itf):lfq_can_push(itf);
+}
+
+inline static int lfq_is_empty(rtdal_itflfq_t *itf) {
+	if (itf->parent.delay >= 0) {
+		return lfq_is_empty_nb(itf);
+	} else if (itf->parent.delay == RTDAL_ITF_POLLING) {
+		return !itf_wait(&itf->wait_r, lfq_can_pop, itf, 1000);
+	} else if (itf->parent.delay == RTDAL_ITF_FUTEX) {
+		itf_wait(&itf->wait_r, lfq_can_pop, itf, 0);
+		return 0;
+	} else {
+		while (lfq_is_empty_nb(itf)) {
+			qdebug("wait write=%d read=%d\n",itf->write_cache,itf->read);
+			ring_buff_binary_sem_take(itf->sem_r);
+		}
+		return 0;
+	}
+}
+
+inline static int lfq_is_full(rtdal_itflfq_t *itf) {
+	if (itf->parent.delay >= 0) {
+		return lfq_is_full_nb(itf);
+	} else if (itf->parent.delay != RTDAL_ITF_BLOCKING) {
+		itf_wait(&itf->wait_w, lfq_can_push, itf, 0);
+		return 0;
+	} else {
+		while (lfq_is_full_nb(itf)) {
+			qdebug("wait write=%d read=%d\n",itf->write,itf->read_cache);
+			ring_buff_binary_sem_take(itf->sem_w);
+		}
+		return 0;
+	}
+}
+
+int rtdal_itflfq_request(r_itf_t obj, void **ptr) {
+	cast(obj,itf);
+	RTDAL_ASSERT_PARAM(ptr);
+
+	*ptr = NULL;
+
+	if (lfq_is_full(itf)) {
+		qdebug("[full] id=%d write=%d read=%d\n",itf->parent.id,itf->write,itf->read_cache);
+		RTDAL_SETERROR(RTDAL_ERROR_NOSPACE);
+		itf_stats_drop(&itf->parent);
+		return 0;
+	}
+
+	qdebug("[ok] write=%d/%d\n",itf->write,itf->max_msg);
+	*ptr = itf->packets[itf->write].data;
+	memset(itf->packets[itf->write].meta,0,RTDAL_PKT_META_SZ);
+
+	return 1;
+}
+
+int rtdal_itflfq_push(r_itf_t obj, void *ptr, int len, int tstamp) {
+	cast(obj,itf);
+	if (!len) {
+		return 1;
+	}
+
+#ifdef USE_SYSTEM_TSTAMP
+	tstamp=rtdal_time_slot();
+#endif
+
+	itf->packets[itf->write].tstamp = tstamp+itf->parent.delay;
+	itf->packets[itf->write].len = len;
+	itf->packets[itf->write].tx_ns = itf_stats_tx(&itf->parent);
+	qdebug("write=%d/%d, len=%d, tstamp=%d, delay=%d\n",itf->write,itf->max_msg,len,tstamp,
+			itf->parent.delay);
+
+	/* publishes the packet contents before the new write index */
+	__atomic_store_n(&itf->write, lfq_next(itf,itf->write), __ATOMIC_RELEASE);
+
+	if (itf->parent.delay == RTDAL_ITF_BLOCKING) {
+		ring_buff_binary_sem_give(itf->sem_r);
+	} else if (itf->parent.delay < 0) {
+		itf_wait_signal(&itf->wait_r);
+	}
+	dataflow_notify(itf->parent.consumer);
+
+	return 1;
+}
+
+/**
+ * Like rtdal_itflfq_pop() but an empty queue is not counted in the statistics
+ */
+int rtdal_itflfq_peek(r_itf_t obj, void **ptr, int *len, int tstamp) {
+	cast(obj,itf);
+	RTDAL_ASSERT_PARAM(ptr);
+	RTDAL_ASSERT_PARAM(len);
+
+	*ptr = NULL;
+	*len = 0;
+
+	do {
+		if (lfq_is_empty(itf)) {
+			qdebug("[empty] read=%d write=%d\n",itf->read,itf->write_cache);
+			return 0;
+		}
+		if (itf->parent.delay < 0) {
+			break;
+		}
+#ifdef USE_SYSTEM_TSTAMP
+		tstamp=rtdal_time_slot();
+#endif
+		if (itf->packets[itf->read].tstamp > tstamp) {
+			qdebug("[delay] read=%d, tstamp=%d now=%d\n",itf->read,itf->packets[itf->read].tstamp,
+					tstamp);
+			return 0;
+		}
+		if (!rtdal_itf_is_stale(itf->packets[itf->read].tstamp,tstamp)) {
+			break;
+		}
+		qdebug("[old] read=%d, tstamp=%d now=%d\n",itf->read,itf->packets[itf->read].tstamp,tstamp);
+		if (itf->drop) {
+			itf->drop(itf->packets[itf->read].data);
+		}
+		rtdal_itflfq_release(obj,NULL,0);
+	} while(1);
+
+	qdebug("[ok] read=%d, tstamp=%d (now=%d)\n",itf->read,itf->packets[itf->read].tstamp,tstamp);
+	*ptr = itf->packets[itf->read].data;
+	*len = itf->packets[itf->read].len;
+
+	return 1;
+}
+
+int rtdal_itflfq_pop(r_itf_t obj, void **ptr, int *len, int tstamp) {
+	cast(obj,itf);
+	int n;
+
+	if (!(n = rtdal_itflfq_peek(obj, ptr, len, tstamp))) {
+		itf_stats_empty(&itf->parent);
+	}
+	return n;
+}
+
+/**
+ * Requests up to max consecutive buffers. They must be pushed in the same order.
+ */
+int rtdal_itflfq_request_n(r_itf_t obj, void **ptr, int max) {
+	cast(obj,itf);
+	int n, idx;
+
+	if ((n = rtdal_itflfq_request(obj, &ptr[0])) != 1) {
+		return n;
+	}
+	idx = itf->write;
+	for (n=1;n<max;n++) {
+		idx = lfq_next(itf,idx);
+		if (lfq_next(itf,idx) == itf->read_cache) {
+			itf->read_cache = __atomic_load_n(&itf->read, __ATOMIC_ACQUIRE);
+			if (lfq_next(itf,idx) == itf->read_cache) {
+				break;
+			}
+		}
+		ptr[n] = itf->packets[idx].data;
+		memset(itf->packets[idx].meta,0,RTDAL_PKT_META_SZ);
+	}
+	return n;
+}
+
+/**
+ * Sets the function called with the data of each stale packet that pop() drops, for queues whose
+ * packets hold resources, like the references of rtdal_itfrefq.
+ */
+int rtdal_itflfq_set_drop(r_itf_t obj, void (*drop)(void *data)) {
+	cast(obj,itf);
+	itf->drop = drop;
+	return 0;
+}
+
+/**
+ * Pops up to max pending packets. Waits for the first one like rtdal_itflfq_pop(). They must
+ * be released in the same order.
+ */
+int rtdal_itflfq_pop_n(r_itf_t obj, void **ptr, int *len, int max, int tstamp) {
+	cast(obj,itf);
+	int n, idx;
+
+	if ((n = rtdal_itflfq_pop(obj, &ptr[0], &len[0], tstamp)) != 1) {
+		return n;
+	}
+#ifdef USE_SYSTEM_TSTAMP
+	tstamp=rtdal_time_slot();
+#endif
+	idx = itf->read;
+	for (n=1;n<max;n++) {
+		idx = lfq_next(itf,idx);
+		if (idx == itf->write_cache) {
+			itf->write_cache = __atomic_load_n(&itf->write, __ATOMIC_ACQUIRE);
+			if (idx == itf->write_cache) {
+				break;
+			}
+		}
+		if (itf->parent.delay >= 0 && itf->packets[idx].tstamp > tstamp) {
+			break;
+		}
+		ptr[n] = itf->packets[idx].data;
+		len[n] = itf->packets[idx].len;
+	}
+	return n;
+}
+
+int rtdal_itflfq_release(r_itf_t obj, void *ptr, int len) {
+	cast(obj,itf);
+
+	itf_stats_rx(&itf->parent, itf->packets[itf->read].tstamp-itf->parent.delay,
+			itf->packets[itf->read].tx_ns);
+	/* the producer may reuse the slot once it observes the new read index */
+	__atomic_store_n(&itf->read, lfq_next(itf,itf->read), __ATOMIC_RELEASE);
+	qdebug("read=%d, write=%d\n",itf->read,itf->write_cache);
+
+	if (itf->parent.delay == RTDAL_ITF_BLOCKING) {
+		ring_buff_binary_sem_give(itf->sem_w);
+	} else if (itf->parent.delay < 0) {
+		itf_wait_signal(&itf->wait_w);
+	}
+	dataflow_notify(itf->parent.producer);
+
+	return 1;
+}
+
+void *rtdal_itflfq_meta(r_itf_t obj, void *ptr) {
+	RTDAL_ASSERT_PARAM_P(obj);
+	RTDAL_ASSERT_PARAM_P(ptr);
+	rtdal_itflfq_t *itf = (rtdal_itflfq_t*) obj;
+	int idx = ((char*) ptr-itf->data)/itf->max_msg_sz;
+	if (idx < 0 || idx >= itf->max_msg) {
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		return NULL;
+	}
+	return itf->packets[idx].meta;
+}
+
+int rtdal_itflfq_set_delay(r_itf_t obj, int delay) {
+	aerror("Not yet implemented");
+	return -1;
+}
+
+int rtdal_itflfq_get_delay(r_itf_t obj) {
+	cast(obj,itf);
+	return itf->parent.delay;
+}
+
+int rtdal_itflfq_set_callback(r_itf_t obj, void (*fnc)(void), int prio) {
+	aerror("Not yet implemented");
+	return -1;
+}
+
+int rtdal_itflfq_set_blocking(r_itf_t obj, int block) {
+	aerror("Not yet implemented");
+	return -1;
+}
+
+int rtdal_itflfq_get_blocking(r_itf_t obj) {
+	aerror("Not yet implemented");
+	return -1;
+}
+
+int rtdal_itflfq_send(r_itf_t obj, void* buffer, int len, int tstamp) {
+	cast(obj,itf);
+	RTDAL_ASSERT_PARAM(buffer);
+	RTDAL_ASSERT_PARAM(len>=0);
+
+	int n;
+	void *ptr;
+
+	if (len > itf->max_msg_sz) {
+		RTDAL_SETERROR(RTDAL_ERROR_LARGE);
+		return -1;
+	}
+
+	if ((n = rtdal_itflfq_request(obj, &ptr)) != 1) {
+		return n;
+	}
+
+	memcpy(ptr, buffer, (size_t) len);
+
+	return rtdal_itflfq_push(obj,ptr,len,tstamp);
+}
+
+int rtdal_itflfq_recv(r_itf_t obj, void* buffer, int len, int tstamp) {
+	RTDAL_ASSERT_PARAM(buffer);
+	RTDAL_ASSERT_PARAM(len>=0);
+
+	int n, plen;
+	void *ptr=NULL;
+
+	if ((n = rtdal_itflfq_pop(obj, &ptr, &plen, tstamp)) < 1) {
+		return n;
+	}
+
+	if (plen > len) {
+		plen = len;
+	}
+
+	memcpy(buffer, ptr, (size_t) plen);
+
+	if ((n = rtdal_itflfq_release(obj,NULL,0)) != 1) {
+		printf("Caution packet could not be released (%d)\n",n);
+	}
+	return plen;
+}
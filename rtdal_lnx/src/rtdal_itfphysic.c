@@ -16,76 +16,264 @@
  * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdio.h>
 #include <stddef.h>
+#include <string.h>
 #include "rtdal_itf.h"
 #include "rtdal_itfphysic.h"
+#include "rtdal_itfphysic_shm.h"
+#include "rtdal_itfphysic_net.h"
+#include "rtdal_error.h"
 #include "rtdal.h"
 #include "defs.h"
 #include "str.h"
 
+#define cast(a,b) RTDAL_ASSERT_PARAM(a);\
+			rtdal_itfphysic_t *b = (rtdal_itfphysic_t*) a;
+
+#define assert_connected(itf) if (!(itf)->connected) { \
+			RTDAL_SETERROR(RTDAL_ERROR_NOTREADY); return -1; }
+
+/**
+ * Sets the address of the interface. The kind of interface is given by the prefix: "shm://"
+ * for shared memory, "tcp://" or "udp://" for sockets. The parent name, id, mode, delay and the
+ * max_msg, msg_sz and batch attributes must be set before calling this function.
+ */
 int rtdal_itfphysic_create(r_itf_t obj, string address) {
-	aerror("Not yet implemented");
-	return -1;
+	cast(obj,itf);
+	RTDAL_ASSERT_PARAM(address);
+
+	if (!strncmp(address,"shm://",strlen("shm://"))) {
+		itf->kind = PHYSIC_SHM;
+		itf->parent.delay = 0;
+	} else if (!strncmp(address,"tcp://",strlen("tcp://"))) {
+		itf->kind = PHYSIC_TCP;
+	} else if (!strncmp(address,"udp://",strlen("udp://"))) {
+		itf->kind = PHYSIC_UDP;
+	} else {
+		aerror_msg("Unsupported address %s\n",address);
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		return -1;
+	}
+	if (itf->max_msg <= 0 || itf->msg_sz <= 0) {
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		return -1;
+	}
+	snprintf(itf->address,LSTR_LEN,"%s",address);
+	itf->parent.type = ITF_EXTERNAL;
+	itf->connected = 0;
+	return 0;
 }
 
 int rtdal_itfphysic_reset(r_itf_t obj) {
-	aerror("Not yet implemented");
-	return -1;
+	cast(obj,itf);
+	assert_connected(itf);
+	switch(itf->kind) {
+	case PHYSIC_SHM:
+		return physic_shm_reset(itf);
+	case PHYSIC_TCP:
+	case PHYSIC_UDP:
+		return physic_net_reset(itf);
+	default:
+		return -1;
+	}
 }
 
 int rtdal_itfphysic_connect(r_itf_t obj) {
-	aerror("Not yet implemented");
-	return -1;
+	cast(obj,itf);
+	if (itf->connected) {
+		return 0;
+	}
+	switch(itf->kind) {
+	case PHYSIC_SHM:
+		return physic_shm_connect(itf);
+	case PHYSIC_TCP:
+	case PHYSIC_UDP:
+		return physic_net_connect(itf);
+	default:
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		return -1;
+	}
 }
 
 int rtdal_itfphysic_disconnect(r_itf_t obj) {
-	aerror("Not yet implemented");
-	return -1;
+	cast(obj,itf);
+	if (!itf->connected) {
+		return 0;
+	}
+	switch(itf->kind) {
+	case PHYSIC_SHM:
+		return physic_shm_disconnect(itf);
+	case PHYSIC_TCP:
+	case PHYSIC_UDP:
+		return physic_net_disconnect(itf);
+	default:
+		return -1;
+	}
 }
 
+/**
+ * Physical interfaces are owned by the rtdal and are removed when the node finishes. Modules
+ * closing their interfaces do not remove them.
+ */
 int rtdal_itfphysic_remove(r_itf_t obj) {
-	aerror("Not yet implemented");
-	return -1;
+	return 0;
 }
 
 int rtdal_itfphysic_recv(r_itf_t obj, void* buffer, int len, int tstamp) {
-	aerror("Not yet implemented");
-	return -1;
+	RTDAL_ASSERT_PARAM(buffer);
+	RTDAL_ASSERT_PARAM(len>=0);
+
+	int n, plen;
+	void *ptr=NULL;
+
+	if ((n = rtdal_itfphysic_pop(obj, &ptr, &plen, tstamp)) < 1) {
+		return n;
+	}
+
+	if (plen > len) {
+		plen = len;
+	}
+
+	memcpy(buffer, ptr, (size_t) plen);
+
+	if ((n = rtdal_itfphysic_release(obj,NULL,0)) != 1) {
+		printf("Caution packet could not be released (%d)\n",n);
+	}
+	return plen;
 }
 
 int rtdal_itfphysic_send(r_itf_t obj, void* buffer, int len, int tstamp) {
-	aerror("Not yet implemented");
-	return -1;
+	cast(obj,itf);
+	RTDAL_ASSERT_PARAM(buffer);
+	RTDAL_ASSERT_PARAM(len>=0);
+
+	int n;
+	void *ptr;
+
+	if (len > itf->msg_sz) {
+		RTDAL_SETERROR(RTDAL_ERROR_LARGE);
+		return -1;
+	}
+
+	if ((n = rtdal_itfphysic_request(obj, &ptr)) != 1) {
+		return n;
+	}
+
+	memcpy(ptr, buffer, (size_t) len);
+
+	return rtdal_itfphysic_push(obj,ptr,len,tstamp);
 }
 
 int rtdal_itfphysic_set_blocking(r_itf_t obj, int block) {
-	aerror("Not yet implemented");
-	return -1;
+	cast(obj,itf);
+	itf->parent.is_blocking = block;
+	return 0;
 }
 
 int rtdal_itfphysic_get_blocking(r_itf_t obj) {
-	aerror("Not yet implemented");
-	return -1;
+	cast(obj,itf);
+	return itf->parent.is_blocking;
 }
 
 int rtdal_itfphysic_request(r_itf_t obj, void **ptr) {
-	aerror("Not yet implemented");
-	return -1;
+	cast(obj,itf);
+	RTDAL_ASSERT_PARAM(ptr);
+	assert_connected(itf);
+	*ptr = NULL;
+	switch(itf->kind) {
+	case PHYSIC_SHM:
+		return physic_shm_request(itf,ptr);
+	case PHYSIC_TCP:
+	case PHYSIC_UDP:
+		return physic_net_request(itf,ptr);
+	default:
+		return -1;
+	}
 }
 
 int rtdal_itfphysic_release(r_itf_t obj, void *ptr, int len) {
-	aerror("Not yet implemented");
-	return -1;
+	cast(obj,itf);
+	assert_connected(itf);
+	switch(itf->kind) {
+	case PHYSIC_SHM:
+		return physic_shm_release(itf,ptr,len);
+	case PHYSIC_TCP:
+	case PHYSIC_UDP:
+		return physic_net_release(itf,ptr,len);
+	default:
+		return -1;
+	}
+}
+
+void *rtdal_itfphysic_meta(r_itf_t obj, void *ptr) {
+	RTDAL_ASSERT_PARAM_P(obj);
+	RTDAL_ASSERT_PARAM_P(ptr);
+	rtdal_itfphysic_t *itf = (rtdal_itfphysic_t*) obj;
+	switch(itf->kind) {
+	case PHYSIC_SHM:
+		return physic_shm_meta(itf,ptr);
+	case PHYSIC_TCP:
+	case PHYSIC_UDP:
+		return physic_net_meta(itf,ptr);
+	default:
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		return NULL;
+	}
+}
+
+/* external interfaces do not notify the best-effort worker pool, so they are always ready */
+int rtdal_itfphysic_ready(r_itf_t obj, int is_input) {
+	RTDAL_ASSERT_PARAM(obj);
+	return 1;
+}
+
+/**
+ * Sends the packets that network interfaces with batch>1 hold waiting for the batch to complete.
+ * Only the interfaces pushed from the calling thread are flushed. It is called after running each
+ * module, so a module never leaves packets pending for a later slot.
+ */
+void rtdal_itfphysic_flush() {
+	physic_net_flush_pending();
 }
 
 int rtdal_itfphysic_push(r_itf_t obj, void *ptr, int len, int tstamp) {
-	aerror("Not yet implemented");
-	return -1;
+	cast(obj,itf);
+	assert_connected(itf);
+	switch(itf->kind) {
+	case PHYSIC_SHM:
+		return physic_shm_push(itf,ptr,len,tstamp);
+	case PHYSIC_TCP:
+	case PHYSIC_UDP:
+		return physic_net_push(itf,ptr,len,tstamp);
+	default:
+		return -1;
+	}
 }
 
 int rtdal_itfphysic_pop(r_itf_t obj, void **ptr, int *len, int tstamp) {
-	aerror("Not yet implemented");
-	return -1;
+	cast(obj,itf);
+	RTDAL_ASSERT_PARAM(ptr);
+	RTDAL_ASSERT_PARAM(len);
+	assert_connected(itf);
+	*ptr = NULL;
+	*len = 0;
+	switch(itf->kind) {
+	case PHYSIC_SHM:
+		return physic_shm_pop(itf,ptr,len,tstamp);
+	case PHYSIC_TCP:
+	case PHYSIC_UDP:
+		return physic_net_pop(itf,ptr,len,tstamp);
+	default:
+		return -1;
+	}
+}
+
+/**
+ * Physical interfaces keep no statistics, so it is the same as rtdal_itfphysic_pop()
+ */
+int rtdal_itfphysic_peek(r_itf_t obj, void **ptr, int *len, int tstamp) {
+	return rtdal_itfphysic_pop(obj,ptr,len,tstamp);
 }
 
 int rtdal_itfphysic_set_callback(r_itf_t obj, void (*fnc)(void), int prio) {
@@ -93,12 +281,21 @@ int rtdal_itfphysic_set_callback(r_itf_t obj, void (*fnc)(void), int prio) {
 	return -1;
 }
 
+/**
+ * Sets the delay, in time slots, of the packets received from a network interface. Shared memory
+ * interfaces do not delay packets.
+ */
 int rtdal_itfphysic_set_delay(r_itf_t obj, int delay) {
-	aerror("Not yet implemented");
-	return -1;
+	cast(obj,itf);
+	if (itf->kind == PHYSIC_SHM) {
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		return -1;
+	}
+	itf->parent.delay = delay;
+	return 0;
 }
 
 int rtdal_itfphysic_get_delay(r_itf_t obj) {
-	return -1;//rtdal_itf_get_delay__(obj);
+	cast(obj,itf);
+	return itf->parent.delay;
 }
-
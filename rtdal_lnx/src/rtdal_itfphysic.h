@@ -19,15 +19,22 @@
 #ifndef rtdal_ITFPHYSIC_H
 #define rtdal_ITFPHYSIC_H
 
+#include <netinet/in.h>
 #include "str.h"
 #include "rtdal_itf.h"
 #include "rtdal.h"
 
 
 /**
- * In linux, physical interfaces are TCP/IP Ethernet interfaces. They inherit from the Interface abstract class. Supported protocols are TCP and UDP. Modes can be IN, which creates an input socket and accepts the connection in TCP; or OUT, which creates the output socket.
+ * In linux, physical interfaces are TCP/IP Ethernet interfaces or shared memory rings between
+ * processes of the same host. They inherit from the Interface abstract class. The kind of
+ * interface is given by the address: "shm://name" for shared memory, "tcp://host:port" or
+ * "udp://host:port" for sockets. Modes can be IN, which binds the input socket to the port and
+ * accepts the connection in TCP; or OUT, which creates the output socket to host:port.
  */
 
+enum physic_kind {PHYSIC_NONE, PHYSIC_SHM, PHYSIC_TCP, PHYSIC_UDP};
+
 typedef struct {
 	rtdal_itf_t parent;
 	int sock_fd;
@@ -35,6 +42,38 @@ typedef struct {
 	int is_tcp;
 	int connected;
 	int id;
+
+	enum physic_kind kind;
+	lstrdef(address);
+	int max_msg;
+	int msg_sz;
+
+	/* shared memory ring */
+	void *shm;
+	int shm_sz;
+	int shm_slots;
+	int shm_slot_sz;
+	int shm_created;
+	int read_cache;
+	int write_cache;
+
+	/* network socket */
+	struct sockaddr_in net_addr;
+	int batch;
+	char *tx_buf;
+	int tx_count;
+	int tx_pending;
+	int tx_tstamp;
+	unsigned int tx_seq;
+	char *rx_buf;
+	int rx_sz;
+	int rx_read;
+	int rx_write;
+	unsigned int rx_seq;
+	int rx_synced;
+	int tstamp_offset;
+	int offset_valid;
+	long lost;
 }rtdal_itfphysic_t;
 
 int rtdal_itfphysic_create(r_itf_t obj, string address);
@@ -44,6 +83,7 @@ int rtdal_itfphysic_request(r_itf_t obj, void **ptr);
 int rtdal_itfphysic_release(r_itf_t obj, void *ptr, int len);
 int rtdal_itfphysic_push(r_itf_t obj, void *ptr, int len, int tstamp);
 int rtdal_itfphysic_pop(r_itf_t obj, void **ptr, int *len, int tstamp);
+int rtdal_itfphysic_peek(r_itf_t obj, void **ptr, int *len, int tstamp);
 int rtdal_itfphysic_send(r_itf_t obj, void* buffer, int len, int tstamp);
 int rtdal_itfphysic_recv(r_itf_t obj, void* buffer, int len, int tstamp);
 int rtdal_itfphysic_set_callback(r_itf_t obj, void (*fnc)(void), int prio);
@@ -51,6 +91,9 @@ int rtdal_itfphysic_set_blocking(r_itf_t obj, int block);
 int rtdal_itfphysic_get_blocking(r_itf_t obj);
 int rtdal_itfphysic_set_delay(r_itf_t obj, int delay);
 int rtdal_itfphysic_get_delay(r_itf_t obj);
+void *rtdal_itfphysic_meta(r_itf_t obj, void *ptr);
+int rtdal_itfphysic_ready(r_itf_t obj, int is_input);
+void rtdal_itfphysic_flush();
 
 
 #endif
@@ -0,0 +1,604 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "rtdal.h"
+#include "rtdal_error.h"
+#include "rtdal_itfphysic.h"
+#include "rtdal_itfphysic_net.h"
+#include "defs.h"
+#include "str.h"
+
+#define USE_SYSTEM_TSTAMP
+
+/**
+ * Network physical interface. Packets are sent to "tcp://host:port" or "udp://host:port" with a
+ * net_pkt_t header (16 bytes plus the RTDAL_PKT_META_SZ bytes of packet metadata) carrying a
+ * sequence number, the length, the time slot of the sender and the metadata.
+ *
+ * Up to batch packets pushed by a module in one execution are sent in a single system call:
+ * sendmmsg() with one datagram per packet in UDP and a gather sendmsg() in TCP. A batch that is
+ * not complete when the module returns is sent by rtdal_itfphysic_flush(), which the pipelines and
+ * the dataflow workers call after running each module, so batch>1 does not delay packets to a
+ * later slot. The receiver reads all the available packets with recvmmsg() (UDP) or a single
+ * recv() into a stream buffer (TCP) and returns them in place.
+ *
+ * Headers are kept in network byte order in the buffers. In UDP, datagrams arriving out of
+ * order are discarded and gaps in the sequence numbers are counted as lost packets.
+ *
+ * The time slot counters of the two nodes are not aligned. With delay>=0, the receiver maps the
+ * sender slot to its own with the minimum offset observed and holds each packet until delay
+ * slots after that, as the internal queues do. With delay<0 packets are returned as they arrive.
+ *
+ * TCP connections are established when the interface is first used: the IN side accepts and the
+ * OUT side connects, retrying in blocking mode until the remote node is up.
+ */
+
+#define NET_MAGIC		0x414c4f4e
+#define NET_MAX_BATCH	64
+#define NET_ALIGN		16
+#define NET_RETRY_US	100000
+#define NET_MAX_PENDING	32
+
+typedef struct {
+	uint32_t magic;
+	uint32_t seq;
+	int32_t len;
+	int32_t tstamp;
+	char meta[RTDAL_PKT_META_SZ];	/* in the byte order of the host */
+} net_pkt_t;
+
+#define net_align(x) (((x)+NET_ALIGN-1) & ~(NET_ALIGN-1))
+#define net_slot_sz(itf) ((int) sizeof(net_pkt_t)+net_align((itf)->msg_sz))
+#define net_tx_pkt(itf,idx) ((net_pkt_t*) ((itf)->tx_buf + (idx)*net_slot_sz(itf)))
+#define net_rx_pkt(itf,idx) ((net_pkt_t*) ((itf)->rx_buf + (idx)*net_slot_sz(itf)))
+#define net_frame_sz(len) ((int) sizeof(net_pkt_t)+net_align(len))
+
+/* output interfaces with an incomplete batch pushed from this thread */
+static __thread rtdal_itfphysic_t *net_pending[NET_MAX_PENDING];
+static __thread int net_nof_pending;
+
+static int net_parse_address(rtdal_itfphysic_t *itf) {
+	char host[STR_LEN];
+	char *port;
+	struct addrinfo hints, *res;
+
+	strncpy(host, strstr(itf->address,"://")+3, STR_LEN-1);
+	host[STR_LEN-1] = '\0';
+	port = strrchr(host, ':');
+	if (!port || atoi(port+1) <= 0) {
+		aerror_msg("Interface %s: missing port in address %s\n",itf->parent.name,itf->address);
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		return -1;
+	}
+	*port++ = '\0';
+
+	memset(&itf->net_addr, 0, sizeof(struct sockaddr_in));
+	itf->net_addr.sin_family = AF_INET;
+	itf->net_addr.sin_port = htons((uint16_t) atoi(port));
+	if (host[0] == '\0' || !strcmp(host,"*")) {
+		itf->net_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+		return 0;
+	}
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	if (getaddrinfo(host, NULL, &hints, &res) || !res) {
+		aerror_msg("Interface %s: unknown host %s\n",itf->parent.name,host);
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		return -1;
+	}
+	itf->net_addr.sin_addr = ((struct sockaddr_in*) res->ai_addr)->sin_addr;
+	freeaddrinfo(res);
+	return 0;
+}
+
+int physic_net_connect(rtdal_itfphysic_t *itf) {
+	int opt = 1;
+
+	if (net_parse_address(itf)) {
+		return -1;
+	}
+	itf->is_tcp = (itf->kind == PHYSIC_TCP);
+	if (itf->batch <= 0) {
+		itf->batch = 1;
+	} else if (itf->batch > NET_MAX_BATCH) {
+		itf->batch = NET_MAX_BATCH;
+	}
+	itf->sock_fd = -1;
+	itf->conn_fd = -1;
+
+	if (itf->parent.mode_is_input) {
+		itf->rx_sz = itf->max_msg*net_slot_sz(itf);
+		itf->rx_buf = malloc((size_t) itf->rx_sz);
+		if (!itf->rx_buf) {
+			RTDAL_SYSERROR("malloc");
+			return -1;
+		}
+		itf->sock_fd = socket(AF_INET, itf->is_tcp?SOCK_STREAM:SOCK_DGRAM, 0);
+		if (itf->sock_fd < 0) {
+			RTDAL_SYSERROR("socket");
+			goto error;
+		}
+		setsockopt(itf->sock_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+		if (bind(itf->sock_fd, (struct sockaddr*) &itf->net_addr, sizeof(struct sockaddr_in))) {
+			RTDAL_SYSERROR("bind");
+			goto error;
+		}
+		if (itf->is_tcp) {
+			if (listen(itf->sock_fd, 1)) {
+				RTDAL_SYSERROR("listen");
+				goto error;
+			}
+			if (!itf->parent.is_blocking) {
+				fcntl(itf->sock_fd, F_SETFL, fcntl(itf->sock_fd, F_GETFL) | O_NONBLOCK);
+			}
+		} else {
+			itf->conn_fd = itf->sock_fd;
+		}
+	} else {
+		itf->tx_buf = malloc((size_t) itf->batch*net_slot_sz(itf));
+		if (!itf->tx_buf) {
+			RTDAL_SYSERROR("malloc");
+			return -1;
+		}
+		if (!itf->is_tcp) {
+			itf->sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
+			if (itf->sock_fd < 0) {
+				RTDAL_SYSERROR("socket");
+				goto error;
+			}
+			if (connect(itf->sock_fd, (struct sockaddr*) &itf->net_addr,
+					sizeof(struct sockaddr_in))) {
+				RTDAL_SYSERROR("connect");
+				goto error;
+			}
+			itf->conn_fd = itf->sock_fd;
+		}
+	}
+	physic_net_reset(itf);
+	itf->tx_seq = 0;
+	itf->lost = 0;
+	itf->connected = 1;
+	return 0;
+
+error:
+	physic_net_disconnect(itf);
+	return -1;
+}
+
+int physic_net_disconnect(rtdal_itfphysic_t *itf) {
+	if (itf->conn_fd >= 0 && itf->conn_fd != itf->sock_fd) {
+		close(itf->conn_fd);
+	}
+	if (itf->sock_fd >= 0) {
+		close(itf->sock_fd);
+	}
+	itf->conn_fd = -1;
+	itf->sock_fd = -1;
+	if (itf->lost) {
+		aerror_msg("Interface %s: %ld packets lost\n",itf->parent.name,itf->lost);
+	}
+	if (itf->tx_buf) {
+		free(itf->tx_buf);
+		itf->tx_buf = NULL;
+	}
+	itf->tx_count = 0;
+	if (itf->rx_buf) {
+		free(itf->rx_buf);
+		itf->rx_buf = NULL;
+	}
+	itf->connected = 0;
+	return 0;
+}
+
+int physic_net_reset(rtdal_itfphysic_t *itf) {
+	itf->tx_count = 0;
+	itf->rx_read = 0;
+	itf->rx_write = 0;
+	itf->rx_synced = 0;
+	itf->offset_valid = 0;
+	return 0;
+}
+
+/* closes a broken TCP connection. The next operation establishes it again */
+static void net_drop_connection(rtdal_itfphysic_t *itf) {
+	aerror_msg("Interface %s: connection closed\n",itf->parent.name);
+	close(itf->conn_fd);
+	itf->conn_fd = -1;
+	itf->tx_count = 0;
+	itf->rx_read = 0;
+	itf->rx_write = 0;
+}
+
+/* returns 1 if the TCP connection is established, 0 if not yet or -1 on error */
+static int net_establish(rtdal_itfphysic_t *itf) {
+	int fd, opt = 1;
+
+	if (itf->conn_fd >= 0) {
+		return 1;
+	}
+	if (itf->parent.mode_is_input) {
+		fd = accept(itf->sock_fd, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+				return 0;
+			}
+			RTDAL_SYSERROR("accept");
+			return -1;
+		}
+	} else {
+		while(1) {
+			fd = socket(AF_INET, SOCK_STREAM, 0);
+			if (fd < 0) {
+				RTDAL_SYSERROR("socket");
+				return -1;
+			}
+			if (!connect(fd, (struct sockaddr*) &itf->net_addr, sizeof(struct sockaddr_in))) {
+				break;
+			}
+			close(fd);
+			if (errno != ECONNREFUSED && errno != EINTR && errno != ETIMEDOUT) {
+				RTDAL_SYSERROR("connect");
+				return -1;
+			}
+			if (!itf->parent.is_blocking) {
+				return 0;
+			}
+			usleep(NET_RETRY_US);
+		}
+	}
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+	itf->conn_fd = fd;
+	return 1;
+}
+
+static int net_flush_udp(rtdal_itfphysic_t *itf) {
+	struct mmsghdr msgs[NET_MAX_BATCH];
+	struct iovec iov[NET_MAX_BATCH];
+	int i, n, sent;
+
+	memset(msgs, 0, sizeof(struct mmsghdr)*itf->tx_count);
+	for (i=0;i<itf->tx_count;i++) {
+		iov[i].iov_base = net_tx_pkt(itf,i);
+		iov[i].iov_len = sizeof(net_pkt_t)+ntohl(net_tx_pkt(itf,i)->len);
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+	sent = 0;
+	while (sent < itf->tx_count) {
+		n = sendmmsg(itf->conn_fd, &msgs[sent], (unsigned int) (itf->tx_count-sent),
+				MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			/* nobody is listening yet: the datagrams are lost */
+			if (errno == ECONNREFUSED) {
+				break;
+			}
+			RTDAL_SYSERROR("sendmmsg");
+			itf->tx_count = 0;
+			return -1;
+		}
+		sent += n;
+	}
+	itf->tx_count = 0;
+	return 1;
+}
+
+static int net_flush_tcp(rtdal_itfphysic_t *itf) {
+	struct msghdr msg;
+	struct iovec iov[NET_MAX_BATCH];
+	int i;
+	ssize_t n;
+
+	memset(&msg, 0, sizeof(struct msghdr));
+	for (i=0;i<itf->tx_count;i++) {
+		iov[i].iov_base = net_tx_pkt(itf,i);
+		iov[i].iov_len = (size_t) net_frame_sz(ntohl(net_tx_pkt(itf,i)->len));
+	}
+	msg.msg_iov = iov;
+	msg.msg_iovlen = (size_t) itf->tx_count;
+	while (msg.msg_iovlen) {
+		n = sendmsg(itf->conn_fd, &msg, MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EPIPE || errno == ECONNRESET) {
+				net_drop_connection(itf);
+				return 1;
+			}
+			RTDAL_SYSERROR("sendmsg");
+			itf->tx_count = 0;
+			return -1;
+		}
+		/* partial write: skip the bytes already sent */
+		while (msg.msg_iovlen && (size_t) n >= msg.msg_iov->iov_len) {
+			n -= msg.msg_iov->iov_len;
+			msg.msg_iov++;
+			msg.msg_iovlen--;
+		}
+		if (msg.msg_iovlen) {
+			msg.msg_iov->iov_base = (char*) msg.msg_iov->iov_base + n;
+			msg.msg_iov->iov_len -= (size_t) n;
+		}
+	}
+	itf->tx_count = 0;
+	return 1;
+}
+
+static int net_flush(rtdal_itfphysic_t *itf) {
+	if (!itf->tx_count) {
+		return 1;
+	}
+	if (itf->is_tcp) {
+		return net_flush_tcp(itf);
+	} else {
+		return net_flush_udp(itf);
+	}
+}
+
+int physic_net_request(rtdal_itfphysic_t *itf, void **ptr) {
+	int n;
+
+	if (itf->is_tcp && (n = net_establish(itf)) != 1) {
+		if (!n) {
+			RTDAL_SETERROR(RTDAL_ERROR_NOTREADY);
+		}
+		return n;
+	}
+	if (itf->tx_count == itf->batch
+			|| (itf->tx_count && itf->tx_tstamp != rtdal_time_slot())) {
+		if ((n = net_flush(itf)) != 1) {
+			return n;
+		}
+	}
+	*ptr = net_tx_pkt(itf,itf->tx_count)+1;
+	memset(net_tx_pkt(itf,itf->tx_count)->meta,0,RTDAL_PKT_META_SZ);
+	return 1;
+}
+
+int physic_net_push(rtdal_itfphysic_t *itf, void *ptr, int len, int tstamp) {
+	net_pkt_t *pkt;
+
+	if (!len) {
+		return 1;
+	}
+	if (len > itf->msg_sz) {
+		RTDAL_SETERROR(RTDAL_ERROR_LARGE);
+		return -1;
+	}
+	if (itf->is_tcp && itf->conn_fd < 0) {
+		/* the connection was dropped after the request */
+		return 1;
+	}
+
+#ifdef USE_SYSTEM_TSTAMP
+	tstamp=rtdal_time_slot();
+#endif
+
+	pkt = net_tx_pkt(itf,itf->tx_count);
+	pkt->magic = htonl(NET_MAGIC);
+	pkt->seq = htonl(itf->tx_seq++);
+	pkt->len = (int32_t) htonl((uint32_t) len);
+	pkt->tstamp = (int32_t) htonl((uint32_t) tstamp);
+	itf->tx_tstamp = tstamp;
+	itf->tx_count++;
+
+	if (itf->tx_count == itf->batch) {
+		return net_flush(itf);
+	}
+	if (!itf->tx_pending) {
+		if (net_nof_pending == NET_MAX_PENDING) {
+			return net_flush(itf);
+		}
+		itf->tx_pending = 1;
+		net_pending[net_nof_pending++] = itf;
+	}
+	return 1;
+}
+
+/* sends the incomplete batches pushed from the calling thread */
+void physic_net_flush_pending() {
+	rtdal_itfphysic_t *itf;
+	while (net_nof_pending) {
+		itf = net_pending[--net_nof_pending];
+		itf->tx_pending = 0;
+		if (itf->connected && (!itf->is_tcp || itf->conn_fd >= 0)) {
+			net_flush(itf);
+		}
+	}
+}
+
+/* receives all the available datagrams into the rx slots and checks their sequence numbers */
+static int net_fill_udp(rtdal_itfphysic_t *itf) {
+	struct mmsghdr msgs[NET_MAX_BATCH];
+	struct iovec iov[NET_MAX_BATCH];
+	net_pkt_t *pkt;
+	int i, n, nof_msg;
+	uint32_t seq;
+
+	nof_msg = itf->max_msg<NET_MAX_BATCH?itf->max_msg:NET_MAX_BATCH;
+	memset(msgs, 0, sizeof(struct mmsghdr)*nof_msg);
+	for (i=0;i<nof_msg;i++) {
+		iov[i].iov_base = net_rx_pkt(itf,i);
+		iov[i].iov_len = (size_t) net_slot_sz(itf);
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+	n = recvmmsg(itf->conn_fd, msgs, (unsigned int) nof_msg,
+			itf->parent.is_blocking?MSG_WAITFORONE:MSG_DONTWAIT, NULL);
+	if (n < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+			return 0;
+		}
+		RTDAL_SYSERROR("recvmmsg");
+		return -1;
+	}
+	/* invalid, late or duplicated datagrams are marked with a null magic */
+	for (i=0;i<n;i++) {
+		pkt = net_rx_pkt(itf,i);
+		seq = ntohl(pkt->seq);
+		if (msgs[i].msg_len < sizeof(net_pkt_t) || ntohl(pkt->magic) != NET_MAGIC
+				|| msgs[i].msg_len != sizeof(net_pkt_t)+ntohl((uint32_t) pkt->len)) {
+			pkt->magic = 0;
+		} else if (!itf->rx_synced) {
+			itf->rx_seq = seq+1;
+			itf->rx_synced = 1;
+		} else if ((int) (seq - itf->rx_seq) < 0) {
+			pkt->magic = 0;
+		} else {
+			itf->lost += seq - itf->rx_seq;
+			itf->rx_seq = seq+1;
+		}
+	}
+	itf->rx_read = 0;
+	itf->rx_write = n;
+	return n>0?1:0;
+}
+
+/* reads from the TCP stream until a complete packet is buffered */
+static int net_fill_tcp(rtdal_itfphysic_t *itf) {
+	net_pkt_t *pkt;
+	ssize_t n;
+	int avail;
+
+	while(1) {
+		avail = itf->rx_write-itf->rx_read;
+		if (avail >= (int) sizeof(net_pkt_t)) {
+			pkt = (net_pkt_t*) &itf->rx_buf[itf->rx_read];
+			if (ntohl(pkt->magic) != NET_MAGIC || (int) ntohl((uint32_t) pkt->len) < 0
+					|| (int) ntohl((uint32_t) pkt->len) > itf->msg_sz) {
+				aerror_msg("Interface %s: invalid packet header\n",itf->parent.name);
+				net_drop_connection(itf);
+				return 0;
+			}
+			if (avail >= net_frame_sz(ntohl((uint32_t) pkt->len))) {
+				return 1;
+			}
+		}
+		if (itf->rx_read) {
+			memmove(itf->rx_buf, &itf->rx_buf[itf->rx_read], (size_t) avail);
+			itf->rx_read = 0;
+			itf->rx_write = avail;
+		}
+		n = recv(itf->conn_fd, &itf->rx_buf[itf->rx_write], (size_t) (itf->rx_sz-itf->rx_write),
+				itf->parent.is_blocking?0:MSG_DONTWAIT);
+		if (n < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+				return 0;
+			}
+			if (errno == ECONNRESET) {
+				net_drop_connection(itf);
+				return 0;
+			}
+			RTDAL_SYSERROR("recv");
+			return -1;
+		} else if (n == 0) {
+			net_drop_connection(itf);
+			return 0;
+		}
+		itf->rx_write += (int) n;
+	}
+	return 0;
+}
+
+/* returns the first received packet, or NULL if none is available */
+static net_pkt_t *net_rx_head(rtdal_itfphysic_t *itf, int *ret) {
+	net_pkt_t *pkt;
+
+	if (itf->is_tcp) {
+		if ((*ret = net_establish(itf)) != 1) {
+			return NULL;
+		}
+		if ((*ret = net_fill_tcp(itf)) != 1) {
+			return NULL;
+		}
+		return (net_pkt_t*) &itf->rx_buf[itf->rx_read];
+	}
+	while(1) {
+		while (itf->rx_read < itf->rx_write) {
+			pkt = net_rx_pkt(itf,itf->rx_read);
+			if (pkt->magic) {
+				return pkt;
+			}
+			itf->rx_read++;
+		}
+		if ((*ret = net_fill_udp(itf)) != 1) {
+			return NULL;
+		}
+	}
+	return NULL;
+}
+
+int physic_net_pop(rtdal_itfphysic_t *itf, void **ptr, int *len, int tstamp) {
+	net_pkt_t *pkt;
+	int n, offset, pkt_tstamp;
+
+	if (!(pkt = net_rx_head(itf, &n))) {
+		return n;
+	}
+
+	if (itf->parent.delay >= 0) {
+#ifdef USE_SYSTEM_TSTAMP
+		tstamp=rtdal_time_slot();
+#endif
+		pkt_tstamp = (int) ntohl((uint32_t) pkt->tstamp);
+		offset = tstamp - pkt_tstamp;
+		if (!itf->offset_valid || offset < itf->tstamp_offset) {
+			itf->tstamp_offset = offset;
+			itf->offset_valid = 1;
+		}
+		if (pkt_tstamp + itf->tstamp_offset + itf->parent.delay > tstamp) {
+			return 0;
+		}
+	}
+
+	*ptr = pkt+1;
+	*len = (int) ntohl((uint32_t) pkt->len);
+	return 1;
+}
+
+int physic_net_release(rtdal_itfphysic_t *itf, void *ptr, int len) {
+	net_pkt_t *pkt;
+	if (itf->is_tcp) {
+		if (itf->rx_read < itf->rx_write) {
+			pkt = (net_pkt_t*) &itf->rx_buf[itf->rx_read];
+			itf->rx_read += net_frame_sz(ntohl((uint32_t) pkt->len));
+		}
+	} else if (itf->rx_read < itf->rx_write) {
+		itf->rx_read++;
+	}
+	return 1;
+}
+
+void *physic_net_meta(rtdal_itfphysic_t *itf, void *ptr) {
+	return ((net_pkt_t*) ptr-1)->meta;
+}
@@ -0,0 +1,329 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "rtdal.h"
+#include "rtdal_error.h"
+#include "rtdal_itfphysic.h"
+#include "rtdal_itfphysic_shm.h"
+#include "futex.h"
+#include "defs.h"
+#include "str.h"
+
+/**
+ * Shared memory physical interface. The segment "/name" (from the address "shm://name") holds a
+ * single producer single consumer ring of max_msg packets of msg_sz bytes. The output side is
+ * the producer and the input side the consumer. Both sides map the same segment, and packets are
+ * written and read in place: request() and pop() return pointers to the shared memory.
+ *
+ * The sides can be started in any order. The first one creates the segment, sets the geometry
+ * in the header and then the magic number. The second one waits for the magic number and checks
+ * the geometry matches its own configuration. A segment left by a creator that died, or that did
+ * not initialize it in SHM_ATTACH_MS, is removed and created again.
+ *
+ * In blocking mode, a side that finds the ring empty (or full) sleeps on a futex on the remote
+ * index. The remote side only calls futex_wake() if the waiters counter is non-zero.
+ */
+
+#define SHM_MAGIC		0x414c4f45
+#define SHM_ATTACH_MS	1000
+
+typedef struct {
+	int magic;
+	int max_msg;
+	int msg_sz;
+	int creator_pid;
+
+	/* written by the producer only: its index and the count of producers waiting for read */
+	int write CACHE_ALIGNED;
+	int read_waiters;
+
+	/* written by the consumer only: its index and the count of consumers waiting for write */
+	int read CACHE_ALIGNED;
+	int write_waiters;
+} CACHE_ALIGNED shm_hdr_t;
+
+typedef struct {
+	int tstamp;
+	int len;
+	char meta[RTDAL_PKT_META_SZ];
+} shm_pkt_t;
+
+#define SHM_PKT_HDR		CACHE_LINE_SZ
+
+#define shm_hdr(itf) ((shm_hdr_t*) (itf)->shm)
+#define shm_pkt(itf,idx) ((shm_pkt_t*) ((char*) (itf)->shm + sizeof(shm_hdr_t) + (idx)*(itf)->shm_slot_sz))
+#define shm_next(itf,idx) ((idx)+1 >= (itf)->shm_slots ? 0 : (idx)+1)
+
+/* opens the segment, creating it if it does not exist. Returns the descriptor or -1 */
+static int shm_open_segment(rtdal_itfphysic_t *itf, char *name) {
+	int fd;
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+	if (fd >= 0) {
+		itf->shm_created = 1;
+		/* new pages are zero, which is an empty ring */
+		if (ftruncate(fd, itf->shm_sz)) {
+			RTDAL_SYSERROR("ftruncate");
+			close(fd);
+			shm_unlink(name);
+			itf->shm_created = 0;
+			return -1;
+		}
+		return fd;
+	}
+	if (errno != EEXIST) {
+		RTDAL_SYSERROR("shm_open");
+		return -1;
+	}
+	if ((fd = shm_open(name, O_RDWR, 0)) < 0) {
+		RTDAL_SYSERROR("shm_open");
+	}
+	return fd;
+}
+
+/* waits until the creator sized the segment. Returns its size or 0 on timeout */
+static int shm_wait_size(int fd) {
+	struct stat st;
+	int i;
+	for (i=0;i<SHM_ATTACH_MS;i++) {
+		if (fstat(fd, &st)) {
+			return 0;
+		}
+		if (st.st_size > 0) {
+			return (int) st.st_size;
+		}
+		usleep(1000);
+	}
+	return 0;
+}
+
+/* waits until the creator initialized the header. Returns 1 if it did */
+static int shm_wait_magic(shm_hdr_t *hdr) {
+	int i;
+	for (i=0;i<SHM_ATTACH_MS;i++) {
+		if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) == SHM_MAGIC) {
+			return 1;
+		}
+		usleep(1000);
+	}
+	return 0;
+}
+
+int physic_shm_connect(rtdal_itfphysic_t *itf) {
+	int fd, sz, stale, retry;
+	shm_hdr_t *hdr;
+	char *name = &itf->address[strlen("shm:/")];
+	int msg_sz;
+
+	/* max_msg and msg_sz are left untouched, so that a failed connect can be retried */
+	msg_sz = ((itf->msg_sz+CACHE_LINE_SZ-1)/CACHE_LINE_SZ)*CACHE_LINE_SZ;
+	/* one slot is always left empty */
+	itf->shm_slots = itf->max_msg+1;
+	itf->shm_slot_sz = SHM_PKT_HDR+msg_sz;
+	itf->shm_sz = sizeof(shm_hdr_t)+itf->shm_slots*itf->shm_slot_sz;
+
+	for (retry=0;retry<2;retry++) {
+		if ((fd = shm_open_segment(itf, name)) < 0) {
+			return -1;
+		}
+		sz = itf->shm_created?itf->shm_sz:shm_wait_size(fd);
+		if (sz < (int) sizeof(shm_hdr_t)) {
+			/* the creator died before sizing it */
+			close(fd);
+			shm_unlink(name);
+			continue;
+		}
+		itf->shm = mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if (itf->shm == MAP_FAILED) {
+			itf->shm = NULL;
+			RTDAL_SYSERROR("mmap");
+			physic_shm_disconnect(itf);
+			return -1;
+		}
+		hdr = shm_hdr(itf);
+		if (itf->shm_created) {
+			hdr->max_msg = itf->shm_slots;
+			hdr->msg_sz = msg_sz;
+			hdr->creator_pid = (int) getpid();
+			__atomic_store_n(&hdr->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+			break;
+		}
+		stale = !shm_wait_magic(hdr)
+				|| (kill((pid_t) hdr->creator_pid, 0) && errno == ESRCH);
+		if (!stale) {
+			if (hdr->max_msg != itf->shm_slots || hdr->msg_sz != msg_sz || sz != itf->shm_sz) {
+				aerror_msg("Interface %s: max_msg=%d msg_sz=%d do not match the remote side "
+						"(%d, %d)\n", itf->parent.name, itf->max_msg, msg_sz, hdr->max_msg-1,
+						hdr->msg_sz);
+				munmap(itf->shm, sz);
+				itf->shm = NULL;
+				physic_shm_disconnect(itf);
+				return -1;
+			}
+			break;
+		}
+		/* left by a creator that died, its indices are not valid */
+		munmap(itf->shm, sz);
+		itf->shm = NULL;
+		shm_unlink(name);
+	}
+	if (!itf->shm) {
+		aerror_msg("Interface %s: could not attach to the segment %s\n",itf->parent.name,name);
+		return -1;
+	}
+
+	itf->read_cache = 0;
+	itf->write_cache = 0;
+	itf->connected = 1;
+	return 0;
+}
+
+int physic_shm_disconnect(rtdal_itfphysic_t *itf) {
+	if (itf->shm) {
+		munmap(itf->shm, itf->shm_sz);
+		itf->shm = NULL;
+	}
+	if (itf->shm_created) {
+		shm_unlink(&itf->address[strlen("shm:/")]);
+		itf->shm_created = 0;
+	}
+	itf->connected = 0;
+	return 0;
+}
+
+int physic_shm_reset(rtdal_itfphysic_t *itf) {
+	shm_hdr_t *hdr = shm_hdr(itf);
+	if (itf->parent.mode_is_input) {
+		__atomic_store_n(&hdr->read, __atomic_load_n(&hdr->write, __ATOMIC_ACQUIRE),
+				__ATOMIC_RELEASE);
+	}
+	itf->read_cache = __atomic_load_n(&hdr->read, __ATOMIC_ACQUIRE);
+	itf->write_cache = __atomic_load_n(&hdr->write, __ATOMIC_ACQUIRE);
+	return 0;
+}
+
+/* sleeps until *idx is no longer equal to value */
+static void shm_wait(int *idx, int *waiters, int value) {
+	__sync_fetch_and_add(waiters, 1);
+	if (__atomic_load_n(idx, __ATOMIC_SEQ_CST) == value) {
+		futex_wait_val(idx, value);
+	}
+	__sync_fetch_and_sub(waiters, 1);
+}
+
+static void shm_wake(int *idx, int *waiters) {
+	__sync_synchronize();
+	if (*((volatile int*) waiters)) {
+		futex_wake(idx);
+	}
+}
+
+/* called by the consumer only */
+static int shm_is_empty(rtdal_itfphysic_t *itf) {
+	shm_hdr_t *hdr = shm_hdr(itf);
+	int read = hdr->read;
+	while (read == itf->write_cache) {
+		itf->write_cache = __atomic_load_n(&hdr->write, __ATOMIC_ACQUIRE);
+		if (read != itf->write_cache) {
+			break;
+		}
+		if (!itf->parent.is_blocking) {
+			return 1;
+		}
+		shm_wait(&hdr->write, &hdr->write_waiters, read);
+	}
+	return 0;
+}
+
+/* called by the producer only */
+static int shm_is_full(rtdal_itfphysic_t *itf) {
+	shm_hdr_t *hdr = shm_hdr(itf);
+	int next = shm_next(itf,hdr->write);
+	while (next == itf->read_cache) {
+		itf->read_cache = __atomic_load_n(&hdr->read, __ATOMIC_ACQUIRE);
+		if (next != itf->read_cache) {
+			break;
+		}
+		if (!itf->parent.is_blocking) {
+			return 1;
+		}
+		shm_wait(&hdr->read, &hdr->read_waiters, itf->read_cache);
+	}
+	return 0;
+}
+
+int physic_shm_request(rtdal_itfphysic_t *itf, void **ptr) {
+	if (shm_is_full(itf)) {
+		RTDAL_SETERROR(RTDAL_ERROR_NOSPACE);
+		return 0;
+	}
+	*ptr = (char*) shm_pkt(itf,shm_hdr(itf)->write)+SHM_PKT_HDR;
+	memset(shm_pkt(itf,shm_hdr(itf)->write)->meta,0,RTDAL_PKT_META_SZ);
+	return 1;
+}
+
+int physic_shm_push(rtdal_itfphysic_t *itf, void *ptr, int len, int tstamp) {
+	shm_hdr_t *hdr = shm_hdr(itf);
+	shm_pkt_t *pkt;
+
+	if (!len) {
+		return 1;
+	}
+	if (len > itf->msg_sz) {
+		RTDAL_SETERROR(RTDAL_ERROR_LARGE);
+		return -1;
+	}
+	pkt = shm_pkt(itf,hdr->write);
+	pkt->tstamp = tstamp;
+	pkt->len = len;
+	__atomic_store_n(&hdr->write, shm_next(itf,hdr->write), __ATOMIC_RELEASE);
+	shm_wake(&hdr->write, &hdr->write_waiters);
+	return 1;
+}
+
+int physic_shm_pop(rtdal_itfphysic_t *itf, void **ptr, int *len, int tstamp) {
+	shm_pkt_t *pkt;
+
+	if (shm_is_empty(itf)) {
+		return 0;
+	}
+	pkt = shm_pkt(itf,shm_hdr(itf)->read);
+	*ptr = (char*) pkt+SHM_PKT_HDR;
+	*len = pkt->len;
+	return 1;
+}
+
+int physic_shm_release(rtdal_itfphysic_t *itf, void *ptr, int len) {
+	shm_hdr_t *hdr = shm_hdr(itf);
+	__atomic_store_n(&hdr->read, shm_next(itf,hdr->read), __ATOMIC_RELEASE);
+	shm_wake(&hdr->read, &hdr->read_waiters);
+	return 1;
+}
+
+void *physic_shm_meta(rtdal_itfphysic_t *itf, void *ptr) {
+	return ((shm_pkt_t*) ((char*) ptr-SHM_PKT_HDR))->meta;
+}
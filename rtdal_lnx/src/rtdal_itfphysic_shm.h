@@ -0,0 +1,33 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef rtdal_ITFPHYSIC_SHM_H
+#define rtdal_ITFPHYSIC_SHM_H
+
+#include "rtdal_itfphysic.h"
+
+int physic_shm_connect(rtdal_itfphysic_t *itf);
+int physic_shm_disconnect(rtdal_itfphysic_t *itf);
+int physic_shm_reset(rtdal_itfphysic_t *itf);
+int physic_shm_request(rtdal_itfphysic_t *itf, void **ptr);
+int physic_shm_push(rtdal_itfphysic_t *itf, void *ptr, int len, int tstamp);
+int physic_shm_pop(rtdal_itfphysic_t *itf, void **ptr, int *len, int tstamp);
+int physic_shm_release(rtdal_itfphysic_t *itf, void *ptr, int len);
+void *physic_shm_meta(rtdal_itfphysic_t *itf, void *ptr);
+
+#endif
@@ -0,0 +1,396 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+
+#include "rtdal.h"
+#include "rtdal_error.h"
+#include "rtdal_itf.h"
+#include "rtdal_itflfq.h"
+#include "rtdal_itfrefq.h"
+#include "rtdal_itfstats.h"
+#include "rtdal_pool.h"
+#include "dataflow.h"
+#include "defs.h"
+#include "str.h"
+
+/**
+ * Queue of references to reference-counted buffers. The packets are buffers of a rtdal pool,
+ * and the queue (a rtdal_itflfq) only carries their addresses. Besides the usual
+ * request/push/pop/release functions, a buffer popped from another reference queue can be pushed
+ * with rtdal_itfrefq_push_ref(), which only adds a reference to it. This way the same buffer can
+ * be read by any number of consumers without copying it, and it returns to the pool of the
+ * interface that requested it after the last consumer releases it.
+ */
+typedef struct {
+	rtdal_itf_t parent;
+
+	int max_msg_sz;
+	r_itf_t queue;
+	r_pool_t pool;
+
+	/* written by the producer only. Buffer returned by request() and not yet pushed */
+	void *pending;
+
+	/* written by the consumer only. Buffer returned by pop() and not yet released */
+	void *popped;
+} rtdal_itfrefq_t;
+
+#define cast(a,b) RTDAL_ASSERT_PARAM(a);\
+			rtdal_itfrefq_t *b = (rtdal_itfrefq_t*) a;
+
+static int refq_id=1;
+
+/* drops the reference held by a stale packet of the inner queue */
+static void refq_drop(void *slot) {
+	rtdal_pool_unref(*((void**) slot));
+}
+
+/**
+ * Creates a reference queue of max_msg packets of up to msg_sz bytes. The pool has twice as many
+ * buffers as the queue, because buffers pushed to other queues with rtdal_itfrefq_push_ref() are
+ * still taken from this pool.
+ */
+r_itf_t rtdal_itfrefq_new(int max_msg, int msg_sz, int delay, r_log_t log) {
+	rtdal_itfrefq_t *itf;
+
+	itf = calloc(1,sizeof(rtdal_itfrefq_t));
+	if (!itf) {
+		return NULL;
+	}
+
+	itf->parent.type = ITF_INT_REFQ;
+	itf->parent.delay = delay;
+	itf->parent.log = log;
+	itf->parent.id=refq_id++;
+	itf->max_msg_sz = msg_sz;
+	itf->queue = rtdal_itflfq_new(max_msg,sizeof(void*),delay,log);
+	if (!itf->queue) {
+		free(itf);
+		return NULL;
+	}
+	rtdal_itflfq_set_drop(itf->queue, refq_drop);
+	itf->pool = rtdal_pool_new(2*max_msg,msg_sz);
+	if (!itf->pool) {
+		rtdal_itflfq_remove(itf->queue);
+		free(itf);
+		return NULL;
+	}
+
+	return (r_itf_t) itf;
+}
+
+/**
+ * Resets the queue and returns all the buffers to the pool, including those pushed to other
+ * queues, which shall be reset at the same time (e.g. all the interfaces of a waveform).
+ */
+int rtdal_itfrefq_reset(r_itf_t obj) {
+	cast(obj,itf);
+
+	itf->pending = NULL;
+	itf->popped = NULL;
+	rtdal_pool_reset(itf->pool);
+	itf_stats_reset(&((rtdal_itf_t*) itf->queue)->stats);
+	return rtdal_itflfq_reset(itf->queue);
+}
+
+/**
+ * Buffers of this interface pushed to other queues must be released before calling this
+ * function.
+ */
+int rtdal_itfrefq_remove(r_itf_t obj) {
+	cast(obj,itf);
+	if (itf->pending) {
+		rtdal_pool_unref(itf->pending);
+	}
+	if (itf->queue) {
+		rtdal_itflfq_remove(itf->queue);
+		itf->queue = NULL;
+	}
+	if (itf->pool) {
+		rtdal_pool_remove(itf->pool);
+		itf->pool = NULL;
+	}
+	itf->parent.id = 0;
+	free(itf);
+	return 0;
+}
+
+/**
+ * Moves the queue of references and the buffers of the pool to the NUMA node node
+ */
+int rtdal_itfrefq_place(r_itf_t obj, int node, int policy) {
+	cast(obj,itf);
+	if (rtdal_itflfq_place(itf->queue, node, policy)) {
+		return -1;
+	}
+	return rtdal_pool_place(itf->pool, node, policy);
+}
+
+int rtdal_itfrefq_request(r_itf_t obj, void **ptr) {
+	cast(obj,itf);
+	RTDAL_ASSERT_PARAM(ptr);
+	void *slot;
+	int n;
+
+	*ptr = NULL;
+
+	if ((n = rtdal_itflfq_request(itf->queue, &slot)) != 1) {
+		return n;
+	}
+	if (!itf->pending) {
+		itf->pending = rtdal_pool_get(itf->pool);
+		if (!itf->pending) {
+			qdebug("[nobuffer] id=%d\n",itf->parent.id);
+			itf_stats_drop(&itf->parent);
+			return 0;
+		}
+	}
+	*ptr = itf->pending;
+	return 1;
+}
+
+static int refq_push(rtdal_itfrefq_t *itf, void *ptr, int len, int tstamp) {
+	void *slot;
+	int n;
+
+	if ((n = rtdal_itflfq_request(itf->queue, &slot)) != 1) {
+		return n;
+	}
+	*((void**) slot) = ptr;
+	if ((n = rtdal_itflfq_push(itf->queue, slot, len, tstamp)) == 1) {
+		dataflow_notify(itf->parent.consumer);
+	}
+	return n;
+}
+
+int rtdal_itfrefq_push(r_itf_t obj, void *ptr, int len, int tstamp) {
+	cast(obj,itf);
+	int n;
+
+	if (!len) {
+		return 1;
+	}
+	if (len > itf->max_msg_sz) {
+		RTDAL_SETERROR(RTDAL_ERROR_LARGE);
+		return -1;
+	}
+
+	n = refq_push(itf, ptr, len, tstamp);
+	if (n == 1 && ptr == itf->pending) {
+		itf->pending = NULL;
+	}
+	return n;
+}
+
+/**
+ * Pushes a buffer popped from the reference queue src, adding a reference to it. The caller still
+ * has to release it from src.
+ */
+int rtdal_itfrefq_push_ref(r_itf_t obj, r_itf_t src, void *ptr, int len, int tstamp) {
+	cast(obj,itf);
+	RTDAL_ASSERT_PARAM(src);
+	RTDAL_ASSERT_PARAM(ptr);
+	int n;
+
+	if (src->type != ITF_INT_REFQ) {
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		return -1;
+	}
+	if (!len) {
+		return 1;
+	}
+	if (len > itf->max_msg_sz) {
+		RTDAL_SETERROR(RTDAL_ERROR_LARGE);
+		return -1;
+	}
+
+	rtdal_pool_ref(ptr);
+	n = refq_push(itf, ptr, len, tstamp);
+	if (n != 1) {
+		rtdal_pool_unref(ptr);
+	}
+	return n;
+}
+
+int rtdal_itfrefq_pop(r_itf_t obj, void **ptr, int *len, int tstamp) {
+	cast(obj,itf);
+	RTDAL_ASSERT_PARAM(ptr);
+	void *slot;
+	int n;
+
+	*ptr = NULL;
+	if ((n = rtdal_itflfq_pop(itf->queue, &slot, len, tstamp)) != 1) {
+		return n;
+	}
+	itf->popped = *((void**) slot);
+	*ptr = itf->popped;
+	return 1;
+}
+
+/**
+ * Like rtdal_itfrefq_pop() but an empty queue is not counted in the statistics
+ */
+int rtdal_itfrefq_peek(r_itf_t obj, void **ptr, int *len, int tstamp) {
+	cast(obj,itf);
+	RTDAL_ASSERT_PARAM(ptr);
+	void *slot;
+	int n;
+
+	*ptr = NULL;
+	if ((n = rtdal_itflfq_peek(itf->queue, &slot, len, tstamp)) != 1) {
+		return n;
+	}
+	*ptr = *((void**) slot);
+	return 1;
+}
+
+/**
+ * Pops up to max pending packets. They must be released in the same order, passing their address
+ * to rtdal_itfrefq_release().
+ */
+int rtdal_itfrefq_pop_n(r_itf_t obj, void **ptr, int *len, int max, int tstamp) {
+	cast(obj,itf);
+	int i, n;
+
+	n = rtdal_itflfq_pop_n(itf->queue, ptr, len, max, tstamp);
+	for (i=0;i<n;i++) {
+		ptr[i] = *((void**) ptr[i]);
+	}
+	itf->popped = n>0?ptr[0]:NULL;
+	return n;
+}
+
+int rtdal_itfrefq_release(r_itf_t obj, void *ptr, int len) {
+	cast(obj,itf);
+	int n;
+
+	if (!ptr) {
+		ptr = itf->popped;
+	}
+	if (ptr) {
+		rtdal_pool_unref(ptr);
+	}
+	itf->popped = NULL;
+	if ((n = rtdal_itflfq_release(itf->queue, ptr, len)) == 1) {
+		dataflow_notify(itf->parent.producer);
+	}
+	return n;
+}
+
+/**
+ * The packets are counted by the inner queue, this interface only counts the requests that found
+ * the pool empty.
+ */
+int rtdal_itfrefq_set_stats(r_itf_t obj, int enable) {
+	cast(obj,itf);
+	itf->parent.stats.enabled = enable;
+	return rtdal_itf_set_stats(itf->queue, enable);
+}
+
+int rtdal_itfrefq_get_stats(r_itf_t obj, rtdal_itf_stats_t *stats) {
+	cast(obj,itf);
+	if (rtdal_itf_get_stats(itf->queue, stats)) {
+		return -1;
+	}
+	stats->dropped += itf->parent.stats.dropped;
+	return 0;
+}
+
+/* the pool is not checked, a producer waiting for a free buffer polls it */
+int rtdal_itfrefq_ready(r_itf_t obj, int is_input) {
+	cast(obj,itf);
+	return rtdal_itflfq_ready(itf->queue, is_input);
+}
+
+/* the metadata lives in the pool header, so all the queues holding a buffer share it */
+void *rtdal_itfrefq_meta(r_itf_t obj, void *ptr) {
+	RTDAL_ASSERT_PARAM_P(obj);
+	return rtdal_pool_meta(ptr);
+}
+
+int rtdal_itfrefq_set_delay(r_itf_t obj, int delay) {
+	aerror("Not yet implemented");
+	return -1;
+}
+
+int rtdal_itfrefq_get_delay(r_itf_t obj) {
+	cast(obj,itf);
+	return itf->parent.delay;
+}
+
+int rtdal_itfrefq_set_callback(r_itf_t obj, void (*fnc)(void), int prio) {
+	aerror("Not yet implemented");
+	return -1;
+}
+
+int rtdal_itfrefq_set_blocking(r_itf_t obj, int block) {
+	aerror("Not yet implemented");
+	return -1;
+}
+
+int rtdal_itfrefq_get_blocking(r_itf_t obj) {
+	aerror("Not yet implemented");
+	return -1;
+}
+
+int rtdal_itfrefq_send(r_itf_t obj, void* buffer, int len, int tstamp) {
+	cast(obj,itf);
+	RTDAL_ASSERT_PARAM(buffer);
+	RTDAL_ASSERT_PARAM(len>=0);
+
+	int n;
+	void *ptr;
+
+	if (len > itf->max_msg_sz) {
+		RTDAL_SETERROR(RTDAL_ERROR_LARGE);
+		return -1;
+	}
+
+	if ((n = rtdal_itfrefq_request(obj, &ptr)) != 1) {
+		return n;
+	}
+
+	memcpy(ptr, buffer, (size_t) len);
+
+	return rtdal_itfrefq_push(obj,ptr,len,tstamp);
+}
+
+int rtdal_itfrefq_recv(r_itf_t obj, void* buffer, int len, int tstamp) {
+	RTDAL_ASSERT_PARAM(buffer);
+	RTDAL_ASSERT_PARAM(len>=0);
+
+	int n, plen;
+	void *ptr=NULL;
+
+	if ((n = rtdal_itfrefq_pop(obj, &ptr, &plen, tstamp)) < 1) {
+		return n;
+	}
+
+	if (plen > len) {
+		plen = len;
+	}
+
+	memcpy(buffer, ptr, (size_t) plen);
+
+	if ((n = rtdal_itfrefq_release(obj,NULL,0)) != 1) {
+		printf("Caution packet could not be released (%d)\n",n);
+	}
+	return plen;
+}
@@ -0,0 +1,48 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef rtdal_ITFREFQ_H
+#define rtdal_ITFREFQ_H
+
+#include "str.h"
+#include "rtdal_itf.h"
+#include "rtdal.h"
+
+
+int rtdal_itfrefq_reset(r_itf_t obj);
+int rtdal_itfrefq_remove(r_itf_t obj);
+int rtdal_itfrefq_request(r_itf_t obj, void **ptr);
+int rtdal_itfrefq_push(r_itf_t obj, void *ptr, int len, int tstamp);
+int rtdal_itfrefq_pop(r_itf_t obj, void **ptr, int *len, int tstamp);
+int rtdal_itfrefq_peek(r_itf_t obj, void **ptr, int *len, int tstamp);
+int rtdal_itfrefq_release(r_itf_t obj, void *ptr, int len);
+int rtdal_itfrefq_pop_n(r_itf_t obj, void **ptr, int *len, int max, int tstamp);
+int rtdal_itfrefq_send(r_itf_t obj, void* buffer, int len, int tstamp);
+int rtdal_itfrefq_recv(r_itf_t obj, void* buffer, int len, int tstamp);
+int rtdal_itfrefq_set_callback(r_itf_t obj, void (*fnc)(void), int prio);
+int rtdal_itfrefq_set_blocking(r_itf_t obj, int block);
+int rtdal_itfrefq_get_blocking(r_itf_t obj);
+int rtdal_itfrefq_set_delay(r_itf_t obj, int delay);
+int rtdal_itfrefq_get_delay(r_itf_t obj);
+void *rtdal_itfrefq_meta(r_itf_t obj, void *ptr);
+int rtdal_itfrefq_ready(r_itf_t obj, int is_input);
+int rtdal_itfrefq_set_stats(r_itf_t obj, int enable);
+int rtdal_itfrefq_get_stats(r_itf_t obj, rtdal_itf_stats_t *stats);
+int rtdal_itfrefq_push_ref(r_itf_t obj, r_itf_t src, void *ptr, int len, int tstamp);
+int rtdal_itfrefq_place(r_itf_t obj, int node, int policy);
+#endif
@@ -27,6 +27,10 @@
 #include "rtdal_error.h"
 #include "rtdal_itf.h"
 #include "rtdal_itfspscq.h"
+#include "rtdal_itfwait.h"
+#include "dataflow.h"
+#include "rtdal_itfstats.h"
+#include "rtdal_numa.h"
 #include "defs.h"
 #include "str.h"
 
@@ -37,6 +41,8 @@ typedef struct {
 	int tstamp;
 	int len;
 	void *data;
+	long long tx_ns;
+	char meta[RTDAL_PKT_META_SZ];
 }r_pkt_t;
 
 typedef struct {
@@ -48,13 +54,15 @@ typedef struct {
 	int write;
 	ring_buff_binary_sem_t sem_r;
 	ring_buff_binary_sem_t sem_w;
+	itf_wait_t wait_r;
+	itf_wait_t wait_w;
 	r_pkt_t *packets;
 	char *data;
 }rtdal_itfspscq_t;
 
 #define cast(a,b) RTDAL_ASSERT_PARAM(a);\
 			rtdal_itfspscq_t *b = (rtdal_itfspscq_t*) a;
-#define cast_p(a,b) RTDAL_ASSERT_PARAM_p(a);\
+#define cast_p(a,b) RTDAL_ASSERT_PARAM_P(a);\
 			rtdal_itfspscq_t *b = (rtdal_itfspscq_t*) a;
 
 static int spscq_id=1;
@@ -65,6 +73,7 @@ r_itf_t rtdal_itfspscq_new(int max_msg, int msg_sz, int delay, r_log_t log) {
 	if (!itf) {
 		return NULL;
 	}
+	memset(itf,0,sizeof(rtdal_itfspscq_t));
 
 	itf->parent.type = ITF_INT_SPSCQ;
 	itf->max_msg = max_msg;
@@ -84,10 +93,12 @@ r_itf_t rtdal_itfspscq_new(int max_msg, int msg_sz, int delay, r_log_t log) {
 		itf->packets[i].data = &itf->data[i*itf->max_msg_sz];
 		itf->packets[i].valid = 0;
 	}
-	if (itf->parent.delay < 0) {
+	if (itf->parent.delay == RTDAL_ITF_BLOCKING) {
 		ring_buff_binary_sem_create(&itf->sem_r);
 		ring_buff_binary_sem_create(&itf->sem_w);
 	}
+	itf_wait_init(&itf->wait_r);
+	itf_wait_init(&itf->wait_w);
 
 	return (r_itf_t) itf;
 }
@@ -126,12 +137,43 @@ int rtdal_itfspscq_remove(r_itf_t obj) {
 	return 0;
 }
 
+/**
+ * Moves the packets to the NUMA node node (see numa_place())
+ */
+int rtdal_itfspscq_place(r_itf_t obj, int node, int policy) {
+	cast(obj,itf);
+	if (numa_place(itf->data, (size_t) itf->max_msg*itf->max_msg_sz, node, policy)) {
+		return -1;
+	}
+	return numa_place(itf->packets, itf->max_msg*sizeof(r_pkt_t), node, policy);
+}
+
+
+static int spscq_can_pop(void *arg) {
+	rtdal_itfspscq_t *itf = arg;
+	return __atomic_load_n(&itf->packets[itf->read].valid, __ATOMIC_ACQUIRE) != 0;
+}
+
+static int spscq_can_push(void *arg) {
+	rtdal_itfspscq_t *itf = arg;
+	return __atomic_load_n(&itf->packets[itf->write].valid, __ATOMIC_ACQUIRE) == 0;
+}
+
+int rtdal_itfspscq_ready(r_itf_t obj, int is_input) {
+	cast(obj,itf);
+	return is_input?spscq_can_pop(itf):spscq_can_push(itf);
+}
 
 inline static int spscq_is_empty(rtdal_itfspscq_t *itf, int tstamp) {
-	if (itf->parent.delay >= 0 || itf->parent.delay == -2) {
+	if (itf->parent.delay >= 0) {
 		return (itf->packets[itf->read].valid == 0);
+	} else if (itf->parent.delay == RTDAL_ITF_POLLING) {
+		return !itf_wait(&itf->wait_r, spscq_can_pop, itf, 1000);
+	} else if (itf->parent.delay == RTDAL_ITF_FUTEX) {
+		itf_wait(&itf->wait_r, spscq_can_pop, itf, 0);
+		return 0;
 	} else {
-		while (itf->packets[itf->read].valid == 0 && itf->packets[itf->read].tstamp > tstamp) {
+		while (__atomic_load_n(&itf->packets[itf->read].valid, __ATOMIC_ACQUIRE) == 0) {
 			qdebug("wait write=%d read=%d\n",itf->write,itf->read);
 			ring_buff_binary_sem_take(itf->sem_r);
 		}
@@ -143,6 +185,9 @@ inline static int spscq_is_empty(rtdal_itfspscq_t *itf, int tstamp) {
 inline static int spscq_is_full(rtdal_itfspscq_t *itf) {
 	if (itf->parent.delay >= 0) {
 		return (itf->packets[itf->write].valid != 0);
+	} else if (itf->parent.delay != RTDAL_ITF_BLOCKING) {
+		itf_wait(&itf->wait_w, spscq_can_push, itf, 0);
+		return 0;
 	} else {
 		while(itf->packets[itf->write].valid != 0) {
 			qdebug("wait write=%d read=%d\n",itf->write,itf->read);
@@ -163,11 +208,13 @@ int rtdal_itfspscq_request(r_itf_t obj, void **ptr) {
 
 		qdebug("[full] id=%d write=%d, valid=%d\n",itf->parent.id,itf->write,itf->packets[itf->write].valid);
 		RTDAL_SETERROR(RTDAL_ERROR_NOSPACE);
+		itf_stats_drop(&itf->parent);
 		return 0;
 	}
 
 	qdebug("[ok] write=%d/%d\n",itf->write,itf->max_msg);
 	*ptr = itf->packets[itf->write].data;
+	memset(itf->packets[itf->write].meta,0,RTDAL_PKT_META_SZ);
 
 
 	return 1;
@@ -192,19 +239,26 @@ int rtdal_itfspscq_push(r_itf_t obj, void *ptr, int len, int tstamp) {
 
 	itf->packets[itf->write].tstamp = tstamp+itf->parent.delay;
 	itf->packets[itf->write].len = len;
-	itf->packets[itf->write].valid = 1;
+	itf->packets[itf->write].tx_ns = itf_stats_tx(&itf->parent);
+	__atomic_store_n(&itf->packets[itf->write].valid, 1, __ATOMIC_RELEASE);
 	qdebug("write=%d/%d, len=%d, tstamp=%d, delay=%d\n",itf->write,itf->max_msg,len,tstamp,itf->parent.delay);
 
 	itf->write += (itf->write+1 >= itf->max_msg) ? (1-itf->max_msg) : 1;
 
-	if (itf->parent.delay < 0) {
+	if (itf->parent.delay == RTDAL_ITF_BLOCKING) {
 		ring_buff_binary_sem_give(itf->sem_r);
+	} else if (itf->parent.delay < 0) {
+		itf_wait_signal(&itf->wait_r);
 	}
+	dataflow_notify(itf->parent.consumer);
 
 	return 1;
 }
 
-int rtdal_itfspscq_pop(r_itf_t obj, void **ptr, int *len, int tstamp) {
+/**
+ * Like rtdal_itfspscq_pop() but an empty queue is not counted in the statistics
+ */
+int rtdal_itfspscq_peek(r_itf_t obj, void **ptr, int *len, int tstamp) {
 	cast(obj,itf);
 	RTDAL_ASSERT_PARAM(ptr);
 	RTDAL_ASSERT_PARAM(len);
@@ -212,15 +266,14 @@ int rtdal_itfspscq_pop(r_itf_t obj, void **ptr, int *len, int tstamp) {
 	*ptr = NULL;
 	*len = 0;
 
-	if (spscq_is_empty(itf,tstamp)) {
-		if (itf->parent.delay==-2) {
-			usleep(1000);
+	do {
+		if (spscq_is_empty(itf,tstamp)) {
+			qdebug("[empty] read=%d write=%d\n",itf->read,itf->write);
+			return 0;
+		}
+		if (itf->parent.delay < 0) {
+			break;
 		}
-		qdebug("[empty] read=%d write=%d\n",itf->read,itf->write);
-		return 0;
-	}
-
-	if (itf->parent.delay >= 0 ) {
 #ifdef USE_SYSTEM_TSTAMP
 		tstamp=rtdal_time_slot();
 #endif
@@ -228,14 +281,12 @@ int rtdal_itfspscq_pop(r_itf_t obj, void **ptr, int *len, int tstamp) {
 			qdebug("[delay] read=%d, tstamp=%d now=%d\n",itf->read,itf->packets[itf->read].tstamp,tstamp);
 			return 0;
 		}
-/*
-		if (itf->packets[itf->read].tstamp < tstamp-1) {
-			qdebug("[old] read=%d, tstamp=%d now=%d\n",itf->read,itf->packets[itf->read].tstamp,tstamp);
-			rtdal_itfspscq_release(obj,NULL,0);
-			return 2;
+		if (!rtdal_itf_is_stale(itf->packets[itf->read].tstamp,tstamp)) {
+			break;
 		}
-*/
-	}
+		qdebug("[old] read=%d, tstamp=%d now=%d\n",itf->read,itf->packets[itf->read].tstamp,tstamp);
+		rtdal_itfspscq_release(obj,NULL,0);
+	} while(1);
 
 	qdebug("[ok] read=%d, tstamp=%d (now=%d)\n",itf->read,itf->packets[itf->read].tstamp,tstamp);
 	*ptr = itf->packets[itf->read].data;
@@ -244,6 +295,67 @@ int rtdal_itfspscq_pop(r_itf_t obj, void **ptr, int *len, int tstamp) {
 	return 1;
 }
 
+int rtdal_itfspscq_pop(r_itf_t obj, void **ptr, int *len, int tstamp) {
+	cast(obj,itf);
+	int n;
+
+	if (!(n = rtdal_itfspscq_peek(obj, ptr, len, tstamp))) {
+		itf_stats_empty(&itf->parent);
+	}
+	return n;
+}
+
+/**
+ * Requests up to max consecutive buffers. They must be pushed in the same order.
+ */
+int rtdal_itfspscq_request_n(r_itf_t obj, void **ptr, int max) {
+	cast(obj,itf);
+	int n, idx;
+
+	if ((n = rtdal_itfspscq_request(obj, &ptr[0])) != 1) {
+		return n;
+	}
+	idx = itf->write;
+	for (n=1;n<max && n<itf->max_msg;n++) {
+		idx += (idx+1 >= itf->max_msg) ? (1-itf->max_msg) : 1;
+		if (__atomic_load_n(&itf->packets[idx].valid, __ATOMIC_ACQUIRE) != 0) {
+			break;
+		}
+		ptr[n] = itf->packets[idx].data;
+		memset(itf->packets[idx].meta,0,RTDAL_PKT_META_SZ);
+	}
+	return n;
+}
+
+/**
+ * Pops up to max pending packets. Waits for the first one like rtdal_itfspscq_pop(). They must
+ * be released in the same order.
+ */
+int rtdal_itfspscq_pop_n(r_itf_t obj, void **ptr, int *len, int max, int tstamp) {
+	cast(obj,itf);
+	int n, idx;
+
+	if ((n = rtdal_itfspscq_pop(obj, &ptr[0], &len[0], tstamp)) != 1) {
+		return n;
+	}
+#ifdef USE_SYSTEM_TSTAMP
+	tstamp=rtdal_time_slot();
+#endif
+	idx = itf->read;
+	for (n=1;n<max && n<itf->max_msg;n++) {
+		idx += (idx+1 >= itf->max_msg) ? (1-itf->max_msg) : 1;
+		if (__atomic_load_n(&itf->packets[idx].valid, __ATOMIC_ACQUIRE) == 0) {
+			break;
+		}
+		if (itf->parent.delay >= 0 && itf->packets[idx].tstamp > tstamp) {
+			break;
+		}
+		ptr[n] = itf->packets[idx].data;
+		len[n] = itf->packets[idx].len;
+	}
+	return n;
+}
+
 int rtdal_itfspscq_release(r_itf_t obj, void *ptr, int len) {
 	cast(obj,itf);
 	/*
@@ -253,25 +365,41 @@ int rtdal_itfspscq_release(r_itf_t obj, void *ptr, int len) {
 	}
 	*/
 
-	itf->packets[itf->read].valid = 0;
+	itf_stats_rx(&itf->parent, itf->packets[itf->read].tstamp-itf->parent.delay,
+			itf->packets[itf->read].tx_ns);
+	__atomic_store_n(&itf->packets[itf->read].valid, 0, __ATOMIC_RELEASE);
 	itf->read += (itf->read+1 >= itf->max_msg) ? (1-itf->max_msg) : 1;
 	qdebug("read=%d, write=%d\n",itf->read,itf->write);
 
-	if (itf->parent.delay < 0) {
+	if (itf->parent.delay == RTDAL_ITF_BLOCKING) {
 		ring_buff_binary_sem_give(itf->sem_w);
+	} else if (itf->parent.delay < 0) {
+		itf_wait_signal(&itf->wait_w);
 	}
+	dataflow_notify(itf->parent.producer);
 
 	return 1;
 }
 
+void *rtdal_itfspscq_meta(r_itf_t obj, void *ptr) {
+	cast_p(obj,itf);
+	RTDAL_ASSERT_PARAM_P(ptr);
+	int idx = ((char*) ptr-itf->data)/itf->max_msg_sz;
+	if (idx < 0 || idx >= itf->max_msg) {
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		return NULL;
+	}
+	return itf->packets[idx].meta;
+}
+
 int rtdal_itfspscq_set_delay(r_itf_t obj, int delay) {
 	aerror("Not yet implemented");
 	return -1;
 }
 
 int rtdal_itfspscq_get_delay(r_itf_t obj) {
-	aerror("Not yet implemented");
-	return -1;
+	cast(obj,itf);
+	return itf->parent.delay;
 }
 
 
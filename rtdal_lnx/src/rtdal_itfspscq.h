@@ -29,7 +29,10 @@ int rtdal_itfspscq_remove(r_itf_t obj);
 int rtdal_itfspscq_request(r_itf_t obj, void **ptr);
 int rtdal_itfspscq_push(r_itf_t obj, void *ptr, int len, int tstamp);
 int rtdal_itfspscq_pop(r_itf_t obj, void **ptr, int *len, int tstamp);
+int rtdal_itfspscq_peek(r_itf_t obj, void **ptr, int *len, int tstamp);
 int rtdal_itfspscq_release(r_itf_t obj, void *ptr, int len);
+int rtdal_itfspscq_request_n(r_itf_t obj, void **ptr, int max);
+int rtdal_itfspscq_pop_n(r_itf_t obj, void **ptr, int *len, int max, int tstamp);
 int rtdal_itfspscq_send(r_itf_t obj, void* buffer, int len, int tstamp);
 int rtdal_itfspscq_recv(r_itf_t obj, void* buffer, int len, int tstamp);
 int rtdal_itfspscq_set_callback(r_itf_t obj, void (*fnc)(void), int prio);
@@ -37,4 +40,7 @@ int rtdal_itfspscq_set_blocking(r_itf_t obj, int block);
 int rtdal_itfspscq_get_blocking(r_itf_t obj);
 int rtdal_itfspscq_set_delay(r_itf_t obj, int delay);
 int rtdal_itfspscq_get_delay(r_itf_t obj);
+void *rtdal_itfspscq_meta(r_itf_t obj, void *ptr);
+int rtdal_itfspscq_ready(r_itf_t obj, int is_input);
+int rtdal_itfspscq_place(r_itf_t obj, int node, int policy);
 #endif
@@ -0,0 +1,120 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTDAL_ITFSTATS_H_
+#define RTDAL_ITFSTATS_H_
+
+#include <time.h>
+#include <string.h>
+#include "rtdal.h"
+#include "rtdal_itf.h"
+
+/**
+ * Telemetry of the internal queues, enabled with rtdal_itf_set_stats().
+ *
+ * The producer calls itf_stats_tx() before publishing a packet and stores the returned time in
+ * the packet, and itf_stats_drop() when request() finds the queue full. The consumer calls
+ * itf_stats_empty() when pop() returns no packet and itf_stats_rx() when it releases one.
+ * Each side only writes its own counters. When disabled, each function costs a single load.
+ */
+
+static inline long long itf_stats_now() {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC,&t);
+	return (long long) t.tv_sec*1000000000+t.tv_nsec;
+}
+
+/** Returns the time to store in the packet being pushed, or 0 if disabled */
+static inline long long itf_stats_tx(rtdal_itf_t *itf) {
+	itf_stats_t *s = &itf->stats;
+	if (!s->enabled) {
+		return 0;
+	}
+	/* the queue publishes the packet afterwards with a release store */
+	__atomic_store_n(&s->pushed, s->pushed+1, __ATOMIC_RELAXED);
+	return itf_stats_now();
+}
+
+static inline void itf_stats_drop(rtdal_itf_t *itf) {
+	if (itf->stats.enabled) {
+		itf->stats.dropped++;
+	}
+}
+
+static inline void itf_stats_empty(rtdal_itf_t *itf) {
+	if (itf->stats.enabled) {
+		itf->stats.empty++;
+	}
+}
+
+/**
+ * Accounts for a released packet, pushed at time slot tx_slot and time tx_ns. The occupancy
+ * includes the released packet.
+ */
+static inline void itf_stats_rx(rtdal_itf_t *itf, int tx_slot, long long tx_ns) {
+	itf_stats_t *s = &itf->stats;
+	long long lat_ns;
+	int occ, lat_slots;
+
+	if (!s->enabled) {
+		return;
+	}
+	occ = (int) (__atomic_load_n(&s->pushed, __ATOMIC_RELAXED) - s->popped);
+	s->popped++;
+	if (occ > s->max_occupancy) {
+		s->max_occupancy = occ;
+	}
+	if (tx_ns) {
+		lat_ns = itf_stats_now()-tx_ns;
+		s->sum_latency_ns += lat_ns;
+		if (lat_ns > s->max_latency_ns) {
+			s->max_latency_ns = lat_ns;
+		}
+	}
+	lat_slots = rtdal_time_slot()-tx_slot;
+	if (lat_slots >= 0) {
+		s->sum_latency_slots += lat_slots;
+		if (lat_slots > s->max_latency_slots) {
+			s->max_latency_slots = lat_slots;
+		}
+	}
+}
+
+static inline void itf_stats_get(itf_stats_t *s, rtdal_itf_stats_t *stats) {
+	memset(stats,0,sizeof(rtdal_itf_stats_t));
+	stats->pushed = __atomic_load_n(&s->pushed, __ATOMIC_RELAXED);
+	stats->dropped = __atomic_load_n(&s->dropped, __ATOMIC_RELAXED);
+	stats->popped = __atomic_load_n(&s->popped, __ATOMIC_RELAXED);
+	stats->empty = __atomic_load_n(&s->empty, __ATOMIC_RELAXED);
+	stats->max_occupancy = s->max_occupancy;
+	stats->max_latency_slots = s->max_latency_slots;
+	stats->max_latency_ns = s->max_latency_ns;
+	if (stats->popped) {
+		stats->mean_latency_slots = (float) s->sum_latency_slots/stats->popped;
+		stats->mean_latency_ns = (float) s->sum_latency_ns/stats->popped;
+	}
+}
+
+/** Clears the counters. Must not be called while the queue is being used */
+static inline void itf_stats_reset(itf_stats_t *s) {
+	int enabled = s->enabled;
+	memset(s,0,sizeof(itf_stats_t));
+	s->enabled = enabled;
+}
+
+#endif
@@ -0,0 +1,129 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTDAL_ITFWAIT_H_
+#define RTDAL_ITFWAIT_H_
+
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "rtdal_trace.h"
+#include "futex.h"
+#include "cpu_relax.h"
+
+/**
+ * Blocking wait used by the internal queues with delay RTDAL_ITF_FUTEX and RTDAL_ITF_POLLING.
+ *
+ * The waiting side spins for a while and then sleeps on a futex. The spin length adapts: it grows
+ * while packets arrive during the spin and shrinks when the thread has to sleep. On machines with
+ * a single core it never spins.
+ *
+ * The signaling side only makes a system call if the other side is sleeping, so a queue whose
+ * consumer keeps up costs a single load per packet.
+ *
+ * When the timeline trace is on, the waits that end up sleeping are recorded with the address of
+ * the queue, which is also its r_itf_t handler.
+ */
+
+#define ITF_WAIT_SPIN_MIN	16
+#define ITF_WAIT_SPIN_MAX	4096
+
+typedef struct {
+	int seq;
+	int waiters;
+	int spin;
+	int spin_max;
+} itf_wait_t;
+
+static inline void itf_wait_init(itf_wait_t *w) {
+	w->seq = 0;
+	w->waiters = 0;
+	w->spin_max = sysconf(_SC_NPROCESSORS_ONLN)>1?ITF_WAIT_SPIN_MAX:0;
+	w->spin = w->spin_max?ITF_WAIT_SPIN_MIN:0;
+}
+
+static inline void itf_wait_trace(uint64_t begin_ns, void *arg) {
+	trace_wait_t ev;
+	if (begin_ns) {
+		ev.begin_ns = begin_ns;
+		ev.itf = (uint64_t) (uintptr_t) arg;
+		rtdal_trace_event(TRACE_WAIT, &ev, sizeof(ev));
+	}
+}
+
+/**
+ * Waits until ready(arg) returns non-zero or timeout_us microseconds have elapsed. A
+ * non-positive timeout waits forever.
+ * @return 1 if ready, 0 on timeout
+ */
+static inline int itf_wait(itf_wait_t *w, int (*ready)(void*), void *arg, int timeout_us) {
+	struct timespec ts, *tsp = NULL;
+	uint64_t begin_ns = rtdal_trace_timeline_on()?rtdal_trace_time():0;
+	int i, seq;
+	long n;
+
+	for (i=0;i<w->spin;i++) {
+		if (ready(arg)) {
+			w->spin = 2*w->spin>w->spin_max?w->spin_max:2*w->spin;
+			return 1;
+		}
+		cpu_relax();
+	}
+	if (w->spin_max) {
+		w->spin = w->spin/2<ITF_WAIT_SPIN_MIN?ITF_WAIT_SPIN_MIN:w->spin/2;
+	}
+	if (timeout_us > 0) {
+		ts.tv_sec = timeout_us/1000000;
+		ts.tv_nsec = (timeout_us%1000000)*1000;
+		tsp = &ts;
+	}
+	while(1) {
+		seq = __atomic_load_n(&w->seq, __ATOMIC_ACQUIRE);
+		__atomic_fetch_add(&w->waiters, 1, __ATOMIC_SEQ_CST);
+		if (ready(arg)) {
+			__atomic_fetch_sub(&w->waiters, 1, __ATOMIC_SEQ_CST);
+			return 1;
+		}
+		n = futex_wait_private_timeout(&w->seq, seq, tsp);
+		__atomic_fetch_sub(&w->waiters, 1, __ATOMIC_SEQ_CST);
+		if (ready(arg)) {
+			itf_wait_trace(begin_ns, arg);
+			return 1;
+		}
+		if (n == -1 && errno == ETIMEDOUT) {
+			itf_wait_trace(begin_ns, arg);
+			return 0;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Wakes up the other side if it is sleeping in itf_wait(). Must be called after the change that
+ * makes ready() true has been published.
+ */
+static inline void itf_wait_signal(itf_wait_t *w) {
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&w->waiters, __ATOMIC_RELAXED)) {
+		__atomic_fetch_add(&w->seq, 1, __ATOMIC_RELEASE);
+		futex_wake_private(&w->seq);
+	}
+}
+
+#endif /* RTDAL_ITFWAIT_H_ */
@@ -48,6 +48,11 @@
 #include "futex.h"
 #include "barrier.h"
 #include "pipeline_sync.h"
+#include "pipeline_dag.h"
+#include "pipeline_batch.h"
+#include "dataflow.h"
+#include "rtdal_numa.h"
+#include "rtdal_error.h"
 
 rtdal_context_t rtdal;
 static rtdal_timer_t kernel_timer;
@@ -81,12 +86,49 @@ void rtdal_timeslot_set(int ts_base_multiply) {
         }
 }
 
+/**
+ * Returns the number of ticks missed by the timer that drives the pipeline pipeline_id, which is
+ * the timer of the pipeline with the multi timer and the kernel timer otherwise, or -1 on error.
+ */
+long long rtdal_pipeline_missed_ticks(int pipeline_id) {
+	if (pipeline_id < 0 || pipeline_id >= rtdal.machine.nof_cores) {
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		return -1;
+	}
+	switch(rtdal.machine.clock_mode) {
+	case SINGLE_TIMER:
+		return (long long) kernel_timer.wakeups_missed;
+	case MULTI_TIMER:
+		return (long long) rtdal.pipelines[pipeline_id].mytimer.wakeups_missed;
+	default:
+		return 0;
+	}
+}
+
 void *exec_timer_none(void *arg) {
 	while(1) {
 		kernel_cycle(NULL,NULL);
 	}
 }
 
+/* with the batch clock, prints the throughput every batch_report_s seconds */
+void *exec_timer_batch(void *arg) {
+	long long slots, last_slots = 0;
+	double seconds, last_seconds = 0;
+
+	while(!kernel_timer.stop) {
+		sleep(rtdal.machine.batch_report_s);
+		if (!pipeline_batch_stats(&slots, &seconds) && seconds > last_seconds) {
+			printf("Batch: %lld subframes in %.1f s, %.1f subframes/s (last %.1f)\n",
+					slots, seconds, (double) slots/seconds,
+					(double) (slots-last_slots)/(seconds-last_seconds));
+			last_slots = slots;
+			last_seconds = seconds;
+		}
+	}
+	return NULL;
+}
+
 inline static int kernel_initialize_setup_clock() {
 	struct timespec start_time;
 
@@ -107,8 +149,10 @@ inline static int kernel_initialize_setup_clock() {
 #ifdef __XENO__
 		kernel_timer.mode = XENOMAI;
 #else
-		kernel_timer.mode = NANOSLEEP;
+		kernel_timer.mode = rtdal.machine.timer_spin_us?HYBRID:NANOSLEEP;
+		kernel_timer.spin_ns = (long int) rtdal.machine.timer_spin_us*1000;
 #endif
+		kernel_timer.overrun = rtdal.machine.timer_overrun;
 		kernel_timer.wait_futex = NULL;
 		kernel_timer.thread = &single_timer_thread;
 		hdebug("creating single_timer_thread period %d\n",(int) kernel_timer.period);
@@ -146,6 +190,18 @@ inline static int kernel_initialize_setup_clock() {
 			return -1;
 		}
 
+		break;
+	case BATCH_TIMER:
+		clock_gettime(CLOCK_REALTIME, &start_time);
+		rtdal_time_reset_realtime(&start_time);
+		pipeline_batch_start();
+		if (rtdal.machine.batch_report_s > 0) {
+			if (rtdal_task_new_thread(&exec_timer_thread, exec_timer_batch,
+					NULL, DETACHABLE, TASK_DEFAULT_PRIORITY, -1, 0)) {
+				rtdal_perror("rtdal_task_new_thread");
+				return -1;
+			}
+		}
 		break;
 	default:
 		aerror_msg("Unknown clock source %d\n", rtdal.machine.clock_mode);
@@ -170,8 +226,10 @@ int kernel_initialize_create_pipeline(pipeline_t *obj, int *wait_futex) {
 #ifdef __XENO__
 		obj->mytimer.mode = XENOMAI;
 #else
-		obj->mytimer.mode = NANOSLEEP;
+		obj->mytimer.mode = rtdal.machine.timer_spin_us?HYBRID:NANOSLEEP;
+		obj->mytimer.spin_ns = (long int) rtdal.machine.timer_spin_us*1000;
 #endif
+		obj->mytimer.overrun = rtdal.machine.timer_overrun;
 		obj->mytimer.thread =
 				&obj->thread;
 		tmp_thread_fnc = timer_run_thread;
@@ -181,6 +239,15 @@ int kernel_initialize_create_pipeline(pipeline_t *obj, int *wait_futex) {
 		tmp_thread_arg = obj;
 	}
 	obj->wait_on_finish=rtdal.machine.thread_sync_on_finish;
+	if (rtdal.machine.numa_policy != NUMA_POLICY_NONE) {
+		obj->numa_node = numa_cpu_node(rtdal.machine.core_mapping[obj->id]);
+	} else {
+		obj->numa_node = -1;
+	}
+	obj->numa_bound = 0;
+	obj->perf_opened = 0;
+	obj->perf.nof_fd = 0;
+	memset(&obj->perf_total,0,sizeof(rtdal_perf_counters_t));
 	prio = rtdal.machine.kernel_prio-1;
 	obj->xenomai_warn_msw = rtdal.machine.rt_cfg.xenomai_warn_msw;
 
@@ -221,7 +288,23 @@ int kernel_initialize_create_pipeline(pipeline_t *obj, int *wait_futex) {
  */
 static int kernel_initialize_create_pipelines() {
 
-	pipeline_initialize(rtdal.machine.nof_cores);
+	if (pipeline_initialize(rtdal.machine.nof_cores)) {
+		aerror("Initializing pipeline synchronization\n");
+		return -1;
+	}
+	if (rtdal.machine.clock_mode == BATCH_TIMER) {
+		if (pipeline_batch_initialize(rtdal.machine.nof_cores, rtdal.machine.batch_window)) {
+			aerror("Initializing batch clock\n");
+			return -1;
+		}
+	}
+	/* edf_order uses the dependencies of the dag scheduling */
+	if (rtdal.machine.scheduling == SCHEDULING_DAG || rtdal.machine.edf_order) {
+		if (pipeline_dag_initialize(rtdal.machine.nof_cores)) {
+			aerror("Initializing dag scheduler\n");
+			return -1;
+		}
+	}
 	hdebug("creating %d pipeline threads\n",rtdal.machine.nof_cores);
 
 	for (int i=0;i<rtdal.machine.nof_cores;i++) {
@@ -276,7 +359,10 @@ int kernel_initialize_set_kernel_priority() {
 static int kernel_initialize(void) {
 
 
-	rtdal_initialize_node(&rtdal, NULL, NULL);
+	if (rtdal_initialize_node(&rtdal, NULL, NULL)) {
+		aerror("Initializing rtdal\n");
+		return -1;
+	}
 
 	pthread_mutex_init(&rtdal.mutex,NULL);
 
@@ -288,6 +374,14 @@ static int kernel_initialize(void) {
 			aerror("Creating logs\n");
 			return -1;
 		}
+		if (rtdal.machine.logs_cfg.trace) {
+			if (rtdal_log_init_trace(rtdal.machine.logs_cfg.trace_kb,
+					rtdal.machine.logs_cfg.trace_flush_ms)) {
+				aerror("Creating trace buffers\n");
+				return -1;
+			}
+			rtdal_log_trace_timeline(rtdal.machine.logs_cfg.timeline);
+		}
 	}
 	/* and create kernel log */
 	if (rtdal.machine.logs_cfg.kernel_en) {
@@ -310,7 +404,16 @@ static int kernel_initialize(void) {
 		return -1;
 	}
 
-	if (rtdal.machine.scheduling == SCHEDULING_PIPELINE) {
+	if (rtdal.machine.scheduling == SCHEDULING_BESTEFFORT
+			&& rtdal.machine.besteffort_workers) {
+		/* create the worker pool, otherwise each process has its own thread */
+		if (dataflow_initialize(rtdal.machine.besteffort_workers)) {
+			return -1;
+		}
+	}
+
+	if (rtdal.machine.scheduling == SCHEDULING_PIPELINE
+			|| rtdal.machine.scheduling == SCHEDULING_DAG) {
 		/* create pipelines */
 		if (kernel_initialize_create_pipelines()) {
 			return -1;
@@ -350,12 +453,141 @@ static void check_threads() {
 	}
 }
 
+/**
+ * Prints the slack of each pipeline measured with the slack_stats option. The histogram gives
+ * the number of time slots finished with a slack in each 5% of the time slot.
+ */
+static void print_slackinfo() {
+	rtdal_pipeline_stats_t *s;
+	int i, j;
+
+	if (!rtdal.machine.slack_stats) {
+		return;
+	}
+	for (i=0;i<rtdal.machine.nof_cores;i++) {
+		s = &rtdal.pipelines[i].stats;
+		if (!s->slots) {
+			continue;
+		}
+		printf("Pipeline %d: %lld slots, %lld late, slack min %lld us, mean %.1f us\n",i,
+				s->slots,s->late,s->min_slack_ns/1000,s->mean_slack_ns/1000);
+		printf("  slack%%\tslots\n");
+		if (s->slack_hist[0]) {
+			printf("  late\t%u\n",s->slack_hist[0]);
+		}
+		for (j=1;j<RTDAL_SLACK_HIST_SZ;j++) {
+			if (s->slack_hist[j]) {
+				printf("  %d-%d\t%u\n",(j-1)*100/(RTDAL_SLACK_HIST_SZ-1),
+						j*100/(RTDAL_SLACK_HIST_SZ-1),s->slack_hist[j]);
+			}
+		}
+	}
+}
+
+/**
+ * Prints the ticks missed by the timer and the time slots not run by each pipeline.
+ */
+static void print_missinfo() {
+	long long ticks, slots;
+	int i;
+
+	for (i=0;i<rtdal.machine.nof_cores;i++) {
+		ticks = rtdal_pipeline_missed_ticks(i);
+		slots = rtdal_pipeline_missed_slots(i);
+		if (ticks > 0 || slots > 0) {
+			printf("Pipeline %d: %lld timer ticks missed, %lld time slots not run (%s)\n",i,
+					ticks,slots,rtdal.machine.timer_overrun==OVERRUN_SKIP?"skip":"compress");
+		}
+	}
+}
+
+/**
+ * Prints the wake-up error of each pipeline measured with the jitter_stats option. Bins are
+ * powers of two microseconds.
+ */
+static void print_jitterinfo() {
+	rtdal_jitter_stats_t s;
+	int i, j;
+
+	if (!rtdal.machine.jitter_stats) {
+		return;
+	}
+	for (i=0;i<rtdal.machine.nof_cores;i++) {
+		if (rtdal_pipeline_get_jitter(i, &s) || !s.slots) {
+			continue;
+		}
+		printf("Pipeline %d: %lld slots, wake-up error max %lld us, mean %.1f us\n",i,
+				s.slots,s.max_ns/1000,(float) s.sum_ns/s.slots/1000);
+		printf("  us\tslots\n");
+		if (s.hist[0]) {
+			printf("  0-1\t%u\n",s.hist[0]);
+		}
+		for (j=1;j<RTDAL_JITTER_HIST_SZ-1;j++) {
+			if (s.hist[j]) {
+				printf("  %d-%d\t%u\n",1<<(j-1),1<<j,s.hist[j]);
+			}
+		}
+		if (s.hist[j]) {
+			printf("  >%d\t%u\n",1<<(j-1),s.hist[j]);
+		}
+	}
+}
+
+/**
+ * Prints the hardware events counted by each pipeline with the perf_counters option, per
+ * thousand instructions.
+ */
+static void print_perfinfo() {
+	rtdal_perf_counters_t p;
+	long long ki;
+	int i;
+
+	if (!rtdal.machine.perf_counters) {
+		return;
+	}
+	for (i=0;i<rtdal.machine.nof_cores;i++) {
+		if (rtdal_pipeline_get_perf(i, &p) || !p.runs) {
+			continue;
+		}
+		ki = p.count[RTDAL_PERF_INSTRUCTIONS]/1000;
+		printf("Pipeline %d: %lld runs, %.1f Mcycles, IPC %.2f, misses per kinstr: L1D %.2f "
+				"LLC %.2f branch %.2f\n",i,p.runs,(double) p.count[RTDAL_PERF_CYCLES]/1e6,
+				(double) p.count[RTDAL_PERF_INSTRUCTIONS]/(p.count[RTDAL_PERF_CYCLES]?
+						p.count[RTDAL_PERF_CYCLES]:1),
+				(double) p.count[RTDAL_PERF_L1D_MISSES]/(ki?ki:1),
+				(double) p.count[RTDAL_PERF_LLC_MISSES]/(ki?ki:1),
+				(double) p.count[RTDAL_PERF_BRANCH_MISSES]/(ki?ki:1));
+	}
+}
+
+/**
+ * Prints the number of time slots (subframes) run with the batch clock and their rate.
+ */
+static void print_batchinfo() {
+	long long slots;
+	double seconds;
+
+	if (rtdal.machine.clock_mode != BATCH_TIMER) {
+		return;
+	}
+	if (pipeline_batch_stats(&slots, &seconds) || seconds <= 0) {
+		printf("Batch: no subframes processed\n");
+		return;
+	}
+	printf("Batch: %lld subframes in %.3f s, %.1f subframes/s, %.1f us/subframe\n",slots,
+			seconds,(double) slots/seconds,seconds*1e6/(slots?slots:1));
+}
+
 void kernel_exit() {
 
 	rtdal_log_flushall();
 
 	sigwait_stops = 1;
 	kernel_timer.stop = 1;
+	if (rtdal.machine.clock_mode == BATCH_TIMER) {
+		print_batchinfo();
+		pipeline_batch_stop();
+	}
 	for (int i=0;i<rtdal.machine.nof_cores;i++) {
 		if (rtdal.machine.clock_mode == MULTI_TIMER) {
 			rtdal.pipelines[i].mytimer.stop = 1;
@@ -365,6 +597,11 @@ void kernel_exit() {
 	}
 	usleep(100000);
 	check_threads();
+	print_missinfo();
+	print_slackinfo();
+	print_jitterinfo();
+	print_perfinfo();
+	rtdal_finish_node();
 }
 void *volk_malloc(int size) {
 	void *ptr;
@@ -404,7 +641,9 @@ void load_volk() {
 void print_schedinfo() {
 	switch(rtdal.machine.scheduling) {
 	case SCHEDULING_PIPELINE:
-		printf("-- Pipeline Scheduling Selected --\n");
+	case SCHEDULING_DAG:
+		printf("-- %s Scheduling Selected --\n",
+				rtdal.machine.scheduling == SCHEDULING_DAG?"DAG Work-Stealing":"Pipeline");
 		printf("Time slot:\t%g us\nPlatform:\t%d cores\nTimer:\t\t", (float) rtdal.machine.ts_len_ns/1000,
 				rtdal.machine.nof_cores);
 		switch(rtdal.machine.clock_mode) {
@@ -416,10 +655,17 @@ void print_schedinfo() {
 			break;
 		case NO_TIMER:
 			printf("None\n\n");
+			break;
+		case BATCH_TIMER:
+			printf("Batch, window %d time slots\n\n",rtdal.machine.batch_window);
 		}
 		break;
 	case SCHEDULING_BESTEFFORT:
 		printf("-- Best-Effort Scheduling Selected --\n");
+		if (rtdal.machine.besteffort_workers) {
+			printf("Worker pool:\t%d threads\n\n",rtdal.machine.besteffort_workers<0?
+					(int) sysconf(_SC_NPROCESSORS_ONLN):rtdal.machine.besteffort_workers);
+		}
 	}
 }
 
@@ -31,6 +31,7 @@
 #define TASK_TERMINATION_SIGNAL	SIGUSR2
 
 int kernel_tslot_run();
+int kernel_tslot_run_tick(struct timespec *tick);
 int rtdal_kernel_sigwait_thread();
 int kernel_initialize_create_pipeline(pipeline_t *obj, int *wait_futex);
 void kernel_cycle(void *x, struct timespec *time);
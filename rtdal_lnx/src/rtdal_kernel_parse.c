@@ -6,6 +6,8 @@
 
 #include "rtdal_kernel.h"
 #include "rtdal_machine.h"
+#include "pipeline_sync.h"
+#include "pipeline_batch.h"
 #include "defs.h"
 
 int parse_cores_comma_sep(char *str, int *core_mapping) {
@@ -105,6 +107,24 @@ int parse_config_opts(config_setting_t *cfg, rtdal_machine_t *machine) {
 	if (!config_setting_lookup_int(cfg,"log_length_mb",&machine->logs_cfg.log_length_mb)) {
 		machine->logs_cfg.log_length_mb=0;
 	}
+	if (!config_setting_lookup_bool(cfg,"log_trace",&machine->logs_cfg.trace)) {
+		machine->logs_cfg.trace=0;
+	}
+	if (!config_setting_lookup_int(cfg,"log_trace_kb",&machine->logs_cfg.trace_kb)) {
+		machine->logs_cfg.trace_kb=1024;
+	} else if (machine->logs_cfg.trace_kb <= 0) {
+		aerror_msg("Invalid log_trace_kb %d\n",machine->logs_cfg.trace_kb);
+		return -1;
+	}
+	if (!config_setting_lookup_int(cfg,"log_trace_flush_ms",&machine->logs_cfg.trace_flush_ms)) {
+		machine->logs_cfg.trace_flush_ms=10;
+	} else if (machine->logs_cfg.trace_flush_ms <= 0) {
+		aerror_msg("Invalid log_trace_flush_ms %d\n",machine->logs_cfg.trace_flush_ms);
+		return -1;
+	}
+	if (!config_setting_lookup_bool(cfg,"log_timeline",&machine->logs_cfg.timeline)) {
+		machine->logs_cfg.timeline=0;
+	}
 
 	if (!machine->logs_cfg.enabled) {
 		memset(&machine->logs_cfg,0,sizeof(struct rtdal_logs_cfg));
@@ -114,6 +134,48 @@ int parse_config_opts(config_setting_t *cfg, rtdal_machine_t *machine) {
 		machine->rt_cfg.xenomai_warn_msw=0;
 	}
 
+	if (!config_setting_lookup_string(cfg, "queue_type", &tmp)) {
+		machine->queue_type = QUEUE_TYPE_SPSCQ;
+	} else if (!strcmp(tmp,"spscq")) {
+		machine->queue_type = QUEUE_TYPE_SPSCQ;
+	} else if (!strcmp(tmp,"lfq")) {
+		machine->queue_type = QUEUE_TYPE_LFQ;
+	} else if (!strcmp(tmp,"bring")) {
+		machine->queue_type = QUEUE_TYPE_BRING;
+	} else if (!strcmp(tmp,"refq")) {
+		machine->queue_type = QUEUE_TYPE_REFQ;
+	} else {
+		aerror_msg("Invalid queue type %s\n",tmp);
+		return -1;
+	}
+
+	double ratio;
+	if (!config_setting_lookup_float(cfg,"queue_bring_ratio",&ratio)) {
+		machine->queue_bring_ratio=0.25;
+	} else if (ratio <= 0.0 || ratio > 1.0) {
+		aerror_msg("Invalid queue_bring_ratio %g. Must be in (0,1]\n",ratio);
+		return -1;
+	} else {
+		machine->queue_bring_ratio=(float) ratio;
+	}
+
+	if (!config_setting_lookup_bool(cfg,"itf_stats",&machine->itf_stats)) {
+		machine->itf_stats=0;
+	}
+
+	if (!config_setting_lookup_string(cfg, "numa_policy", &tmp)) {
+		machine->numa_policy = NUMA_POLICY_NONE;
+	} else if (!strcmp(tmp,"none")) {
+		machine->numa_policy = NUMA_POLICY_NONE;
+	} else if (!strcmp(tmp,"preferred")) {
+		machine->numa_policy = NUMA_POLICY_PREFERRED;
+	} else if (!strcmp(tmp,"bind")) {
+		machine->numa_policy = NUMA_POLICY_BIND;
+	} else {
+		aerror_msg("Invalid numa_policy %s\n",tmp);
+		return -1;
+	}
+
 	return 0;
 }
 
@@ -147,6 +209,12 @@ int parse_pipeline_opts(config_setting_t *cfg, rtdal_machine_t *machine) {
 		machine->clock_mode = MULTI_TIMER;
 	} else if (!strcmp(tmp,"none")) {
 		machine->clock_mode = NO_TIMER;
+	} else if (!strcmp(tmp,"batch")) {
+		if (machine->scheduling != SCHEDULING_PIPELINE) {
+			aerror("timer_mode batch requires the pipeline scheduling\n");
+			return -1;
+		}
+		machine->clock_mode = BATCH_TIMER;
 	} else {
 		aerror_msg("Invalid timer mode %s\n",tmp);
 		return -1;
@@ -158,10 +226,63 @@ int parse_pipeline_opts(config_setting_t *cfg, rtdal_machine_t *machine) {
 		machine->core0_relative=(float) t;
 	}
 
-	if (!config_setting_lookup_bool(cfg,"thread_sync_on_finish",&machine->thread_sync_on_finish)) {
+	if (!config_setting_lookup_bool(cfg,"thread_sync_on_finish",&machine->thread_sync_on_finish)
+			|| machine->clock_mode == BATCH_TIMER) {
 		machine->thread_sync_on_finish=0;
 	}
 
+	machine->sync_mode = 0;
+	if (config_setting_lookup_string(cfg, "sync_mode", &tmp)) {
+		if (!strcmp(tmp,"sem")) {
+			machine->sync_mode = SEM;
+		} else if (!strcmp(tmp,"futex")) {
+			machine->sync_mode = FUTEX;
+		} else if (!strcmp(tmp,"barrier")) {
+			machine->sync_mode = BARRIER;
+		} else if (!strcmp(tmp,"condvar")) {
+			machine->sync_mode = CONDVAR;
+		} else if (!strcmp(tmp,"epoch")) {
+			machine->sync_mode = EPOCH;
+		} else {
+			aerror_msg("Invalid sync_mode %s\n",tmp);
+			return -1;
+		}
+	}
+	if (!config_setting_lookup_int(cfg,"sync_spin_us",&machine->sync_spin_us)) {
+		machine->sync_spin_us=0;
+	}
+	machine->timer_overrun = OVERRUN_COMPRESS;
+	if (config_setting_lookup_string(cfg, "timer_overrun", &tmp)) {
+		if (!strcmp(tmp,"skip")) {
+			machine->timer_overrun = OVERRUN_SKIP;
+		} else if (strcmp(tmp,"compress")) {
+			aerror_msg("Invalid timer_overrun %s\n",tmp);
+			return -1;
+		}
+	}
+	if (!config_setting_lookup_int(cfg,"timer_spin_us",&machine->timer_spin_us)) {
+		machine->timer_spin_us=0;
+	} else if (machine->timer_spin_us < 0
+			|| (long int) machine->timer_spin_us*1000 >= machine->ts_len_ns) {
+		aerror_msg("Invalid timer_spin_us %d. Must be shorter than the time slot\n",
+				machine->timer_spin_us);
+		return -1;
+	}
+
+	if (!config_setting_lookup_int(cfg,"batch_window",&machine->batch_window)) {
+		machine->batch_window=2;
+	} else if (machine->batch_window < 1 || machine->batch_window > BATCH_MAX_WINDOW) {
+		aerror_msg("Invalid batch_window %d. Must be in [1,%d]\n",machine->batch_window,
+				BATCH_MAX_WINDOW);
+		return -1;
+	}
+	if (!config_setting_lookup_int(cfg,"batch_slots",&machine->batch_slots)) {
+		machine->batch_slots=0;
+	}
+	if (!config_setting_lookup_int(cfg,"batch_report_s",&machine->batch_report_s)) {
+		machine->batch_report_s=1;
+	}
+
 	if (!config_setting_lookup_bool(cfg,"correct_on_rtfault_missed",&machine->rt_cfg.miss_correct)) {
 		machine->rt_cfg.miss_correct=0;
 	}
@@ -174,13 +295,91 @@ int parse_pipeline_opts(config_setting_t *cfg, rtdal_machine_t *machine) {
 	if (!config_setting_lookup_bool(cfg,"kill_on_rtfault_exec",&machine->rt_cfg.exec_kill)) {
 		machine->rt_cfg.exec_kill=0;
 	}
+	if (!config_setting_lookup_bool(cfg,"slack_stats",&machine->slack_stats)
+			|| machine->clock_mode == BATCH_TIMER) {
+		/* there is no deadline without a timer */
+		machine->slack_stats=0;
+	}
+	if (!config_setting_lookup_bool(cfg,"jitter_stats",&machine->jitter_stats)
+			|| machine->clock_mode == BATCH_TIMER) {
+		machine->jitter_stats=0;
+	}
+	if (!config_setting_lookup_bool(cfg,"perf_counters",&machine->perf_counters)) {
+		machine->perf_counters=0;
+	}
+	if (!config_setting_lookup_bool(cfg,"edf_order",&machine->edf_order)
+			|| machine->scheduling == SCHEDULING_DAG) {
+		/* the dag scheduling already runs each process as soon as it can */
+		machine->edf_order=0;
+	}
+	return 0;
+}
+
+int parse_physic_itfs(config_setting_t *cfg, rtdal_machine_t *machine) {
+	config_setting_t *itf;
+	struct rtdal_physic_cfg *pcfg;
+	const char *tmp;
+	int i;
+
+	machine->nof_physic_itfs = config_setting_length(cfg);
+	if (machine->nof_physic_itfs > RTDAL_MAX_PHYSIC) {
+		aerror_msg("Too many physical interfaces (%d). Maximum is %d\n",
+				machine->nof_physic_itfs, RTDAL_MAX_PHYSIC);
+		return -1;
+	}
+	for (i=0;i<machine->nof_physic_itfs;i++) {
+		itf = config_setting_get_elem(cfg, i);
+		pcfg = &machine->physic_itfs[i];
+		if (!config_setting_lookup_int(itf, "id", &pcfg->id) || pcfg->id <= 0) {
+			aerror_msg("Physical interface %d: missing or invalid id\n",i);
+			return -1;
+		}
+		if (!config_setting_lookup_string(itf, "name", &tmp)) {
+			aerror_msg("Physical interface %d: name field not defined\n",i);
+			return -1;
+		}
+		strcpy(pcfg->name,tmp);
+		if (!config_setting_lookup_string(itf, "address", &tmp)) {
+			aerror_msg("Physical interface %d: address field not defined\n",i);
+			return -1;
+		}
+		lstrcpy(pcfg->address,tmp);
+		if (!config_setting_lookup_string(itf, "mode", &tmp)) {
+			aerror_msg("Physical interface %d: mode field not defined\n",i);
+			return -1;
+		}
+		if (!strcmp(tmp,"in")) {
+			pcfg->mode_is_input = 1;
+		} else if (!strcmp(tmp,"out")) {
+			pcfg->mode_is_input = 0;
+		} else {
+			aerror_msg("Physical interface %d: invalid mode %s\n",i,tmp);
+			return -1;
+		}
+		if (!config_setting_lookup_int(itf, "max_msg", &pcfg->max_msg)) {
+			pcfg->max_msg = 16;
+		}
+		if (!config_setting_lookup_int(itf, "msg_sz", &pcfg->msg_sz)) {
+			aerror_msg("Physical interface %d: msg_sz field not defined\n",i);
+			return -1;
+		}
+		if (!config_setting_lookup_bool(itf, "blocking", &pcfg->blocking)) {
+			pcfg->blocking = 0;
+		}
+		if (!config_setting_lookup_int(itf, "delay", &pcfg->delay)) {
+			pcfg->delay = -1;
+		}
+		if (!config_setting_lookup_int(itf, "batch", &pcfg->batch)) {
+			pcfg->batch = 1;
+		}
+	}
 	return 0;
 }
 
 int parse_config(char *config_file, rtdal_machine_t *machine) {
 	config_t config;
 	int ret = -1;
-	config_setting_t *rtdal,*rtdal_opts,*pipeline_opts;
+	config_setting_t *rtdal,*rtdal_opts,*pipeline_opts,*physic_itfs;
 	const char *tmp;
 
 	config_init(&config);
@@ -193,7 +392,16 @@ int parse_config(char *config_file, rtdal_machine_t *machine) {
 
 	rtdal_opts = config_lookup(&config, "rtdal_opts");
 	if (rtdal_opts) {
-		parse_config_opts(rtdal_opts,machine);
+		if (parse_config_opts(rtdal_opts,machine)) {
+			goto destroy;
+		}
+	}
+
+	physic_itfs = config_lookup(&config, "physic_itfs");
+	if (physic_itfs) {
+		if (parse_physic_itfs(physic_itfs,machine)) {
+			goto destroy;
+		}
 	}
 
 	rtdal = config_lookup(&config, "rtdal");
@@ -214,14 +422,14 @@ int parse_config(char *config_file, rtdal_machine_t *machine) {
 		goto destroy;
 	}
 
-	if (!strcmp(tmp,"pipeline")) {
+	if (!strcmp(tmp,"pipeline") || !strcmp(tmp,"dag")) {
 		pipeline_opts = config_lookup(&config, "pipeline_opts");
 		if (!pipeline_opts) {
 			aerror("Error parsing config file: pipeline_opts section not found but "
 					"pipeline scheduling was selected.\n");
 			goto destroy;
 		}
-		machine->scheduling = SCHEDULING_PIPELINE;
+		machine->scheduling = strcmp(tmp,"dag")?SCHEDULING_PIPELINE:SCHEDULING_DAG;
 		machine->queues = QUEUE_NONBLOCKING;
 		if (parse_pipeline_opts(pipeline_opts, machine)) {
 			goto destroy;
@@ -229,14 +437,18 @@ int parse_config(char *config_file, rtdal_machine_t *machine) {
 	} else if (!strcmp(tmp,"best-effort")) {
 		machine->scheduling = SCHEDULING_BESTEFFORT;
 		machine->queues = QUEUE_BLOCKING;
+		if (!config_setting_lookup_int(rtdal, "besteffort_workers", &machine->besteffort_workers)) {
+			machine->besteffort_workers = 0;
+		}
 	} else {
 		aerror_msg("Invalid scheduling %s\n",tmp);
 		goto destroy;
 	}
 
-	if (machine->rt_cfg.miss_correct || machine->rt_cfg.exec_correct
+	if ((machine->rt_cfg.miss_correct || machine->rt_cfg.exec_correct
 			|| machine->rt_cfg.miss_kill || machine->rt_cfg.exec_kill
-			|| (machine->logs_cfg.timing_en && machine->logs_cfg.enabled)) {
+			|| (machine->logs_cfg.timing_en && machine->logs_cfg.enabled))
+			&& machine->clock_mode != BATCH_TIMER) {
 		machine->rt_cfg.do_rtcontrol = 1;
 	}
 
@@ -343,7 +343,7 @@ void thread_signal_handler(int signum, siginfo_t *info, void *ctx) {
 cancel_and_exit:
 	if (signum == SIGABRT) {
 		return;
-	} else if (rtdal.machine.scheduling == SCHEDULING_PIPELINE &&
+	} else if (rtdal.machine.scheduling != SCHEDULING_BESTEFFORT &&
 			thread_id >= 0 && thread_id < rtdal.machine.nof_cores) {
 		rtdal.pipelines[thread_id].waiting=1;
 		while(rtdal.pipelines[thread_id].waiting) {
@@ -93,6 +93,9 @@ inline static int kernel_tslot_run_rt_control() {
 static inline void kernel_tslot_run_periodic_callbacks() {
 	/* Call periodic functions */
 	for (int i=0;i<rtdal.nof_periodic;i++) {
+		if (!rtdal.periodic[i].callback) {
+			continue;
+		}
 		hdebug("function %d, counter %d\n",i,rtdal.periodic[i].counter);
 		if (rtdal.periodic[i].counter==rtdal.periodic[i].period)  {
 			hdebug("function %d, calling\n",i);
@@ -103,9 +106,7 @@ static inline void kernel_tslot_run_periodic_callbacks() {
 	}
 }
 
-inline int kernel_tslot_run() {
-	rtdal_time_ts_inc();
-
+inline static int kernel_tslot_start() {
 	hdebug("tslot=%d\n",rtdal_time_slot());
 
 	if (signal_received) {
@@ -126,6 +127,23 @@ inline int kernel_tslot_run() {
 	return 1;
 }
 
+inline int kernel_tslot_run() {
+	rtdal_time_ts_inc();
+	return kernel_tslot_start();
+}
+
+/**
+ * With the skip overrun policy, starts the time slot of the timer tick instead of the next one.
+ * \returns -1 if the time slot was already started by another timer, otherwise as
+ * kernel_tslot_run()
+ */
+int kernel_tslot_run_tick(struct timespec *tick) {
+	if (!rtdal_time_ts_align(tick)) {
+		return -1;
+	}
+	return kernel_tslot_start();
+}
+
 /**
  * This function is called by the internal timer, a DAC event or by the sync_slave,
  * after the reception of a synchronization packet.
@@ -140,7 +158,11 @@ void kernel_cycle(void *x, struct timespec *time) {
 		rtdal_time_reset_realtime(time);
 		first_cycle = 1;
 	}
-	if (kernel_tslot_run()) {
+	if (rtdal.machine.timer_overrun == OVERRUN_SKIP && time) {
+		if (kernel_tslot_run_tick(time) == 1) {
+			pipeline_sync_threads();
+		}
+	} else if (kernel_tslot_run()) {
 		pipeline_sync_threads();
 	}
 	if (rtdal.machine.thread_sync_on_finish) {
@@ -12,6 +12,7 @@
 #include "rtdal.h"
 #include "defs.h"
 #include "rtdal_error.h"
+#include "rtdal_trace.h"
 
 typedef struct {
 	int id;
@@ -37,6 +38,7 @@ static int logs_enabled=0;
 static int default_log_sz;
 static FILE *output;
 static pthread_mutex_t mutex;
+static int trace_en=0;
 #endif
 
 #define cast(a,b) CAST(a,b,log_t*)
@@ -68,12 +70,59 @@ int rtdal_log_init(char *_base_path, int _max_logs, int _max_str_len, int _defau
 	return 0;
 }
 
+/**
+ * Sends the records of all the logs to per-thread binary trace buffers instead of the log
+ * buffers, see rtdal_trace.c. Must be called after rtdal_log_init() and before creating the logs.
+ * The log files are then generated with the trace_decode tool.
+ * \returns 0 on success, -1 on error
+ */
+int rtdal_log_init_trace(int ring_kb, int flush_ms) {
+#if LOGS_ENABLED!=0
+	if (!logs_enabled) {
+		return -1;
+	}
+	if (rtdal_trace_init(base_path, ring_kb, flush_ms)) {
+		return -1;
+	}
+	trace_en = 1;
+#endif
+	return 0;
+}
+
+/**
+ * With the trace buffers, also records the timeline of the pipelines: the beginning of each
+ * time slot, the execution of each process, the RT faults and the packets pushed, popped and
+ * waited for in the interfaces. trace_decode -j converts it to the Chrome trace event format.
+ */
+void rtdal_log_trace_timeline(int enable) {
+#if LOGS_ENABLED!=0
+	if (trace_en) {
+		rtdal_trace_timeline = enable;
+	}
+#endif
+}
+
+/**
+ * Gives a name to a process or interface in the timeline. Does nothing without trace buffers.
+ */
+void rtdal_log_trace_name(void *obj, char *name) {
+#if LOGS_ENABLED!=0
+	if (trace_en && obj && name) {
+		rtdal_trace_object(obj, name);
+	}
+#endif
+}
+
 void rtdal_log_flushall() {
 #if LOGS_ENABLED!=0
 	int i;
 	if (!logs_enabled) {
 		return;
 	}
+	if (trace_en) {
+		rtdal_trace_stop();
+		return;
+	}
 
 	for (i=0;i<max_logs;i++) {
 		if (logs[i].id) {
@@ -88,7 +137,7 @@ void rtdal_log_flush(r_log_t _log) {
 	char tmp[128];
 	cast(log,_log);
 	assert(log);
-	if (!logs_enabled) {
+	if (!logs_enabled || trace_en) {
 		return;
 	}
 	pthread_mutex_lock(&mutex);
@@ -168,6 +217,15 @@ r_log_t rtdal_log_new_opts(char *name, r_log_mode_t mode, int size, int opts) {
 	if (!size) {
 		size = default_log_sz;
 	}
+	if (trace_en) {
+		lstrcpy(logs[i].name,name);
+		logs[i].opts = opts & ~RTDAL_LOG_OPTS_EXCL;
+		logs[i].mode = mode;
+		logs[i].id = i+1;
+		pthread_mutex_unlock(&mutex);
+		rtdal_trace_name(logs[i].id, mode, name);
+		return (r_log_t) &logs[i];
+	}
 
 	logs[i].memory = calloc(size,sizeof(char));
 	if (!logs[i].memory) {
@@ -213,6 +271,10 @@ void rtdal_log_add_(r_log_t _log, void *_data, int size, int locked) {
 	if (!log) {
 		return;
 	}
+	if (trace_en) {
+		rtdal_trace_data(log->id, _data, size);
+		return;
+	}
 	if (!locked) {
 		lock();
 	}
@@ -257,6 +319,16 @@ void rtdal_log_vprintf(r_log_t _log, const char *format, va_list ap) {
 	if (!log) {
 		return;
 	}
+	if (trace_en) {
+		va_list aq;
+		va_copy(aq,ap);
+		rtdal_trace_vprintf(log->id,format,aq);
+		va_end(aq);
+		if (output) {
+			vfprintf(output,format,ap);
+		}
+		return;
+	}
 	lock();
 	assert(log);
 	assert(format);
@@ -296,6 +368,10 @@ void rtdal_log_add_us(r_log_t _log) {
 	if (!log) {
 		return;
 	}
+	if (trace_en) {
+		rtdal_trace_us(log->id);
+		return;
+	}
 	lock();
 	assert(log);
 
@@ -329,6 +405,10 @@ void rtdal_log_add_tslot(r_log_t _log) {
 		return;
 	}
 	cast(log,_log);
+	if (trace_en) {
+		rtdal_trace_tslot(log->id, rtdal_time_slot());
+		return;
+	}
 	lock();
 	assert(log);
 
@@ -0,0 +1,122 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#include "rtdal.h"
+#include "rtdal_error.h"
+#include "rtdal_machine.h"
+#include "rtdal_numa.h"
+#include "defs.h"
+
+/**
+ * Memory placement on NUMA machines, using the mbind() and set_mempolicy() system calls directly
+ * so that libnuma is not needed. Nodes are given as a mask of one unsigned long.
+ *
+ * With NUMA_POLICY_PREFERRED the pages are allocated in the node while it has free memory, with
+ * NUMA_POLICY_BIND they are only allocated in that node. NUMA_POLICY_NONE leaves the default
+ * policy of the kernel, where a page goes to the node of the thread that touches it first.
+ */
+
+#define NUMA_MAX_NODES	(8*sizeof(unsigned long))
+
+static int numa_mode(int policy) {
+	return policy == NUMA_POLICY_BIND?MPOL_BIND:MPOL_PREFERRED;
+}
+
+/**
+ * Returns the NUMA node of the cpu, read from sysfs, or -1 if it is unknown.
+ */
+int numa_cpu_node(int cpu) {
+	char path[64];
+	DIR *dir;
+	struct dirent *entry;
+	int node = -1;
+
+	snprintf(path,64,"/sys/devices/system/cpu/cpu%d",cpu);
+	dir = opendir(path);
+	if (!dir) {
+		return -1;
+	}
+	while ((entry = readdir(dir))) {
+		if (!strncmp(entry->d_name,"node",4)
+				&& sscanf(&entry->d_name[4],"%d",&node) == 1) {
+			break;
+		}
+	}
+	closedir(dir);
+	return node;
+}
+
+/**
+ * Sets the memory policy of the calling thread, so that the memory it allocates from now on,
+ * including the buffers allocated by the modules it runs, is placed in node.
+ * Nothing is done if node is -1 or policy is NUMA_POLICY_NONE.
+ *
+ * \returns 0 on success or -1 on error
+ */
+int numa_bind_thread(int node, int policy) {
+	unsigned long mask;
+
+	if (policy == NUMA_POLICY_NONE || node < 0) {
+		return 0;
+	}
+	RTDAL_ASSERT_PARAM((size_t) node < NUMA_MAX_NODES);
+	mask = 1UL<<node;
+	if (syscall(SYS_set_mempolicy, numa_mode(policy), &mask, NUMA_MAX_NODES+1)) {
+		RTDAL_SYSERROR("set_mempolicy");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Moves the pages of the buffer [ptr, ptr+len) to node and keeps there the pages allocated later
+ * in that range. Only the pages fully inside the buffer are moved, so the memory around it is not
+ * affected. Nothing is done if node is -1 or policy is NUMA_POLICY_NONE.
+ *
+ * \returns 0 on success or -1 on error
+ */
+int numa_place(void *ptr, size_t len, int node, int policy) {
+	unsigned long mask;
+	uintptr_t page_sz, start, end;
+
+	if (policy == NUMA_POLICY_NONE || node < 0 || !ptr) {
+		return 0;
+	}
+	RTDAL_ASSERT_PARAM((size_t) node < NUMA_MAX_NODES);
+	page_sz = (uintptr_t) sysconf(_SC_PAGESIZE);
+	start = ((uintptr_t) ptr + page_sz-1) & ~(page_sz-1);
+	end = ((uintptr_t) ptr + len) & ~(page_sz-1);
+	if (end <= start) {
+		return 0;
+	}
+	mask = 1UL<<node;
+	if (syscall(SYS_mbind, start, end-start, numa_mode(policy), &mask, NUMA_MAX_NODES+1,
+			MPOL_MF_MOVE)) {
+		RTDAL_SYSERROR("mbind");
+		return -1;
+	}
+	return 0;
+}
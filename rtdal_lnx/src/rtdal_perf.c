@@ -0,0 +1,172 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "rtdal.h"
+#include "rtdal_perf.h"
+#include "defs.h"
+
+/**
+ * Hardware performance counters, using the perf_event_open() system call directly so that
+ * libpfm or the perf tools are not needed.
+ *
+ * The events of a thread are opened as a group led by the cycles counter, so they are
+ * scheduled together on the PMU and read with a single read() of the leader. Each process is
+ * charged the difference between the values read before and after running it. If the kernel
+ * multiplexes the group with other users of the counters, the differences are scaled by the
+ * time the group was enabled over the time it was counting.
+ */
+
+static struct {
+	uint32_t type;
+	uint64_t config;
+	const char *name;
+} perf_events[RTDAL_PERF_NOF_EVENTS] = {
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+	{PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+			| (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), "L1-dcache-load-misses"},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "cache-misses"},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "branch-misses"},
+};
+
+static int perf_event_open(struct perf_event_attr *attr, int group_fd) {
+	/* this thread, any cpu */
+	return (int) syscall(SYS_perf_event_open, attr, 0, -1, group_fd, 0);
+}
+
+/**
+ * Opens the counters for the calling thread. The events the CPU does not have are skipped.
+ * \returns 0 on success or -1 if the cycles can not be counted, with errno set
+ */
+int perf_open(perf_group_t *g) {
+	struct perf_event_attr attr;
+	int i;
+
+	g->nof_fd = 0;
+	for (i=0;i<RTDAL_PERF_NOF_EVENTS;i++) {
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = perf_events[i].type;
+		attr.config = perf_events[i].config;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED
+				| PERF_FORMAT_TOTAL_TIME_RUNNING;
+		g->fd[i] = perf_event_open(&attr, i?g->fd[0]:-1);
+		if (g->fd[i] < 0) {
+			if (!i) {
+				return -1;
+			}
+			awarn("Hardware event %s not available\n",perf_events[i].name);
+			g->pos[i] = -1;
+		} else {
+			g->pos[i] = g->nof_fd++;
+		}
+	}
+	return 0;
+}
+
+void perf_close(perf_group_t *g) {
+	int i;
+	if (!g->nof_fd) {
+		return;
+	}
+	/* the leader last */
+	for (i=RTDAL_PERF_NOF_EVENTS-1;i>=0;i--) {
+		if (g->pos[i] >= 0) {
+			close(g->fd[i]);
+		}
+	}
+	g->nof_fd = 0;
+}
+
+/* saves in x the time enabled, the time running and the value of each event of the group */
+static int perf_read(perf_group_t *g, uint64_t *x) {
+	uint64_t buf[1+PERF_READ_SZ];
+	int n = (int) sizeof(uint64_t)*(3+g->nof_fd);
+
+	if (read(g->fd[0], buf, n) != n) {
+		return -1;
+	}
+	memcpy(x, &buf[1], sizeof(uint64_t)*(2+g->nof_fd));
+	return 0;
+}
+
+/**
+ * Called before running a process.
+ */
+void perf_begin(perf_group_t *g) {
+	if (g->nof_fd && perf_read(g, g->begin)) {
+		g->begin[0] = 0;
+	}
+}
+
+/* only the thread of the pipeline writes them, perf_get() may read them at any time */
+static void perf_add(rtdal_perf_counters_t *c, int event, long long x) {
+	__atomic_store_n(&c->count[event], c->count[event]+x, __ATOMIC_RELAXED);
+}
+
+/**
+ * Called after running a process. Adds the events counted since perf_begin() to the counters of
+ * the process and to the total of the thread.
+ */
+void perf_end(perf_group_t *g, rtdal_perf_counters_t *proc, rtdal_perf_counters_t *total) {
+	uint64_t end[PERF_READ_SZ];
+	double scale;
+	long long x;
+	int i;
+
+	if (!g->nof_fd || !g->begin[0] || perf_read(g, end)) {
+		return;
+	}
+	if (end[1] == g->begin[1]) {
+		/* the group was not on the PMU */
+		return;
+	}
+	scale = (double) (end[0]-g->begin[0])/(end[1]-g->begin[1]);
+	for (i=0;i<RTDAL_PERF_NOF_EVENTS;i++) {
+		if (g->pos[i] >= 0) {
+			x = (long long) (end[2+g->pos[i]]-g->begin[2+g->pos[i]]);
+			if (scale > 1.0) {
+				x = (long long) (x*scale);
+			}
+			perf_add(proc, i, x);
+			perf_add(total, i, x);
+		}
+	}
+	__atomic_store_n(&proc->runs, proc->runs+1, __ATOMIC_RELEASE);
+	__atomic_store_n(&total->runs, total->runs+1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Copies the counters written by perf_end() from another thread.
+ */
+void perf_get(rtdal_perf_counters_t *src, rtdal_perf_counters_t *dst) {
+	int i;
+	dst->runs = __atomic_load_n(&src->runs, __ATOMIC_ACQUIRE);
+	for (i=0;i<RTDAL_PERF_NOF_EVENTS;i++) {
+		dst->count[i] = __atomic_load_n(&src->count[i], __ATOMIC_RELAXED);
+	}
+}
@@ -0,0 +1,44 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTDAL_PERF_H_
+#define RTDAL_PERF_H_
+
+#include <stdint.h>
+
+#include "rtdal_types.h"
+
+/* time enabled, time running and one value per event, see perf_read() */
+#define PERF_READ_SZ	(2+RTDAL_PERF_NOF_EVENTS)
+
+/* hardware counters of a thread, opened with perf_open() from the thread */
+typedef struct {
+	int fd[RTDAL_PERF_NOF_EVENTS];
+	/* position of each event in the values read from the group, -1 if it is not counted */
+	int pos[RTDAL_PERF_NOF_EVENTS];
+	int nof_fd;
+	uint64_t begin[PERF_READ_SZ];
+} perf_group_t;
+
+int perf_open(perf_group_t *g);
+void perf_close(perf_group_t *g);
+void perf_begin(perf_group_t *g);
+void perf_end(perf_group_t *g, rtdal_perf_counters_t *proc, rtdal_perf_counters_t *total);
+void perf_get(rtdal_perf_counters_t *src, rtdal_perf_counters_t *dst);
+
+#endif
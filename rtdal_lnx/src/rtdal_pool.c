@@ -0,0 +1,170 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "rtdal.h"
+#include "rtdal_error.h"
+#include "rtdal_pool.h"
+#include "rtdal_numa.h"
+#include "defs.h"
+
+/**
+ * Pool of fixed-size reference-counted buffers. A buffer obtained with rtdal_pool_get() has
+ * one reference. Any thread may add references with rtdal_pool_ref() and drop them with
+ * rtdal_pool_unref(). The buffer returns to the pool when the last reference is dropped.
+ *
+ * Each buffer is preceded by a header in its own cache line with the reference counter and
+ * the packet metadata, which is shared by all the references.
+ * A buffer is free when its counter is zero, and rtdal_pool_get() takes it with a
+ * compare-and-swap, starting after the last buffer it took, so no lock is needed.
+ */
+typedef struct {
+	int refcnt;
+	rtdal_pool_t *pool;
+	char meta[RTDAL_PKT_META_SZ];
+} r_pool_hdr_t;
+
+#define POOL_HDR_SZ		CACHE_LINE_SZ
+
+#define pool_hdr(ptr) ((r_pool_hdr_t*) ((char*) (ptr) - POOL_HDR_SZ))
+
+static int pool_id=1;
+
+r_pool_t rtdal_pool_new(int nof_buffers, int buffer_sz) {
+	int i;
+	rtdal_pool_t *pool;
+	r_pool_hdr_t *hdr;
+
+	RTDAL_ASSERT_PARAM_P(nof_buffers>0);
+	RTDAL_ASSERT_PARAM_P(buffer_sz>0);
+
+	pool = calloc(1,sizeof(rtdal_pool_t));
+	if (!pool) {
+		RTDAL_SETERROR(RTDAL_ERROR_NOSPACE);
+		return NULL;
+	}
+	pool->nof_buffers = nof_buffers;
+	pool->buffer_sz = buffer_sz;
+	pool->stride = POOL_HDR_SZ+((buffer_sz+CACHE_LINE_SZ-1)/CACHE_LINE_SZ)*CACHE_LINE_SZ;
+	if (posix_memalign((void**)&pool->memory,CACHE_LINE_SZ,nof_buffers*pool->stride)) {
+		free(pool);
+		RTDAL_SETERROR(RTDAL_ERROR_NOSPACE);
+		return NULL;
+	}
+	memset(pool->memory,0,nof_buffers*pool->stride);
+	for (i=0;i<nof_buffers;i++) {
+		hdr = (r_pool_hdr_t*) &pool->memory[i*pool->stride];
+		hdr->pool = pool;
+	}
+	pool->parent.id = pool_id++;
+	return (r_pool_t) pool;
+}
+
+int rtdal_pool_remove(r_pool_t obj) {
+	RTDAL_ASSERT_PARAM(obj);
+	rtdal_pool_t *pool = (rtdal_pool_t*) obj;
+	if (pool->memory) {
+		free(pool->memory);
+	}
+	free(pool);
+	return 0;
+}
+
+/**
+ * Moves the buffers to the NUMA node node (see numa_place())
+ */
+int rtdal_pool_place(r_pool_t obj, int node, int policy) {
+	RTDAL_ASSERT_PARAM(obj);
+	rtdal_pool_t *pool = (rtdal_pool_t*) obj;
+	return numa_place(pool->memory, (size_t) pool->nof_buffers*pool->stride, node, policy);
+}
+
+/**
+ * Returns all the buffers to the pool, regardless of their references
+ */
+int rtdal_pool_reset(r_pool_t obj) {
+	RTDAL_ASSERT_PARAM(obj);
+	rtdal_pool_t *pool = (rtdal_pool_t*) obj;
+	int i;
+
+	for (i=0;i<pool->nof_buffers;i++) {
+		__atomic_store_n(&((r_pool_hdr_t*) &pool->memory[i*pool->stride])->refcnt,0,
+				__ATOMIC_RELEASE);
+	}
+	pool->next = 0;
+	return 0;
+}
+
+/**
+ * Returns a free buffer with one reference and cleared metadata, or NULL if all buffers are in use.
+ */
+void *rtdal_pool_get(r_pool_t obj) {
+	RTDAL_ASSERT_PARAM_P(obj);
+	rtdal_pool_t *pool = (rtdal_pool_t*) obj;
+	int i, idx;
+	r_pool_hdr_t *hdr;
+
+	idx = pool->next;
+	for (i=0;i<pool->nof_buffers;i++) {
+		hdr = (r_pool_hdr_t*) &pool->memory[idx*pool->stride];
+		if (!hdr->refcnt && __sync_bool_compare_and_swap(&hdr->refcnt,0,1)) {
+			pool->next = idx+1<pool->nof_buffers?idx+1:0;
+			memset(hdr->meta,0,RTDAL_PKT_META_SZ);
+			return (char*) hdr+POOL_HDR_SZ;
+		}
+		idx = idx+1<pool->nof_buffers?idx+1:0;
+	}
+	RTDAL_SETERROR(RTDAL_ERROR_NOSPACE);
+	return NULL;
+}
+
+/**
+ * Adds one reference to a buffer obtained with rtdal_pool_get().
+ * Returns the new number of references.
+ */
+int rtdal_pool_ref(void *ptr) {
+	RTDAL_ASSERT_PARAM(ptr);
+	return __sync_add_and_fetch(&pool_hdr(ptr)->refcnt,1);
+}
+
+/**
+ * Drops one reference to a buffer. When no references remain, the buffer returns to its pool.
+ * Returns the remaining number of references.
+ */
+int rtdal_pool_unref(void *ptr) {
+	RTDAL_ASSERT_PARAM(ptr);
+	return __sync_sub_and_fetch(&pool_hdr(ptr)->refcnt,1);
+}
+
+/**
+ * Returns the number of references of a buffer
+ */
+int rtdal_pool_refcnt(void *ptr) {
+	RTDAL_ASSERT_PARAM(ptr);
+	return __atomic_load_n(&pool_hdr(ptr)->refcnt,__ATOMIC_ACQUIRE);
+}
+
+/**
+ * Returns the address of the RTDAL_PKT_META_SZ bytes of metadata of a buffer
+ */
+void *rtdal_pool_meta(void *ptr) {
+	RTDAL_ASSERT_PARAM_P(ptr);
+	return pool_hdr(ptr)->meta;
+}
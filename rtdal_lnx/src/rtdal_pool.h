@@ -0,0 +1,35 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef rtdal_POOL_H
+#define rtdal_POOL_H
+
+#include "rtdal_types.h"
+
+typedef struct {
+	struct h_pool_ parent;
+	int nof_buffers;
+	int buffer_sz;
+	int stride;
+	int next;
+	char *memory;
+} rtdal_pool_t;
+
+int rtdal_pool_place(r_pool_t obj, int node, int policy);
+
+#endif
@@ -17,14 +17,19 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <dlfcn.h>
 #include "rtdal.h"
 #include "rtdal_context.h"
 #include "rtdal_error.h"
 #include "rtdal_process.h"
 #include "pipeline.h"
+#include "pipeline_dag.h"
+#include "pipeline_batch.h"
 #include "defs.h"
 #include "modulethread.h"
+#include "dataflow.h"
+#include "rtdal_trace.h"
 
 lstrdef(tmp);
 lstrdef(tmp2);
@@ -98,20 +103,45 @@ int rtdal_process_remove(r_proc_t process) {
 
 	switch(rtdal.machine.scheduling) {
 		case SCHEDULING_PIPELINE:
-			if (pipeline_remove((pipeline_t*) obj->pipeline, obj)) {
+			/* a process being migrated belongs to no pipeline until the migration ends, and a
+			 * process that failed to run was already removed from its pipeline */
+			pipeline_migrate_lock();
+			if (obj->pipeline && pipeline_remove((pipeline_t*) obj->pipeline, obj)) {
+				pipeline_migrate_unlock();
 				return -1;
 			}
+			pipeline_migrate_unlock();
 		break;
 		case SCHEDULING_BESTEFFORT:
-			if (modulethread_remove(obj)) {
+			if (dataflow_enabled()) {
+				/* it may still be running in a worker */
+				if (dataflow_remove(obj)) {
+					aerror_msg("Timeout removing process pid=%d\n",obj->pid);
+				}
+			} else if (modulethread_remove(obj)) {
 				return -1;
 			}
 		break;
+		case SCHEDULING_DAG:
+			obj->runnable = 0;
+			pipeline_migrate_lock();
+			if (obj->pipeline && pipeline_remove((pipeline_t*) obj->pipeline, obj)) {
+				pipeline_migrate_unlock();
+				return -1;
+			}
+			pipeline_migrate_unlock();
+			pipeline_dag_remove_deps(obj);
+			/* it may still be in the graph of the current time slot */
+			if (pipeline_dag_wait_update()) {
+				aerror_msg("Timeout removing process pid=%d from the graph\n",obj->pid);
+			}
+		break;
 	}
 
 
 
 	dlclose(obj->dl_handle);
+	rtdal_trace_fmt_reset();
 
 	char *name = strstr(obj->attributes.binary_path,"/");
 	if (!name) {
@@ -156,6 +186,9 @@ int rtdal_process_run(r_proc_t process) {
 	rtdal_process_t *obj = (rtdal_process_t*) process;
 	hdebug("pid=%d\n",obj->pid);
 	obj->runnable = 1;
+	if (dataflow_enabled()) {
+		dataflow_wake(obj);
+	}
 	return 0;
 }
 
@@ -226,3 +259,196 @@ int rtdal_process_group_notified(r_proc_t proc) {
 	pgroup_notified_failure[obj->attributes.process_group_id] = 0;
 	return 0;
 }
+
+/**
+ * Declares that the process proc reads in the same time slot the data written by the process
+ * pred, so it must run after it. Only used with the dag scheduling, where processes without
+ * dependencies between them may run in parallel on any core, and with the edf_order option of
+ * the pipeline scheduling, where they give the deadline of pred. The dependencies of a process
+ * are removed with it.
+ * \param proc Process handler given by rtdal_process_new()
+ * \param pred Process that runs before proc in each time slot
+ * \returns 0 on success, -1 on error or if the dependency creates a cycle
+ */
+int rtdal_process_depends(r_proc_t proc, r_proc_t pred) {
+	RTDAL_ASSERT_PARAM(proc);
+	RTDAL_ASSERT_PARAM(pred);
+	hdebug("pid=%d, pred_pid=%d\n",((rtdal_process_t*) proc)->pid,((rtdal_process_t*) pred)->pid);
+	rtdal_process_t *obj = (rtdal_process_t*) proc, *pobj = (rtdal_process_t*) pred;
+	if (pipeline_dag_add_dep(obj, pobj)) {
+		return -1;
+	}
+	/* the deadlines change, sort the pipelines again */
+	if (obj->pipeline) {
+		__atomic_store_n(&((pipeline_t*) obj->pipeline)->edf_dirty, 1, __ATOMIC_RELEASE);
+	}
+	if (pobj->pipeline) {
+		__atomic_store_n(&((pipeline_t*) pobj->pipeline)->edf_dirty, 1, __ATOMIC_RELEASE);
+	}
+	return 0;
+}
+
+/**
+ * Declares that the process proc reads the packets written by the process src with a delay of
+ * delay time slots. Only used with the batch clock, where the pipeline of proc does not start a
+ * time slot before the pipeline of src has written the packets for it. Processes in the same
+ * pipeline and negative delays are ignored. Does nothing with the other clocks.
+ * \param proc Process handler given by rtdal_process_new()
+ * \param src Process writing the packets
+ * \param delay Delay of the interface, in time slots
+ * \returns 0 on success, -1 on error or if both pipelines would wait for each other
+ */
+int rtdal_process_link(r_proc_t proc, r_proc_t src, int delay) {
+	RTDAL_ASSERT_PARAM(proc);
+	RTDAL_ASSERT_PARAM(src);
+	rtdal_process_t *obj = (rtdal_process_t*) proc, *sobj = (rtdal_process_t*) src;
+	hdebug("pid=%d, src_pid=%d, delay=%d\n",obj->pid,sobj->pid,delay);
+	if (rtdal.machine.clock_mode != BATCH_TIMER) {
+		return 0;
+	}
+	return pipeline_batch_link(obj->attributes.pipeline_id, sobj->attributes.pipeline_id, delay);
+}
+
+/**
+ * Declares that the process proc reads (is_input=1) or writes the internal interface itf. Only
+ * used with the best-effort scheduling and a worker pool (besteffort_workers option), where a
+ * process runs when all its blocking inputs have a packet and all its blocking outputs have
+ * space, and is woken up when they change. The interface is forgotten when it or the process
+ * are removed. Does nothing with the other schedulings.
+ * \param proc Process handler given by rtdal_process_new()
+ * \param itf Internal interface
+ * \param is_input 1 if the process reads from itf, 0 if it writes to it
+ * \returns 0 on success, -1 on error
+ */
+int rtdal_process_add_itf(r_proc_t proc, r_itf_t itf, int is_input) {
+	RTDAL_ASSERT_PARAM(proc);
+	RTDAL_ASSERT_PARAM(itf);
+	hdebug("pid=%d, itf=0x%x, is_input=%d\n",((rtdal_process_t*) proc)->pid,itf,is_input);
+	if (rtdal.machine.scheduling != SCHEDULING_BESTEFFORT || !dataflow_enabled()) {
+		return 0;
+	}
+	return dataflow_add_itf((rtdal_process_t*) proc, itf, is_input);
+}
+
+/**
+ * Moves the processes procs to the pipeline pipeline_id without stopping them. The processes
+ * leave their pipeline after running a time slot and run in the new one from the next time
+ * slot, in their exec_position order. All of them must be in the same pipeline, and processes
+ * exchanging packets with zero delay must be moved together. Only with the pipeline scheduling.
+ * Blocks until the migration is done, or fails after up to two seconds if the pipelines are not
+ * running, leaving the processes in their pipeline.
+ * \param procs Process handlers given by rtdal_process_new()
+ * \param nof_procs Number of processes in procs
+ * \param pipeline_id Destination pipeline
+ * \returns 0 on success, -1 on error
+ */
+int rtdal_process_migrate(r_proc_t *procs, int nof_procs, int pipeline_id) {
+	RTDAL_ASSERT_PARAM(procs);
+	RTDAL_ASSERT_PARAM(nof_procs > 0);
+	rtdal_process_t *obj = (rtdal_process_t*) procs[0];
+	RTDAL_ASSERT_PARAM(obj);
+	hdebug("pid=%d, nof_procs=%d, pipeline_id=%d\n",obj->pid,nof_procs,pipeline_id);
+	if (rtdal.machine.scheduling != SCHEDULING_PIPELINE
+			|| pipeline_id < 0 || pipeline_id >= rtdal.machine.nof_cores) {
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		return -1;
+	}
+	if (&rtdal.pipelines[pipeline_id] == obj->pipeline) {
+		return 0;
+	}
+	return pipeline_migrate(obj->pipeline, &rtdal.pipelines[pipeline_id],
+			(rtdal_process_t**) procs, nof_procs);
+}
+
+/**
+ * Returns the number of consecutive time slots that the pipeline pipeline_id has finished
+ * after the beginning of the next one, or -1 on error.
+ */
+int rtdal_pipeline_overruns(int pipeline_id) {
+	if (pipeline_id < 0 || pipeline_id >= rtdal.machine.nof_cores) {
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		return -1;
+	}
+	return rtdal.pipelines[pipeline_id].overruns;
+}
+
+/**
+ * Returns the number of time slots that the pipeline pipeline_id has not run since it started,
+ * or -1 on error. A time slot is not run when the timer skips it (timer_overrun="skip") or when
+ * it starts while the pipeline is still running the previous one.
+ */
+long long rtdal_pipeline_missed_slots(int pipeline_id) {
+	if (pipeline_id < 0 || pipeline_id >= rtdal.machine.nof_cores) {
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		return -1;
+	}
+	return __atomic_load_n(&rtdal.pipelines[pipeline_id].missed_slots, __ATOMIC_RELAXED);
+}
+
+/**
+ * Copies to stats the slack measured by the pipeline pipeline_id since it started. Only filled
+ * if the slack_stats option is enabled.
+ * \returns 0 on success, -1 on error
+ */
+int rtdal_pipeline_get_stats(int pipeline_id, rtdal_pipeline_stats_t *stats) {
+	RTDAL_ASSERT_PARAM(stats);
+	if (pipeline_id < 0 || pipeline_id >= rtdal.machine.nof_cores) {
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		return -1;
+	}
+	memcpy(stats, &rtdal.pipelines[pipeline_id].stats, sizeof(rtdal_pipeline_stats_t));
+	return 0;
+}
+
+/**
+ * Copies to stats the wake-up error measured by the pipeline pipeline_id since it started. Only
+ * filled if the jitter_stats option is enabled. It may be called while the pipeline is running.
+ * \returns 0 on success, -1 on error
+ */
+int rtdal_pipeline_get_jitter(int pipeline_id, rtdal_jitter_stats_t *stats) {
+	rtdal_jitter_stats_t *s;
+	int i;
+
+	RTDAL_ASSERT_PARAM(stats);
+	if (pipeline_id < 0 || pipeline_id >= rtdal.machine.nof_cores) {
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		return -1;
+	}
+	s = &rtdal.pipelines[pipeline_id].jitter;
+	stats->slots = __atomic_load_n(&s->slots, __ATOMIC_ACQUIRE);
+	stats->max_ns = __atomic_load_n(&s->max_ns, __ATOMIC_RELAXED);
+	stats->sum_ns = __atomic_load_n(&s->sum_ns, __ATOMIC_RELAXED);
+	for (i=0;i<RTDAL_JITTER_HIST_SZ;i++) {
+		stats->hist[i] = __atomic_load_n(&s->hist[i], __ATOMIC_RELAXED);
+	}
+	return 0;
+}
+
+/**
+ * Copies to perf the hardware events counted by the pipeline pipeline_id while running its
+ * processes. Only filled if the perf_counters option is enabled. It may be called while the
+ * pipeline is running.
+ * \returns 0 on success, -1 on error
+ */
+int rtdal_pipeline_get_perf(int pipeline_id, rtdal_perf_counters_t *perf) {
+	RTDAL_ASSERT_PARAM(perf);
+	if (pipeline_id < 0 || pipeline_id >= rtdal.machine.nof_cores) {
+		RTDAL_SETERROR(RTDAL_ERROR_INVAL);
+		return -1;
+	}
+	perf_get(&rtdal.pipelines[pipeline_id].perf_total, perf);
+	return 0;
+}
+
+/**
+ * Copies to perf the hardware events counted while running the process proc, in any pipeline.
+ * Only filled if the perf_counters option is enabled. It may be called while the process is
+ * running.
+ * \returns 0 on success, -1 on error
+ */
+int rtdal_process_get_perf(r_proc_t proc, rtdal_perf_counters_t *perf) {
+	RTDAL_ASSERT_PARAM(proc);
+	RTDAL_ASSERT_PARAM(perf);
+	perf_get(&((rtdal_process_t*) proc)->perf, perf);
+	return 0;
+}
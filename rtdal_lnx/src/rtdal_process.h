@@ -19,10 +19,17 @@
 #ifndef rtdal_PROCESS_H
 #define rtdal_PROCESS_H
 
+#include <pthread.h>
 #include "str.h"
 #include "rtdal_types.h"
 #include "rtdal.h"
 
+/** Maximum number of processes a process can depend on, see rtdal_process_depends() */
+#define RTDAL_PROCESS_MAX_PREDS	16
+
+/** Maximum number of interfaces of a process, see rtdal_process_add_itf() */
+#define RTDAL_PROCESS_MAX_ITF	32
+
 struct _rtdal_process_t {
 	int pid;
 
@@ -39,6 +46,24 @@ struct _rtdal_process_t {
 	strdef(error_msg);
 	/* pointer to the next process in the pipeline spscq */
 	struct _rtdal_process_t *next;
+	/* processes that run before this one in the same time slot with SCHEDULING_DAG */
+	struct _rtdal_process_t *preds[RTDAL_PROCESS_MAX_PREDS];
+	int nof_preds;
+	/* index of the process in the current graph, or -1 */
+	int dag_idx;
+	/* with edf_order, mean execution time and deadline relative to the start of the slot */
+	int edf_exec_ns;
+	int edf_deadline_ns;
+	/* with perf_counters, hardware events counted while it runs */
+	rtdal_perf_counters_t perf;
+	/* interfaces the process reads (itf_is_input=1) or writes with the best-effort worker pool */
+	r_itf_t itfs[RTDAL_PROCESS_MAX_ITF];
+	char itf_is_input[RTDAL_PROCESS_MAX_ITF];
+	int nof_itfs;
+	pthread_mutex_t itf_mutex;
+	/* state in the worker pool and next process in its ready list */
+	int df_state;
+	struct _rtdal_process_t *df_next;
 };
 typedef struct _rtdal_process_t rtdal_process_t;
 
@@ -27,6 +27,9 @@
 
 static rtdal_time_t *context = NULL;
 
+/* with the batch clock, the time slot of the pipeline running in this thread */
+static __thread int *thread_ts_counter = NULL;
+
 /**
  * Sets the rtdal context pointer
  * @param _context
@@ -36,6 +39,18 @@ void rtdal_time_set_context(rtdal_time_t *_context) {
 	context = _context;
 }
 
+/**
+ * Maps the realtime reference x to CLOCK_MONOTONIC and saves it in init_mono_ns
+ */
+static void time_set_mono_ref(struct timespec *x) {
+	struct timespec real, mono;
+
+	clock_gettime(CLOCK_REALTIME,&real);
+	clock_gettime(CLOCK_MONOTONIC,&mono);
+	context->init_mono_ns = (long long) mono.tv_sec*1000000000 + mono.tv_nsec
+			- ((long long) (real.tv_sec-x->tv_sec)*1000000000 + real.tv_nsec - x->tv_nsec);
+}
+
 int rtdal_time_reset() {
 	assert(context);
 
@@ -48,6 +63,7 @@ int rtdal_time_reset() {
 	context->init_time.tv_sec = x.tv_sec;
 	context->init_time.tv_usec = x.tv_nsec/1000;
 	context->ts_counter = 0;
+	time_set_mono_ref(&x);
 	return 0;
 }
 
@@ -59,6 +75,7 @@ int rtdal_time_reset_realtime(struct timespec *x) {
 	context->init_time.tv_sec = x->tv_sec;
 	context->init_time.tv_usec = x->tv_nsec/1000;
 	context->ts_counter = 0;
+	time_set_mono_ref(x);
 	last_time.tv_sec = x->tv_sec;
 	last_time.tv_usec = x->tv_nsec/1000;
 	return 0;
@@ -87,6 +104,32 @@ inline void rtdal_time_ts_inc() {
 #endif
 }
 
+/**
+ * Moves the time slot counter to the time slot starting at tick, the time of a timer tick. Time
+ * slot 1 starts at the reference time. Used with the skip overrun policy, so that the time slots
+ * missed by a late timer are skipped and the time slot counter, and so the timestamps of the
+ * packets, stay aligned with the real time. Several timers may call it for the same tick.
+ * \returns the number of time slots advanced, 0 if the counter was already there
+ */
+int rtdal_time_ts_align(struct timespec *tick) {
+	assert(context);
+	long long ns;
+	int cur, slot;
+
+	/* in ns: a slot length truncated to us would drift by one slot every few hundred slots */
+	ns = (long long) (tick->tv_sec-context->init_time.tv_sec)*1000000000
+			+ tick->tv_nsec - (long long) context->init_time.tv_usec*1000;
+	slot = (int) ((ns+context->ts_len_ns/2)/context->ts_len_ns)+1;
+	cur = __atomic_load_n(&context->ts_counter, __ATOMIC_RELAXED);
+	do {
+		if (cur >= slot) {
+			return 0;
+		}
+	} while(!__atomic_compare_exchange_n(&context->ts_counter, &cur, slot, 0,
+			__ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	return slot-cur;
+}
+
 /**
  * Sets the current time to time defined by the first argument
  * \returns 0 on success, -1 on error.
@@ -136,9 +179,20 @@ int rtdal_time_get(time_t *time) {
 int rtdal_time_slot() {
 	assert(context);
 
+	if (thread_ts_counter) {
+		return *thread_ts_counter;
+	}
 	return context->ts_counter;
 }
 
+/**
+ * Makes rtdal_time_slot() return *ts_counter when called from this thread, or the global time
+ * slot if ts_counter is NULL. With the batch clock, each pipeline runs its own time slots.
+ */
+void rtdal_time_set_thread_slot(int *ts_counter) {
+	thread_ts_counter = ts_counter;
+}
+
 /**
  * tdata points to a buffer of 3 time_t consecutive structures.
  * Computes the time interval between position 1 and position 2, storing
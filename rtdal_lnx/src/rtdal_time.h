@@ -30,10 +30,19 @@ typedef struct {
 	 */
 	time_t init_time;
 	int init_time_is_shm;
+	/**
+	 * init_time on CLOCK_MONOTONIC, in ns. Execution times are measured against it so that
+	 * steps or slews of the realtime clock do not show up as jitter.
+	 */
+	long long init_mono_ns;
 	/**
 	 * Time-slot length, in microseconds
 	 */
 	int ts_len_us;
+	/**
+	 * Time-slot length, in nanoseconds. ts_len_us is truncated from it
+	 */
+	long long ts_len_ns;
 	/**
 	 * Time-slot number. Incremented every event of the kernel-thread timer.
 	 */
@@ -47,7 +56,9 @@ typedef struct {
 
 void rtdal_time_set_context(rtdal_time_t *_context);
 void rtdal_time_ts_inc();
+int rtdal_time_ts_align(struct timespec *tick);
 int rtdal_time_reset();
 int rtdal_time_reset_realtime(struct timespec *x);
+void rtdal_time_set_thread_slot(int *ts_counter);
 
 #endif
@@ -43,6 +43,8 @@ void* timer_run_thread(void* x) {
 #endif
 	case NANOSLEEP:
 		return nanoclock_timer_run_thread(obj);
+	case HYBRID:
+		return hybrid_timer_run_thread(obj);
 	default:
 		aerror_msg("Unknown timer mode %d\n", obj->mode);
 		return NULL;
@@ -64,7 +66,39 @@ void timespec_sub_us(struct timespec *t, long int us) {
 	}
 }
 
+static inline long long timespec_to_ns(struct timespec *t) {
+	return (long long) t->tv_sec*1000000000+t->tv_nsec;
+}
+
+static inline void timespec_add_periods(struct timespec *t, long int period, long long n) {
+	long long x = timespec_to_ns(t)+n*period;
+	t->tv_sec = x/1000000000;
+	t->tv_nsec = x%1000000000;
+}
+
+/**
+ * Called after waking up for the tick at next_ns, now_ns is the current time in the same clock.
+ * Adds to wakeups_missed the ticks that have passed without being served. behind keeps the ticks
+ * already counted, so a burst of compressed ticks after an overrun is counted once.
+ * \returns the number of periods the tick must be moved forward, 0 with OVERRUN_COMPRESS
+ */
+static inline long long timer_overrun(rtdal_timer_t *obj, long long next_ns, long long now_ns) {
+	long long late;
+
+	late = (now_ns-next_ns)/obj->period;
+	if (late > obj->behind) {
+		obj->wakeups_missed += late-obj->behind;
+	}
+	if (obj->overrun == OVERRUN_SKIP) {
+		return late;
+	}
+	obj->behind = late;
+	return 0;
+}
+
 void* nanoclock_timer_run_thread(rtdal_timer_t* obj) {
+	struct timespec now;
+	long long skip;
 	int s;
 	int n;
 	assert(obj->period_function);
@@ -84,6 +118,70 @@ void* nanoclock_timer_run_thread(rtdal_timer_t* obj) {
 		timespec_add_us(&obj->next, obj->period);
 		clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME,
 				&obj->next, NULL);
+		clock_gettime(CLOCK_REALTIME, &now);
+		skip = timer_overrun(obj, timespec_to_ns(&obj->next), timespec_to_ns(&now));
+		if (skip) {
+			timespec_add_periods(&obj->next, obj->period, skip);
+		}
+
+		timelog(obj->log);
+
+		n++;
+		if (n>=obj->multiple) {
+			obj->period_function(obj->arg, &obj->next);
+			n=0;
+		}
+	}
+
+	s = 0;
+	pthread_exit(&s);
+	return NULL;
+}
+
+/**
+ * Sleeps on CLOCK_MONOTONIC until spin_ns before the end of the period and busy-waits the rest,
+ * which removes most of the wake-up latency of the scheduler at the cost of a busy core during
+ * spin_ns. Deadlines are absolute, so the error of a period does not accumulate on the next one.
+ * The rest of rtdal works with CLOCK_REALTIME: period_function receives the same tick as
+ * the NANOSLEEP timer, translated with the offset between both clocks measured at start.
+ */
+void* hybrid_timer_run_thread(rtdal_timer_t* obj) {
+	struct timespec mono, real, sleep;
+	long long next_ns, sleep_ns, offset_ns, skip;
+	int s;
+	int n;
+	assert(obj->period_function);
+
+	obj->stop = 0;
+	if (obj->wait_futex) {
+		futex_wait(obj->wait_futex);
+		obj->next.tv_sec+=TIMER_FUTEX_GUARD_SEC;
+		obj->next.tv_nsec=0;
+	} else {
+		clock_gettime(CLOCK_REALTIME, &obj->next);
+	}
+	clock_gettime(CLOCK_REALTIME, &real);
+	clock_gettime(CLOCK_MONOTONIC, &mono);
+	offset_ns = timespec_to_ns(&real)-timespec_to_ns(&mono);
+	next_ns = timespec_to_ns(&obj->next)-offset_ns;
+
+	n=0;
+	while(!obj->stop) {
+		timespec_add_us(&obj->next, obj->period);
+		next_ns += obj->period;
+
+		sleep_ns = next_ns-obj->spin_ns;
+		sleep.tv_sec = sleep_ns/1000000000;
+		sleep.tv_nsec = sleep_ns%1000000000;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &sleep, NULL);
+		do {
+			clock_gettime(CLOCK_MONOTONIC, &mono);
+		} while(timespec_to_ns(&mono) < next_ns);
+		skip = timer_overrun(obj, next_ns, timespec_to_ns(&mono));
+		if (skip) {
+			timespec_add_periods(&obj->next, obj->period, skip);
+			next_ns += skip*obj->period;
+		}
 
 		timelog(obj->log);
 
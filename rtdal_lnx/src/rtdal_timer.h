@@ -23,10 +23,12 @@
 #include <sys/time.h>
 #include <time.h>
 
+#include "rtdal_machine.h"
+
 #define TIMER_FUTEX_GUARD_SEC 	2
 #define KERNEL_OFFSET_USEC	30
 enum timer_mode {
-	NANOSLEEP, TIMERFD, XENOMAI
+	NANOSLEEP, TIMERFD, XENOMAI, HYBRID
 };
 
 typedef struct
@@ -34,8 +36,12 @@ typedef struct
 	struct timespec next;
 	int timer_fd;
 	unsigned long long wakeups_missed;
+	long long behind;
+	enum timer_overrun overrun;
 	struct itimerspec itval;
 	long int period;
+	/* HYBRID only: the last spin_ns of each period are busy-waited */
+	long int spin_ns;
 	int multiple;
 	int stop;
 	pthread_t *thread;
@@ -51,6 +57,7 @@ void *xenomai_timer_run_thread(rtdal_timer_t *obj);
 #endif
 void* nanoclock_timer_run_thread(rtdal_timer_t* x);
 void* timerfd_timer_run_thread(rtdal_timer_t* x);
+void* hybrid_timer_run_thread(rtdal_timer_t* x);
 void *timer_run_thread(void *timer);
 int timer_setup(rtdal_timer_t *timer);
 int timer_start(rtdal_timer_t *timer);
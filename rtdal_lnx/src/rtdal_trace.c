@@ -0,0 +1,678 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "rtdal.h"
+#include "rtdal_error.h"
+#include "rtdal_trace.h"
+#include "defs.h"
+
+/*
+ * Per-thread binary trace rings. Each thread writing to a log gets its own single producer single
+ * consumer ring the first time it writes, so the real-time threads never take a lock or format
+ * a string: rtdal_log_printf() stores the format pointer and the arguments. A low priority
+ * flusher thread copies the rings to TRACE_FILE_NAME every flush_ms, through a shared mapping of
+ * the file, so the records already flushed survive a crash. When a ring is full the record is
+ * dropped and counted. trace_decode converts the file into the log files.
+ */
+
+#define TRACE_MAX_THREADS	128
+#define TRACE_FMT_CACHE		256
+#define TRACE_FILE_CHUNK	(4*1024*1024)
+
+enum ring_state {
+	RING_FREE, RING_INIT, RING_USED, RING_ORPHAN
+};
+
+typedef struct {
+	int state;
+	int tid;
+	uint64_t size;
+	char *buffer;
+	/* written by the thread */
+	uint64_t head __attribute__((aligned(64)));
+	uint64_t dropped;
+	const char *fmt_cache[TRACE_FMT_CACHE];
+	int fmt_gen;
+	/* written by the flusher */
+	uint64_t tail __attribute__((aligned(64)));
+	uint64_t dropped_flushed;
+} trace_ring_t;
+
+static trace_ring_t rings[TRACE_MAX_THREADS];
+static int nof_rings;
+static uint64_t ring_size;
+static uint64_t lost_no_ring;
+static int fmt_gen;
+static __thread trace_ring_t *my_ring;
+static pthread_key_t ring_key;
+
+static int trace_enabled;
+int rtdal_trace_timeline;
+static int flush_period_ms;
+static int flusher_stop;
+static pthread_t flusher;
+
+static int fd = -1;
+static char *map;
+static size_t map_pos;
+static size_t file_len;
+
+static inline uint64_t trace_time_ns() {
+	struct timespec t;
+	clock_gettime(CLOCK_REALTIME, &t);
+	return (uint64_t) t.tv_sec*1000000000+t.tv_nsec;
+}
+
+/* the clock of the records, to measure the beginning of TRACE_EXEC and TRACE_WAIT */
+uint64_t rtdal_trace_time() {
+	return trace_time_ns();
+}
+
+/* pthread key destructor: the flusher frees the ring once it is empty */
+static void trace_ring_release(void *arg) {
+	trace_ring_t *r = (trace_ring_t*) arg;
+	__atomic_store_n(&r->state, RING_ORPHAN, __ATOMIC_RELEASE);
+}
+
+/**
+ * Returns the ring of the calling thread, taking a free one the first time.
+ */
+static trace_ring_t *trace_ring() {
+	trace_ring_t *r;
+	int i, state, n;
+
+	if (my_ring) {
+		return my_ring;
+	}
+	for (i=0;i<TRACE_MAX_THREADS;i++) {
+		r = &rings[i];
+		state = RING_FREE;
+		if (!__atomic_compare_exchange_n(&r->state, &state, RING_INIT, 0,
+				__ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			continue;
+		}
+		if (!r->buffer) {
+			if (posix_memalign((void**) &r->buffer, 64, ring_size)) {
+				r->buffer = NULL;
+				__atomic_store_n(&r->state, RING_FREE, __ATOMIC_RELEASE);
+				break;
+			}
+			r->size = ring_size;
+		}
+		r->tid = (int) syscall(SYS_gettid);
+		memset(r->fmt_cache, 0, sizeof(r->fmt_cache));
+		r->fmt_gen = __atomic_load_n(&fmt_gen, __ATOMIC_ACQUIRE);
+		n = __atomic_load_n(&nof_rings, __ATOMIC_RELAXED);
+		while(n <= i && !__atomic_compare_exchange_n(&nof_rings, &n, i+1, 0,
+				__ATOMIC_RELEASE, __ATOMIC_RELAXED));
+		pthread_setspecific(ring_key, r);
+		__atomic_store_n(&r->state, RING_USED, __ATOMIC_RELEASE);
+		my_ring = r;
+		return r;
+	}
+	__atomic_add_fetch(&lost_no_ring, 1, __ATOMIC_RELAXED);
+	return NULL;
+}
+
+/**
+ * Reserves a contiguous record with len bytes of payload in the ring. A record that does not
+ * fit before the end of the buffer starts at the beginning, after a TRACE_PAD record (or after
+ * a gap shorter than a header, which the flusher skips too).
+ * \returns a pointer to the payload or NULL if the ring is full
+ */
+static char *trace_reserve(trace_ring_t *r, int type, int log_id, uint32_t len,
+		uint64_t *next_head) {
+	trace_rec_t *rec;
+	uint64_t head, tail, pos, to_end, need, skip;
+
+	need = TRACE_REC_SZ(len);
+	head = r->head;
+	tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+	pos = head & (r->size-1);
+	to_end = r->size-pos;
+	skip = to_end<need?to_end:0;
+	if (need > r->size/2 || head+skip+need-tail > r->size) {
+		__atomic_store_n(&r->dropped, r->dropped+1, __ATOMIC_RELAXED);
+		return NULL;
+	}
+	if (skip) {
+		if (to_end >= sizeof(trace_rec_t)) {
+			rec = (trace_rec_t*) &r->buffer[pos];
+			rec->type = TRACE_PAD;
+			rec->len = to_end-sizeof(trace_rec_t);
+		}
+		head += skip;
+	}
+	rec = (trace_rec_t*) &r->buffer[head & (r->size-1)];
+	rec->time_ns = trace_time_ns();
+	rec->type = type;
+	rec->log_id = log_id;
+	rec->len = len;
+	*next_head = head+need;
+	return (char*) (rec+1);
+}
+
+static inline void trace_commit(trace_ring_t *r, uint64_t next_head) {
+	__atomic_store_n(&r->head, next_head, __ATOMIC_RELEASE);
+}
+
+void rtdal_trace_data(int log_id, void *data, int len) {
+	trace_ring_t *r;
+	uint64_t next;
+	char *p;
+
+	if (!trace_enabled || !(r = trace_ring())) {
+		return;
+	}
+	if ((p = trace_reserve(r, TRACE_DATA, log_id, len, &next))) {
+		memcpy(p, data, len);
+		trace_commit(r, next);
+	}
+}
+
+void rtdal_trace_us(int log_id) {
+	trace_ring_t *r;
+	uint64_t next;
+
+	if (!trace_enabled || !(r = trace_ring())) {
+		return;
+	}
+	if (trace_reserve(r, TRACE_US, log_id, 0, &next)) {
+		trace_commit(r, next);
+	}
+}
+
+void rtdal_trace_tslot(int log_id, int tslot) {
+	trace_ring_t *r;
+	uint64_t next;
+	char *p;
+
+	if (!trace_enabled || !(r = trace_ring())) {
+		return;
+	}
+	if ((p = trace_reserve(r, TRACE_TSLOT, log_id, sizeof(int32_t), &next))) {
+		memcpy(p, &tslot, sizeof(int32_t));
+		trace_commit(r, next);
+	}
+}
+
+/**
+ * Writes a fixed size record of the timeline.
+ */
+void rtdal_trace_event(int type, void *payload, int len) {
+	trace_ring_t *r;
+	uint64_t next;
+	char *p;
+
+	if (!trace_enabled || !(r = trace_ring())) {
+		return;
+	}
+	if ((p = trace_reserve(r, type, 0, len, &next))) {
+		memcpy(p, payload, len);
+		trace_commit(r, next);
+	}
+}
+
+/**
+ * Names a process or interface handler in the timeline.
+ */
+void rtdal_trace_object(void *obj, char *name) {
+	trace_ring_t *r;
+	uint64_t next, key = (uint64_t) (uintptr_t) obj;
+	int len = strlen(name)+1;
+	char *p;
+
+	if (!trace_enabled || !(r = trace_ring())) {
+		return;
+	}
+	if ((p = trace_reserve(r, TRACE_OBJECT, 0, sizeof(uint64_t)+len, &next))) {
+		memcpy(p, &key, sizeof(uint64_t));
+		memcpy(p+sizeof(uint64_t), name, len);
+		trace_commit(r, next);
+	}
+}
+
+void rtdal_trace_name(int log_id, int mode, char *name) {
+	trace_ring_t *r;
+	uint64_t next;
+	uint32_t m = (uint32_t) mode;
+	int len = strlen(name)+1;
+	char *p;
+
+	if (!trace_enabled || !(r = trace_ring())) {
+		return;
+	}
+	if ((p = trace_reserve(r, TRACE_NAME, log_id, sizeof(uint32_t)+len, &next))) {
+		memcpy(p, &m, sizeof(uint32_t));
+		memcpy(p+sizeof(uint32_t), name, len);
+		trace_commit(r, next);
+	}
+}
+
+/**
+ * Forgets the formats written to the rings, so they are written again the next time they are used.
+ * Called when a module is unloaded, because the module loaded next may place different formats at
+ * the same addresses.
+ */
+void rtdal_trace_fmt_reset() {
+	__atomic_add_fetch(&fmt_gen, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Writes the format string to the ring of the thread the first time it is used by this thread.
+ * \returns 0 if the format is in the ring, -1 if it could not be written
+ */
+static int trace_fmt(trace_ring_t *r, const char *format) {
+	int idx = (int) (((uintptr_t) format >> 3) & (TRACE_FMT_CACHE-1));
+	uint64_t ptr = (uint64_t) (uintptr_t) format, next;
+	int len, gen;
+	char *p;
+
+	gen = __atomic_load_n(&fmt_gen, __ATOMIC_ACQUIRE);
+	if (r->fmt_gen != gen) {
+		memset(r->fmt_cache, 0, sizeof(r->fmt_cache));
+		r->fmt_gen = gen;
+	}
+	if (r->fmt_cache[idx] == format) {
+		return 0;
+	}
+	len = strlen(format)+1;
+	if (!(p = trace_reserve(r, TRACE_FMT, 0, sizeof(uint64_t)+len, &next))) {
+		return -1;
+	}
+	memcpy(p, &ptr, sizeof(uint64_t));
+	memcpy(p+sizeof(uint64_t), format, len);
+	trace_commit(r, next);
+	r->fmt_cache[idx] = format;
+	return 0;
+}
+
+static inline char *trace_put64(char *p, uint64_t x) {
+	memcpy(p, &x, sizeof(uint64_t));
+	return p+sizeof(uint64_t);
+}
+
+void rtdal_trace_vprintf(int log_id, const char *format, va_list ap) {
+	trace_ring_t *r;
+	const char *f, *spec, *s;
+	int stars, arg, i;
+	uint32_t len, n;
+	uint64_t next;
+	double d;
+	va_list aq;
+	char *p;
+
+	if (!trace_enabled || !(r = trace_ring())) {
+		return;
+	}
+	if (trace_fmt(r, format)) {
+		return;
+	}
+	/* size of the arguments */
+	va_copy(aq, ap);
+	len = sizeof(uint64_t);
+	f = format;
+	while((f = trace_fmt_next(f, &spec, &stars, &arg))) {
+		for (i=0;i<stars;i++) {
+			(void) va_arg(aq, int);
+		}
+		len += stars*sizeof(uint64_t);
+		switch(arg) {
+		case TRACE_ARG_NONE:
+			break;
+		case TRACE_ARG_INT:
+			(void) va_arg(aq, int);
+			len += sizeof(uint64_t);
+			break;
+		case TRACE_ARG_LONG:
+			(void) va_arg(aq, long);
+			len += sizeof(uint64_t);
+			break;
+		case TRACE_ARG_LLONG:
+			(void) va_arg(aq, long long);
+			len += sizeof(uint64_t);
+			break;
+		case TRACE_ARG_DOUBLE:
+			(void) va_arg(aq, double);
+			len += sizeof(uint64_t);
+			break;
+		case TRACE_ARG_LDOUBLE:
+			(void) va_arg(aq, long double);
+			len += sizeof(uint64_t);
+			break;
+		case TRACE_ARG_PTR:
+			(void) va_arg(aq, void*);
+			len += sizeof(uint64_t);
+			break;
+		case TRACE_ARG_STR:
+			s = va_arg(aq, char*);
+			n = s?strnlen(s, TRACE_STR_MAX):6;
+			len += (sizeof(uint32_t)+n+TRACE_ALIGN-1)&~(TRACE_ALIGN-1);
+			break;
+		}
+	}
+	va_end(aq);
+
+	if (!(p = trace_reserve(r, TRACE_PRINTF, log_id, len, &next))) {
+		return;
+	}
+	p = trace_put64(p, (uint64_t) (uintptr_t) format);
+	f = format;
+	while((f = trace_fmt_next(f, &spec, &stars, &arg))) {
+		for (i=0;i<stars;i++) {
+			p = trace_put64(p, (uint64_t) (int64_t) va_arg(ap, int));
+		}
+		switch(arg) {
+		case TRACE_ARG_NONE:
+			break;
+		case TRACE_ARG_INT:
+			p = trace_put64(p, (uint64_t) (int64_t) va_arg(ap, int));
+			break;
+		case TRACE_ARG_LONG:
+			p = trace_put64(p, (uint64_t) (int64_t) va_arg(ap, long));
+			break;
+		case TRACE_ARG_LLONG:
+			p = trace_put64(p, (uint64_t) va_arg(ap, long long));
+			break;
+		case TRACE_ARG_DOUBLE:
+			d = va_arg(ap, double);
+			memcpy(p, &d, sizeof(double));
+			p += sizeof(uint64_t);
+			break;
+		case TRACE_ARG_LDOUBLE:
+			d = (double) va_arg(ap, long double);
+			memcpy(p, &d, sizeof(double));
+			p += sizeof(uint64_t);
+			break;
+		case TRACE_ARG_PTR:
+			p = trace_put64(p, (uint64_t) (uintptr_t) va_arg(ap, void*));
+			break;
+		case TRACE_ARG_STR:
+			s = va_arg(ap, char*);
+			if (!s) {
+				s = "(null)";
+			}
+			n = strnlen(s, TRACE_STR_MAX);
+			memcpy(p, &n, sizeof(uint32_t));
+			memcpy(p+sizeof(uint32_t), s, n);
+			p += (sizeof(uint32_t)+n+TRACE_ALIGN-1)&~(TRACE_ALIGN-1);
+			break;
+		}
+	}
+	trace_commit(r, next);
+}
+
+/**
+ * Appends len bytes to the trace file, extending it and moving the mapping TRACE_FILE_CHUNK
+ * bytes at a time.
+ */
+static int trace_file_write(void *data, size_t len) {
+	size_t n;
+
+	while(len > 0) {
+		if (!map || map_pos == TRACE_FILE_CHUNK) {
+			if (map) {
+				munmap(map, TRACE_FILE_CHUNK);
+				map = NULL;
+			}
+			if (ftruncate(fd, file_len+TRACE_FILE_CHUNK)) {
+				RTDAL_SYSERROR("ftruncate");
+				return -1;
+			}
+			map = mmap(NULL, TRACE_FILE_CHUNK, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+					file_len);
+			if (map == MAP_FAILED) {
+				map = NULL;
+				RTDAL_SYSERROR("mmap");
+				return -1;
+			}
+			map_pos = 0;
+		}
+		n = TRACE_FILE_CHUNK-map_pos;
+		if (n > len) {
+			n = len;
+		}
+		memcpy(&map[map_pos], data, n);
+		map_pos += n;
+		file_len += n;
+		data = (char*) data+n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int trace_file_rec(int type, void *payload, uint32_t len) {
+	char buffer[TRACE_REC_SZ(16)];
+	trace_rec_t *rec = (trace_rec_t*) buffer;
+
+	memset(buffer, 0, sizeof(buffer));
+	rec->time_ns = trace_time_ns();
+	rec->type = type;
+	rec->len = len;
+	memcpy(rec+1, payload, len);
+	return trace_file_write(buffer, TRACE_REC_SZ(len));
+}
+
+/**
+ * Copies to the file the records written since the last call, coalescing the contiguous ones.
+ */
+static int trace_flush_ring(int idx, trace_ring_t *r) {
+	uint64_t head, tail, pos, to_end, run, run_len, dropped;
+	uint32_t thread[2];
+	trace_rec_t *rec;
+
+	head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+	dropped = __atomic_load_n(&r->dropped, __ATOMIC_RELAXED);
+	tail = r->tail;
+	if (head == tail && dropped == r->dropped_flushed) {
+		return 0;
+	}
+	thread[0] = idx;
+	thread[1] = r->tid;
+	if (trace_file_rec(TRACE_THREAD, thread, sizeof(thread))) {
+		return -1;
+	}
+	if (dropped != r->dropped_flushed) {
+		run = dropped-r->dropped_flushed;
+		if (trace_file_rec(TRACE_DROP, &run, sizeof(uint64_t))) {
+			return -1;
+		}
+		r->dropped_flushed = dropped;
+	}
+	run = tail & (r->size-1);
+	run_len = 0;
+	while(tail < head) {
+		pos = tail & (r->size-1);
+		to_end = r->size-pos;
+		if (to_end < sizeof(trace_rec_t)) {
+			rec = NULL;
+		} else {
+			rec = (trace_rec_t*) &r->buffer[pos];
+		}
+		if (!rec || rec->type == TRACE_PAD) {
+			if (run_len && trace_file_write(&r->buffer[run], run_len)) {
+				return -1;
+			}
+			tail += rec?TRACE_REC_SZ(rec->len):to_end;
+			run = tail & (r->size-1);
+			run_len = 0;
+		} else {
+			if (pos != run+run_len) {
+				/* wrapped at the end of the buffer */
+				if (run_len && trace_file_write(&r->buffer[run], run_len)) {
+					return -1;
+				}
+				run = pos;
+				run_len = 0;
+			}
+			run_len += TRACE_REC_SZ(rec->len);
+			tail += TRACE_REC_SZ(rec->len);
+		}
+	}
+	if (run_len && trace_file_write(&r->buffer[run], run_len)) {
+		return -1;
+	}
+	__atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static int trace_flush_all() {
+	int i, n, state;
+
+	n = __atomic_load_n(&nof_rings, __ATOMIC_ACQUIRE);
+	for (i=0;i<n;i++) {
+		state = __atomic_load_n(&rings[i].state, __ATOMIC_ACQUIRE);
+		if (state == RING_FREE || state == RING_INIT) {
+			continue;
+		}
+		if (trace_flush_ring(i, &rings[i])) {
+			return -1;
+		}
+		if (state == RING_ORPHAN) {
+			/* the thread has exited, so the ring is empty now */
+			__atomic_store_n(&rings[i].state, RING_FREE, __ATOMIC_RELEASE);
+		}
+	}
+	return 0;
+}
+
+static void *trace_flusher(void *arg) {
+	struct timespec period;
+
+	period.tv_sec = flush_period_ms/1000;
+	period.tv_nsec = (flush_period_ms%1000)*1000000;
+	while(!__atomic_load_n(&flusher_stop, __ATOMIC_ACQUIRE)) {
+		if (trace_flush_all()) {
+			aerror("Writing trace file. Tracing stopped\n");
+			rtdal_trace_timeline = 0;
+			trace_enabled = 0;
+			break;
+		}
+		nanosleep(&period, NULL);
+	}
+	return NULL;
+}
+
+/**
+ * Creates the trace file in base_path and starts the flusher thread, with normal (not
+ * real-time) scheduling. Each thread gets a ring of ring_kb kbytes, rounded up to a power of two.
+ * \returns 0 on success, -1 on error
+ */
+int rtdal_trace_init(char *base_path, int ring_kb, int flush_ms) {
+	struct {
+		uint64_t magic;
+		uint32_t version;
+		uint32_t ring_size;
+	} header;
+	struct sched_param param;
+	pthread_attr_t attr;
+	char tmp[256];
+	int s;
+
+	RTDAL_ASSERT_PARAM(base_path);
+	RTDAL_ASSERT_PARAM(ring_kb > 0);
+	RTDAL_ASSERT_PARAM(flush_ms > 0);
+
+	ring_size = 4096;
+	while(ring_size < (uint64_t) ring_kb*1024) {
+		ring_size <<= 1;
+	}
+	flush_period_ms = flush_ms;
+
+	snprintf(tmp, sizeof(tmp), "%s/%s", base_path, TRACE_FILE_NAME);
+	fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		RTDAL_SYSERROR("open");
+		return -1;
+	}
+	header.magic = TRACE_MAGIC;
+	header.version = TRACE_VERSION;
+	header.ring_size = (uint32_t) ring_size;
+	if (trace_file_rec(TRACE_HEADER, &header, sizeof(header))) {
+		close(fd);
+		fd = -1;
+		return -1;
+	}
+	if ((s = pthread_key_create(&ring_key, trace_ring_release))) {
+		RTDAL_POSERROR(s, "pthread_key_create");
+		return -1;
+	}
+	trace_enabled = 1;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+	param.sched_priority = 0;
+	pthread_attr_setschedparam(&attr, &param);
+	s = pthread_create(&flusher, &attr, trace_flusher, NULL);
+	pthread_attr_destroy(&attr);
+	if (s) {
+		RTDAL_POSERROR(s, "pthread_create");
+		trace_enabled = 0;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Stops the flusher thread, writes the remaining records and truncates the file to its length.
+ */
+void rtdal_trace_stop() {
+	uint64_t dropped = 0;
+	int i;
+
+	if (fd < 0) {
+		return;
+	}
+	if (trace_enabled) {
+		__atomic_store_n(&flusher_stop, 1, __ATOMIC_RELEASE);
+		pthread_join(flusher, NULL);
+		rtdal_trace_timeline = 0;
+		trace_enabled = 0;
+		trace_flush_all();
+	}
+	for (i=0;i<nof_rings;i++) {
+		dropped += rings[i].dropped;
+	}
+	if (map) {
+		munmap(map, TRACE_FILE_CHUNK);
+		map = NULL;
+	}
+	if (ftruncate(fd, file_len)) {
+		RTDAL_SYSERROR("ftruncate");
+	}
+	close(fd);
+	fd = -1;
+	printf("Trace: %lu bytes written to %s",(unsigned long) file_len, TRACE_FILE_NAME);
+	if (dropped || lost_no_ring) {
+		printf(", %lu records dropped",(unsigned long) (dropped+lost_no_ring));
+	}
+	printf("\n");
+}
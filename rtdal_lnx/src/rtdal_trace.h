@@ -0,0 +1,133 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTDAL_TRACE_H_
+#define RTDAL_TRACE_H_
+
+#include <stdint.h>
+#include <stdarg.h>
+
+/*
+ * Binary trace format, shared by rtdal_trace.c and the trace_decode tool.
+ *
+ * The file is a sequence of records, each one a trace_rec_t header followed by len bytes of
+ * payload and padded to TRACE_ALIGN bytes. A record of type TRACE_NONE (zeros) ends the file,
+ * which happens when the program did not exit cleanly and the file was not truncated.
+ */
+
+#define TRACE_FILE_NAME		"trace.bin"
+#define TRACE_MAGIC			0x45434152544c4130ULL	/* "0ALTRACE" */
+#define TRACE_VERSION		1
+#define TRACE_ALIGN			8
+#define TRACE_REC_SZ(len)	((sizeof(trace_rec_t)+(len)+TRACE_ALIGN-1)&~(TRACE_ALIGN-1))
+
+enum trace_type {
+	TRACE_NONE = 0,
+	TRACE_HEADER,	/* first record: uint64 magic, uint32 version */
+	TRACE_THREAD,	/* the next records come from thread: uint32 thread index, uint32 tid */
+	TRACE_NAME,		/* log_id is named: uint32 r_log_mode_t, name with '\0' */
+	TRACE_DATA,		/* rtdal_log_add(): the data */
+	TRACE_US,		/* rtdal_log_add_us(): no payload, the time is in the header */
+	TRACE_TSLOT,	/* rtdal_log_add_tslot(): int32 time slot */
+	TRACE_FMT,		/* a format string of this thread: uint64 pointer, string with '\0' */
+	TRACE_PRINTF,	/* rtdal_log_printf(): uint64 format pointer, arguments (see below) */
+	TRACE_DROP,		/* uint64 records lost by the thread because its ring was full */
+	TRACE_PAD,		/* skipped */
+	/* timeline, see rtdal_log_trace_timeline() */
+	TRACE_OBJECT,	/* uint64 process or interface handler, name with '\0' */
+	TRACE_SLOT,		/* trace_slot_t: a pipeline starts a time slot */
+	TRACE_EXEC,		/* trace_exec_t: a process has run, the header time is the end */
+	TRACE_FAULT,	/* trace_fault_t: a pipeline has not finished the time slot */
+	TRACE_ITF,		/* trace_itf_t: a packet pushed or popped */
+	TRACE_WAIT		/* trace_wait_t: a blocking interface has waited, the header time is the end */
+};
+
+enum trace_itf_op {
+	TRACE_ITF_PUSH, TRACE_ITF_POP
+};
+
+typedef struct {
+	int32_t pipeline;
+	int32_t tslot;
+} trace_slot_t;
+
+typedef struct {
+	uint64_t begin_ns;
+	uint64_t proc;
+	int32_t pipeline;
+	int32_t tslot;
+} trace_exec_t;
+
+typedef struct {
+	uint64_t proc;
+	int32_t pipeline;
+	int32_t tslot;
+} trace_fault_t;
+
+typedef struct {
+	uint64_t itf;
+	int32_t op;
+	int32_t len;
+} trace_itf_t;
+
+typedef struct {
+	uint64_t begin_ns;
+	uint64_t itf;
+} trace_wait_t;
+
+/*
+ * The arguments of TRACE_PRINTF are stored in the order of the format conversions. Integers,
+ * pointers and floating point values (as double) take one 8 byte word, '*' widths and
+ * precisions too. Strings take a uint32 length followed by the characters, padded to 8 bytes.
+ */
+#define TRACE_STR_MAX		256
+
+enum trace_arg {
+	TRACE_ARG_NONE, TRACE_ARG_INT, TRACE_ARG_LONG, TRACE_ARG_LLONG, TRACE_ARG_DOUBLE,
+	TRACE_ARG_LDOUBLE, TRACE_ARG_PTR, TRACE_ARG_STR
+};
+
+const char *trace_fmt_next(const char *f, const char **spec, int *stars, int *arg);
+
+typedef struct {
+	uint64_t time_ns;	/* CLOCK_REALTIME */
+	uint16_t type;
+	uint16_t log_id;
+	uint32_t len;
+} trace_rec_t;
+
+extern int rtdal_trace_timeline;
+
+/* checked by the real-time threads before building a timeline record */
+static inline int rtdal_trace_timeline_on() {
+	return __builtin_expect(rtdal_trace_timeline, 0);
+}
+
+int rtdal_trace_init(char *base_path, int ring_kb, int flush_ms);
+void rtdal_trace_stop();
+void rtdal_trace_name(int log_id, int mode, char *name);
+void rtdal_trace_data(int log_id, void *data, int len);
+void rtdal_trace_us(int log_id);
+void rtdal_trace_tslot(int log_id, int tslot);
+void rtdal_trace_vprintf(int log_id, const char *format, va_list ap);
+uint64_t rtdal_trace_time();
+void rtdal_trace_event(int type, void *payload, int len);
+void rtdal_trace_object(void *obj, char *name);
+void rtdal_trace_fmt_reset();
+
+#endif
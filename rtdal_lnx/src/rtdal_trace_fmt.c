@@ -0,0 +1,83 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "rtdal_trace.h"
+
+/**
+ * Finds the next conversion of a printf format. *spec points to its '%', *stars is the number
+ * of '*' arguments it takes before its value and *arg the type of the value (TRACE_ARG_NONE for
+ * "%%").
+ * \returns a pointer to the character after the conversion or NULL if there are no more
+ */
+const char *trace_fmt_next(const char *f, const char **spec, int *stars, int *arg) {
+	int lng = 0;
+
+	while(*f && *f != '%') {
+		f++;
+	}
+	if (!*f) {
+		return NULL;
+	}
+	*spec = f++;
+	*stars = 0;
+	/* flags, width and precision */
+	while(*f && strchr("#0- +'.123456789*",*f)) {
+		if (*f == '*') {
+			(*stars)++;
+		}
+		f++;
+	}
+	/* length: 1 h, 2 l, 3 ll, 4 L */
+	while(*f && strchr("hlLqjzt",*f)) {
+		if (*f == 'l') {
+			lng = lng==2?3:2;
+		} else if (*f == 'q' || *f == 'j') {
+			lng = 3;
+		} else if (*f == 'z' || *f == 't') {
+			lng = 2;
+		} else if (*f == 'L') {
+			lng = 4;
+		} else if (!lng) {
+			lng = 1;
+		}
+		f++;
+	}
+	switch(*f) {
+	case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+		*arg = lng==3||lng==4?TRACE_ARG_LLONG:lng==2?TRACE_ARG_LONG:TRACE_ARG_INT;
+		break;
+	case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+		*arg = lng==4?TRACE_ARG_LDOUBLE:TRACE_ARG_DOUBLE;
+		break;
+	case 's':
+		*arg = lng?TRACE_ARG_PTR:TRACE_ARG_STR;
+		break;
+	case 'p': case 'n':
+		*arg = TRACE_ARG_PTR;
+		break;
+	case '\0':
+		*arg = TRACE_ARG_NONE;
+		return f;
+	default:
+		*arg = TRACE_ARG_NONE;
+		break;
+	}
+	return f+1;
+}
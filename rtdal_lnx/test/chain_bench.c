@@ -0,0 +1,203 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures the end-to-end latency of a chain of modules connected with internal interfaces in
+ * each of the modes used when the modules are not synchronized to the time slot (best-effort
+ * scheduling): RTDAL_ITF_POLLING, RTDAL_ITF_BLOCKING and RTDAL_ITF_FUTEX.
+ *
+ * Each module is a thread that pops a packet from its input and pushes it to its output. The
+ * first module injects one packet at a time and the last one returns it to the first through a
+ * last interface, so every hop finds its consumer waiting.
+ *
+ * Usage: chain_bench [nof_packets] [nof_modules] [queue]
+ *   queue is one of spscq, lfq or bring (default spscq)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "rtdal.h"
+#include "rtdal_error.h"
+#include "rtdal_time.h"
+#include "rtdal_itf.h"
+#include "rtdal_context.h"
+#include "dataflow.h"
+
+#define DEFAULT_NOF_PACKETS	10000
+#define DEFAULT_NOF_MODULES	10
+#define MAX_MODULES			64
+#define PKT_SZ				64
+#define QUEUE_MSG			8
+
+r_log_t rtdal_log;
+
+/* provided by the kernel and the dataflow workers, unused with the interfaces alone */
+rtdal_context_t rtdal;
+void dataflow_remove_itf(r_itf_t itf) {}
+void dataflow_wake(rtdal_process_t *proc) {}
+
+static rtdal_error_t error_ctx;
+static rtdal_time_t time_ctx;
+
+static int nof_packets;
+static int nof_modules;
+
+/* itfs[i] is the input of module i, module 0 reads from itfs[0] the packets of the last one */
+static r_itf_t itfs[MAX_MODULES];
+static long long *lat_ns;
+
+typedef r_itf_t (*itf_new_t)(int max_msg, int msg_sz, int delay, r_log_t log);
+
+static inline long long now_ns() {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC,&t);
+	return (long long) t.tv_sec*1000000000+t.tv_nsec;
+}
+
+static void *first_module(void *arg) {
+	void *ptr;
+	int len;
+
+	for (int i=0;i<nof_packets;i++) {
+		while (rtdal_itf_request(itfs[1],&ptr) != 1);
+		*((long long*) ptr) = now_ns();
+		rtdal_itf_push(itfs[1],ptr,PKT_SZ,0);
+		while (rtdal_itf_pop(itfs[0],&ptr,&len,0) != 1);
+		lat_ns[i] = now_ns()-*((long long*) ptr);
+		rtdal_itf_release(itfs[0],ptr,len);
+	}
+	return NULL;
+}
+
+static void *module(void *arg) {
+	int idx = (int) (long) arg;
+	r_itf_t in = itfs[idx], out = itfs[(idx+1)%nof_modules];
+	void *iptr, *optr;
+	int len;
+
+	for (int i=0;i<nof_packets;i++) {
+		while (rtdal_itf_pop(in,&iptr,&len,0) != 1);
+		while (rtdal_itf_request(out,&optr) != 1);
+		memcpy(optr,iptr,len);
+		rtdal_itf_push(out,optr,len,0);
+		rtdal_itf_release(in,iptr,len);
+	}
+	return NULL;
+}
+
+static int cmp_ll(const void *a, const void *b) {
+	long long x = *((long long*) a), y = *((long long*) b);
+	return (x>y)-(x<y);
+}
+
+static r_itf_t bring_new(int max_msg, int msg_sz, int delay, r_log_t log) {
+	return rtdal_itfbring_new(max_msg*msg_sz,msg_sz,delay,log);
+}
+
+static int run_bench(char *name, itf_new_t itf_new, int delay) {
+	pthread_t threads[MAX_MODULES];
+	long long sum=0, t0;
+	int i;
+
+	for (i=0;i<nof_modules;i++) {
+		itfs[i] = itf_new(QUEUE_MSG,PKT_SZ,delay,NULL);
+		if (!itfs[i]) {
+			printf("Error creating %s interfaces\n",name);
+			return -1;
+		}
+	}
+	t0 = now_ns();
+	for (i=nof_modules-1;i>=0;i--) {
+		if (pthread_create(&threads[i],NULL,i?module:first_module,(void*) (long) i)) {
+			perror("pthread_create");
+			return -1;
+		}
+	}
+	for (i=0;i<nof_modules;i++) {
+		pthread_join(threads[i],NULL);
+	}
+	t0 = now_ns()-t0;
+
+	qsort(lat_ns,nof_packets,sizeof(long long),cmp_ll);
+	for (i=0;i<nof_packets;i++) {
+		sum += lat_ns[i];
+	}
+	printf("%-8s chain latency (us): mean=%.1f median=%.1f p99=%.1f max=%.1f "
+			"per-hop=%.2f total=%.2f s\n",name,
+			(float) sum/nof_packets/1000, (float) lat_ns[nof_packets/2]/1000,
+			(float) lat_ns[(int) (0.99*nof_packets)]/1000, (float) lat_ns[nof_packets-1]/1000,
+			(float) sum/nof_packets/nof_modules/1000, (float) t0/1000000000);
+
+	for (i=0;i<nof_modules;i++) {
+		rtdal_itf_remove(itfs[i]);
+	}
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	itf_new_t itf_new;
+
+	mlockall(MCL_CURRENT | MCL_FUTURE);
+
+	nof_packets = argc>1?atoi(argv[1]):DEFAULT_NOF_PACKETS;
+	nof_modules = argc>2?atoi(argv[2]):DEFAULT_NOF_MODULES;
+
+	if (argc>3 && !strcmp(argv[3],"lfq")) {
+		itf_new = rtdal_itflfq_new;
+	} else if (argc>3 && !strcmp(argv[3],"bring")) {
+		itf_new = bring_new;
+	} else if (argc<=3 || !strcmp(argv[3],"spscq")) {
+		itf_new = rtdal_itfspscq_new;
+	} else {
+		itf_new = NULL;
+	}
+
+	if (nof_packets <= 0 || nof_modules < 2 || nof_modules > MAX_MODULES || !itf_new) {
+		printf("Usage: %s [nof_packets] [nof_modules] [spscq|lfq|bring]\n",argv[0]);
+		return -1;
+	}
+
+	rtdal_error_set_context(&error_ctx);
+	rtdal_time_set_context(&time_ctx);
+
+	lat_ns = malloc(sizeof(long long)*nof_packets);
+	if (!lat_ns) {
+		perror("malloc");
+		return -1;
+	}
+
+	printf("Running %d packets through a chain of %d modules\n",nof_packets,nof_modules);
+
+	if (run_bench("polling",itf_new,RTDAL_ITF_POLLING)) {
+		return -1;
+	}
+	if (run_bench("blocking",itf_new,RTDAL_ITF_BLOCKING)) {
+		return -1;
+	}
+	if (run_bench("futex",itf_new,RTDAL_ITF_FUTEX)) {
+		return -1;
+	}
+
+	free(lat_ns);
+	return 0;
+}
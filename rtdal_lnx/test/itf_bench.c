@@ -0,0 +1,201 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures the cross-core handoff latency of the internal interfaces. Two threads pinned to
+ * different cores exchange packets in ping-pong through a pair of queues of the same type.
+ * The one-way latency is half the measured round-trip time.
+ *
+ * Usage: itf_bench [nof_packets] [producer_core] [consumer_core] [packet_bytes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "rtdal.h"
+#include "rtdal_error.h"
+#include "rtdal_time.h"
+#include "rtdal_itf.h"
+#include "rtdal_context.h"
+#include "dataflow.h"
+
+#define DEFAULT_NOF_PACKETS	1000000
+#define DEFAULT_PKT_SZ		64
+#define QUEUE_MSG			8
+
+r_log_t rtdal_log;
+
+/* provided by the kernel and the dataflow workers, unused with the interfaces alone */
+rtdal_context_t rtdal;
+void dataflow_remove_itf(r_itf_t itf) {}
+void dataflow_wake(rtdal_process_t *proc) {}
+
+static rtdal_error_t error_ctx;
+static rtdal_time_t time_ctx;
+
+static int nof_packets;
+static int pkt_sz;
+static int cores[2];
+
+static r_itf_t ping, pong;
+static long long *rtt_ns;
+
+typedef r_itf_t (*itf_new_t)(int max_msg, int msg_sz, int delay, r_log_t log);
+
+static inline long long now_ns() {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC,&t);
+	return (long long) t.tv_sec*1000000000+t.tv_nsec;
+}
+
+/* when both threads share the core, spinning only delays the other side */
+static inline void spin() {
+	if (cores[0] == cores[1]) {
+		sched_yield();
+	}
+}
+
+static void pin_thread(int core) {
+	cpu_set_t cpuset;
+	CPU_ZERO(&cpuset);
+	CPU_SET(core, &cpuset);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset)) {
+		printf("Warning could not pin thread to core %d\n",core);
+	}
+}
+
+static void *producer(void *arg) {
+	void *ptr;
+	int len;
+	long long t0;
+
+	pin_thread(cores[0]);
+	for (int i=0;i<nof_packets;i++) {
+		t0 = now_ns();
+		while (rtdal_itf_request(ping,&ptr) != 1) spin();
+		*((int*) ptr) = i;
+		rtdal_itf_push(ping,ptr,pkt_sz,0);
+		while (rtdal_itf_pop(pong,&ptr,&len,0) != 1) spin();
+		if (*((int*) ptr) != i) {
+			printf("Error received packet %d expected %d\n",*((int*) ptr),i);
+		}
+		rtdal_itf_release(pong,ptr,len);
+		rtt_ns[i] = now_ns()-t0;
+	}
+	return NULL;
+}
+
+static void *consumer(void *arg) {
+	void *iptr, *optr;
+	int len;
+
+	pin_thread(cores[1]);
+	for (int i=0;i<nof_packets;i++) {
+		while (rtdal_itf_pop(ping,&iptr,&len,0) != 1) spin();
+		while (rtdal_itf_request(pong,&optr) != 1) spin();
+		*((int*) optr) = *((int*) iptr);
+		rtdal_itf_push(pong,optr,len,0);
+		rtdal_itf_release(ping,iptr,len);
+	}
+	return NULL;
+}
+
+static int cmp_ll(const void *a, const void *b) {
+	long long x = *((long long*) a), y = *((long long*) b);
+	return (x>y)-(x<y);
+}
+
+/* byte ring sized as the slot queues, but packets are stored with their actual length */
+static r_itf_t bring_new(int max_msg, int msg_sz, int delay, r_log_t log) {
+	return rtdal_itfbring_new(max_msg*msg_sz,msg_sz,delay,log);
+}
+
+static int run_bench(char *name, itf_new_t itf_new) {
+	pthread_t threads[2];
+	long long sum=0;
+
+	ping = itf_new(QUEUE_MSG,pkt_sz,0,NULL);
+	pong = itf_new(QUEUE_MSG,pkt_sz,0,NULL);
+	if (!ping || !pong) {
+		printf("Error creating %s interfaces\n",name);
+		return -1;
+	}
+	if (pthread_create(&threads[1],NULL,consumer,NULL)
+			|| pthread_create(&threads[0],NULL,producer,NULL)) {
+		perror("pthread_create");
+		return -1;
+	}
+	pthread_join(threads[0],NULL);
+	pthread_join(threads[1],NULL);
+
+	qsort(rtt_ns,nof_packets,sizeof(long long),cmp_ll);
+	for (int i=0;i<nof_packets;i++) {
+		sum += rtt_ns[i];
+	}
+	printf("%-8s one-way handoff (ns): mean=%.1f median=%lld p99=%lld max=%lld\n",name,
+			(float) sum/nof_packets/2, rtt_ns[nof_packets/2]/2,
+			rtt_ns[(int) (0.99*nof_packets)]/2, rtt_ns[nof_packets-1]/2);
+
+	rtdal_itf_remove(ping);
+	rtdal_itf_remove(pong);
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	mlockall(MCL_CURRENT | MCL_FUTURE);
+
+	nof_packets = argc>1?atoi(argv[1]):DEFAULT_NOF_PACKETS;
+	cores[0] = argc>2?atoi(argv[2]):0;
+	cores[1] = argc>3?atoi(argv[3]):1;
+	pkt_sz = argc>4?atoi(argv[4]):DEFAULT_PKT_SZ;
+
+	if (nof_packets <= 0 || pkt_sz < (int) sizeof(int)) {
+		printf("Usage: %s [nof_packets] [producer_core] [consumer_core] [packet_bytes]\n",argv[0]);
+		return -1;
+	}
+
+	rtdal_error_set_context(&error_ctx);
+	rtdal_time_set_context(&time_ctx);
+
+	rtt_ns = malloc(sizeof(long long)*nof_packets);
+	if (!rtt_ns) {
+		perror("malloc");
+		return -1;
+	}
+
+	printf("Running %d packets of %d bytes between cores %d and %d\n",nof_packets,pkt_sz,
+			cores[0],cores[1]);
+
+	if (run_bench("spscq",rtdal_itfspscq_new)) {
+		return -1;
+	}
+	if (run_bench("lfq",rtdal_itflfq_new)) {
+		return -1;
+	}
+	if (run_bench("bring",bring_new)) {
+		return -1;
+	}
+
+	free(rtt_ns);
+	return 0;
+}
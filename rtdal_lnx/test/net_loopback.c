@@ -0,0 +1,200 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Loopback test of the physical interfaces. For each kind of address, an "out" and an "in"
+ * interface of the same process exchange bursts of packets of different lengths. The test checks
+ * the payload, the length, the order and the metadata of every packet. Bursts are shorter than
+ * the batch of the network interfaces, so the packets only arrive if rtdal_itfphysic_flush()
+ * sends the incomplete batches, as it does after each module execution.
+ *
+ * Usage: net_loopback [base_port]
+ *
+ * Returns 0 if all the packets were received correctly.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "rtdal.h"
+#include "rtdal_error.h"
+#include "rtdal_time.h"
+#include "rtdal_itf.h"
+#include "rtdal_itfphysic.h"
+#include "rtdal_context.h"
+#include "dataflow.h"
+
+#define DEFAULT_BASE_PORT	45100
+#define NOF_PACKETS			200
+#define BURST				3
+#define BATCH				8
+#define MAX_MSG				32
+#define MSG_SZ				512
+#define TIMEOUT_US			1000000
+#define POLL_US				1000
+
+r_log_t rtdal_log;
+
+/* provided by the kernel and the dataflow workers, unused with the interfaces alone */
+rtdal_context_t rtdal;
+void dataflow_remove_itf(r_itf_t itf) {}
+void dataflow_wake(rtdal_process_t *proc) {}
+
+static rtdal_error_t error_ctx;
+static rtdal_time_t time_ctx;
+
+static rtdal_itfphysic_t itf_in, itf_out;
+
+static int pkt_len(int i) {
+	return 8+(i*37)%(MSG_SZ-8);
+}
+
+static void pkt_fill(char *ptr, char *meta, int i) {
+	int k;
+	for (k=0;k<pkt_len(i);k++) {
+		ptr[k] = (char) (i+k);
+	}
+	memset(meta,i,RTDAL_PKT_META_SZ);
+}
+
+static int pkt_check(char *ptr, int len, char *meta, int i) {
+	int k;
+	if (len != pkt_len(i)) {
+		printf("packet %d: length %d, expected %d\n",i,len,pkt_len(i));
+		return -1;
+	}
+	for (k=0;k<len;k++) {
+		if (ptr[k] != (char) (i+k)) {
+			printf("packet %d: wrong byte %d\n",i,k);
+			return -1;
+		}
+	}
+	for (k=0;k<RTDAL_PKT_META_SZ;k++) {
+		if (meta[k] != (char) i) {
+			printf("packet %d: wrong metadata byte %d\n",i,k);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int send_packet(int i) {
+	void *ptr;
+	int n, t;
+	for (t=0;(n = rtdal_itf_request((r_itf_t) &itf_out,&ptr)) == 0 && t<TIMEOUT_US;t+=POLL_US) {
+		usleep(POLL_US);
+	}
+	if (n != 1) {
+		printf("packet %d: request returned %d\n",i,n);
+		return -1;
+	}
+	pkt_fill(ptr,rtdal_itf_meta((r_itf_t) &itf_out,ptr),i);
+	if (rtdal_itf_push((r_itf_t) &itf_out,ptr,pkt_len(i),0) != 1) {
+		printf("packet %d: push failed\n",i);
+		return -1;
+	}
+	return 0;
+}
+
+/* receives the packets first..last-1 */
+static int recv_packets(int first, int last) {
+	void *ptr;
+	int i, n, len, t;
+	for (i=first;i<last;i++) {
+		for (t=0;(n = rtdal_itf_pop((r_itf_t) &itf_in,&ptr,&len,0)) == 0 && t<TIMEOUT_US;
+				t+=POLL_US) {
+			usleep(POLL_US);
+		}
+		if (n != 1) {
+			printf("packet %d: not received (%d)\n",i,n);
+			return -1;
+		}
+		if (pkt_check(ptr,len,rtdal_itf_meta((r_itf_t) &itf_in,ptr),i)) {
+			return -1;
+		}
+		if (rtdal_itf_release((r_itf_t) &itf_in,ptr,len) != 1) {
+			printf("packet %d: release failed\n",i);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int run_test(char *address) {
+	int i, j, ret = -1;
+
+	memset(&itf_in,0,sizeof(rtdal_itfphysic_t));
+	itf_in.parent.mode_is_input = 1;
+	itf_in.parent.delay = -1;
+	itf_in.max_msg = MAX_MSG;
+	itf_in.msg_sz = MSG_SZ;
+	itf_in.batch = BATCH;
+	itf_out = itf_in;
+	itf_out.parent.mode_is_input = 0;
+
+	if (rtdal_itfphysic_create((r_itf_t) &itf_in,address)
+			|| rtdal_itfphysic_create((r_itf_t) &itf_out,address)) {
+		printf("%s: error creating the interfaces\n",address);
+		return -1;
+	}
+	if (rtdal_itfphysic_connect((r_itf_t) &itf_in)) {
+		printf("%s: error connecting the input\n",address);
+		return -1;
+	}
+	if (rtdal_itfphysic_connect((r_itf_t) &itf_out)) {
+		printf("%s: error connecting the output\n",address);
+		goto out;
+	}
+	for (i=0;i<NOF_PACKETS;i+=BURST) {
+		for (j=i;j<i+BURST && j<NOF_PACKETS;j++) {
+			if (send_packet(j)) {
+				goto out;
+			}
+		}
+		rtdal_itfphysic_flush();
+		if (recv_packets(i,j)) {
+			goto out;
+		}
+	}
+	printf("%s: %d packets ok\n",address,NOF_PACKETS);
+	ret = 0;
+out:
+	rtdal_itfphysic_disconnect((r_itf_t) &itf_out);
+	rtdal_itfphysic_disconnect((r_itf_t) &itf_in);
+	return ret;
+}
+
+int main(int argc, char **argv) {
+	char address[64];
+	int port = argc>1?atoi(argv[1]):DEFAULT_BASE_PORT;
+	int ret = 0;
+
+	rtdal_error_set_context(&error_ctx);
+	rtdal_time_set_context(&time_ctx);
+
+	snprintf(address,64,"shm://net_loopback_%d",port);
+	ret |= run_test(address);
+	snprintf(address,64,"udp://127.0.0.1:%d",port);
+	ret |= run_test(address);
+	snprintf(address,64,"tcp://127.0.0.1:%d",port+1);
+	ret |= run_test(address);
+
+	return ret?-1:0;
+}
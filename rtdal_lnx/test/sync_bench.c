@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ *
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures how long the pipeline threads take to wake up at the beginning of a time slot with
+ * each of the synchronization modes of pipeline_sync.c.
+ *
+ * The main thread plays the kernel timer: it sleeps until the next time slot and calls
+ * pipeline_sync_threads_wake(). Each pipeline thread, pinned to its own core when there are
+ * enough, records the time it returns from pipeline_sync_thread_waits(). For every time slot,
+ * the latency is the delay of the first thread and the skew the difference between the last
+ * and the first one. Time slots missed by some thread are not counted.
+ *
+ * FUTEX is not measured, a thread not yet waiting when the time slot starts misses it. Neither is
+ * BARRIER, where the timer also waits for the pipelines that are late.
+ *
+ * Usage: sync_bench [nof_slots] [nof_pipelines] [slot_us] [spin_us]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "pipeline_sync.h"
+
+#define DEFAULT_NOF_SLOTS		4000
+#define DEFAULT_NOF_PIPELINES	4
+#define DEFAULT_SLOT_US			250
+#define DEFAULT_SPIN_US			50
+
+static int nof_slots;
+static int nof_pipelines;
+static int slot_us;
+
+/* wake_ns[s] is when slot s was started, run_ns[s*nof_pipelines+i] when pipeline i started it */
+static long long *wake_ns;
+static long long *run_ns;
+static int cur_slot;
+static volatile int stop;
+
+static inline long long now_ns() {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC,&t);
+	return (long long) t.tv_sec*1000000000+t.tv_nsec;
+}
+
+static void set_affinity_prio(int core, int prio) {
+	cpu_set_t set;
+	struct sched_param param;
+	int nof_cpus = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+	CPU_ZERO(&set);
+	CPU_SET(core%nof_cpus, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set);
+	/* only as root */
+	param.sched_priority = prio;
+	pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+}
+
+static void *pipeline(void *arg) {
+	int idx = (int) (long) arg;
+	int s;
+
+	set_affinity_prio(idx+1, 50);
+	while (1) {
+		pipeline_sync_thread_waits(idx);
+		if (stop) {
+			break;
+		}
+		/* the main thread writes the slot number before waking up */
+		s = __atomic_load_n(&cur_slot, __ATOMIC_ACQUIRE);
+		run_ns[s*nof_pipelines+idx] = now_ns();
+	}
+	return NULL;
+}
+
+static int cmp_ll(const void *a, const void *b) {
+	long long x = *((long long*) a), y = *((long long*) b);
+	return (x>y)-(x<y);
+}
+
+static int run_bench(char *name, int mode, int spin_us) {
+	pthread_t threads[MAX_PIPELINES];
+	struct timespec next;
+	long long *lat, *skew, first, last;
+	int i, s, n=0, missed=0;
+
+	if (pipeline_sync_initialize(nof_pipelines, mode, spin_us)) {
+		printf("Error initializing %s\n",name);
+		return -1;
+	}
+	memset(run_ns, 0, sizeof(long long)*nof_slots*nof_pipelines);
+	stop = 0;
+	for (i=0;i<nof_pipelines;i++) {
+		if (pthread_create(&threads[i],NULL,pipeline,(void*) (long) i)) {
+			perror("pthread_create");
+			return -1;
+		}
+	}
+	set_affinity_prio(0, 60);
+	usleep(100000);
+
+	clock_gettime(CLOCK_MONOTONIC,&next);
+	for (s=0;s<nof_slots+1;s++) {
+		next.tv_nsec += slot_us*1000;
+		if (next.tv_nsec >= 1000000000) {
+			next.tv_nsec -= 1000000000;
+			next.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		if (s == nof_slots) {
+			stop = 1;
+		} else {
+			wake_ns[s] = now_ns();
+			__atomic_store_n(&cur_slot, s, __ATOMIC_RELEASE);
+		}
+		pipeline_sync_threads_wake();
+	}
+	for (i=0;i<nof_pipelines;i++) {
+		pthread_join(threads[i],NULL);
+	}
+
+	lat = malloc(sizeof(long long)*nof_slots);
+	skew = malloc(sizeof(long long)*nof_slots);
+	if (!lat || !skew) {
+		perror("malloc");
+		return -1;
+	}
+	for (s=0;s<nof_slots;s++) {
+		first = last = run_ns[s*nof_pipelines];
+		for (i=0;i<nof_pipelines;i++) {
+			if (!run_ns[s*nof_pipelines+i]) {
+				break;
+			}
+			if (run_ns[s*nof_pipelines+i] < first) {
+				first = run_ns[s*nof_pipelines+i];
+			}
+			if (run_ns[s*nof_pipelines+i] > last) {
+				last = run_ns[s*nof_pipelines+i];
+			}
+		}
+		if (i < nof_pipelines) {
+			missed++;
+			continue;
+		}
+		lat[n] = first-wake_ns[s];
+		skew[n] = last-first;
+		n++;
+	}
+	if (!n) {
+		printf("%-8s all time slots missed\n",name);
+	} else {
+		qsort(lat,n,sizeof(long long),cmp_ll);
+		qsort(skew,n,sizeof(long long),cmp_ll);
+		printf("%-8s latency (us): median=%.1f p99=%.1f max=%.1f  skew (us): median=%.1f "
+				"p99=%.1f max=%.1f  missed=%d\n",name,
+				(float) lat[n/2]/1000, (float) lat[(int) (0.99*n)]/1000, (float) lat[n-1]/1000,
+				(float) skew[n/2]/1000, (float) skew[(int) (0.99*n)]/1000, (float) skew[n-1]/1000,
+				missed);
+	}
+	free(lat);
+	free(skew);
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	int spin_us;
+
+	mlockall(MCL_CURRENT | MCL_FUTURE);
+
+	nof_slots = argc>1?atoi(argv[1]):DEFAULT_NOF_SLOTS;
+	nof_pipelines = argc>2?atoi(argv[2]):DEFAULT_NOF_PIPELINES;
+	slot_us = argc>3?atoi(argv[3]):DEFAULT_SLOT_US;
+	spin_us = argc>4?atoi(argv[4]):DEFAULT_SPIN_US;
+
+	if (nof_slots <= 0 || nof_pipelines < 1 || nof_pipelines > MAX_PIPELINES || slot_us <= 0
+			|| spin_us < 0) {
+		printf("Usage: %s [nof_slots] [nof_pipelines] [slot_us] [spin_us]\n",argv[0]);
+		return -1;
+	}
+
+	wake_ns = malloc(sizeof(long long)*nof_slots);
+	run_ns = malloc(sizeof(long long)*nof_slots*nof_pipelines);
+	if (!wake_ns || !run_ns) {
+		perror("malloc");
+		return -1;
+	}
+
+	printf("Waking up %d pipelines every %d us during %d time slots\n",nof_pipelines,slot_us,
+			nof_slots);
+
+	if (run_bench("sem",SEM,0)) {
+		return -1;
+	}
+	if (run_bench("condvar",CONDVAR,0)) {
+		return -1;
+	}
+	if (run_bench("epoch",EPOCH,0)) {
+		return -1;
+	}
+	if (spin_us && run_bench("epoch+spin",EPOCH,spin_us)) {
+		return -1;
+	}
+
+	free(wake_ns);
+	free(run_ns);
+	return 0;
+}
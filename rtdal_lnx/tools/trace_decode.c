@@ -0,0 +1,601 @@
+/* 
+ * Copyright (c) 2012, Ismael Gomez-Miguelez <ismael.gomez@tsc.upc.edu>.
+ * This file is part of ALOE++ (http://flexnets.upc.edu/)
+ * 
+ * ALOE++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * ALOE++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with ALOE++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Converts the binary trace written with the log_trace option (see src/rtdal_trace.c) into the
+ * same log files that the logs write at exit without it, in output_dir (default: the directory
+ * of the trace file). Text logs get the formatted strings, binary logs the data. With -t, it also
+ * prints every record to stdout, in file order, with its time and thread.
+ *
+ * With -j, the timeline recorded with the log_timeline option is also written to json_file in the
+ * Chrome trace event format, which can be opened with chrome://tracing or ui.perfetto.dev. Each
+ * pipeline is a track with the execution of its processes, the beginning of the time slots and the
+ * RT faults. The packets pushed and popped and the waits of blocking interfaces go to the track of
+ * the pipeline of the thread, or to a track of their own for other threads.
+ *
+ * A trace of a program that did not exit cleanly is decoded up to the last record flushed.
+ *
+ * Usage: trace_decode [-t] [-j json_file] trace_file [output_dir]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "rtdal_types.h"
+#include "rtdal_trace.h"
+
+#define MAX_LOG_ID	65536
+#define FMT_HASH	4096
+#define MAX_TRACKS	1024
+#define TRACK_OTHER	1000	/* track of the threads that are not pipelines: TRACK_OTHER+thread */
+
+typedef struct fmt_ {
+	uint64_t ptr;
+	const char *str;
+	struct fmt_ *next;
+} fmt_t;
+
+typedef struct {
+	const char *name;
+	uint32_t mode;
+	FILE *f;
+	long long records;
+} log_info_t;
+
+/* the pipeline run by each thread, found in the first pass */
+typedef struct {
+	uint32_t tid;
+	int pipeline;
+} track_t;
+
+static log_info_t logs[MAX_LOG_ID];
+static fmt_t *fmts[FMT_HASH];
+static fmt_t *objects[FMT_HASH];
+static track_t tracks[MAX_TRACKS];
+static int pipelines[MAX_TRACKS];
+static int others[MAX_TRACKS];
+static char *output_dir;
+static int timeline;
+static FILE *json;
+static uint64_t start_ns;
+
+static const char *fmt_find(fmt_t **fmts, uint64_t ptr) {
+	fmt_t *f;
+	for (f=fmts[(ptr>>3)&(FMT_HASH-1)];f;f=f->next) {
+		if (f->ptr == ptr) {
+			return f->str;
+		}
+	}
+	return NULL;
+}
+
+/* a later definition of the same pointer (a module reloaded) replaces the previous one */
+static int fmt_add(fmt_t **fmts, uint64_t ptr, const char *str) {
+	fmt_t *f;
+	for (f=fmts[(ptr>>3)&(FMT_HASH-1)];f;f=f->next) {
+		if (f->ptr == ptr) {
+			f->str = str;
+			return 0;
+		}
+	}
+	f = malloc(sizeof(fmt_t));
+	if (!f) {
+		perror("malloc");
+		return -1;
+	}
+	f->ptr = ptr;
+	f->str = str;
+	f->next = fmts[(ptr>>3)&(FMT_HASH-1)];
+	fmts[(ptr>>3)&(FMT_HASH-1)] = f;
+	return 0;
+}
+
+static FILE *log_file(int id) {
+	char tmp[1024];
+
+	if (!logs[id].name) {
+		return NULL;
+	}
+	if (!logs[id].f) {
+		snprintf(tmp, sizeof(tmp), "%s/%s", output_dir, logs[id].name);
+		logs[id].f = fopen(tmp, logs[id].mode==TEXT?"w":"wb");
+		if (!logs[id].f) {
+			perror(tmp);
+			logs[id].name = NULL;
+		}
+	}
+	return logs[id].f;
+}
+
+static inline uint64_t get64(char **p) {
+	uint64_t x;
+	memcpy(&x, *p, sizeof(uint64_t));
+	*p += sizeof(uint64_t);
+	return x;
+}
+
+static track_t *track_find(uint32_t tid) {
+	int i, n;
+	for (i=tid%MAX_TRACKS,n=0;n<MAX_TRACKS;i=(i+1)%MAX_TRACKS,n++) {
+		if (!tracks[i].tid || tracks[i].tid == tid) {
+			return &tracks[i];
+		}
+	}
+	return NULL;
+}
+
+/* a thread that started a time slot is running that pipeline */
+static void track_set(uint32_t tid, int pipeline) {
+	track_t *t = track_find(tid);
+	if (t && !t->tid) {
+		t->tid = tid;
+		t->pipeline = pipeline;
+	}
+	if (pipeline >= 0 && pipeline < TRACK_OTHER) {
+		pipelines[pipeline%MAX_TRACKS] = 1;
+	}
+}
+
+static int track_get(uint32_t thread, uint32_t tid) {
+	track_t *t = track_find(tid);
+	if (t && t->tid) {
+		return t->pipeline;
+	}
+	others[thread%MAX_TRACKS] = 1;
+	return TRACK_OTHER+(int) thread;
+}
+
+static void json_str(const char *prefix, const char *s) {
+	fputc('"', json);
+	fputs(prefix, json);
+	for (;*s;s++) {
+		if (*s == '"' || *s == '\\') {
+			fprintf(json, "\\%c", *s);
+		} else if ((unsigned char) *s < 0x20) {
+			fprintf(json, "\\u%04x", *s);
+		} else {
+			fputc(*s, json);
+		}
+	}
+	fputc('"', json);
+}
+
+static void json_name(const char *prefix, uint64_t obj, const char *unnamed) {
+	char tmp[64];
+	const char *name = fmt_find(objects, obj);
+	if (!name) {
+		snprintf(tmp, sizeof(tmp), "%s 0x%llx", unnamed, (unsigned long long) obj);
+		name = tmp;
+	}
+	json_str(prefix, name);
+}
+
+/* opens an event, the caller adds its own fields and closes it */
+static void json_event(const char *cat, char ph, uint64_t time_ns, int track) {
+	fprintf(json, ",\n{\"cat\":\"%s\",\"ph\":\"%c\",\"pid\":0,\"tid\":%d,\"ts\":%.3f", cat, ph,
+			track, (double) (int64_t) (time_ns-start_ns)/1000);
+	if (ph == 'i') {
+		fprintf(json, ",\"s\":\"t\"");
+	}
+	fprintf(json, ",\"name\":");
+}
+
+static int timeline_len[] = {
+	[TRACE_SLOT] = sizeof(trace_slot_t), [TRACE_EXEC] = sizeof(trace_exec_t),
+	[TRACE_FAULT] = sizeof(trace_fault_t), [TRACE_ITF] = sizeof(trace_itf_t),
+	[TRACE_WAIT] = sizeof(trace_wait_t)
+};
+
+static void json_timeline(trace_rec_t *rec, char *payload, uint32_t thread, uint32_t tid) {
+	trace_slot_t slot;
+	trace_exec_t exec;
+	trace_fault_t fault;
+	trace_itf_t itf;
+	trace_wait_t wait;
+	char tmp[64];
+
+	if (rec->len < timeline_len[rec->type]) {
+		return;
+	}
+	switch(rec->type) {
+	case TRACE_SLOT:
+		memcpy(&slot, payload, sizeof(slot));
+		json_event("slot", 'i', rec->time_ns, slot.pipeline);
+		snprintf(tmp, sizeof(tmp), "slot %d", slot.tslot);
+		json_str("", tmp);
+		fprintf(json, "}");
+		break;
+	case TRACE_EXEC:
+		memcpy(&exec, payload, sizeof(exec));
+		json_event("exec", 'X', exec.begin_ns, exec.pipeline);
+		json_name("", exec.proc, "process");
+		fprintf(json, ",\"dur\":%.3f,\"args\":{\"tslot\":%d}}",
+				(double) (int64_t) (rec->time_ns-exec.begin_ns)/1000, exec.tslot);
+		break;
+	case TRACE_FAULT:
+		memcpy(&fault, payload, sizeof(fault));
+		json_event("fault", 'i', rec->time_ns, fault.pipeline);
+		fprintf(json, "\"rtfault\",\"args\":{\"tslot\":%d,\"process\":", fault.tslot);
+		if (fault.proc) {
+			json_name("", fault.proc, "process");
+		} else {
+			fprintf(json, "null");
+		}
+		fprintf(json, "}}");
+		break;
+	case TRACE_ITF:
+		memcpy(&itf, payload, sizeof(itf));
+		json_event("itf", 'i', rec->time_ns, track_get(thread, tid));
+		json_name(itf.op==TRACE_ITF_PUSH?"push ":"pop ", itf.itf, "itf");
+		fprintf(json, ",\"args\":{\"len\":%d}}", itf.len);
+		break;
+	case TRACE_WAIT:
+		memcpy(&wait, payload, sizeof(wait));
+		json_event("wait", 'X', wait.begin_ns, track_get(thread, tid));
+		json_name("wait ", wait.itf, "itf");
+		fprintf(json, ",\"dur\":%.3f}", (double) (int64_t) (rec->time_ns-wait.begin_ns)/1000);
+		break;
+	}
+}
+
+static void json_begin() {
+	fprintf(json, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+			"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"rtdal\"}}");
+}
+
+static void json_end() {
+	int i;
+	for (i=0;i<MAX_TRACKS;i++) {
+		if (pipelines[i]) {
+			fprintf(json, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,"
+					"\"args\":{\"name\":\"pipeline %d\"}}", i, i);
+			fprintf(json, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,"
+					"\"args\":{\"sort_index\":%d}}", i, i);
+		}
+		if (others[i]) {
+			fprintf(json, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,"
+					"\"args\":{\"name\":\"thread %d\"}}", TRACK_OTHER+i, i);
+		}
+	}
+	fprintf(json, "\n]}\n");
+}
+
+/**
+ * Prints the arguments stored by rtdal_trace_vprintf() with the format, one conversion at a
+ * time, replacing the '*' widths and precisions with their values.
+ */
+static void print_fmt(FILE *out, const char *format, char *p, char *end) {
+	const char *f = format, *prev = format, *spec;
+	char conv[64], *c;
+	int stars, arg, i, j, star[2];
+	uint32_t n;
+	uint64_t x;
+	double d;
+
+	while((f = trace_fmt_next(f, &spec, &stars, &arg))) {
+		fwrite(prev, 1, spec-prev, out);
+		prev = f;
+		if (p+(stars+(arg!=TRACE_ARG_NONE))*sizeof(uint64_t) > end) {
+			fprintf(out, "<truncated>");
+			return;
+		}
+		for (i=0;i<stars;i++) {
+			star[i<2?i:1] = (int) (int64_t) get64(&p);
+		}
+		c = conv;
+		j = 0;
+		for (i=0;spec+i<f && c<conv+sizeof(conv)-16;i++) {
+			if (spec[i] == '*') {
+				c += sprintf(c, "%d", star[j<2?j:1]);
+				j++;
+			} else {
+				*c++ = spec[i];
+			}
+		}
+		*c = '\0';
+		switch(arg) {
+		case TRACE_ARG_NONE:
+			fprintf(out, "%s", strcmp(conv,"%%")?conv:"%");
+			break;
+		case TRACE_ARG_INT:
+			fprintf(out, conv, (int) get64(&p));
+			break;
+		case TRACE_ARG_LONG:
+			fprintf(out, conv, (long) get64(&p));
+			break;
+		case TRACE_ARG_LLONG:
+			fprintf(out, conv, (long long) get64(&p));
+			break;
+		case TRACE_ARG_DOUBLE:
+			memcpy(&d, p, sizeof(double));
+			p += sizeof(uint64_t);
+			fprintf(out, conv, d);
+			break;
+		case TRACE_ARG_LDOUBLE:
+			memcpy(&d, p, sizeof(double));
+			p += sizeof(uint64_t);
+			fprintf(out, conv, (long double) d);
+			break;
+		case TRACE_ARG_PTR:
+			x = get64(&p);
+			if (f[-1] != 'n') {
+				fprintf(out, "0x%llx", (unsigned long long) x);
+			}
+			break;
+		case TRACE_ARG_STR:
+			memcpy(&n, p, sizeof(uint32_t));
+			if (p+sizeof(uint32_t)+n > end) {
+				fprintf(out, "<truncated>");
+				return;
+			}
+			conv[strlen(conv)-1] = '\0';
+			strcat(conv, ".*s");
+			fprintf(out, conv, (int) n, p+sizeof(uint32_t));
+			p += (sizeof(uint32_t)+n+TRACE_ALIGN-1)&~(TRACE_ALIGN-1);
+			break;
+		}
+	}
+	fprintf(out, "%s", prev);
+}
+
+/* as rtdal_log_add_us() and rtdal_log_add_tslot() write them */
+static void print_value(FILE *out, int mode, uint32_t x) {
+	switch(mode) {
+	case TEXT:
+		fprintf(out, "%u, ", x);
+		break;
+	default:
+		fwrite(&x, sizeof(uint32_t), 1, out);
+		break;
+	}
+}
+
+/**
+ * Walks the records of the file. In the first pass only collects the log names, which may be
+ * written by a thread different from the ones using the log, the names of the processes and
+ * interfaces and the pipeline of each thread.
+ */
+static int decode(char *data, size_t size, int names_only) {
+	char *p = data, *payload, *end;
+	trace_rec_t *rec;
+	uint32_t thread = 0, tid = 0, x;
+	uint64_t dropped, ptr;
+	const char *fmt;
+	trace_slot_t slot;
+	FILE *f;
+
+	while(p+sizeof(trace_rec_t) <= data+size) {
+		rec = (trace_rec_t*) p;
+		if (rec->type == TRACE_NONE) {
+			break;
+		}
+		if (p+TRACE_REC_SZ(rec->len) > data+size) {
+			fprintf(stderr, "Record truncated at offset %ld\n", (long) (p-data));
+			break;
+		}
+		payload = (char*) (rec+1);
+		end = payload+rec->len;
+		p += TRACE_REC_SZ(rec->len);
+
+		if (names_only) {
+			if (rec->type == TRACE_THREAD) {
+				memcpy(&thread, payload, sizeof(uint32_t));
+				memcpy(&tid, payload+sizeof(uint32_t), sizeof(uint32_t));
+			} else if (rec->type == TRACE_NAME && rec->len > sizeof(uint32_t)) {
+				memcpy(&logs[rec->log_id].mode, payload, sizeof(uint32_t));
+				end[-1] = '\0';
+				logs[rec->log_id].name = payload+sizeof(uint32_t);
+			} else if (rec->type == TRACE_OBJECT && rec->len > sizeof(uint64_t)) {
+				end[-1] = '\0';
+				ptr = get64(&payload);
+				if (fmt_add(objects, ptr, payload)) {
+					return -1;
+				}
+			} else if (rec->type == TRACE_SLOT && rec->len >= sizeof(trace_slot_t)) {
+				memcpy(&slot, payload, sizeof(slot));
+				track_set(tid, slot.pipeline);
+			}
+			continue;
+		}
+		if (json && rec->type >= TRACE_SLOT && rec->type <= TRACE_WAIT) {
+			json_timeline(rec, payload, thread, tid);
+		}
+		if (timeline && rec->type != TRACE_FMT && rec->type != TRACE_THREAD
+				&& rec->type != TRACE_OBJECT && rec->type != TRACE_PAD) {
+			printf("%llu.%09llu [%u:%u] %s: ", (unsigned long long) rec->time_ns/1000000000,
+					(unsigned long long) rec->time_ns%1000000000, thread, tid,
+					logs[rec->log_id].name?logs[rec->log_id].name:"-");
+		}
+		f = NULL;
+		if (rec->type >= TRACE_DATA && rec->type <= TRACE_PRINTF && rec->type != TRACE_FMT) {
+			f = log_file(rec->log_id);
+			logs[rec->log_id].records++;
+		}
+		switch(rec->type) {
+		case TRACE_HEADER:
+			if (timeline) {
+				printf("trace start\n");
+			}
+			break;
+		case TRACE_THREAD:
+			memcpy(&thread, payload, sizeof(uint32_t));
+			memcpy(&tid, payload+sizeof(uint32_t), sizeof(uint32_t));
+			break;
+		case TRACE_NAME:
+			if (timeline) {
+				printf("log created\n");
+			}
+			break;
+		case TRACE_DATA:
+			if (f) {
+				fwrite(payload, 1, rec->len, f);
+			}
+			if (timeline) {
+				printf("%u bytes\n", rec->len);
+			}
+			break;
+		case TRACE_US:
+			x = (uint32_t) (rec->time_ns%1000000000/1000);
+			if (f) {
+				print_value(f, logs[rec->log_id].mode, x);
+			}
+			if (timeline) {
+				printf("us\n");
+			}
+			break;
+		case TRACE_TSLOT:
+			memcpy(&x, payload, sizeof(uint32_t));
+			if (f) {
+				print_value(f, logs[rec->log_id].mode, x);
+			}
+			if (timeline) {
+				printf("tslot %d\n", (int) x);
+			}
+			break;
+		case TRACE_FMT:
+			end[-1] = '\0';
+			ptr = get64(&payload);
+			if (fmt_add(fmts, ptr, payload)) {
+				return -1;
+			}
+			break;
+		case TRACE_PRINTF:
+			fmt = fmt_find(fmts, get64(&payload));
+			if (!fmt) {
+				fmt = "<unknown format>\n";
+			}
+			if (f) {
+				print_fmt(f, fmt, payload, end);
+			}
+			if (timeline) {
+				print_fmt(stdout, fmt, payload, end);
+			}
+			break;
+		case TRACE_DROP:
+			memcpy(&dropped, payload, sizeof(uint64_t));
+			fprintf(stderr, "Thread %u (tid %u): %llu records dropped\n", thread, tid,
+					(unsigned long long) dropped);
+			if (timeline) {
+				printf("%llu records dropped\n", (unsigned long long) dropped);
+			}
+			break;
+		case TRACE_PAD:
+		case TRACE_OBJECT:
+			break;
+		case TRACE_SLOT:
+		case TRACE_EXEC:
+		case TRACE_FAULT:
+		case TRACE_ITF:
+		case TRACE_WAIT:
+			if (timeline) {
+				printf("timeline event\n");
+			}
+			break;
+		default:
+			if (timeline) {
+				printf("unknown record type %d\n", rec->type);
+			}
+			break;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	struct stat st;
+	char *data;
+	trace_rec_t *rec;
+	uint64_t magic;
+	char *json_file = NULL;
+	int fd, i, opt;
+
+	while((opt = getopt(argc, argv, "tj:")) != -1) {
+		if (opt == 't') {
+			timeline = 1;
+		} else if (opt == 'j') {
+			json_file = optarg;
+		} else {
+			printf("Usage: %s [-t] [-j json_file] trace_file [output_dir]\n",argv[0]);
+			return -1;
+		}
+	}
+	if (optind >= argc) {
+		printf("Usage: %s [-t] [-j json_file] trace_file [output_dir]\n",argv[0]);
+		return -1;
+	}
+	fd = open(argv[optind], O_RDONLY);
+	if (fd < 0 || fstat(fd, &st)) {
+		perror(argv[optind]);
+		return -1;
+	}
+	if (st.st_size < (off_t) TRACE_REC_SZ(sizeof(uint64_t))) {
+		printf("%s: empty trace\n", argv[optind]);
+		return -1;
+	}
+	/* private, the records are modified to terminate the strings */
+	data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED) {
+		perror("mmap");
+		return -1;
+	}
+	rec = (trace_rec_t*) data;
+	memcpy(&magic, rec+1, sizeof(uint64_t));
+	if (rec->type != TRACE_HEADER || magic != TRACE_MAGIC) {
+		printf("%s: not a trace file\n", argv[optind]);
+		return -1;
+	}
+	if (optind+1 < argc) {
+		output_dir = argv[optind+1];
+	} else {
+		output_dir = dirname(strdup(argv[optind]));
+	}
+
+	if (json_file) {
+		json = fopen(json_file, "w");
+		if (!json) {
+			perror(json_file);
+			return -1;
+		}
+		start_ns = rec->time_ns;
+		json_begin();
+	}
+
+	if (decode(data, st.st_size, 1) || decode(data, st.st_size, 0)) {
+		return -1;
+	}
+	if (json) {
+		json_end();
+		fclose(json);
+	}
+	for (i=0;i<MAX_LOG_ID;i++) {
+		if (logs[i].f) {
+			fclose(logs[i].f);
+			fprintf(stderr, "%s/%s: %lld records\n", output_dir, logs[i].name, logs[i].records);
+		}
+	}
+	munmap(data, st.st_size);
+	close(fd);
+	return 0;
+}